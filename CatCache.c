@@ -0,0 +1,395 @@
+/*
+ * CBLibrary: Cache of catalogue information read from the filing system
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* History:
+  CJB: 16-Oct-26: Created this source file.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <limits.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBUtilLib headers */
+#include "StrExtra.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSFile.h"
+#include "OSReadTime.h"
+
+/* Local headers */
+#include "Internal/CBMisc.h"
+#include "CatCache.h"
+
+enum
+{
+  NoEntry = -1
+};
+
+/* Parameters of the 32-bit FNV-1a hash function */
+#define FNVOffsetBasis 2166136261u
+#define FNVPrime 16777619u
+
+/* Catalogue information about one object. Entries are chained from a hash
+   table bucket, or from the free list if not in use. */
+typedef struct
+{
+  char                  *path_name; /* NULL if not in use */
+  unsigned int           hash;
+  int                    time_stored;
+  int                    next; /* Index of the next entry in the same chain,
+                                  or NoEntry */
+  OS_File_CatalogueInfo  info;
+}
+CatCacheEntry;
+
+static struct
+{
+  CatCacheEntry *entries;
+  int           *buckets; /* Index of the first entry in each chain */
+  size_t         capacity;
+  size_t         nbuckets; /* Power of two */
+  size_t         next_victim; /* Index of the next entry to be evicted */
+  int            free_list;
+  int            lifetime;
+  CatCacheStats  stats;
+}
+cache;
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static unsigned int hash_string(unsigned int hash, const char *s)
+{
+  assert(s != NULL);
+  for (; *s != '\0'; ++s)
+  {
+    hash ^= (unsigned char)tolower((unsigned char)*s);
+    hash *= FNVPrime;
+  }
+  return hash;
+}
+
+static unsigned int hash_path(const char *dir_name, const char *leaf_name)
+{
+  unsigned int hash = FNVOffsetBasis;
+
+  if (dir_name != NULL)
+  {
+    hash = hash_string(hash, dir_name);
+    hash = hash_string(hash, ".");
+  }
+  return hash_string(hash, leaf_name);
+}
+
+static bool path_equals(const char *path_name, const char *dir_name,
+                        const char *leaf_name)
+{
+  assert(path_name != NULL);
+  assert(leaf_name != NULL);
+
+  if (dir_name != NULL)
+  {
+    const size_t dir_len = strlen(dir_name);
+    if (strnicmp(path_name, dir_name, dir_len) != 0 ||
+        path_name[dir_len] != '.')
+    {
+      return false;
+    }
+    path_name += dir_len + 1;
+  }
+  return stricmp(path_name, leaf_name) == 0;
+}
+
+static int *find_link(const char *dir_name, const char *leaf_name,
+                      unsigned int hash)
+{
+  /* Find the link to the matching entry, or else to NoEntry at the end of
+     the chain. */
+  int *link = &cache.buckets[hash & (cache.nbuckets - 1)];
+
+  while (*link != NoEntry)
+  {
+    const CatCacheEntry *const entry = &cache.entries[*link];
+    if (entry->hash == hash &&
+        path_equals(entry->path_name, dir_name, leaf_name))
+    {
+      break;
+    }
+    link = &cache.entries[*link].next;
+  }
+  return link;
+}
+
+static void remove_entry(int index)
+{
+  CatCacheEntry *const entry = &cache.entries[index];
+  int *link;
+
+  assert(entry->path_name != NULL);
+  DEBUG_VERBOSEF("CatCache: Removing '%s'\n", entry->path_name);
+
+  /* Unlink the entry from its chain */
+  for (link = &cache.buckets[entry->hash & (cache.nbuckets - 1)];
+       *link != index;
+       link = &cache.entries[*link].next)
+  {
+    assert(*link != NoEntry);
+  }
+  *link = entry->next;
+
+  free(entry->path_name);
+  entry->path_name = NULL;
+  entry->next = cache.free_list;
+  cache.free_list = index;
+
+  assert(cache.stats.count > 0);
+  --cache.stats.count;
+}
+
+static int allocate_entry(void)
+{
+  int index = cache.free_list;
+
+  if (index != NoEntry)
+  {
+    cache.free_list = cache.entries[index].next;
+  }
+  else
+  {
+    /* Evict the entries in turn, which approximates evicting the entry
+       stored earliest */
+    index = (int)cache.next_victim;
+    cache.next_victim = (cache.next_victim + 1) % cache.capacity;
+    remove_entry(index);
+    cache.free_list = cache.entries[index].next;
+  }
+  return index;
+}
+
+static bool is_within(const char *path_name, const char *dir_name,
+                      size_t dir_len)
+{
+  return strnicmp(path_name, dir_name, dir_len) == 0 &&
+         (path_name[dir_len] == '\0' || path_name[dir_len] == '.');
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+CONST _kernel_oserror *catcache_enable(size_t capacity, int lifetime)
+{
+  size_t nbuckets;
+
+  assert(capacity > 0);
+  assert(capacity <= INT_MAX);
+  assert(lifetime >= 0);
+  DEBUGF("CatCache: Enabling with capacity %zu and lifetime %d\n",
+         capacity, lifetime);
+
+  catcache_disable();
+
+  /* Aim for chains of no more than one or two entries when full */
+  for (nbuckets = 1; nbuckets < capacity; nbuckets *= 2)
+  {
+  }
+
+  cache.entries = malloc(sizeof(*cache.entries) * capacity);
+  cache.buckets = malloc(sizeof(*cache.buckets) * nbuckets);
+  if (cache.entries == NULL || cache.buckets == NULL)
+  {
+    free(cache.entries);
+    free(cache.buckets);
+    cache.entries = NULL;
+    cache.buckets = NULL;
+    return messagetrans_error_lookup(NULL, DUMMY_ERRNO, "NoMem", 0);
+  }
+
+  for (size_t i = 0; i < nbuckets; ++i)
+    cache.buckets[i] = NoEntry;
+
+  for (size_t i = 0; i < capacity; ++i)
+  {
+    cache.entries[i].path_name = NULL;
+    cache.entries[i].next = (i + 1 < capacity ? (int)i + 1 : NoEntry);
+  }
+
+  cache.capacity = capacity;
+  cache.nbuckets = nbuckets;
+  cache.next_victim = 0;
+  cache.free_list = 0;
+  cache.lifetime = lifetime;
+  memset(&cache.stats, 0, sizeof(cache.stats));
+
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void catcache_disable(void)
+{
+  if (cache.entries != NULL)
+  {
+    DEBUGF("CatCache: Disabling (%lu hits, %lu misses)\n",
+           cache.stats.hits, cache.stats.misses);
+
+    for (size_t i = 0; i < cache.capacity; ++i)
+      free(cache.entries[i].path_name); /* may be null */
+
+    free(cache.entries);
+    free(cache.buckets);
+    cache.entries = NULL;
+    cache.buckets = NULL;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool catcache_is_enabled(void)
+{
+  return cache.entries != NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void catcache_store(const char                  *dir_name,
+                    const char                  *leaf_name,
+                    const OS_File_CatalogueInfo *info)
+{
+  assert(leaf_name != NULL);
+  assert(info != NULL);
+
+  if (cache.entries == NULL)
+    return;
+
+  const unsigned int hash = hash_path(dir_name, leaf_name);
+  int *const link = find_link(dir_name, leaf_name, hash);
+  int index = *link;
+
+  if (index == NoEntry)
+  {
+    /* Build the full path name before taking an entry, in case it fails */
+    const size_t dir_len = (dir_name != NULL ? strlen(dir_name) + 1 : 0);
+    char *const path_name = malloc(dir_len + strlen(leaf_name) + 1);
+    if (path_name == NULL)
+      return;
+
+    if (dir_name != NULL)
+    {
+      memcpy(path_name, dir_name, dir_len - 1);
+      path_name[dir_len - 1] = '.';
+    }
+    strcpy(path_name + dir_len, leaf_name);
+
+    index = allocate_entry();
+    CatCacheEntry *const entry = &cache.entries[index];
+    entry->path_name = path_name;
+    entry->hash = hash;
+
+    /* Add the new entry at the head of its chain (not at the old link,
+       which may have been freed if an entry was evicted) */
+    int *const head = &cache.buckets[hash & (cache.nbuckets - 1)];
+    entry->next = *head;
+    *head = index;
+    ++cache.stats.count;
+  }
+
+  CatCacheEntry *const entry = &cache.entries[index];
+  entry->info = *info;
+  (void)os_read_monotonic_time(&entry->time_stored);
+  ++cache.stats.stored;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void catcache_invalidate(const char *path_name)
+{
+  DEBUGF("CatCache: Invalidating '%s'\n", path_name ? path_name : "");
+
+  if (cache.entries == NULL)
+    return;
+
+  const size_t path_len = (path_name != NULL ? strlen(path_name) : 0);
+  for (size_t i = 0; i < cache.capacity; ++i)
+  {
+    const CatCacheEntry *const entry = &cache.entries[i];
+    if (entry->path_name != NULL &&
+        (path_name == NULL ||
+         is_within(entry->path_name, path_name, path_len)))
+    {
+      remove_entry((int)i);
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *catcache_read_cat_no_path(
+                                   const char            *path_name,
+                                   OS_File_CatalogueInfo *info)
+{
+  CONST _kernel_oserror *e;
+
+  assert(path_name != NULL);
+  assert(info != NULL);
+
+  if (cache.entries != NULL)
+  {
+    const int index = *find_link(NULL, path_name, hash_path(NULL, path_name));
+    if (index != NoEntry)
+    {
+      const CatCacheEntry *const entry = &cache.entries[index];
+      int time_now;
+
+      (void)os_read_monotonic_time(&time_now);
+      if (time_now - entry->time_stored < cache.lifetime)
+      {
+        DEBUG_VERBOSEF("CatCache: Hit for '%s'\n", path_name);
+        ++cache.stats.hits;
+        *info = entry->info;
+        return NULL;
+      }
+    }
+    ++cache.stats.misses;
+  }
+
+  e = os_file_read_cat_no_path(path_name, info);
+  if (e == NULL && info->object_type != ObjectType_NotFound)
+    catcache_store(NULL, path_name, info);
+
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void catcache_get_stats(CatCacheStats *stats)
+{
+  assert(stats != NULL);
+
+  if (cache.entries != NULL)
+    *stats = cache.stats;
+  else
+    memset(stats, 0, sizeof(*stats));
+}
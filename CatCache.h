@@ -0,0 +1,125 @@
+/*
+ * CBLibrary: Cache of catalogue information read from the filing system
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* CatCache.h declares functions to manage an optional cache of the
+   catalogue information of objects, keyed by path name. When the cache is
+   enabled, get_file_type, get_file_size and get_date_stamp use catalogue
+   information that was read recently (e.g. by a directory iterator created
+   with the DirIterator_CacheCatalogue flag) instead of reading it again.
+   Path names are compared without regard to case, but are not
+   canonicalised, so an object only hits the cache if it is named the same
+   way as when its information was stored.
+
+   Cached information may be out of date if an object is changed by other
+   means within the freshness window. Callers that change objects should
+   call catcache_invalidate (set_file_type does so automatically).
+
+Dependencies: ANSI C library, Acorn library kernel, CBOSLib.
+Message tokens: NoMem.
+History:
+  CJB: 16-Oct-26: Created this header file.
+*/
+
+#ifndef CatCache_h
+#define CatCache_h
+
+/* ISO library headers */
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBOSLib headers */
+#include "OSFile.h"
+
+/* Local headers */
+#include "Macros.h"
+
+CONST _kernel_oserror *catcache_enable(size_t /*capacity*/,
+                                       int    /*lifetime*/);
+   /*
+    * Enables the catalogue information cache, or changes its size if it is
+    * already enabled (which discards all cached information). Up to
+    * 'capacity' objects are remembered; when the cache is full, the
+    * information stored earliest is discarded first. Information is
+    * considered fresh for 'lifetime' centiseconds after it was stored.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+void catcache_disable(void);
+   /*
+    * Disables the catalogue information cache and frees the memory that was
+    * allocated for it. Does nothing if the cache isn't enabled.
+    */
+
+bool catcache_is_enabled(void);
+   /*
+    * Finds out whether the catalogue information cache is enabled.
+    * Returns: true if enabled, otherwise false.
+    */
+
+void catcache_store(const char                  * /*dir_name*/,
+                    const char                  * /*leaf_name*/,
+                    const OS_File_CatalogueInfo * /*info*/);
+   /*
+    * Stores catalogue information about an object in the cache, replacing
+    * any information already stored about the same object. The object's
+    * path name is formed by joining 'dir_name' and 'leaf_name' with a
+    * separator, unless 'dir_name' is a null pointer, in which case
+    * 'leaf_name' is the whole path name. Does nothing if the cache isn't
+    * enabled or memory could not be allocated.
+    */
+
+void catcache_invalidate(const char * /*path_name*/);
+   /*
+    * Discards any cached information about the named object and (if it is
+    * a directory) about any objects within it. If 'path_name' is a null
+    * pointer then all cached information is discarded.
+    */
+
+CONST _kernel_oserror *catcache_read_cat_no_path(
+                                   const char            * /*path_name*/,
+                                   OS_File_CatalogueInfo * /*info*/);
+   /*
+    * Gets catalogue information about the named object from the cache if
+    * fresh information is cached, or else reads it by calling
+    * os_file_read_cat_no_path and stores it in the cache if the object
+    * exists. Like os_file_read_cat_no_path, no error is returned if the
+    * object does not exist (its type is ObjectType_NotFound instead).
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+typedef struct
+{
+  unsigned long int hits;    /* Number of lookups satisfied by the cache */
+  unsigned long int misses;  /* Number of lookups that read the filing
+                                system (including for stale entries) */
+  unsigned long int stored;  /* Number of objects stored */
+  size_t            count;   /* Number of objects currently cached */
+}
+CatCacheStats;
+
+void catcache_get_stats(CatCacheStats * /*stats*/);
+   /*
+    * Gets statistics about the use of the catalogue information cache since
+    * it was last enabled. All counts are zero if it isn't enabled.
+    */
+
+#endif
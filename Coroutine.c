@@ -0,0 +1,229 @@
+/*
+ * CBLibrary: Resumable functions called by the scheduler
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* History:
+  CJB: 16-Oct-26: Created this source file.
+  CJB: 16-Oct-26: A coroutine that stops itself is now marked as stopped
+                  instead of finished, because its resume point is
+                  overwritten when it yields.
+  CJB: 16-Oct-26: Each record now keeps the token with which its idle
+                  function was registered, so that destroying a record
+                  doesn't require the scheduler to search for it.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBUtilLib headers */
+#include "LinkedList.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+
+/* Local headers */
+#include "Internal/CBMisc.h"
+#include "Scheduler.h"
+#include "Coroutine.h"
+
+/* Each running coroutine is registered with the scheduler as an idle
+   function with a pointer to one of these records as its handle. */
+typedef struct
+{
+  LinkedListItem     list_item;
+  CoroutineFunction *function;
+  void              *handle;
+  Coroutine          state;
+  SchedulerToken     token;
+  bool               stopped; /* coroutine_stop was called whilst running */
+}
+CoroutineRecord;
+
+typedef struct
+{
+  CoroutineFunction *function;
+  void              *handle;
+}
+CoroutineKey;
+
+static LinkedList coroutines;
+static bool initialised = false;
+static CoroutineRecord *running;
+
+/* ----------------------------------------------------------------------- */
+/*                       Function prototypes                               */
+
+static SchedulerIdleFunction resume;
+static LinkedListCallbackFn has_key;
+static CoroutineRecord *find_record(CoroutineFunction *function, void *handle);
+static void destroy_record(CoroutineRecord *record);
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+CONST _kernel_oserror *coroutine_start(CoroutineFunction *function,
+                                       void *handle,
+                                       SchedulerTime first_call,
+                                       int priority)
+{
+  DEBUGF("Coroutine: starting function with handle %p at %d (priority %d)\n",
+         handle, first_call, priority);
+
+  assert(function != NULL);
+
+  if (!initialised)
+  {
+    linkedlist_init(&coroutines);
+    initialised = true;
+  }
+
+  assert(find_record(function, handle) == NULL);
+
+  CoroutineRecord *const record = malloc(sizeof(*record));
+  if (record == NULL)
+  {
+    return messagetrans_error_lookup(NULL, DUMMY_ERRNO, "NoMem", 0);
+  }
+
+  *record = (CoroutineRecord){
+    .function = function,
+    .handle = handle,
+    .state = {.resume_point = Coroutine_Start},
+    .token = NULL,
+    .stopped = false,
+  };
+
+  /* The record is new so the function and handle combination is unique */
+  CONST _kernel_oserror *const e = scheduler_register_token(
+    resume, record, first_call, priority, &record->token);
+  if (e != NULL)
+  {
+    free(record);
+  }
+  else
+  {
+    linkedlist_insert(&coroutines, NULL, &record->list_item);
+  }
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void coroutine_stop(CoroutineFunction *function, void *handle)
+{
+  DEBUGF("Coroutine: stopping function with handle %p\n", handle);
+
+  CoroutineRecord *const record = find_record(function, handle);
+  if (record == NULL)
+  {
+    DEBUGF("Coroutine: not running\n");
+  }
+  else if (record == running)
+  {
+    /* Don't free the record whilst it's in use; resume will do that.
+       The resume point can't be used to mark it because the function may
+       yield after stopping itself. */
+    record->stopped = true;
+  }
+  else
+  {
+    destroy_record(record);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+bool coroutine_is_running(CoroutineFunction *function, void *handle)
+{
+  CoroutineRecord *const record = find_record(function, handle);
+  return record != NULL && !record->stopped &&
+         record->state.resume_point != Coroutine_Finished;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static SchedulerTime resume(void *handle, SchedulerTime time_now,
+                            const volatile bool *time_up)
+{
+  CoroutineRecord *const record = handle;
+  assert(record != NULL);
+  assert(record->state.resume_point != Coroutine_Finished);
+
+  DEBUG_VERBOSEF("Coroutine: resuming function with handle %p at %d\n",
+                 record->handle, record->state.resume_point);
+
+  running = record;
+  SchedulerTime const next_call = record->function(record->handle,
+                                                   &record->state, time_now,
+                                                   time_up);
+  running = NULL;
+
+  if (record->stopped ||
+      record->state.resume_point == Coroutine_Finished)
+  {
+    DEBUGF("Coroutine: function with handle %p %s\n", record->handle,
+           record->stopped ? "stopped" : "finished");
+    destroy_record(record);
+  }
+  return next_call;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool has_key(LinkedList *list, LinkedListItem *item, void *arg)
+{
+  const CoroutineRecord *const record = CONTAINER_OF(item, CoroutineRecord,
+                                                     list_item);
+  const CoroutineKey *const key = arg;
+  NOT_USED(list);
+  assert(key != NULL);
+
+  return record->function == key->function && record->handle == key->handle;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CoroutineRecord *find_record(CoroutineFunction *function, void *handle)
+{
+  if (!initialised)
+    return NULL;
+
+  CoroutineKey key = {.function = function, .handle = handle};
+  LinkedListItem *const item = linkedlist_for_each(&coroutines, has_key,
+                                                   &key);
+  return item == NULL ? NULL : CONTAINER_OF(item, CoroutineRecord, list_item);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void destroy_record(CoroutineRecord *record)
+{
+  assert(record != NULL);
+  assert(record != running);
+
+  /* It's safe for an idle function to deregister itself */
+  assert(record->token != NULL);
+  scheduler_deregister_token(record->token);
+  linkedlist_remove(&coroutines, &record->list_item);
+  free(record);
+}
@@ -0,0 +1,166 @@
+/*
+ * CBLibrary: Resumable functions called by the scheduler
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Coroutine.h declares a type, macros and functions which allow a long job
+   to be written as a straight-line function that yields control whenever its
+   time slice expires, instead of as an explicit state machine. The scheduler
+   resumes the function after the point at which it last yielded.
+
+   Coroutines are stackless: the values of local variables are not preserved
+   when a coroutine yields, so any state that must survive should be kept in
+   the object referenced by the 'handle' argument. The macros are built upon
+   a 'switch' statement, so a coroutine must not yield from within another
+   'switch' statement.
+
+Dependencies: ANSI C library, Acorn library kernel, Acorn's event library.
+Message tokens: NoMem.
+History:
+  CJB: 16-Oct-26: Created this header.
+*/
+
+#ifndef Coroutine_h
+#define Coroutine_h
+
+/* ISO library headers */
+#include <stdbool.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* Local headers */
+#include "Scheduler.h"
+#include "Macros.h"
+
+enum
+{
+  Coroutine_Start    = 0,  /* Initial resume point */
+  Coroutine_Finished = -1  /* Resume point after COROUTINE_END or
+                              COROUTINE_EXIT */
+};
+
+typedef struct
+{
+  int resume_point; /* Private: where to resume the function */
+}
+Coroutine;
+   /*
+    * State of a coroutine between calls.
+    */
+
+typedef SchedulerTime CoroutineFunction (void                */*handle*/,
+                                         Coroutine           */*coroutine*/,
+                                         SchedulerTime        /*time_now*/,
+                                         const volatile bool */*time_up*/);
+   /*
+    * When your function is called it will be passed the value of 'handle'
+    * given to coroutine_start, a pointer to its state (to be passed to the
+    * macros below) and the same 'time_now' and 'time_up' arguments as a
+    * SchedulerIdleFunction. Its body must begin with COROUTINE_BEGIN and end
+    * with COROUTINE_END. Each time it yields, the value returned is the
+    * earliest time at which to resume it.
+    */
+
+#define COROUTINE_BEGIN(coroutine) \
+  switch ((coroutine)->resume_point) \
+  { \
+    case Coroutine_Start:
+   /*
+    * Marks the start of the body of a CoroutineFunction. When the function
+    * is resumed, control is transferred from here to the point at which it
+    * last yielded.
+    */
+
+#define COROUTINE_YIELD(coroutine, next_call) \
+    do \
+    { \
+      (coroutine)->resume_point = __LINE__; \
+      return (next_call); \
+      case __LINE__:; \
+    } \
+    while (0)
+   /*
+    * Returns 'next_call' to the scheduler as the earliest time at which to
+    * resume the coroutine, which will continue from the following statement.
+    * Must not be used more than once on the same source line.
+    */
+
+#define COROUTINE_YIELD_IF_TIME_UP(coroutine, time_up, next_call) \
+    do \
+    { \
+      if (*(time_up)) \
+      { \
+        COROUTINE_YIELD(coroutine, next_call); \
+      } \
+    } \
+    while (0)
+   /*
+    * Yields (as COROUTINE_YIELD) only if the volatile bool pointed to by
+    * 'time_up' is true. Typically used once per iteration of a loop.
+    */
+
+#define COROUTINE_EXIT(coroutine, time_now) \
+    do \
+    { \
+      (coroutine)->resume_point = Coroutine_Finished; \
+      return (time_now); \
+    } \
+    while (0)
+   /*
+    * Finishes the coroutine early. It will not be called again.
+    */
+
+#define COROUTINE_END(coroutine, time_now) \
+    default: \
+      break; \
+  } \
+  COROUTINE_EXIT(coroutine, time_now)
+   /*
+    * Marks the end of the body of a CoroutineFunction. When control reaches
+    * this point, the coroutine is finished and it will not be called again.
+    */
+
+CONST _kernel_oserror *coroutine_start(CoroutineFunction */*function*/,
+                                       void              */*handle*/,
+                                       SchedulerTime      /*first_call*/,
+                                       int                /*priority*/);
+   /*
+    * Registers a coroutine with the scheduler, to be called at time
+    * 'first_call' or later, with the given priority (as for
+    * scheduler_register). The coroutine is automatically deregistered when
+    * it finishes. The same function and handle combination must not be
+    * started again until the coroutine has finished or been stopped.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+void coroutine_stop(CoroutineFunction */*function*/, void */*handle*/);
+   /*
+    * Stops a coroutine that has not yet finished, so that it will not be
+    * called again. Nothing happens if the function and handle combination
+    * is unknown, for example because the coroutine already finished. It is
+    * safe for a coroutine to stop itself (or another coroutine).
+    */
+
+bool coroutine_is_running(CoroutineFunction */*function*/, void */*handle*/);
+   /*
+    * Finds out whether a coroutine has been started and has not yet
+    * finished or been stopped.
+    * Returns: true if the coroutine is running, otherwise false.
+    */
+
+#endif
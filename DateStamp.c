@@ -45,6 +45,7 @@
                   os_file_generate_error functions instead of _kernel_osfile.
   CJB: 18-Apr-15: Assertions are now provided by debug.h.
   CJB: 01-Nov-18: Replaced DEBUG macro usage with DEBUGF.
+  CJB: 16-Oct-26: Catalogue information is now read via the cache.
  */
 
 /* ISO library headers */
@@ -61,6 +62,7 @@
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "DateStamp.h"
+#include "CatCache.h"
 
 #define LoadAddressHasStamp (0xfff00000u)
 #define LoadAddressStampMSB (0x000000ffu)
@@ -77,7 +79,7 @@ CONST _kernel_oserror *get_date_stamp(const char *f, OS_DateAndTime *utc)
   assert(utc != NULL);
   DEBUGF("DateStamp: Reading catalogue info for object '%s'\n", f);
 
-  e = os_file_read_cat_no_path(f, &cat);
+  e = catcache_read_cat_no_path(f, &cat);
   if (e != NULL)
   {
     DEBUGF("DateStamp: SWI returned error 0x%x '%s'\n",
@@ -38,6 +38,7 @@ History:
                   Declared a new function to decode load and exec addresses.
   CJB: 30-Oct-18: Moved definitions of the date type and the decode_load_exec
                   function to CBOSLib.
+  CJB: 16-Oct-26: Documented use of the catalogue information cache.
 */
 
 #ifndef DateStamp_h
@@ -66,6 +67,8 @@ CONST _kernel_oserror *get_date_stamp(const char * /*f*/,
     * Returns: a pointer to an OS error block, or else NULL for success. If no
     *          error occured then the date stamp will have been output. For an
     *          unstamped file this will be 00:00:00 01-Jan-1900.
+    * Uses cached catalogue information if the catalogue information cache is
+    * enabled (see CatCache.h).
     */
 
 CONST _kernel_oserror *get_current_time(OS_DateAndTime * /*utc*/);
@@ -30,14 +30,66 @@
                   stringbuffer_append.
   CJB: 05-Feb-19: Use stringbuffer_append_all where appropriate.
   CJB: 28-Apr-19: Less verbose debugging output.
+  CJB: 16-Oct-26: The number of catalogue entries requested from
+                  _kernel_osgbpb now grows (up to a configurable limit) for
+                  directories that need more than one call to read, faster
+                  if the calls are slow. Buffers are sized from the average
+                  length of names seen so far, and the buffer of a directory
+                  that was left is reused for the next one entered.
+  CJB: 16-Oct-26: Added the diriterator_walk function.
+  CJB: 16-Oct-26: Records for directories that were left are now kept on
+                  a free list for reuse instead of only keeping the one with
+                  the biggest buffer. Added the diriterator_rebind function.
+                  diriterator_walk reuses one iterator for all directories.
+  CJB: 16-Oct-26: Added the diriterator_get_object_path_view function.
+                  If the DirIterator_ContiguousPath flag is set then the
+                  leaf name of the current object is kept appended to the
+                  path name buffer between calls.
+  CJB: 16-Oct-26: Added flags to sort the catalogue entries of each
+                  directory through an index at the end of its buffer.
+                  Added the diriterator_set_filter function. Entries that
+                  don't match the filter are discarded as soon as they are
+                  read.
+  CJB: 16-Oct-26: If the DirIterator_ReadAhead flag is set then a scheduler
+                  client reads the next batch of catalogue entries that
+                  will be needed while the task is idle.
+  CJB: 16-Oct-26: Added the diriterator_advance_until and
+                  diriterator_get_progress functions. Directories found
+                  and entered are now counted.
+  CJB: 16-Oct-26: Fixed a read of an uninitialised name when an empty
+                  directory is entered.
+  CJB: 16-Oct-26: If the DirIterator_CacheCatalogue flag is set then
+                  catalogue entries are stored in the catalogue cache.
+  CJB: 16-Oct-26: The batch size is no longer adapted using uninitialised
+                  times if the monotonic time can't be read.
+  CJB: 16-Oct-26: diriterator_walk passes errors reading a directory to the
+                  callback function instead of stopping. If built with
+                  DIRITER_USE_THREADS defined, it can read directories in
+                  parallel using POSIX threads that steal directories from
+                  each other's queues.
+  CJB: 16-Oct-26: The read-ahead function is no longer called while there
+                  is nothing to read in advance (e.g. if the iterator is
+                  empty), so that null events can be masked. It is woken
+                  when the iterator enters, leaves or refills a directory,
+                  or is reset or rebound. It is registered with a token.
 */
 
+#ifdef DIRITER_USE_THREADS
+/* Needed for pthreads in strict ISO C mode */
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 /* ISO library headers */
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+#ifdef DIRITER_USE_THREADS
+/* POSIX headers */
+#include <pthread.h>
+#endif
+
 /* Acorn C/C++ library headers */
 #include "kernel.h"
 
@@ -49,12 +101,15 @@
 /* CBOSLib headers */
 #include "MessTrans.h"
 #include "OSGBPB.h"
+#include "OSReadTime.h"
 
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "Platform.h"
 #include "DirIter.h"
 #include "DateStamp.h"
+#include "Scheduler.h"
+#include "CatCache.h"
 
 
 /* Refilling the buffer early makes it more complex to find the total
@@ -68,8 +123,22 @@ enum
   ErrorNum_BufferOverflow = 484, /* Error number used by _kernel_osgbpb */
   NameSize   = 11, /* Not a limit, but object names longer than 10
                       characters are still unusual on RISC OS. */
-  MaxEntries = 16  /* Increase this to reduce the frequency of calling
+  MaxEntries = 16, /* Initial number of catalogue entries to request from
                       _kernel_osgbpb. */
+  DefaultBatchLimit = 256, /* Default limit on the number of catalogue
+                              entries to request from _kernel_osgbpb. */
+  SlowReadTime = 2, /* Time in centiseconds for which a call to
+                       _kernel_osgbpb must block to be considered slow
+                       (e.g. on a network share). */
+  MaxNameCount = 1024, /* Name sizes are averaged over roughly this many of
+                         the most recently read names. */
+  ReadAheadDelay = 5, /* Time in centiseconds to wait before trying again
+                         if catalogue entries couldn't be read in
+                         advance. */
+  ReadAheadIdleTime = 360000, /* Time in centiseconds to wait if there are
+                                 no catalogue entries to read in advance
+                                 (an hour, so effectively until woken). */
+  MaxWalkThreads = 64 /* Maximum number of threads used by diriterator_walk. */
 };
 
 #define DEFAULT_BUFFER_SIZE ((offsetof(OS_GBPB_CatalogueInfo, name) + \
@@ -89,6 +158,9 @@ typedef struct DirIteratorLevel
                    iterator hasn't yet advanced beyond. */
   const OS_GBPB_CatalogueInfo *entry; /* Pointer to catalogue entry for current object, or
                             NULL if none. */
+  const OS_GBPB_CatalogueInfo **index; /* Pointer to the sorted index of the
+                            catalogue entries after the current one, or NULL
+                            if the entries are not sorted. */
   size_t entry_name_len; /* Length of the name of the current object. */
   size_t buffer_size; /* Size of the buffer for catalogue entries, in
                          bytes. */
@@ -106,10 +178,98 @@ struct DirIterator
                          directories and/or image files). */
   char *pattern; /* Pointer to wildcarded name to match, or NULL to match
                     all (equivalent to "*"). */
-  StringBuffer path_name; /* Path name of current deepest directory. */
+  StringBuffer path_name; /* Path name of current deepest directory,
+                             followed by the leaf name of the current
+                             object if 'has_leaf_name' is true. */
   size_t path_name_len; /* Length of the root path, for convenience of
                            diriterator_get_object_sub_path_name. */
   LinkedList dir_list;
+  unsigned int batch_size; /* Number of catalogue entries to request from
+                              _kernel_osgbpb. */
+  unsigned int batch_limit; /* Upper limit on 'batch_size'. */
+  unsigned long int name_count; /* Number of names read recently. */
+  unsigned long int name_bytes; /* Total size of names read recently,
+                                   including terminators. */
+  LinkedList free_list; /* Records for directories that were left, kept
+                           for reuse with their buffers. */
+  bool has_leaf_name; /* Whether the leaf name of the current object is
+                         appended to 'path_name'. */
+  DirIteratorFilter filter; /* Criteria for objects to be visited. */
+  bool ahead_valid; /* Whether 'ahead_buffer' holds catalogue entries that
+                       were read in advance. */
+  char *ahead_buffer; /* Catalogue entries read in advance, or NULL. */
+  size_t ahead_buffer_size; /* Size of 'ahead_buffer', in bytes. */
+  size_t ahead_used; /* Number of bytes of 'ahead_buffer' in use. */
+  unsigned int ahead_count; /* Number of catalogue entries read in advance. */
+  int ahead_position; /* Offset from which the entries were read. */
+  int ahead_next; /* Offset of the next entry after them (-1 at end). */
+  StringBuffer ahead_path; /* Path name of the directory from which the
+                              entries were read. */
+  SchedulerToken ahead_token; /* Identifies the read-ahead function. */
+  bool ahead_idle; /* Whether the read-ahead function found nothing to read
+                      and won't be called again until woken. */
+  unsigned long int dirs_found; /* Number of directories found that will
+                                   be entered (including the root). */
+  unsigned long int dirs_entered; /* Number of those that were entered. */
+};
+
+/* Outcome of an attempt to read catalogue entries in advance. */
+typedef enum
+{
+  ReadAheadResult_Read,    /* Catalogue entries were read. */
+  ReadAheadResult_Nothing, /* There is nothing (more) to read until the
+                              iterator moves. */
+  ReadAheadResult_Failed   /* Entries couldn't be read, but may be later. */
+}
+ReadAheadResult;
+
+/* Record for a directory waiting to be visited by diriterator_walk. */
+typedef struct
+{
+  LinkedListItem list_item;
+  char path_name[]; /* Variable-length path name of the directory. */
+}
+DirIteratorWalkItem;
+
+typedef struct DirIteratorWalker DirIteratorWalker;
+
+/* State shared by everything that takes part in a call to
+   diriterator_walk. */
+typedef struct
+{
+  const char *pattern; /* Wildcarded name to match, or NULL. */
+  unsigned int flags; /* Whether to recurse into directories, etc. */
+  DirIteratorWalkFunction *callback;
+  void *arg;
+  DirIteratorWalker *walkers; /* Array of 'nwalkers' walkers. */
+  unsigned int nwalkers;
+  bool stop; /* Whether the walk was stopped by the callback function or
+                an error. */
+  CONST _kernel_oserror *e; /* Error that stopped the walk, or NULL. */
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_t lock; /* Protects the members below and 'stop' and 'e'. */
+  pthread_cond_t changed; /* Signalled when 'nqueued' or 'npending'
+                             changes, or the walk is stopped. */
+  unsigned long int nqueued; /* Number of directories in walkers' queues. */
+  unsigned long int npending; /* Number of directories queued or being
+                                 read. */
+#endif
+}
+DirIteratorWalk;
+
+/* State of one thread taking part in a call to diriterator_walk. */
+struct DirIteratorWalker
+{
+  DirIteratorWalk *walk;
+  LinkedList queue; /* Directories waiting to be read by this walker. */
+  DirIterator *it; /* Rebound to each directory, to reuse its buffers. */
+  char *object_path; /* Buffer for the path name of each object. */
+  size_t object_path_size; /* Size of 'object_path', in bytes. */
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_t lock; /* Protects 'queue' from other walkers. */
+  pthread_t thread;
+  bool started; /* Whether 'thread' was created. */
+#endif
 };
 
 static CONST _kernel_oserror *no_mem(void)
@@ -117,32 +277,222 @@ static CONST _kernel_oserror *no_mem(void)
   return messagetrans_error_lookup(NULL, DUMMY_ERRNO, "NoMem", 0);
 }
 
+static void append_leaf_name(DirIterator *iterator)
+{
+  const DirIteratorLevel *level;
+
+  assert(iterator != NULL);
+  assert(!iterator->has_leaf_name);
+
+  /* Only keep the full path name of the current object in one buffer if
+     requested, because it costs an extra copy of every leaf name. */
+  if (TEST_BITS(iterator->flags, DirIterator_ContiguousPath))
+  {
+    level = (DirIteratorLevel *)linkedlist_get_head(&iterator->dir_list);
+    if (level != NULL)
+    {
+      assert(level->entry != NULL);
+      assert(level->path_name_len ==
+             stringbuffer_get_length(&iterator->path_name));
+
+      /* Failure isn't fatal because get_name doesn't need the leaf name
+         to be in the path name buffer. */
+      iterator->has_leaf_name = stringbuffer_append_separated(
+                                  &iterator->path_name, PATH_SEPARATOR,
+                                  level->entry->name);
+    }
+  }
+}
+
+static void remove_leaf_name(DirIterator *iterator)
+{
+  const DirIteratorLevel *level;
+
+  assert(iterator != NULL);
+
+  /* Restore the path name of the deepest directory, which is needed to
+     read catalogue entries and enter sub-directories. */
+  if (iterator->has_leaf_name)
+  {
+    level = (DirIteratorLevel *)linkedlist_get_head(&iterator->dir_list);
+    assert(level != NULL);
+    stringbuffer_truncate(&iterator->path_name, level->path_name_len);
+    iterator->has_leaf_name = false;
+  }
+}
+
+static int get_entry_type(const OS_GBPB_CatalogueInfo *entry,
+                          OSDateAndTime               *date_stamp)
+{
+  int file_type;
+
+  assert(entry != NULL);
+  assert(date_stamp != NULL);
+
+  file_type = decode_load_exec(entry->info.load, entry->info.exec,
+                               date_stamp);
+
+  if (entry->info.object_type == ObjectType_Directory ||
+      entry->info.object_type == ObjectType_Image)
+  {
+    file_type = (entry->name[0] == '!' ?
+                 FileType_Application : FileType_Directory);
+  }
+
+  return file_type;
+}
+
+static size_t entry_size(const OS_GBPB_CatalogueInfo *entry)
+{
+  assert(entry != NULL);
+  return offsetof(OS_GBPB_CatalogueInfo, name) +
+         WORD_ALIGN(strlen(entry->name) + 1);
+}
+
+static void release_level(DirIterator *iterator, DirIteratorLevel *level)
+{
+  assert(iterator != NULL);
+  assert(level != NULL);
+
+  /* Keep the record so that it can be reused for the next directory,
+     including when the iterator is reset or rebound. The number of records
+     on the free list is limited by the depth of the directory tree. */
+  DEBUG_VERBOSEF("DirIterator: recycling level %p\n", (void *)level);
+  linkedlist_insert(&iterator->free_list, NULL, &level->list_item);
+}
+
+static bool destroy_level_callback(LinkedList *list, LinkedListItem *item, void *arg)
+{
+  NOT_USED(arg);
+  assert(item != NULL);
+
+  DEBUG_VERBOSEF("DirIterator: freeing level %p\n", (void *)item);
+  linkedlist_remove(list, item);
+  free(CONTAINER_OF(item, DirIteratorLevel, list_item));
+
+  return false; /* next item */
+}
+
+typedef struct
+{
+  DirIterator          *iterator;
+  const LinkedListItem *stop;
+}
+FreeLevelsArgs;
+
 static bool free_level_callback(LinkedList *list, LinkedListItem *item, void *arg)
 {
-  const LinkedListItem * const stop = arg;
+  const FreeLevelsArgs * const args = arg;
 
   /* If stop is NULL then no item can match it and all will be freed. */
   assert(item != NULL);
-  if (item != stop)
+  assert(args != NULL);
+  if (item != args->stop)
   {
-    assert(item != NULL);
-    DEBUG_VERBOSEF("DirIterator: freeing level %p\n", (void *)item);
     linkedlist_remove(list, item);
-    free(item);
+    release_level(args->iterator, CONTAINER_OF(item, DirIteratorLevel,
+                                               list_item));
   }
 
-  return item == stop;
+  return item == args->stop;
 }
 
-static void free_levels(LinkedList *dir_list, LinkedListItem *stop)
+static void free_levels(DirIterator    *iterator,
+                        LinkedList     *dir_list,
+                        LinkedListItem *stop)
 {
-  linkedlist_for_each(dir_list, free_level_callback, stop);
+  FreeLevelsArgs args = {iterator, stop};
+  linkedlist_for_each(dir_list, free_level_callback, &args);
 }
 
-static CONST _kernel_oserror *extend_buffer(DirIterator       *iterator,
-                                            DirIteratorLevel **levelp)
+static size_t estimate_buffer_size(const DirIterator *iterator)
+{
+  size_t name_size = NameSize;
+
+  /* Estimate the size of buffer required for a batch of catalogue entries,
+     rounding the average name size up. */
+  assert(iterator != NULL);
+  if (iterator->name_count > 0)
+  {
+    name_size = (iterator->name_bytes + iterator->name_count - 1) /
+                iterator->name_count;
+  }
+
+  return (offsetof(OS_GBPB_CatalogueInfo, name) + WORD_ALIGN(name_size)) *
+         iterator->batch_size;
+}
+
+static bool can_enter(unsigned int flags, int object_type);
+
+static void cache_entries(const char                  *path_name,
+                          const OS_GBPB_CatalogueInfo *entry,
+                          unsigned int                 n)
 {
-  size_t new_size, entry_offset;
+  assert(path_name != NULL);
+  assert(entry != NULL || n == 0);
+
+  for (; n > 0; --n)
+  {
+    catcache_store(path_name, entry->name, &entry->info);
+    entry = (const OS_GBPB_CatalogueInfo *)((const char *)entry +
+                                            entry_size(entry));
+  }
+}
+
+static void count_names(DirIterator                 *iterator,
+                        const OS_GBPB_CatalogueInfo *entry,
+                        unsigned int                 n)
+{
+  assert(iterator != NULL);
+  assert(entry != NULL || n == 0);
+
+  for (; n > 0; --n)
+  {
+    const size_t name_size = strlen(entry->name) + 1;
+    iterator->name_bytes += name_size;
+    ++iterator->name_count;
+
+    /* Count directories to be entered, for progress estimates. Filters
+       never discard them. */
+    if (can_enter(iterator->flags, entry->info.object_type))
+      ++iterator->dirs_found;
+
+    entry = (const OS_GBPB_CatalogueInfo *)(entry->name + WORD_ALIGN(name_size));
+  }
+
+  /* Halve the totals periodically so that recent names dominate. */
+  if (iterator->name_count > MaxNameCount)
+  {
+    iterator->name_count /= 2;
+    iterator->name_bytes /= 2;
+  }
+}
+
+static void grow_batch(DirIterator *iterator, int read_time)
+{
+  unsigned int factor = GrowthFactor;
+
+  assert(iterator != NULL);
+
+  /* Having to call _kernel_osgbpb again for the same directory indicates
+     that the batch size is too small. Grow faster if the call was slow. */
+  if (read_time >= SlowReadTime)
+    factor *= GrowthFactor;
+
+  if (iterator->batch_size > iterator->batch_limit / factor)
+    iterator->batch_size = iterator->batch_limit;
+  else
+    iterator->batch_size *= factor;
+
+  DEBUG_VERBOSEF("DirIterator: batch size is now %u (read took %d cs)\n",
+    iterator->batch_size, read_time);
+}
+
+static CONST _kernel_oserror *resize_buffer(DirIterator       *iterator,
+                                            DirIteratorLevel **levelp,
+                                            size_t             new_size)
+{
+  size_t entry_offset;
   DirIteratorLevel *level, *new_level;
   LinkedListItem *prev;
   CONST _kernel_oserror *e = NULL;
@@ -160,7 +510,6 @@ static CONST _kernel_oserror *extend_buffer(DirIterator       *iterator,
     entry_offset = SIZE_MAX;
 
   /* Try to allocate a larger buffer */
-  new_size = level->buffer_size * GrowthFactor;
   DEBUG_VERBOSEF("DirIterator: trying to expand buffer from %zu to %zu bytes\n",
     level->buffer_size, new_size);
 
@@ -198,23 +547,281 @@ static CONST _kernel_oserror *extend_buffer(DirIterator       *iterator,
   return e;
 }
 
+static int compare_date_stamps(const OSDateAndTime *a, const OSDateAndTime *b)
+{
+  size_t i;
+
+  /* Five byte times are little-endian, so compare the most significant
+     byte first. */
+  assert(a != NULL);
+  assert(b != NULL);
+  for (i = ARRAY_SIZE(a->bytes); i > 0; --i)
+  {
+    if (a->bytes[i - 1] != b->bytes[i - 1])
+      return a->bytes[i - 1] < b->bytes[i - 1] ? -1 : 1;
+  }
+  return 0;
+}
+
+static bool filter_entry(const DirIterator           *iterator,
+                         const OS_GBPB_CatalogueInfo *entry)
+{
+  const DirIteratorFilter *filter;
+  OSDateAndTime date_stamp;
+  int file_type;
+
+  assert(iterator != NULL);
+  assert(entry != NULL);
+  filter = &iterator->filter;
+
+  /* Never skip a directory that may contain objects that match. */
+  if (can_enter(iterator->flags, entry->info.object_type))
+    return true;
+
+  file_type = get_entry_type(entry, &date_stamp);
+
+  if (TEST_BITS(filter->flags, DirIteratorFilter_FileType) &&
+      file_type != filter->file_type)
+    return false;
+
+  if (TEST_BITS(filter->flags, DirIteratorFilter_Length) &&
+      (entry->info.length < filter->min_length ||
+       entry->info.length > filter->max_length))
+    return false;
+
+  if (TEST_BITS(filter->flags, DirIteratorFilter_DateStamp) &&
+      (compare_date_stamps(&date_stamp, &filter->min_date_stamp) < 0 ||
+       compare_date_stamps(&date_stamp, &filter->max_date_stamp) > 0))
+    return false;
+
+  return true;
+}
+
+static unsigned int filter_entries(const DirIterator *iterator,
+                                   char              *buffer,
+                                   unsigned int       n)
+{
+  const char *read = buffer;
+  char *write = buffer;
+  unsigned int nkept = 0;
+
+  assert(iterator != NULL);
+  assert(buffer != NULL || n == 0);
+
+  if (iterator->filter.flags == 0)
+    return n;
+
+  /* Discard catalogue entries that don't match by moving the others down
+     over them. */
+  for (; n > 0; --n)
+  {
+    const OS_GBPB_CatalogueInfo *const entry =
+      (const OS_GBPB_CatalogueInfo *)read;
+    const size_t size = entry_size(entry);
+
+    if (filter_entry(iterator, entry))
+    {
+      if (write != read)
+        memmove(write, read, size);
+
+      write += size;
+      ++nkept;
+    }
+    read += size;
+  }
+
+  DEBUG_VERBOSEF("DirIterator: kept %u entries\n", nkept);
+  return nkept;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+  const OS_GBPB_CatalogueInfo *const *const entry_a = a;
+  const OS_GBPB_CatalogueInfo *const *const entry_b = b;
+
+  return stricmp((*entry_a)->name, (*entry_b)->name);
+}
+
+static int compare_lengths(const void *a, const void *b)
+{
+  const OS_GBPB_CatalogueInfo *const *const entry_a = a;
+  const OS_GBPB_CatalogueInfo *const *const entry_b = b;
+
+  if ((*entry_a)->info.length != (*entry_b)->info.length)
+    return (*entry_a)->info.length < (*entry_b)->info.length ? -1 : 1;
+
+  return compare_names(a, b);
+}
+
+static int compare_dates(const void *a, const void *b)
+{
+  const OS_GBPB_CatalogueInfo *const *const entry_a = a;
+  const OS_GBPB_CatalogueInfo *const *const entry_b = b;
+  OSDateAndTime date_a, date_b;
+  int result;
+
+  (void)get_entry_type(*entry_a, &date_a);
+  (void)get_entry_type(*entry_b, &date_b);
+  result = compare_date_stamps(&date_a, &date_b);
+
+  return result != 0 ? result : compare_names(a, b);
+}
+
+static int compare_file_types(const void *a, const void *b)
+{
+  const OS_GBPB_CatalogueInfo *const *const entry_a = a;
+  const OS_GBPB_CatalogueInfo *const *const entry_b = b;
+  OSDateAndTime date_a, date_b;
+  const int type_a = get_entry_type(*entry_a, &date_a);
+  const int type_b = get_entry_type(*entry_b, &date_b);
+
+  if (type_a != type_b)
+    return type_a < type_b ? -1 : 1;
+
+  return compare_names(a, b);
+}
+
+static CONST _kernel_oserror *resize_buffer(DirIterator       *iterator,
+                                            DirIteratorLevel **levelp,
+                                            size_t             new_size);
+
+static CONST _kernel_oserror *sort_entries(DirIterator       *iterator,
+                                           DirIteratorLevel **levelp,
+                                           size_t             entries_size)
+{
+  static int (*const compare[])(const void *, const void *) =
+  {
+    NULL,
+    compare_names,
+    compare_lengths,
+    compare_dates,
+    compare_file_types
+  };
+  CONST _kernel_oserror *e = NULL;
+  const OS_GBPB_CatalogueInfo **index;
+  const OS_GBPB_CatalogueInfo *entry;
+  DirIteratorLevel *level;
+  size_t index_offset, index_size;
+  unsigned int i, sort;
+
+  assert(iterator != NULL);
+  assert(levelp != NULL);
+  level = *levelp;
+  assert(level != NULL);
+  assert(level->gbpb_next == OS_GBPB_ReadCat_PositionEnd);
+
+  sort = (iterator->flags & DirIterator_SortMask) / DirIterator_SortByName;
+  assert(sort > 0);
+  if (sort >= ARRAY_SIZE(compare) || level->nentries == 0)
+    return NULL;
+
+  /* The index of entries is stored after the entries themselves, so that
+     it is recycled with the rest of the buffer. */
+  index_offset = (entries_size + sizeof(*index) - 1) / sizeof(*index) *
+                 sizeof(*index);
+  index_size = level->nentries * sizeof(*index);
+  if (level->buffer_size < index_offset + index_size)
+  {
+    e = resize_buffer(iterator, levelp, index_offset + index_size);
+    level = *levelp;
+  }
+
+  if (e == NULL)
+  {
+    index = (const OS_GBPB_CatalogueInfo **)(level->buffer + index_offset);
+    entry = (const OS_GBPB_CatalogueInfo *)level->buffer;
+    for (i = 0; i < level->nentries; ++i)
+    {
+      index[i] = entry;
+      entry = (const OS_GBPB_CatalogueInfo *)((const char *)entry +
+                                              entry_size(entry));
+    }
+
+    qsort(index, level->nentries, sizeof(*index), compare[sort]);
+
+    if (TEST_BITS(iterator->flags, DirIterator_SortDescending))
+    {
+      for (i = 0; i < level->nentries / 2; ++i)
+      {
+        entry = index[i];
+        index[i] = index[level->nentries - 1 - i];
+        index[level->nentries - 1 - i] = entry;
+      }
+    }
+
+    level->entry = index[0];
+    level->entry_name_len = strlen(level->entry->name);
+    level->index = index + 1;
+  }
+
+  return e;
+}
+
+static bool take_ahead(DirIterator       *iterator,
+                       DirIteratorLevel **levelp,
+                       size_t             keep_size,
+                       unsigned int      *n)
+{
+  DirIteratorLevel *level;
+
+  assert(iterator != NULL);
+  assert(levelp != NULL);
+  level = *levelp;
+  assert(level != NULL);
+  assert(n != NULL);
+
+  /* Were the next catalogue entries for this directory read in advance? */
+  if (!iterator->ahead_valid ||
+      iterator->ahead_position != level->gbpb_next ||
+      strcmp(stringbuffer_get_pointer(&iterator->ahead_path),
+             stringbuffer_get_pointer(&iterator->path_name)) != 0)
+  {
+    return false;
+  }
+
+  /* Copying the entries is much quicker than reading them again. */
+  if (level->buffer_size - keep_size < iterator->ahead_used)
+  {
+    if (resize_buffer(iterator, levelp, keep_size + iterator->ahead_used) != NULL)
+      return false;
+
+    level = *levelp;
+  }
+
+  DEBUGF("DirIterator: Using %u entries read in advance from '%s'\n",
+         iterator->ahead_count, stringbuffer_get_pointer(&iterator->ahead_path));
+
+  memcpy(level->buffer + keep_size, iterator->ahead_buffer,
+         iterator->ahead_used);
+  *n = iterator->ahead_count;
+  level->gbpb_next = iterator->ahead_next;
+  iterator->ahead_valid = false;
+
+  return true;
+}
+
 static CONST _kernel_oserror *refill_buffer(DirIterator       *iterator,
                                             DirIteratorLevel **levelp)
 {
   CONST _kernel_oserror *e = NULL;
   size_t keep_size = 0;
   DirIteratorLevel *level;
+  size_t entries_size = 0;
   const char *path_name;
-  bool retry;
+  bool retry, sorted;
 
   assert(iterator != NULL);
   path_name = stringbuffer_get_pointer(&iterator->path_name);
+  sorted = (iterator->flags & DirIterator_SortMask) != 0;
   assert(path_name != NULL);
 
   assert(levelp != NULL);
   level = *levelp;
   assert(level != NULL);
 
+  /* Sorted directories are read in full when entered. */
+  assert(!sorted || level->gbpb_next == 0);
+
   /* I don't trust _kernel_osgbpb to leave the buffer untouched on error, so
      move any remaining catalogue entries (including the current one) to the
      start of the buffer for safekeeping. */
@@ -247,11 +854,37 @@ static CONST _kernel_oserror *refill_buffer(DirIterator       *iterator,
   }
   level->entry = (const OS_GBPB_CatalogueInfo *)level->buffer;
 
+  /* Try to make room for a full batch of fresh entries. Failure isn't
+     an error because fewer entries can be read into the existing buffer. */
+  {
+    const size_t batch_buffer_size = estimate_buffer_size(iterator);
+    if (level->buffer_size - keep_size < batch_buffer_size &&
+        resize_buffer(iterator, levelp, keep_size + batch_buffer_size) == NULL)
+    {
+      level = *levelp;
+    }
+  }
+
   do
   {
     unsigned int n;
+    int start_time = 0, end_time = 0;
+    bool timed = false;
     retry = false;
 
+    if (sorted && level->nentries > 0)
+    {
+      /* Read the next batch after the entries already in the buffer, making
+         room for it first. */
+      const size_t batch_buffer_size = estimate_buffer_size(iterator);
+      keep_size = entries_size;
+      if (level->buffer_size - keep_size < batch_buffer_size &&
+          resize_buffer(iterator, levelp, keep_size + batch_buffer_size) == NULL)
+      {
+        level = *levelp;
+      }
+    }
+
     /* The offset to the next item to read is updated by each call to
        _kernel_osgbpb. */
     assert(level->gbpb_next != OS_GBPB_ReadCat_PositionEnd);
@@ -261,32 +894,77 @@ static CONST _kernel_oserror *refill_buffer(DirIterator       *iterator,
        or the end of the directory is reached. */
     do
     {
-      n = MaxEntries;
-      e = os_gbpb_read_cat_no_path(path_name,
-                                   level->buffer + keep_size,
-                                   level->buffer_size - keep_size,
-                                   &n,
-                                   &level->gbpb_next,
-                                   iterator->pattern);
+      n = iterator->batch_size;
+      timed = (os_read_monotonic_time(&start_time) == NULL);
+      if (!take_ahead(iterator, levelp, keep_size, &n))
+      {
+        e = os_gbpb_read_cat_no_path(path_name,
+                                     level->buffer + keep_size,
+                                     level->buffer_size - keep_size,
+                                     &n,
+                                     &level->gbpb_next,
+                                     iterator->pattern);
+      }
+      level = *levelp;
+      if (timed)
+        timed = (os_read_monotonic_time(&end_time) == NULL);
+
+      if (e == NULL)
+      {
+        count_names(iterator,
+                    (const OS_GBPB_CatalogueInfo *)(level->buffer + keep_size),
+                    n);
+
+        /* Store entries in the cache before any are filtered out. */
+        if (TEST_BITS(iterator->flags, DirIterator_CacheCatalogue))
+        {
+          cache_entries(path_name,
+                    (const OS_GBPB_CatalogueInfo *)(level->buffer + keep_size),
+                    n);
+        }
+
+        n = filter_entries(iterator, level->buffer + keep_size, n);
+      }
     }
     while (e == NULL && n == 0 && level->gbpb_next != OS_GBPB_ReadCat_PositionEnd);
 
     if (e == NULL)
     {
+      /* Don't adapt the batch size if the time taken is unknown */
+      if (timed && level->gbpb_next != OS_GBPB_ReadCat_PositionEnd)
+        grow_batch(iterator, end_time - start_time);
+
       /* If there was previously no 'current' entry then find the length of
-         the new 'current' entry */
-      if (level->nentries == 0)
+         the new 'current' entry (if any: the directory may be empty) */
+      if (level->nentries == 0 && n > 0)
       {
         assert(level->entry != NULL);
         level->entry_name_len = strlen(level->entry->name);
       }
       level->nentries += n;
+
+      if (sorted)
+      {
+        /* Find the end of the entries read so far. */
+        const OS_GBPB_CatalogueInfo *entry =
+          (const OS_GBPB_CatalogueInfo *)(level->buffer + keep_size);
+
+        for (; n > 0; --n)
+        {
+          entry = (const OS_GBPB_CatalogueInfo *)((const char *)entry +
+                                                  entry_size(entry));
+        }
+        entries_size = (const char *)entry - level->buffer;
+
+        /* The whole directory must be read before it can be sorted. */
+        retry = (level->gbpb_next != OS_GBPB_ReadCat_PositionEnd);
+      }
     }
     else
     {
       if (e->errnum == ErrorNum_BufferOverflow)
       {
-        e = extend_buffer(iterator, levelp);
+        e = resize_buffer(iterator, levelp, level->buffer_size * GrowthFactor);
         level = *levelp;
 
         /* If the buffer was successfully extended then try again
@@ -298,6 +976,9 @@ static CONST _kernel_oserror *refill_buffer(DirIterator       *iterator,
   }
   while (retry);
 
+  if (e == NULL && sorted)
+    e = sort_entries(iterator, levelp, entries_size);
+
   return e;
 }
 
@@ -311,15 +992,30 @@ static CONST _kernel_oserror *enter_dir(DirIterator *iterator)
   DEBUGF("DirIterator: Entering '%s'\n",
          stringbuffer_get_pointer(&iterator->path_name));
 
-  level = malloc(offsetof(DirIteratorLevel, buffer) + DEFAULT_BUFFER_SIZE);
+  /* Reuse the record (and buffer) of a directory that was left, if any.
+     Otherwise, allocate a buffer big enough for a full batch of entries. */
+  level = (DirIteratorLevel *)linkedlist_get_head(&iterator->free_list);
+  if (level != NULL)
+  {
+    linkedlist_remove(&iterator->free_list, &level->list_item);
+  }
+  else
+  {
+    const size_t buffer_size = HIGHEST(estimate_buffer_size(iterator),
+                                       DEFAULT_BUFFER_SIZE);
+    level = malloc(offsetof(DirIteratorLevel, buffer) + buffer_size);
+    if (level != NULL)
+      level->buffer_size = buffer_size;
+  }
+
   if (level != NULL)
   {
     /* Record the length of the path name leading up to this directory. */
     level->path_name_len = stringbuffer_get_length(&iterator->path_name);
     level->entry = NULL;
+    level->index = NULL;
     level->nentries = 0;
     level->gbpb_next = 0; /* start of directory */
-    level->buffer_size = DEFAULT_BUFFER_SIZE;
     linkedlist_insert(&iterator->dir_list, NULL, &level->list_item);
 
     /* Try to fill the buffer with catalogue entries for this level. */
@@ -330,50 +1026,258 @@ static CONST _kernel_oserror *enter_dir(DirIterator *iterator)
       level = tmp;
     }
 
-    /* Don't bother entering empty directories. */
-    if (e == NULL && level->nentries > 0)
-    {
-      DEBUG_VERBOSEF("DirIterator: Deepest directory is now %p (path length %zu)\n",
-        (void *)level, level->path_name_len);
-    }
-    else
-    {
-      linkedlist_remove(&iterator->dir_list, &level->list_item);
-      free(level);
-      DEBUGF("DirIterator: Ignoring empty directory '%s'\n",
-             stringbuffer_get_pointer(&iterator->path_name));
-    }
+    if (e == NULL)
+      ++iterator->dirs_entered;
+
+    /* Don't bother entering empty directories. */
+    if (e == NULL && level->nentries > 0)
+    {
+      DEBUG_VERBOSEF("DirIterator: Deepest directory is now %p (path length %zu)\n",
+        (void *)level, level->path_name_len);
+    }
+    else
+    {
+      linkedlist_remove(&iterator->dir_list, &level->list_item);
+      release_level(iterator, level);
+      DEBUGF("DirIterator: Ignoring empty directory '%s'\n",
+             stringbuffer_get_pointer(&iterator->path_name));
+    }
+  }
+  else
+  {
+    e = no_mem();
+  }
+  return e;
+}
+
+static bool can_enter(unsigned int flags, int object_type)
+{
+  unsigned int mask;
+
+  /* If the object is a directory or image file and the
+     appropriate recursion flag is set then enter it. */
+  switch (object_type)
+  {
+    case ObjectType_Image:
+      mask = DirIterator_RecurseIntoImages;
+      break;
+    case ObjectType_Directory:
+      mask = DirIterator_RecurseIntoDirectories;
+      break;
+    default:
+      mask = 0;
+      break;
+  }
+
+  return mask & flags;
+}
+
+static bool can_enter_dir(const DirIterator *iterator, const OS_GBPB_CatalogueInfo *entry)
+{
+  assert(iterator != NULL);
+  assert(entry != NULL);
+
+  return can_enter(iterator->flags, entry->info.object_type);
+}
+
+static const OS_GBPB_CatalogueInfo *peek_entry(
+                                    const DirIteratorLevel      *level,
+                                    const OS_GBPB_CatalogueInfo *entry,
+                                    unsigned int                 i)
+{
+  /* Get the catalogue entry that follows the i-1th entry after the current
+     entry (which is 'entry'), without advancing. */
+  assert(level != NULL);
+  assert(entry != NULL);
+  assert(i > 0);
+
+  if (i >= level->nentries)
+    return NULL;
+
+  if (level->index != NULL)
+    return level->index[i - 1];
+
+  return (const OS_GBPB_CatalogueInfo *)((const char *)entry +
+                                         entry_size(entry));
+}
+
+static bool is_ahead_path(const DirIterator           *iterator,
+                          const DirIteratorLevel      *level,
+                          const OS_GBPB_CatalogueInfo *entry)
+{
+  const char *ahead_path;
+  size_t len;
+
+  assert(iterator != NULL);
+  assert(level != NULL);
+
+  /* Is the path name of the directory from which entries were read in
+     advance the same as that of the given level (or of its sub-directory
+     'entry', if not null)? */
+  ahead_path = stringbuffer_get_pointer(&iterator->ahead_path);
+  len = level->path_name_len;
+  if (strncmp(ahead_path, stringbuffer_get_pointer(&iterator->path_name),
+              len) != 0)
+    return false;
+
+  if (entry == NULL)
+    return ahead_path[len] == '\0';
+
+  return ahead_path[len] == PATH_SEPARATOR &&
+         strcmp(ahead_path + len + 1, entry->name) == 0;
+}
+
+static ReadAheadResult read_ahead(DirIterator *iterator)
+{
+  const DirIteratorLevel *level;
+  const OS_GBPB_CatalogueInfo *entry;
+  CONST _kernel_oserror *e;
+  unsigned int i, n;
+  int position;
+  size_t buffer_size;
+
+  assert(iterator != NULL);
+
+  /* Find the next catalogue entries that will be needed, starting from the
+     deepest directory. The current entry of each ancestor is the next to
+     be visited in that directory. */
+  for (level = (DirIteratorLevel *)linkedlist_get_head(&iterator->dir_list);
+       level != NULL;
+       level = (DirIteratorLevel *)linkedlist_get_next(&level->list_item))
+  {
+    /* The first sub-directory among the remaining entries will be entered
+       before any more entries are needed for this directory. */
+    entry = level->entry;
+    for (i = 1; entry != NULL && !can_enter_dir(iterator, entry); ++i)
+      entry = peek_entry(level, entry, i);
+
+    if (entry != NULL)
+    {
+      position = 0;
+      break;
+    }
+
+    if (level->gbpb_next != OS_GBPB_ReadCat_PositionEnd)
+    {
+      position = level->gbpb_next;
+      break;
+    }
+  }
+
+  if (level == NULL)
+    return ReadAheadResult_Nothing; /* e.g. the iterator is empty */
+
+  /* Don't read the same entries again unless they have been used. */
+  if (iterator->ahead_valid && iterator->ahead_position == position &&
+      is_ahead_path(iterator, level, entry))
+  {
+    return ReadAheadResult_Nothing;
+  }
+
+  iterator->ahead_valid = false;
+
+  stringbuffer_truncate(&iterator->ahead_path, 0);
+  if (!stringbuffer_append(&iterator->ahead_path,
+                           stringbuffer_get_pointer(&iterator->path_name),
+                           level->path_name_len) ||
+      (entry != NULL &&
+       !stringbuffer_append_separated(&iterator->ahead_path, PATH_SEPARATOR,
+                                      entry->name)))
+  {
+    /* Not an error because the entries can be read later */
+    return ReadAheadResult_Failed;
+  }
+
+  buffer_size = estimate_buffer_size(iterator);
+  if (iterator->ahead_buffer_size < buffer_size)
+  {
+    char *const new_buffer = realloc(iterator->ahead_buffer, buffer_size);
+    if (new_buffer == NULL)
+      return ReadAheadResult_Failed;
+
+    iterator->ahead_buffer = new_buffer;
+    iterator->ahead_buffer_size = buffer_size;
   }
-  else
+
+  DEBUGF("DirIterator: Reading ahead from '%s' at %d\n",
+         stringbuffer_get_pointer(&iterator->ahead_path), position);
+
+  iterator->ahead_position = position;
+  n = iterator->batch_size;
+  e = os_gbpb_read_cat_no_path(stringbuffer_get_pointer(&iterator->ahead_path),
+                               iterator->ahead_buffer,
+                               iterator->ahead_buffer_size,
+                               &n,
+                               &position,
+                               iterator->pattern);
+
+  /* Any error will be reported when the entries are needed. */
+  if (e == NULL)
   {
-    e = no_mem();
+    const OS_GBPB_CatalogueInfo *end =
+      (const OS_GBPB_CatalogueInfo *)iterator->ahead_buffer;
+
+    for (i = 0; i < n; ++i)
+      end = (const OS_GBPB_CatalogueInfo *)((const char *)end +
+                                            entry_size(end));
+
+    iterator->ahead_used = (const char *)end - iterator->ahead_buffer;
+    iterator->ahead_count = n;
+    iterator->ahead_next = position;
+    iterator->ahead_valid = true;
   }
-  return e;
+
+  return e == NULL ? ReadAheadResult_Read : ReadAheadResult_Failed;
 }
 
-static bool can_enter_dir(const DirIterator *iterator, const OS_GBPB_CatalogueInfo *entry)
+static SchedulerTime read_ahead_idle(void                *handle,
+                                     SchedulerTime        time_now,
+                                     const volatile bool *time_up)
 {
-  unsigned int mask;
+  DirIterator *const iterator = handle;
+  SchedulerTime next_time;
 
   assert(iterator != NULL);
-  assert(entry != NULL);
+  NOT_USED(time_up);
 
-  /* If the current object is a directory or image file and the
-     appropriate recursion flag is set then enter it. */
-  switch (entry->info.object_type)
+  switch (read_ahead(iterator))
   {
-    case ObjectType_Image:
-      mask = DirIterator_RecurseIntoImages;
+    case ReadAheadResult_Read:
+      /* Something else may be worth reading as soon as entries have been
+         read successfully. */
+      next_time = time_now;
       break;
-    case ObjectType_Directory:
-      mask = DirIterator_RecurseIntoDirectories;
+
+    case ReadAheadResult_Nothing:
+      /* Don't request null events until woken by wake_read_ahead. */
+      DEBUGF("DirIterator: Nothing to read ahead for iterator %p\n",
+             (void *)iterator);
+      iterator->ahead_idle = true;
+      next_time = time_now + ReadAheadIdleTime;
       break;
+
     default:
-      mask = 0;
+      next_time = time_now + ReadAheadDelay;
       break;
   }
 
-  return mask & iterator->flags;
+  return next_time;
+}
+
+static void wake_read_ahead(DirIterator *iterator)
+{
+  SchedulerTime time_now;
+
+  assert(iterator != NULL);
+
+  /* The next catalogue entries that will be needed may have changed. */
+  if (iterator->ahead_idle && os_read_monotonic_time(&time_now) == NULL)
+  {
+    DEBUGF("DirIterator: Waking read-ahead for iterator %p\n",
+           (void *)iterator);
+    iterator->ahead_idle = false;
+    scheduler_reschedule(iterator->ahead_token, time_now);
+  }
 }
 
 static void advance(DirIteratorLevel *level)
@@ -385,7 +1289,18 @@ static void advance(DirIteratorLevel *level)
   assert(level != NULL);
   assert(level->nentries > 0);
 
-  if (--level->nentries > 0)
+  if (--level->nentries == 0)
+  {
+    /* No more entries on the current level */
+    entry = NULL;
+  }
+  else if (level->index != NULL)
+  {
+    /* Get the address of the next catalogue entry in sorted order */
+    entry = *(level->index++);
+    level->entry_name_len = strlen(entry->name);
+  }
+  else
   {
     /* Calculate the address of the next catalogue entry in the buffer */
     const size_t name_size = WORD_ALIGN(level->entry_name_len + 1);
@@ -397,11 +1312,6 @@ static void advance(DirIteratorLevel *level)
     /* Cache the length of the object name, for future use */
     level->entry_name_len = strlen(entry->name);
   }
-  else
-  {
-    /* No more entries on the current level */
-    entry = NULL;
-  }
 
   DEBUGF("DirIterator: Next entry is %p ('%s'), %d entries remain\n",
          (void *)entry, entry == NULL ? "" : entry->name, level->nentries);
@@ -456,7 +1366,8 @@ static CONST _kernel_oserror *leave_dir(DirIterator *iterator)
        which we managed to find catalogue entries.
        This works even if ancestor == NULL (in which case the
        iterator is empty and all directory level structs are freed). */
-    free_levels(&iterator->dir_list, &ancestor->list_item);
+    free_levels(iterator, &iterator->dir_list,
+                ancestor == NULL ? NULL : &ancestor->list_item);
 
     /* Remove the leaf names of the lower directories from the path */
     if (ancestor != NULL)
@@ -500,7 +1411,7 @@ static size_t get_name(const DirIterator *iterator,
     assert(level->nentries > 0);
     assert(level->entry != NULL);
     assert(strlen(level->entry->name) == level->entry_name_len);
-    assert(level->path_name_len ==
+    assert(level->path_name_len <=
            stringbuffer_get_length(&iterator->path_name));
 
     if (buff_size > 0)
@@ -595,12 +1506,54 @@ CONST _kernel_oserror *diriterator_make(DirIterator  **iterator,
       if (stringbuffer_append_all(&it->path_name, path_name))
       {
         it->flags = flags;
+        it->batch_size = MaxEntries;
+        it->batch_limit = DefaultBatchLimit;
+        it->name_count = 0;
+        it->name_bytes = 0;
+        linkedlist_init(&it->free_list);
         linkedlist_init(&it->dir_list);
         it->path_name_len = stringbuffer_get_length(&it->path_name);
+        it->has_leaf_name = false;
+        it->filter.flags = 0;
+        it->ahead_valid = false;
+        it->ahead_buffer = NULL;
+        it->ahead_buffer_size = 0;
+        stringbuffer_init(&it->ahead_path);
+        it->ahead_token = NULL;
+        it->ahead_idle = false;
+        it->dirs_found = 1;
+        it->dirs_entered = 0;
+
+        if (TEST_BITS(flags, DirIterator_ReadAhead))
+        {
+          SchedulerTime time_now;
+          e = os_read_monotonic_time(&time_now);
+          if (e == NULL)
+          {
+            e = scheduler_register_token(read_ahead_idle, it, time_now,
+                                         SchedulerPriority_Min,
+                                         &it->ahead_token);
+          }
+        }
+
+        if (e == NULL)
+        {
+          e = enter_dir(it);
+          if (e != NULL && TEST_BITS(flags, DirIterator_ReadAhead))
+            scheduler_deregister_token(it->ahead_token);
+        }
 
-        e = enter_dir(it);
-        if (e != NULL)
+        if (e == NULL)
+        {
+          append_leaf_name(it);
+        }
+        else
+        {
+          (void)linkedlist_for_each(&it->free_list, destroy_level_callback,
+                                    NULL);
+          stringbuffer_destroy(&it->ahead_path);
           stringbuffer_destroy(&it->path_name);
+        }
       }
       else
       {
@@ -630,28 +1583,100 @@ CONST _kernel_oserror *diriterator_reset(DirIterator *iterator)
 {
   CONST _kernel_oserror *e = NULL;
   LinkedList old_dir_list;
+  unsigned long int old_dirs_found, old_dirs_entered;
 
   DEBUGF("DirIterator: Resetting iterator %p\n", (void *)iterator);
   assert(iterator != NULL);
 
-  /* Try to recreate the top level data structure again. */
+  /* Try to recreate the top level data structure again, reading the
+     catalogue entries afresh. */
+  remove_leaf_name(iterator);
+  iterator->ahead_valid = false;
   old_dir_list = iterator->dir_list;
   linkedlist_init(&iterator->dir_list);
   stringbuffer_truncate(&iterator->path_name, iterator->path_name_len);
+  old_dirs_found = iterator->dirs_found;
+  old_dirs_entered = iterator->dirs_entered;
+  iterator->dirs_found = 1;
+  iterator->dirs_entered = 0;
 
   e = enter_dir(iterator);
   if (e == NULL)
   {
     /* Destroy the old data structures on success. */
-    free_levels(&old_dir_list, NULL);
+    free_levels(iterator, &old_dir_list, NULL);
   }
   else
   {
     /* Restore the previous state on error */
     iterator->dir_list = old_dir_list;
     stringbuffer_undo(&iterator->path_name);
+    iterator->dirs_found = old_dirs_found;
+    iterator->dirs_entered = old_dirs_entered;
+  }
+
+  append_leaf_name(iterator);
+  wake_read_ahead(iterator);
+  return e;
+}
+
+CONST _kernel_oserror *diriterator_set_filter(
+                                     DirIterator             *iterator,
+                                     const DirIteratorFilter *filter)
+{
+  DEBUGF("DirIterator: Setting filter %p for iterator %p\n",
+         (void *)filter, (void *)iterator);
+  assert(iterator != NULL);
+
+  if (filter == NULL)
+  {
+    iterator->filter.flags = 0;
+  }
+  else
+  {
+    assert(!TEST_BITS(filter->flags, DirIteratorFilter_Length) ||
+           filter->min_length <= filter->max_length);
+    iterator->filter = *filter;
   }
 
+  /* Entries that were already read may not match. */
+  return diriterator_reset(iterator);
+}
+
+CONST _kernel_oserror *diriterator_rebind(DirIterator *iterator,
+                                          const char  *path_name)
+{
+  CONST _kernel_oserror *e = NULL;
+
+  DEBUGF("DirIterator: Rebinding iterator %p to path '%s'\n",
+         (void *)iterator, path_name);
+  assert(iterator != NULL);
+  assert(path_name != NULL);
+
+  /* Recycle the data structures for the old directory tree. Buffers are
+     reused by enter_dir and the path name buffer is reused by
+     stringbuffer_append_all, so nothing is allocated unless the new tree
+     is bigger than any seen previously. */
+  free_levels(iterator, &iterator->dir_list, NULL);
+  stringbuffer_truncate(&iterator->path_name, 0);
+  iterator->has_leaf_name = false;
+  iterator->ahead_valid = false;
+  iterator->dirs_found = 1;
+  iterator->dirs_entered = 0;
+
+  if (stringbuffer_append_all(&iterator->path_name, path_name))
+  {
+    iterator->path_name_len = stringbuffer_get_length(&iterator->path_name);
+    e = enter_dir(iterator);
+  }
+  else
+  {
+    iterator->path_name_len = 0;
+    e = no_mem();
+  }
+
+  append_leaf_name(iterator);
+  wake_read_ahead(iterator);
   return e;
 }
 
@@ -693,17 +1718,7 @@ int diriterator_get_object_info(const DirIterator     *iterator,
 
     if (info != NULL)
     {
-      info->file_type = decode_load_exec(entry->info.load,
-                                         entry->info.exec,
-                                         &info->date_stamp);
-
-      if (entry->info.object_type == ObjectType_Directory ||
-          entry->info.object_type == ObjectType_Image)
-      {
-        info->file_type = (entry->name[0] == '!' ?
-                          FileType_Application : FileType_Directory);
-      }
-
+      info->file_type = get_entry_type(entry, &info->date_stamp);
       info->length = entry->info.length;
       info->attributes = entry->info.attributes;
     }
@@ -756,6 +1771,59 @@ size_t diriterator_get_object_leaf_name(const DirIterator *iterator,
   return get_name(iterator, buffer, buff_size, SIZE_MAX);
 }
 
+bool diriterator_get_object_path_view(const DirIterator   *iterator,
+                                      DirIteratorPathView *view)
+{
+  const DirIteratorLevel *level;
+  const char *path_name;
+
+  DEBUGF("DirIterator: Getting path view from iterator %p into %p\n",
+         (void *)iterator, (void *)view);
+
+  assert(iterator != NULL);
+  assert(view != NULL);
+
+  level = (DirIteratorLevel *)linkedlist_get_head(&iterator->dir_list);
+  if (level == NULL)
+  {
+    DEBUGF("DirIterator: Iterator %p is empty\n", (void *)iterator);
+    return false;
+  }
+
+  assert(level->nentries > 0);
+  assert(level->entry != NULL);
+  assert(strlen(level->entry->name) == level->entry_name_len);
+
+  path_name = stringbuffer_get_pointer(&iterator->path_name);
+  view->dir_path_name = path_name;
+  view->dir_path_name_len = level->path_name_len;
+  view->root_path_name_len = iterator->path_name_len;
+  view->leaf_name = level->entry->name;
+  view->leaf_name_len = level->entry_name_len;
+
+  if (iterator->has_leaf_name)
+  {
+    /* The sub-path name of an object in the top-level directory is the
+       same as its leaf name. */
+    view->path_name = path_name;
+    view->path_name_len = stringbuffer_get_length(&iterator->path_name);
+    assert(view->path_name_len >= iterator->path_name_len + 1);
+    view->sub_path_name = path_name + iterator->path_name_len + 1;
+    view->sub_path_name_len = view->path_name_len -
+                              (iterator->path_name_len + 1);
+  }
+  else
+  {
+    view->path_name = NULL;
+    view->path_name_len = 0;
+    view->sub_path_name = NULL;
+    view->sub_path_name_len = 0;
+  }
+
+  DEBUG_VERBOSEF("DirIterator: leaf name is '%s'\n", view->leaf_name);
+  return true;
+}
+
 CONST _kernel_oserror *diriterator_advance(DirIterator *iterator)
 {
   CONST _kernel_oserror *e = NULL;
@@ -770,8 +1838,9 @@ CONST _kernel_oserror *diriterator_advance(DirIterator *iterator)
   }
   else
   {
-    bool entered = false;
+    bool entered = false, moved = false;
 
+    remove_leaf_name(iterator);
     assert(level->nentries > 0);
     if (can_enter_dir(iterator, level->entry))
     {
@@ -779,6 +1848,7 @@ CONST _kernel_oserror *diriterator_advance(DirIterator *iterator)
                                         PATH_SEPARATOR, level->entry->name))
       {
         e = enter_dir(iterator);
+        moved = true;
         if (e == NULL &&
             level != (DirIteratorLevel *)linkedlist_get_head(&iterator->dir_list))
         {
@@ -813,6 +1883,7 @@ CONST _kernel_oserror *diriterator_advance(DirIterator *iterator)
           e = refill_buffer(iterator, &tmp);
           assert(tmp != NULL);
           level = tmp;
+          moved = true;
         }
 
         if (e == NULL)
@@ -824,6 +1895,7 @@ CONST _kernel_oserror *diriterator_advance(DirIterator *iterator)
             /* Go up a level until reaching the top or finding a directory in
                which we haven't already advanced past all of the entries. */
             e = leave_dir(iterator);
+            moved = true;
           }
           else
           {
@@ -838,20 +1910,447 @@ CONST _kernel_oserror *diriterator_advance(DirIterator *iterator)
         advance(level);
       }
     }
+
+    append_leaf_name(iterator);
+
+    /* Entries to be read in advance only change when catalogue entries
+       are read or a directory is entered or left. */
+    if (moved)
+      wake_read_ahead(iterator);
+  }
+
+  return e;
+}
+
+CONST _kernel_oserror *diriterator_advance_until(
+                                     DirIterator              *iterator,
+                                     const volatile bool      *time_up,
+                                     DirIteratorVisitFunction *callback,
+                                     void                     *arg)
+{
+  CONST _kernel_oserror *e = NULL;
+
+  DEBUGF("DirIterator: Advancing iterator %p until time up\n",
+         (void *)iterator);
+
+  assert(iterator != NULL);
+  assert(time_up != NULL);
+  assert(callback != NULL);
+
+  /* Visit at least one object, even if time is already up, to guarantee
+     progress. */
+  do
+  {
+    if (diriterator_is_empty(iterator) || !callback(iterator, arg))
+      break;
+
+    e = diriterator_advance(iterator);
+  }
+  while (e == NULL && !*time_up);
+
+  return e;
+}
+
+unsigned int diriterator_get_progress(const DirIterator *iterator)
+{
+  assert(iterator != NULL);
+
+  if (diriterator_is_empty(iterator))
+    return 100;
+
+  /* Every directory entered was found first, including the root. */
+  assert(iterator->dirs_found > 0);
+  assert(iterator->dirs_entered <= iterator->dirs_found);
+  return (unsigned int)((iterator->dirs_entered * 100) / iterator->dirs_found);
+}
+
+static bool free_walk_item_callback(LinkedList *list, LinkedListItem *item, void *arg)
+{
+  NOT_USED(arg);
+  assert(item != NULL);
+
+  linkedlist_remove(list, item);
+  free(CONTAINER_OF(item, DirIteratorWalkItem, list_item));
+
+  return false; /* next item */
+}
+
+static bool walk_stopped(DirIteratorWalk *walk)
+{
+  bool stop;
+
+  assert(walk != NULL);
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_lock(&walk->lock);
+#endif
+  stop = walk->stop;
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_unlock(&walk->lock);
+#endif
+  return stop;
+}
+
+static void stop_walk(DirIteratorWalk *walk, CONST _kernel_oserror *e)
+{
+  assert(walk != NULL);
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_lock(&walk->lock);
+#endif
+  if (!walk->stop)
+  {
+    walk->stop = true;
+    walk->e = e;
+  }
+#ifdef DIRITER_USE_THREADS
+  pthread_cond_broadcast(&walk->changed);
+  pthread_mutex_unlock(&walk->lock);
+#endif
+}
+
+static CONST _kernel_oserror *enqueue_dir(DirIteratorWalker *walker,
+                                          const char        *path_name,
+                                          size_t             path_name_len)
+{
+  DirIteratorWalkItem *item;
+
+  assert(walker != NULL);
+  assert(path_name != NULL);
+
+  item = malloc(offsetof(DirIteratorWalkItem, path_name) + path_name_len + 1);
+  if (item == NULL)
+    return no_mem();
+
+  memcpy(item->path_name, path_name, path_name_len + 1);
+
+  /* Sub-directories are visited in the order in which they were found */
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_lock(&walker->lock);
+#endif
+  linkedlist_insert(&walker->queue, linkedlist_get_tail(&walker->queue),
+                    &item->list_item);
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_unlock(&walker->lock);
+
+  pthread_mutex_lock(&walker->walk->lock);
+  ++walker->walk->nqueued;
+  ++walker->walk->npending;
+  pthread_cond_signal(&walker->walk->changed);
+  pthread_mutex_unlock(&walker->walk->lock);
+#endif
+  return NULL;
+}
+
+static DirIteratorWalkItem *dequeue_dir(DirIteratorWalker *walker,
+                                        bool               oldest)
+{
+  LinkedListItem *list_item;
+
+  assert(walker != NULL);
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_lock(&walker->lock);
+#endif
+  list_item = oldest ? linkedlist_get_head(&walker->queue) :
+                       linkedlist_get_tail(&walker->queue);
+  if (list_item != NULL)
+    linkedlist_remove(&walker->queue, list_item);
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_unlock(&walker->lock);
+#endif
+
+  return list_item == NULL ? NULL :
+         CONTAINER_OF(list_item, DirIteratorWalkItem, list_item);
+}
+
+static DirIteratorWalkItem *take_dir(DirIteratorWalker *walker)
+{
+  /* A walker reads the directories in its own queue in the order in which
+     they were found. */
+  DirIteratorWalkItem *item = dequeue_dir(walker, true);
+
+#ifdef DIRITER_USE_THREADS
+  /* If it has none left then it steals the directory found most recently
+     by another walker, which is the least likely to be taken by that
+     walker soon. */
+  DirIteratorWalk *const walk = walker->walk;
+  const unsigned int self = (unsigned int)(walker - walk->walkers);
+
+  for (unsigned int i = 1; item == NULL && i < walk->nwalkers; ++i)
+  {
+    item = dequeue_dir(&walk->walkers[(self + i) % walk->nwalkers], false);
+  }
+
+  if (item != NULL)
+  {
+    pthread_mutex_lock(&walk->lock);
+    assert(walk->nqueued > 0);
+    --walk->nqueued;
+    pthread_mutex_unlock(&walk->lock);
+  }
+#endif
+
+  return item;
+}
+
+#ifdef DIRITER_USE_THREADS
+static void finish_dir(DirIteratorWalk *walk)
+{
+  assert(walk != NULL);
+  pthread_mutex_lock(&walk->lock);
+  assert(walk->npending > 0);
+  if (--walk->npending == 0)
+    pthread_cond_broadcast(&walk->changed);
+  pthread_mutex_unlock(&walk->lock);
+}
+
+static bool wait_for_dir(DirIteratorWalk *walk)
+{
+  bool more;
+
+  /* Wait until another walker queues a directory, or every directory has
+     been read. */
+  assert(walk != NULL);
+  pthread_mutex_lock(&walk->lock);
+  while (!walk->stop && walk->npending > 0 && walk->nqueued == 0)
+    pthread_cond_wait(&walk->changed, &walk->lock);
+
+  more = !walk->stop && walk->npending > 0;
+  pthread_mutex_unlock(&walk->lock);
+  return more;
+}
+#endif
+
+static void walk_dir(DirIteratorWalker *walker, const char *dir_path)
+{
+  DirIteratorWalk *walk;
+  CONST _kernel_oserror *e;
+  bool stop = false;
+
+  assert(walker != NULL);
+  assert(dir_path != NULL);
+  walk = walker->walk;
+
+  if (walker->it == NULL)
+    e = diriterator_make(&walker->it, 0, dir_path, walk->pattern);
+  else
+    e = diriterator_rebind(walker->it, dir_path);
+
+  for (; e == NULL && !stop && !diriterator_is_empty(walker->it);
+       e = diriterator_advance(walker->it))
+  {
+    DirIteratorObjectInfo info;
+    const int object_type = diriterator_get_object_info(walker->it, &info);
+    const size_t len = diriterator_get_object_path_name(walker->it, NULL, 0);
+    CONST _kernel_oserror *queue_e;
+
+    if (len >= walker->object_path_size)
+    {
+      char *const new_path = realloc(walker->object_path, len + 1);
+      if (new_path == NULL)
+      {
+        stop_walk(walk, no_mem());
+        return;
+      }
+      walker->object_path = new_path;
+      walker->object_path_size = len + 1;
+    }
+    (void)diriterator_get_object_path_name(walker->it, walker->object_path,
+                                           walker->object_path_size);
+
+    if (can_enter(walk->flags, object_type))
+    {
+      queue_e = enqueue_dir(walker, walker->object_path, len);
+      if (queue_e != NULL)
+      {
+        stop_walk(walk, queue_e);
+        return;
+      }
+    }
+
+    stop = !walk->callback(walker->object_path, object_type, &info, NULL,
+                           walk->arg) || walk_stopped(walk);
+  }
+
+  /* Failure to read one directory doesn't stop the rest of the tree being
+     walked unless the callback function says so. */
+  if (e != NULL)
+  {
+    DEBUGF("DirIterator: Error 0x%x reading '%s': %s\n", e->errnum,
+           dir_path, e->errmess);
+    stop = !walk->callback(dir_path, ObjectType_NotFound, NULL, e,
+                           walk->arg);
+  }
+
+  if (stop)
+    stop_walk(walk, NULL);
+}
+
+static void run_walker(DirIteratorWalker *walker)
+{
+  assert(walker != NULL);
+
+  while (!walk_stopped(walker->walk))
+  {
+    DirIteratorWalkItem *const item = take_dir(walker);
+    if (item == NULL)
+    {
+#ifdef DIRITER_USE_THREADS
+      if (wait_for_dir(walker->walk))
+        continue;
+#endif
+      break;
+    }
+
+    walk_dir(walker, item->path_name);
+    free(item);
+#ifdef DIRITER_USE_THREADS
+    finish_dir(walker->walk);
+#endif
+  }
+}
+
+#ifdef DIRITER_USE_THREADS
+static void *walker_thread(void *arg)
+{
+  run_walker(arg);
+  return NULL;
+}
+#endif
+
+CONST _kernel_oserror *diriterator_walk(const char              *path_name,
+                                        const char              *pattern,
+                                        unsigned int             flags,
+                                        unsigned int             nthreads,
+                                        DirIteratorWalkFunction *callback,
+                                        void                    *arg)
+{
+  CONST _kernel_oserror *e;
+  DirIteratorWalk walk;
+  unsigned int i;
+
+  assert(path_name != NULL);
+  assert(callback != NULL);
+  DEBUGF("DirIterator: Walking path '%s' with flags 0x%x, pattern '%s' and "
+         "%u threads\n", path_name, flags, pattern ? pattern : "", nthreads);
+
+  walk.pattern = pattern;
+  walk.flags = flags;
+  walk.callback = callback;
+  walk.arg = arg;
+  walk.stop = false;
+  walk.e = NULL;
+#ifdef DIRITER_USE_THREADS
+  walk.nwalkers = nthreads < 1 ? 1 : LOWEST(nthreads, MaxWalkThreads);
+  walk.nqueued = 0;
+  walk.npending = 0;
+#else
+  NOT_USED(nthreads);
+  walk.nwalkers = 1;
+#endif
+
+  walk.walkers = malloc(sizeof(*walk.walkers) * walk.nwalkers);
+  if (walk.walkers == NULL)
+    return no_mem();
+
+#ifdef DIRITER_USE_THREADS
+  pthread_mutex_init(&walk.lock, NULL);
+  pthread_cond_init(&walk.changed, NULL);
+#endif
+
+  for (i = 0; i < walk.nwalkers; ++i)
+  {
+    DirIteratorWalker *const walker = &walk.walkers[i];
+    walker->walk = &walk;
+    linkedlist_init(&walker->queue);
+    walker->it = NULL;
+    walker->object_path = NULL;
+    walker->object_path_size = 0;
+#ifdef DIRITER_USE_THREADS
+    pthread_mutex_init(&walker->lock, NULL);
+    walker->started = false;
+#endif
+  }
+
+  /* Each walker reads the directories in its queue in turn, without
+     recursion, and adds any sub-directories found to the end of its queue.
+     The calling thread is the first walker. If another thread can't be
+     created then there are just fewer walkers taking work. */
+  e = enqueue_dir(&walk.walkers[0], path_name, strlen(path_name));
+  if (e == NULL)
+  {
+#ifdef DIRITER_USE_THREADS
+    for (i = 1; i < walk.nwalkers; ++i)
+    {
+      DirIteratorWalker *const walker = &walk.walkers[i];
+      walker->started = pthread_create(&walker->thread, NULL, walker_thread,
+                                       walker) == 0;
+    }
+#endif
+
+    run_walker(&walk.walkers[0]);
+
+#ifdef DIRITER_USE_THREADS
+    for (i = 1; i < walk.nwalkers; ++i)
+    {
+      if (walk.walkers[i].started)
+        (void)pthread_join(walk.walkers[i].thread, NULL);
+    }
+#endif
+    e = walk.e;
+  }
+
+  DEBUGF("DirIterator: Walk %s\n", e != NULL ? "failed" :
+         walk.stop ? "stopped" : "finished");
+
+  for (i = 0; i < walk.nwalkers; ++i)
+  {
+    DirIteratorWalker *const walker = &walk.walkers[i];
+    (void)linkedlist_for_each(&walker->queue, free_walk_item_callback, NULL);
+    diriterator_destroy(walker->it); /* may be null */
+    free(walker->object_path);
+#ifdef DIRITER_USE_THREADS
+    pthread_mutex_destroy(&walker->lock);
+#endif
   }
 
+#ifdef DIRITER_USE_THREADS
+  pthread_cond_destroy(&walk.changed);
+  pthread_mutex_destroy(&walk.lock);
+#endif
+  free(walk.walkers);
+
   return e;
 }
 
+void diriterator_set_batch_limit(DirIterator *iterator,
+                                 unsigned int max_entries)
+{
+  DEBUGF("DirIterator: Setting batch limit of iterator %p to %u\n",
+         (void *)iterator, max_entries);
+
+  assert(iterator != NULL);
+  assert(max_entries > 0);
+
+  iterator->batch_limit = max_entries;
+  if (iterator->batch_size > max_entries)
+    iterator->batch_size = max_entries;
+}
+
 void diriterator_destroy(DirIterator *iterator)
 {
   DEBUGF("DirIterator: Destroying iterator %p\n", (void *)iterator);
   if (iterator != NULL)
   {
+    if (TEST_BITS(iterator->flags, DirIterator_ReadAhead))
+      scheduler_deregister_token(iterator->ahead_token);
+
     /* Free each member of the linked list in turn, starting at the head. */
-    free_levels(&iterator->dir_list, NULL);
+    free_levels(iterator, &iterator->dir_list, NULL);
+    (void)linkedlist_for_each(&iterator->free_list, destroy_level_callback,
+                              NULL);
 
     stringbuffer_destroy(&iterator->path_name);
+    stringbuffer_destroy(&iterator->ahead_path);
+    free(iterator->ahead_buffer); /* may be null */
     free(iterator->pattern); /* may be null */
     free(iterator);
   }
@@ -37,12 +37,34 @@
   }
   diriterator_destroy(it);
 
-Dependencies: ANSI C library, Acorn library kernel.
+  If the library is built for a hosted platform with DIRITER_USE_THREADS
+  defined then diriterator_walk can read directories in parallel using
+  POSIX threads. Reading ahead (DirIterator_ReadAhead) never uses a thread,
+  even then: it is always done by a scheduler client while the task is
+  idle.
+
+Dependencies: ANSI C library, Acorn library kernel, Acorn's event library (for
+              DirIterator_ReadAhead only).
 Message tokens: NoMem.
 History:
   CJB: 25-Mar-12: Created this header file.
   CJB: 24-Nov-14: Added reset method.
   CJB: 01-Jun-16: Documented that diriterator_destroy(NULL) has no effect.
+  CJB: 16-Oct-26: Added the diriterator_set_batch_limit function.
+  CJB: 16-Oct-26: Added the diriterator_walk function.
+  CJB: 16-Oct-26: Added the diriterator_rebind function.
+  CJB: 16-Oct-26: Added the diriterator_get_object_path_view function and
+                  the DirIterator_ContiguousPath flag.
+  CJB: 16-Oct-26: Added flags to sort the objects in each directory and the
+                  diriterator_set_filter function.
+  CJB: 16-Oct-26: Added the DirIterator_ReadAhead flag.
+  CJB: 16-Oct-26: Added the diriterator_advance_until and
+                  diriterator_get_progress functions.
+  CJB: 16-Oct-26: Added the DirIterator_CacheCatalogue flag.
+  CJB: 16-Oct-26: Added an error argument to DirIteratorWalkFunction and a
+                  number of threads argument to diriterator_walk.
+  CJB: 16-Oct-26: Documented that null events aren't requested for reading
+                  ahead while there is nothing to read.
  */
 
 #ifndef DirIter_h
@@ -76,9 +98,65 @@ typedef struct DirIterator DirIterator;
     * Incomplete struct type representing a directory tree iterator.
     */
 
+typedef struct
+{
+  const char *dir_path_name;
+  size_t      dir_path_name_len;
+  size_t      root_path_name_len;
+  const char *leaf_name;
+  size_t      leaf_name_len;
+  const char *path_name;
+  size_t      path_name_len;
+  const char *sub_path_name;
+  size_t      sub_path_name_len;
+}
+DirIteratorPathView;
+   /*
+    * Pointers to the path name of a directory tree iterator's current
+    * object, as borrowed from the iterator's own buffers. 'dir_path_name'
+    * is the path name of the directory that contains the object, which is
+    * not necessarily null-terminated after 'dir_path_name_len' characters;
+    * its first 'root_path_name_len' characters are the path name with which
+    * the iterator was created. 'leaf_name' is the object's null-terminated
+    * leaf name. 'path_name' and 'sub_path_name' are the object's
+    * null-terminated full path name and sub-path name, or null pointers
+    * unless the iterator was created with the DirIterator_ContiguousPath
+    * flag (see diriterator_make).
+    */
+
 /* Flags for use with the diriterator_make function */
 #define DirIterator_RecurseIntoDirectories       (1u << 0)
 #define DirIterator_RecurseIntoImages            (1u << 1)
+#define DirIterator_ContiguousPath               (1u << 2)
+#define DirIterator_SortMask                     (7u << 3)
+#define DirIterator_SortByName                   (1u << 3)
+#define DirIterator_SortByLength                 (2u << 3)
+#define DirIterator_SortByDate                   (3u << 3)
+#define DirIterator_SortByFileType               (4u << 3)
+#define DirIterator_SortDescending               (1u << 6)
+#define DirIterator_ReadAhead                    (1u << 7)
+#define DirIterator_CacheCatalogue               (1u << 8)
+
+typedef struct
+{
+  unsigned int  flags;
+  int           file_type;
+  long int      min_length;
+  long int      max_length;
+  OSDateAndTime min_date_stamp;
+  OSDateAndTime max_date_stamp;
+}
+DirIteratorFilter;
+   /*
+    * Criteria for the objects to be visited by a directory tree iterator,
+    * in addition to its wildcarded name pattern. Only those members
+    * selected by 'flags' are used. Ranges are inclusive.
+    */
+
+/* Flags for use in the DirIteratorFilter struct */
+#define DirIteratorFilter_FileType               (1u << 0)
+#define DirIteratorFilter_Length                 (1u << 1)
+#define DirIteratorFilter_DateStamp              (1u << 2)
 
 CONST _kernel_oserror *diriterator_make(DirIterator ** /*iterator*/,
                                         unsigned int   /*flags*/,
@@ -91,6 +169,44 @@ CONST _kernel_oserror *diriterator_make(DirIterator ** /*iterator*/,
     * image files is controlled by the specified flags. Only objects with
     * names that match the wildcarded string 'pattern' will be included.
     * If 'pattern' is a null pointer or "*" then all names will match.
+    * If 'flags' includes DirIterator_ContiguousPath then the iterator keeps
+    * the full path name of its current object in one buffer, so that
+    * diriterator_get_object_path_view can return it without copying; that
+    * costs one extra copy of the leaf name each time the iterator moves.
+    * Objects in each directory are visited in the order returned by the
+    * filing system unless 'flags' includes one of DirIterator_SortByName
+    * (ignoring case), DirIterator_SortByLength, DirIterator_SortByDate or
+    * DirIterator_SortByFileType, optionally combined with
+    * DirIterator_SortDescending. Objects with equal keys are sorted by
+    * name. Sorting requires the whole catalogue of each directory to be
+    * held in memory while its objects are visited.
+    * If 'flags' includes DirIterator_ReadAhead then the iterator registers
+    * a function with the scheduler (which must already be initialised) to
+    * read catalogue entries in advance whenever the task is idle: either
+    * the first batch of the next sub-directory to be entered or else the
+    * next batch of the current directory. That hides the time taken to
+    * read from slow media if the caller processes the objects in the
+    * background, yielding between them. Null events aren't requested on the
+    * iterator's behalf while there is nothing more to read in advance (e.g.
+    * once the iterator is empty) until it is advanced, reset or rebound.
+    * If 'flags' includes DirIterator_CacheCatalogue then the catalogue
+    * information of every object read is stored in the catalogue cache (if
+    * enabled), for use by get_file_type, get_file_size and get_date_stamp.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+CONST _kernel_oserror *diriterator_set_filter(
+                                     DirIterator             * /*iterator*/,
+                                     const DirIteratorFilter * /*filter*/);
+   /*
+    * Sets criteria for the objects to be visited by a directory tree
+    * iterator then resets it to its initial state, so that the first object
+    * visited is the first that matches. Objects that don't match are
+    * skipped before their names are copied anywhere. Directories and image
+    * files that the iterator would recurse into are never skipped, so that
+    * matching objects within them can still be found. If 'filter' is a
+    * null pointer then no objects are skipped (apart from those that don't
+    * match the name pattern).
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
@@ -100,6 +216,18 @@ CONST _kernel_oserror *diriterator_reset(DirIterator * /*iterator*/);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+CONST _kernel_oserror *diriterator_rebind(DirIterator * /*iterator*/,
+                                          const char  * /*path_name*/);
+   /*
+    * Reuses a directory iterator to traverse a different directory
+    * 'path_name', with the same flags and pattern as before. Memory
+    * allocated for the previous traversal is recycled, so repeated scans
+    * of the same tree allocate nothing after the first. If an error is
+    * returned then the iterator is empty, but it may still be reset,
+    * rebound or destroyed.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
 bool diriterator_is_empty(const DirIterator *iterator);
    /*
     * Finds out whether a specified iterator is empty (i.e. there is no
@@ -162,6 +290,21 @@ size_t diriterator_get_object_leaf_name(const DirIterator * /*iterator*/,
     * diriterator_get_object_path_name in every other respect.
     */
 
+bool diriterator_get_object_path_view(const DirIterator   * /*iterator*/,
+                                      DirIteratorPathView * /*view*/);
+   /*
+    * Gets pointers to the path name of the current object from a specified
+    * directory tree iterator without copying any characters. This is
+    * cheaper than calling diriterator_get_object_path_name twice (once to
+    * find the required buffer size and again to fill the buffer). The
+    * pointers remain valid until the iterator is advanced, reset, rebound
+    * or destroyed. The full path name and sub-path name are only available
+    * if the iterator was created with the DirIterator_ContiguousPath flag,
+    * and not if there was insufficient memory to append the leaf name.
+    * Returns: true if the view was filled in, or false if the iterator is
+    *          empty (in which case '*view' is not modified).
+    */
+
 CONST _kernel_oserror *diriterator_advance(DirIterator * /*iterator*/);
    /*
     * Advances the given iterator to the next object in the directory tree
@@ -174,6 +317,107 @@ CONST _kernel_oserror *diriterator_advance(DirIterator * /*iterator*/);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+typedef bool DirIteratorVisitFunction(const DirIterator * /*iterator*/,
+                                      void              * /*arg*/);
+   /*
+    * Type of function called by diriterator_advance_until for each object
+    * visited. 'iterator' is the iterator, of which the current object is
+    * the one being visited, and 'arg' is the value passed to
+    * diriterator_advance_until. The function must not advance, reset,
+    * rebind or destroy the iterator.
+    * Returns: true to continue, or false to stop at the current object.
+    */
+
+CONST _kernel_oserror *diriterator_advance_until(
+                                     DirIterator              * /*iterator*/,
+                                     const volatile bool      * /*time_up*/,
+                                     DirIteratorVisitFunction * /*callback*/,
+                                     void                     * /*arg*/);
+   /*
+    * Repeatedly calls the given function for the current object of an
+    * iterator then advances the iterator, returning when the variable
+    * pointed to by 'time_up' is found to be true and at least one object
+    * has been visited, or the iterator is empty, or the function returns
+    * false (in which case the iterator is not advanced past the object for
+    * which it did so). A scan can be resumed by calling this function
+    * again. In conjunction with the scheduler, this allows long scans of
+    * directory trees to be done in the background.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    *          If an error is returned then the current object (which was
+    *          already visited) is unchanged, so it will be visited again
+    *          if this function is called again.
+    */
+
+unsigned int diriterator_get_progress(const DirIterator * /*iterator*/);
+   /*
+    * Estimates what proportion of the directories in the tree have been
+    * entered by the given iterator, as a percentage of the number found so
+    * far. Because directories are found as their parents' catalogues are
+    * read, the estimate can go down as well as up.
+    * Returns: the percentage done (100 if the iterator is empty).
+    */
+
+typedef bool DirIteratorWalkFunction(const char                  */*path_name*/,
+                                     int                          /*object_type*/,
+                                     const DirIteratorObjectInfo */*info*/,
+                                     CONST _kernel_oserror       */*e*/,
+                                     void                        */*arg*/);
+   /*
+    * Type of function called by diriterator_walk for each object found,
+    * and for each directory that couldn't be read. For an object,
+    * 'path_name' is its full path name, 'object_type' is its type, 'info'
+    * points to catalogue information about it (as output by
+    * diriterator_get_object_info) and 'e' is a null pointer. For a
+    * directory that couldn't be read, 'path_name' is the full path name of
+    * the directory, 'object_type' is ObjectType_NotFound, 'info' is a null
+    * pointer and 'e' points to the error; any objects in the directory
+    * that were already visited aren't visited again. 'arg' is the value
+    * passed to diriterator_walk. The strings, information and error are
+    * only valid until the function returns. If the walk uses more than one
+    * thread then the function may be called by several threads at once.
+    * Returns: true to continue the walk, or false to stop it.
+    */
+
+CONST _kernel_oserror *diriterator_walk(const char              * /*path_name*/,
+                                        const char              * /*pattern*/,
+                                        unsigned int              /*flags*/,
+                                        unsigned int              /*nthreads*/,
+                                        DirIteratorWalkFunction * /*callback*/,
+                                        void                    * /*arg*/);
+   /*
+    * Walks the directory tree rooted at 'path_name', calling the given
+    * function for each object that matches the wildcarded string 'pattern'.
+    * The objects visited are the same as for an iterator created by
+    * diriterator_make with the same arguments, but the tree is walked
+    * breadth-first: the whole of each directory is read (without keeping
+    * any other directory open) before any sub-directory found in it.
+    * An error reading a directory (including the root) is passed to the
+    * function instead of stopping the walk. The walk stops early if the
+    * function returns false.
+    * If the library is built with DIRITER_USE_THREADS defined then up to
+    * 'nthreads' threads (including the caller's) read directories in
+    * parallel. Each has its own queue of directories found, and a thread
+    * whose queue is empty takes the directory found most recently by
+    * another. Objects are then visited in an unpredictable order and the
+    * function must be thread-safe, as must the functions used to read
+    * catalogue entries. Otherwise, 'nthreads' is ignored.
+    * Returns: a pointer to an OS error block if the walk couldn't be
+    *          completed (e.g. for lack of memory), or else NULL for success
+    *          (including if the walk was stopped by the function).
+    */
+
+void diriterator_set_batch_limit(DirIterator * /*iterator*/,
+                                 unsigned int  /*max_entries*/);
+   /*
+    * Sets the maximum number of catalogue entries that the given iterator
+    * may request from the filing system in one call. The number requested
+    * starts small and grows up to this limit whilst reading directories
+    * that need more than one call, so a higher limit reduces the number of
+    * calls made for large directories (e.g. on network shares) at the cost
+    * of bigger buffers. The default limit is 256. 'max_entries' must not
+    * be zero.
+    */
+
 void diriterator_destroy(DirIterator * /*iterator*/);
    /*
     * Frees memory that was previously allocated for a directory iterator.
@@ -0,0 +1,184 @@
+/*
+ * CBLibrary: Background scans of directory trees
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* History:
+  CJB: 16-Oct-26: Created this source file.
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+
+/* Local headers */
+#include "Internal/CBMisc.h"
+#include "Scheduler.h"
+#include "DirIter.h"
+#include "DirScan.h"
+
+/* State of a background scan. */
+struct DirScan
+{
+  DirIterator              *iterator;
+  DirIteratorVisitFunction *visitor;
+  DirScanFinishedFunction  *finished;
+  void                     *arg;
+  bool                      stopped; /* Whether the visitor returned
+                                        false. */
+  unsigned int              progress; /* Highest percentage reported. */
+};
+
+/* ----------------------------------------------------------------------- */
+/*                       Function prototypes                               */
+
+static SchedulerIdleFunction scan_idle;
+static DirIteratorVisitFunction visit;
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+CONST _kernel_oserror *dirscan_start(DirScan                 **scan,
+                                     unsigned int               flags,
+                                     const char                *path_name,
+                                     const char                *pattern,
+                                     DirIteratorVisitFunction  *visitor,
+                                     DirScanFinishedFunction   *finished,
+                                     void                      *arg)
+{
+  CONST _kernel_oserror *e = NULL;
+  DirScan *new_scan;
+
+  assert(scan != NULL);
+  assert(path_name != NULL);
+  assert(visitor != NULL);
+  assert(finished != NULL);
+  DEBUGF("DirScan: Starting scan of '%s' with flags 0x%x and pattern '%s'\n",
+         path_name, flags, pattern ? pattern : "");
+
+  *scan = NULL;
+  new_scan = malloc(sizeof(*new_scan));
+  if (new_scan == NULL)
+    return messagetrans_error_lookup(NULL, DUMMY_ERRNO, "NoMem", 0);
+
+  new_scan->visitor = visitor;
+  new_scan->finished = finished;
+  new_scan->arg = arg;
+  new_scan->stopped = false;
+  new_scan->progress = 0;
+
+  e = diriterator_make(&new_scan->iterator, flags, path_name, pattern);
+  if (e == NULL)
+  {
+    /* The first objects are visited the next time the task is idle. */
+    e = scheduler_register_delay(scan_idle, new_scan, 0,
+                                 SchedulerPriority_Min);
+    if (e != NULL)
+      diriterator_destroy(new_scan->iterator);
+  }
+
+  if (e == NULL)
+    *scan = new_scan;
+  else
+    free(new_scan);
+
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+unsigned int dirscan_get_progress(const DirScan *scan)
+{
+  assert(scan != NULL);
+  return scan->progress;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void dirscan_stop(DirScan *scan)
+{
+  DEBUGF("DirScan: Stopping scan %p\n", (void *)scan);
+  if (scan != NULL)
+  {
+    scheduler_deregister(scan_idle, scan);
+    diriterator_destroy(scan->iterator);
+    free(scan);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static bool visit(const DirIterator *iterator, void *arg)
+{
+  DirScan *const scan = arg;
+
+  assert(scan != NULL);
+  assert(iterator == scan->iterator);
+
+  if (!scan->visitor(iterator, scan->arg))
+  {
+    DEBUGF("DirScan: Stopped by visitor\n");
+    scan->stopped = true;
+  }
+
+  return !scan->stopped;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SchedulerTime scan_idle(void                *handle,
+                               SchedulerTime        time_now,
+                               const volatile bool *time_up)
+{
+  DirScan *const scan = handle;
+  CONST _kernel_oserror *e;
+  unsigned int progress;
+
+  assert(scan != NULL);
+
+  e = diriterator_advance_until(scan->iterator, time_up, visit, scan);
+
+  /* Don't let the percentage go backwards when more directories are
+     found. */
+  progress = diriterator_get_progress(scan->iterator);
+  if (progress > scan->progress)
+    scan->progress = progress;
+
+  DEBUG_VERBOSEF("DirScan: Scan %p is %u%% done\n", (void *)scan,
+                 scan->progress);
+
+  if (e != NULL || scan->stopped || diriterator_is_empty(scan->iterator))
+  {
+    DirScanFinishedFunction *const finished = scan->finished;
+    void *const arg = scan->arg;
+
+    /* Destroy the scan before calling the function, in case it starts
+       another scan. */
+    dirscan_stop(scan);
+    finished(e, arg);
+  }
+
+  return time_now; /* call again as soon as possible (ignored if the scan
+                       was destroyed) */
+}
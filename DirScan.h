@@ -0,0 +1,111 @@
+/*
+ * CBLibrary: Background scans of directory trees
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* DirScan.h declares functions and types to scan a directory tree in the
+   background, visiting a few objects each time the task is idle so that
+   the desktop doesn't freeze whilst scanning a big tree. The scheduler
+   must be initialised before starting a scan.
+
+  Example usage (counts the files in a tree):
+
+  static bool count_file(const DirIterator *it, void *arg)
+  {
+    if (diriterator_get_object_info(it, NULL) == ObjectType_File)
+      ++*(unsigned long *)arg;
+    return true;
+  }
+
+  static void scan_finished(CONST _kernel_oserror *e, void *arg)
+  {
+    if (e != NULL)
+      err_check_rep(e);
+  }
+
+  static unsigned long nfiles;
+  DirScan *scan;
+  ON_ERR_RPT(dirscan_start(&scan, DirIterator_RecurseIntoDirectories,
+                           "ADFS::0.$", NULL, count_file, scan_finished,
+                           &nfiles));
+
+Dependencies: ANSI C library, Acorn library kernel, Acorn's event library.
+Message tokens: NoMem.
+History:
+  CJB: 16-Oct-26: Created this header file.
+*/
+
+#ifndef DirScan_h
+#define DirScan_h
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* Local headers */
+#include "Macros.h"
+#include "DirIter.h"
+
+typedef struct DirScan DirScan;
+   /*
+    * Incomplete struct type representing a background scan.
+    */
+
+typedef void DirScanFinishedFunction(CONST _kernel_oserror * /*e*/,
+                                     void                  * /*arg*/);
+   /*
+    * Type of function called when a background scan finishes, either
+    * because every object has been visited, the visitor function returned
+    * false or an error occurred. 'e' is a pointer to an OS error block, or
+    * else NULL for success. 'arg' is the value passed to dirscan_start.
+    * The scan has already been destroyed when this function is called, so
+    * it may start another scan but must not use the old one.
+    */
+
+CONST _kernel_oserror *dirscan_start(DirScan                 ** /*scan*/,
+                                     unsigned int               /*flags*/,
+                                     const char               * /*path_name*/,
+                                     const char               * /*pattern*/,
+                                     DirIteratorVisitFunction * /*visitor*/,
+                                     DirScanFinishedFunction  * /*finished*/,
+                                     void                     * /*arg*/);
+   /*
+    * Starts a background scan of the directory tree 'path_name'. The
+    * 'visitor' function is called for each object that an iterator created
+    * by diriterator_make with the same 'flags' and 'pattern' would visit,
+    * for as long as the scheduler allows each time the task is idle. The
+    * 'finished' function is called when the scan is over (but not if it was
+    * stopped by dirscan_stop). 'arg' is passed to both functions.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    *          If an error is returned then neither function is called.
+    */
+
+unsigned int dirscan_get_progress(const DirScan * /*scan*/);
+   /*
+    * Estimates how much of a background scan has been done, based on the
+    * number of directories entered so far. Unlike the value returned by
+    * diriterator_get_progress, it never goes down.
+    * Returns: the percentage done.
+    */
+
+void dirscan_stop(DirScan * /*scan*/);
+   /*
+    * Stops a background scan that hasn't yet finished and frees the memory
+    * that was allocated for it. The 'finished' function is not called.
+    * Does nothing if called with a null pointer.
+    */
+
+#endif
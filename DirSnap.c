@@ -0,0 +1,1069 @@
+/*
+ * CBLibrary: Directory tree snapshots and change detection
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* History:
+  CJB: 16-Oct-26: Created this source file.
+  CJB: 16-Oct-26: dirsnapshot_read rejects path names, patterns, records
+                  and names that are too long or longer than the rest of
+                  the stream, instead of trying to allocate memory for them.
+  CJB: 16-Oct-26: Added dirsnapshot_initialise so that error messages can be
+                  looked up in the client's messages file. Read and write
+                  errors now name the file instead of "DirSnapshot".
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBUtilLib headers */
+#include "StringBuff.h"
+#include "StrExtra.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSFile.h"
+
+/* StreamLib headers */
+#include "Reader.h"
+#include "Writer.h"
+
+/* Local headers */
+#include "Internal/CBMisc.h"
+#include "Platform.h"
+#include "DateStamp.h"
+#include "DirIter.h"
+#include "DirSnap.h"
+
+/* Constant numeric values */
+enum
+{
+  GrowthFactor = 2,       /* Multiplier for array sizes when full */
+  InitialRecords = 64,    /* Initial size of the array of records */
+  InitialNameSize = 1024, /* Initial size of the pool of names, in bytes */
+  SnapshotMagic = 0x70616e53, /* "Snap" */
+  SnapshotVersion = 1,
+  MaxStringLen = 65535    /* Maximum length of the stored path name or
+                             pattern, in bytes */
+};
+
+/* Record for one object. The objects in each directory are stored as
+   a contiguous block of records, sorted by name. The block for the root
+   directory is first. */
+typedef struct
+{
+  DirIteratorObjectInfo info;
+  int                   object_type;
+  unsigned int          name_offset; /* Offset of the leaf name in the pool
+                                        of names. */
+  unsigned int          first_child; /* Index of the first record in the
+                                        block for this directory. */
+  unsigned int          nchildren; /* Number of records in the block for
+                                      this directory (0 if not entered). */
+}
+DirSnapshotRecord;
+
+struct DirSnapshot
+{
+  unsigned int flags; /* Flags passed to dirsnapshot_make */
+  char *path_name; /* Path name of the root directory */
+  char *pattern; /* Wildcarded name to match, or NULL to match all */
+  DirSnapshotRecord root; /* Pseudo-record for the root directory */
+  DirSnapshotRecord *records;
+  unsigned int nrecords;
+  unsigned int records_size; /* Number of records allocated */
+  char *names; /* Pool of nul-terminated leaf names */
+  size_t names_len;
+  size_t names_size; /* Number of bytes allocated */
+  size_t dirs_read;
+};
+
+/* Header of a snapshot written to a stream. It is followed by the path name
+   and pattern (without terminators), the records and the pool of names. */
+typedef struct
+{
+  unsigned int          magic;
+  unsigned int          version;
+  unsigned int          flags;
+  unsigned int          nrecords;
+  unsigned int          names_len;
+  unsigned int          path_name_len;
+  unsigned int          pattern_len; /* 0 if pattern is NULL */
+  DirSnapshotRecord     root;
+}
+DirSnapshotHeader;
+
+/* State of a scan to create a snapshot. */
+typedef struct
+{
+  DirSnapshot       *snapshot;
+  const DirSnapshot *old; /* Previous snapshot of the same tree, or NULL. */
+  bool               skip_unchanged;
+  DirIterator       *iterator; /* Rebound to each directory in turn, or NULL
+                                  before the first directory is read. */
+  StringBuffer       path_name;
+}
+ScanContext;
+
+/* State of a comparison between snapshots. */
+typedef struct
+{
+  const DirSnapshot       *old;
+  const DirSnapshot       *new;
+  DirSnapshotDiffFunction *callback;
+  void                    *arg;
+  StringBuffer             sub_path_name;
+  bool                     stop;
+}
+DiffContext;
+
+/* Pool of names used by compare_records, because qsort has no argument
+   to pass it. */
+static const char *sort_names;
+
+static MessagesFD *desc;
+
+/* ----------------------------------------------------------------------- */
+/*                       Function prototypes                               */
+
+static CONST _kernel_oserror *lookup_error(const char *token,
+                                           const char *param);
+static CONST _kernel_oserror *no_mem(void);
+static DirSnapshot *alloc_snapshot(unsigned int flags, const char *path_name,
+                                   const char *pattern);
+static CONST _kernel_oserror *reserve_records(DirSnapshot *snapshot,
+                                              unsigned int n);
+static bool fits_in_stream(Reader *reader, const DirSnapshotHeader *header);
+static CONST _kernel_oserror *reserve_names(DirSnapshot *snapshot,
+                                            size_t n);
+static const char *get_name(const DirSnapshot *snapshot,
+                            const DirSnapshotRecord *record);
+static CONST _kernel_oserror *read_info(const char *path_name,
+                                        DirSnapshotRecord *record);
+static bool same_date(const DirIteratorObjectInfo *a,
+                      const DirIteratorObjectInfo *b);
+static bool same_info(const DirSnapshotRecord *a, const DirSnapshotRecord *b);
+static bool can_enter(unsigned int flags, int object_type);
+static int compare_records(const void *a, const void *b);
+static const DirSnapshotRecord *find_child(const DirSnapshot *snapshot,
+                                           const DirSnapshotRecord *dir,
+                                           const char *name);
+static CONST _kernel_oserror *read_dir(ScanContext *ctx);
+static CONST _kernel_oserror *copy_dir(ScanContext *ctx,
+                                       const DirSnapshotRecord *old_dir);
+static CONST _kernel_oserror *scan_dir(ScanContext *ctx,
+                                       DirSnapshotRecord *dir,
+                                       const DirSnapshotRecord *old_dir,
+                                       bool unchanged);
+static CONST _kernel_oserror *scan(DirSnapshot **snapshot,
+                                   DirSnapshot *new_snapshot,
+                                   const DirSnapshot *old,
+                                   bool skip_unchanged);
+static bool push_name(StringBuffer *sub_path_name, const char *name);
+static CONST _kernel_oserror *report_tree(DiffContext *ctx,
+                                          DirSnapshotChange change,
+                                          const DirSnapshotRecord *record);
+static CONST _kernel_oserror *diff_dir(DiffContext *ctx,
+                                       const DirSnapshotRecord *old_dir,
+                                       const DirSnapshotRecord *new_dir);
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+CONST _kernel_oserror *dirsnapshot_initialise(MessagesFD *mfd)
+{
+  /* Store pointer to messages file descriptor */
+  desc = mfd;
+  return NULL; /* success */
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *dirsnapshot_make(DirSnapshot **snapshot,
+                                        unsigned int   flags,
+                                        const char    *path_name,
+                                        const char    *pattern)
+{
+  assert(snapshot != NULL);
+  assert(path_name != NULL);
+  DEBUGF("DirSnapshot: Making snapshot of '%s' with flags 0x%x and "
+         "pattern '%s'\n", path_name, flags, pattern ? pattern : "");
+
+  *snapshot = NULL;
+  DirSnapshot *const new_snapshot = alloc_snapshot(flags, path_name,
+                                                   pattern);
+  if (new_snapshot == NULL)
+    return no_mem();
+
+  return scan(snapshot, new_snapshot, NULL, false);
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *dirsnapshot_rescan(DirSnapshot       **snapshot,
+                                          const DirSnapshot  *old,
+                                          unsigned int        flags)
+{
+  assert(snapshot != NULL);
+  assert(old != NULL);
+  DEBUGF("DirSnapshot: Rescanning snapshot %p with flags 0x%x\n",
+         (void *)old, flags);
+
+  *snapshot = NULL;
+  DirSnapshot *const new_snapshot = alloc_snapshot(old->flags,
+                                                   old->path_name,
+                                                   old->pattern);
+  if (new_snapshot == NULL)
+    return no_mem();
+
+  return scan(snapshot, new_snapshot, old,
+              TEST_BITS(flags, DirSnapshot_SkipUnchangedDirectories));
+}
+
+/* ----------------------------------------------------------------------- */
+
+size_t dirsnapshot_get_count(const DirSnapshot *snapshot)
+{
+  assert(snapshot != NULL);
+  return snapshot->nrecords;
+}
+
+/* ----------------------------------------------------------------------- */
+
+size_t dirsnapshot_get_dirs_read(const DirSnapshot *snapshot)
+{
+  assert(snapshot != NULL);
+  return snapshot->dirs_read;
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *dirsnapshot_diff(const DirSnapshot       *old,
+                                        const DirSnapshot       *new,
+                                        DirSnapshotDiffFunction *callback,
+                                        void                    *arg)
+{
+  assert(old != NULL);
+  assert(new != NULL);
+  assert(callback != NULL);
+  DEBUGF("DirSnapshot: Comparing snapshot %p with %p\n",
+         (void *)old, (void *)new);
+
+  DiffContext ctx = {
+    .old = old,
+    .new = new,
+    .callback = callback,
+    .arg = arg,
+    .stop = false
+  };
+  stringbuffer_init(&ctx.sub_path_name);
+
+  CONST _kernel_oserror *const e = diff_dir(&ctx, &old->root, &new->root);
+
+  stringbuffer_destroy(&ctx.sub_path_name);
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *dirsnapshot_write(const DirSnapshot *snapshot,
+                                         Writer            *writer,
+                                         const char        *file_name)
+{
+  assert(snapshot != NULL);
+  assert(writer != NULL);
+  assert(file_name != NULL);
+  DEBUGF("DirSnapshot: Writing snapshot %p (%u records, %zu bytes of "
+         "names)\n", (void *)snapshot, snapshot->nrecords,
+         snapshot->names_len);
+
+  const size_t path_name_len = strlen(snapshot->path_name);
+  const size_t pattern_len = snapshot->pattern == NULL ?
+                             0 : strlen(snapshot->pattern);
+
+  if (path_name_len > MaxStringLen || pattern_len > MaxStringLen)
+  {
+    DEBUGF("DirSnapshot: path name or pattern too long\n");
+    return lookup_error("WriteFail", file_name);
+  }
+
+  const DirSnapshotHeader header = {
+    .magic = SnapshotMagic,
+    .version = SnapshotVersion,
+    .flags = snapshot->flags,
+    .nrecords = snapshot->nrecords,
+    .names_len = (unsigned int)snapshot->names_len,
+    .path_name_len = (unsigned int)path_name_len,
+    .pattern_len = (unsigned int)pattern_len,
+    .root = snapshot->root
+  };
+
+  if (writer_fwrite(&header, sizeof(header), 1, writer) != 1 ||
+      writer_fwrite(snapshot->path_name, 1, path_name_len, writer) !=
+        path_name_len ||
+      (pattern_len > 0 &&
+       writer_fwrite(snapshot->pattern, 1, pattern_len, writer) !=
+         pattern_len) ||
+      writer_fwrite(snapshot->records, sizeof(*snapshot->records),
+                    snapshot->nrecords, writer) != snapshot->nrecords ||
+      writer_fwrite(snapshot->names, 1, snapshot->names_len, writer) !=
+        snapshot->names_len)
+  {
+    DEBUGF("DirSnapshot: writer_fwrite failed\n");
+    return lookup_error("WriteFail", file_name);
+  }
+
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *dirsnapshot_read(DirSnapshot **snapshot,
+                                        Reader       *reader,
+                                        const char   *file_name)
+{
+  assert(snapshot != NULL);
+  assert(reader != NULL);
+  assert(file_name != NULL);
+  DEBUGF("DirSnapshot: Reading snapshot\n");
+
+  *snapshot = NULL;
+
+  DirSnapshotHeader header;
+  if (reader_fread(&header, sizeof(header), 1, reader) != 1 ||
+      header.magic != SnapshotMagic ||
+      header.version != SnapshotVersion ||
+      header.root.nchildren > header.nrecords ||
+      header.root.first_child != 0 ||
+      header.path_name_len == 0 ||
+      header.path_name_len > MaxStringLen ||
+      header.pattern_len > MaxStringLen ||
+      (header.names_len > 0 && header.nrecords == 0) ||
+      !fits_in_stream(reader, &header))
+  {
+    DEBUGF("DirSnapshot: Bad header\n");
+    return lookup_error("ReadFail", file_name);
+  }
+
+  CONST _kernel_oserror *e = NULL;
+  char *const path_name = malloc(header.path_name_len + 1);
+  char *const pattern = header.pattern_len > 0 ?
+                        malloc(header.pattern_len + 1) : NULL;
+
+  DirSnapshot *new_snapshot = NULL;
+  if (path_name == NULL || (header.pattern_len > 0 && pattern == NULL))
+  {
+    e = no_mem();
+  }
+  else if (reader_fread(path_name, 1, header.path_name_len, reader) !=
+             header.path_name_len ||
+           (pattern != NULL &&
+            reader_fread(pattern, 1, header.pattern_len, reader) !=
+              header.pattern_len))
+  {
+    e = lookup_error("ReadFail", file_name);
+  }
+  else
+  {
+    path_name[header.path_name_len] = '\0';
+    if (pattern != NULL)
+      pattern[header.pattern_len] = '\0';
+
+    new_snapshot = alloc_snapshot(header.flags, path_name, pattern);
+    if (new_snapshot == NULL)
+      e = no_mem();
+  }
+
+  free(pattern);
+  free(path_name);
+
+  if (e == NULL)
+  {
+    new_snapshot->root = header.root;
+    e = reserve_records(new_snapshot, header.nrecords);
+    if (e == NULL)
+      e = reserve_names(new_snapshot, header.names_len);
+  }
+
+  if (e == NULL)
+  {
+    if (reader_fread(new_snapshot->records, sizeof(*new_snapshot->records),
+                     header.nrecords, reader) != header.nrecords ||
+        reader_fread(new_snapshot->names, 1, header.names_len, reader) !=
+          header.names_len)
+    {
+      e = lookup_error("ReadFail", file_name);
+    }
+    else
+    {
+      new_snapshot->nrecords = header.nrecords;
+      new_snapshot->names_len = header.names_len;
+
+      /* Check that every name is terminated and every block of records is
+         later in the array than the record for its directory, so that
+         recursion over the tree must terminate. */
+      bool valid = (header.names_len == 0 ||
+                    new_snapshot->names[header.names_len - 1] == '\0');
+
+      for (unsigned int i = 0; valid && i < header.nrecords; ++i)
+      {
+        const DirSnapshotRecord *const record = &new_snapshot->records[i];
+        valid = record->name_offset < header.names_len &&
+                record->nchildren <= header.nrecords &&
+                (record->nchildren == 0 ||
+                 (record->first_child > i &&
+                  record->first_child <= header.nrecords -
+                                         record->nchildren));
+      }
+
+      if (!valid)
+      {
+        DEBUGF("DirSnapshot: Bad records\n");
+        e = lookup_error("ReadFail", file_name);
+      }
+    }
+  }
+
+  if (e == NULL)
+    *snapshot = new_snapshot;
+  else
+    dirsnapshot_destroy(new_snapshot);
+
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void dirsnapshot_destroy(DirSnapshot *snapshot)
+{
+  DEBUGF("DirSnapshot: Destroying snapshot %p\n", (void *)snapshot);
+  if (snapshot != NULL)
+  {
+    free(snapshot->names);
+    free(snapshot->records);
+    free(snapshot->pattern);
+    free(snapshot->path_name);
+    free(snapshot);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static CONST _kernel_oserror *lookup_error(const char *token,
+                                           const char *param)
+{
+  /* Look up error message from the token, outputting to an internal buffer */
+  return messagetrans_error_lookup(desc, DUMMY_ERRNO, token, 1, param);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *no_mem(void)
+{
+  return lookup_error("NoMem", NULL);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static DirSnapshot *alloc_snapshot(unsigned int flags, const char *path_name,
+                                   const char *pattern)
+{
+  assert(path_name != NULL);
+
+  DirSnapshot *const snapshot = malloc(sizeof(*snapshot));
+  if (snapshot == NULL)
+    return NULL;
+
+  *snapshot = (DirSnapshot){
+    .flags = flags,
+    .path_name = strdup(path_name),
+    .pattern = NULL,
+    .records = NULL,
+    .nrecords = 0,
+    .records_size = 0,
+    .names = NULL,
+    .names_len = 0,
+    .names_size = 0,
+    .dirs_read = 0
+  };
+
+  /* Match any object name if the pattern is "*" */
+  if (pattern != NULL && strcmp(pattern, "*") != 0)
+    snapshot->pattern = strdup(pattern);
+
+  if (snapshot->path_name == NULL ||
+      (pattern != NULL && strcmp(pattern, "*") != 0 &&
+       snapshot->pattern == NULL))
+  {
+    dirsnapshot_destroy(snapshot);
+    return NULL;
+  }
+
+  return snapshot;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool fits_in_stream(Reader *reader, const DirSnapshotHeader *header)
+{
+  /* Check the lengths in the header against the size of the rest of the
+     stream, if known, so that a corrupt header doesn't cause a huge
+     allocation. Streams that can't seek are not checked. */
+  assert(reader != NULL);
+  assert(header != NULL);
+
+  const uint64_t needed = (uint64_t)header->nrecords *
+                           sizeof(DirSnapshotRecord) +
+                         header->path_name_len + header->pattern_len +
+                         header->names_len;
+  const long int pos = reader_ftell(reader);
+  if (pos < 0 || reader_fseek(reader, 0, SEEK_END))
+    return true;
+
+  const long int end = reader_ftell(reader);
+  if (reader_fseek(reader, pos, SEEK_SET))
+    return false;
+
+  return end >= pos && needed <= (uint64_t)(end - pos);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *reserve_records(DirSnapshot *snapshot,
+                                              unsigned int n)
+{
+  assert(snapshot != NULL);
+
+  if (n <= snapshot->records_size - snapshot->nrecords)
+    return NULL;
+
+  if (n > UINT_MAX - snapshot->nrecords)
+    return no_mem();
+
+  unsigned int new_size = HIGHEST(snapshot->records_size * GrowthFactor,
+                                  InitialRecords);
+  new_size = HIGHEST(new_size, snapshot->nrecords + n);
+
+  DirSnapshotRecord *const new_records = realloc(snapshot->records,
+    sizeof(*new_records) * new_size);
+  if (new_records == NULL)
+    return no_mem();
+
+  snapshot->records = new_records;
+  snapshot->records_size = new_size;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *reserve_names(DirSnapshot *snapshot, size_t n)
+{
+  assert(snapshot != NULL);
+
+  if (n <= snapshot->names_size - snapshot->names_len)
+    return NULL;
+
+  /* Name offsets must fit in an unsigned int */
+  if (n > UINT_MAX - snapshot->names_len)
+    return no_mem();
+
+  size_t new_size = HIGHEST(snapshot->names_size * GrowthFactor,
+                            InitialNameSize);
+  new_size = HIGHEST(new_size, snapshot->names_len + n);
+
+  char *const new_names = realloc(snapshot->names, new_size);
+  if (new_names == NULL)
+    return no_mem();
+
+  snapshot->names = new_names;
+  snapshot->names_size = new_size;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const char *get_name(const DirSnapshot *snapshot,
+                            const DirSnapshotRecord *record)
+{
+  assert(snapshot != NULL);
+  assert(record != NULL);
+  assert(record->name_offset < snapshot->names_len);
+  return snapshot->names + record->name_offset;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *read_info(const char *path_name,
+                                        DirSnapshotRecord *record)
+{
+  assert(path_name != NULL);
+  assert(record != NULL);
+
+  OS_File_CatalogueInfo cat;
+  ON_ERR_RTN_E(os_file_read_cat_no_path(path_name, &cat));
+
+  /* Convert the catalogue information in the same way as
+     diriterator_get_object_info */
+  record->object_type = cat.object_type;
+  record->info.file_type = decode_load_exec(cat.load, cat.exec,
+                                            &record->info.date_stamp);
+
+  if (cat.object_type == ObjectType_Directory ||
+      cat.object_type == ObjectType_Image)
+  {
+    const char *const leaf = strrchr(path_name, PATH_SEPARATOR);
+    record->info.file_type = ((leaf != NULL ? leaf[1] : path_name[0]) == '!' ?
+                              FileType_Application : FileType_Directory);
+  }
+
+  record->info.length = cat.length;
+  record->info.attributes = cat.attributes;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool same_date(const DirIteratorObjectInfo *a,
+                      const DirIteratorObjectInfo *b)
+{
+  assert(a != NULL);
+  assert(b != NULL);
+  return memcmp(&a->date_stamp, &b->date_stamp, sizeof(a->date_stamp)) == 0;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool same_info(const DirSnapshotRecord *a, const DirSnapshotRecord *b)
+{
+  assert(a != NULL);
+  assert(b != NULL);
+  return a->object_type == b->object_type &&
+         same_date(&a->info, &b->info) &&
+         a->info.length == b->info.length &&
+         a->info.attributes == b->info.attributes &&
+         a->info.file_type == b->info.file_type;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool can_enter(unsigned int flags, int object_type)
+{
+  switch (object_type)
+  {
+    case ObjectType_Image:
+      return TEST_BITS(flags, DirIterator_RecurseIntoImages);
+    case ObjectType_Directory:
+      return TEST_BITS(flags, DirIterator_RecurseIntoDirectories);
+    default:
+      return false;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static int compare_records(const void *a, const void *b)
+{
+  const DirSnapshotRecord *const ra = a, *const rb = b;
+  assert(sort_names != NULL);
+  return stricmp(sort_names + ra->name_offset, sort_names + rb->name_offset);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const DirSnapshotRecord *find_child(const DirSnapshot *snapshot,
+                                           const DirSnapshotRecord *dir,
+                                           const char *name)
+{
+  assert(snapshot != NULL);
+  assert(dir != NULL);
+  assert(name != NULL);
+
+  /* Binary search of the sorted block of records for the directory */
+  unsigned int low = dir->first_child, high = low + dir->nchildren;
+  while (low < high)
+  {
+    const unsigned int mid = low + (high - low) / 2;
+    const DirSnapshotRecord *const record = &snapshot->records[mid];
+    const int cmp = stricmp(name, get_name(snapshot, record));
+    if (cmp == 0)
+      return record;
+
+    if (cmp < 0)
+      high = mid;
+    else
+      low = mid + 1;
+  }
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *read_dir(ScanContext *ctx)
+{
+  CONST _kernel_oserror *e;
+  assert(ctx != NULL);
+
+  DirSnapshot *const snapshot = ctx->snapshot;
+  const char *const path_name = stringbuffer_get_pointer(&ctx->path_name);
+  const unsigned int first = snapshot->nrecords;
+
+  DEBUGF("DirSnapshot: Reading directory '%s'\n", path_name);
+  ++snapshot->dirs_read;
+
+  /* Read the directory without recursion, to allow the objects in it to be
+     sorted before any sub-directory is read. */
+  if (ctx->iterator == NULL)
+    e = diriterator_make(&ctx->iterator, 0, path_name, snapshot->pattern);
+  else
+    e = diriterator_rebind(ctx->iterator, path_name);
+
+  for (; e == NULL && !diriterator_is_empty(ctx->iterator);
+       e = diriterator_advance(ctx->iterator))
+  {
+    const size_t len = diriterator_get_object_leaf_name(ctx->iterator,
+                                                        NULL, 0);
+    e = reserve_records(snapshot, 1);
+    if (e == NULL)
+      e = reserve_names(snapshot, len + 1);
+    if (e != NULL)
+      break;
+
+    DirSnapshotRecord *const record = &snapshot->records[snapshot->nrecords++];
+    record->object_type = diriterator_get_object_info(ctx->iterator,
+                                                      &record->info);
+    record->name_offset = (unsigned int)snapshot->names_len;
+    record->first_child = 0;
+    record->nchildren = 0;
+
+    (void)diriterator_get_object_leaf_name(ctx->iterator,
+                                           snapshot->names +
+                                           snapshot->names_len,
+                                           len + 1);
+    snapshot->names_len += len + 1;
+  }
+
+  if (e == NULL)
+  {
+    sort_names = snapshot->names;
+    qsort(snapshot->records + first, snapshot->nrecords - first,
+          sizeof(*snapshot->records), compare_records);
+    sort_names = NULL;
+  }
+
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *copy_dir(ScanContext *ctx,
+                                       const DirSnapshotRecord *old_dir)
+{
+  assert(ctx != NULL);
+  assert(ctx->old != NULL);
+  assert(old_dir != NULL);
+
+  DirSnapshot *const snapshot = ctx->snapshot;
+
+  DEBUGF("DirSnapshot: Reusing %u objects in unchanged directory '%s'\n",
+         old_dir->nchildren, stringbuffer_get_pointer(&ctx->path_name));
+
+  ON_ERR_RTN_E(reserve_records(snapshot, old_dir->nchildren));
+
+  for (unsigned int i = 0; i < old_dir->nchildren; ++i)
+  {
+    const DirSnapshotRecord *const old_record =
+      &ctx->old->records[old_dir->first_child + i];
+    const char *const name = get_name(ctx->old, old_record);
+    const size_t name_size = strlen(name) + 1;
+
+    ON_ERR_RTN_E(reserve_names(snapshot, name_size));
+
+    DirSnapshotRecord *const record = &snapshot->records[snapshot->nrecords++];
+    *record = *old_record;
+    record->name_offset = (unsigned int)snapshot->names_len;
+    record->first_child = 0;
+    record->nchildren = 0;
+
+    memcpy(snapshot->names + snapshot->names_len, name, name_size);
+    snapshot->names_len += name_size;
+  }
+
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *scan_dir(ScanContext *ctx,
+                                       DirSnapshotRecord *dir,
+                                       const DirSnapshotRecord *old_dir,
+                                       bool unchanged)
+{
+  CONST _kernel_oserror *e;
+  assert(ctx != NULL);
+  assert(dir != NULL);
+  assert(!unchanged || old_dir != NULL);
+
+  DirSnapshot *const snapshot = ctx->snapshot;
+  const unsigned int first = snapshot->nrecords;
+
+  /* Add a block of records for the objects in this directory */
+  if (unchanged)
+    e = copy_dir(ctx, old_dir);
+  else
+    e = read_dir(ctx);
+
+  /* The array of records may move whilst scanning sub-directories, so
+     only the block's position is recorded here. */
+  const unsigned int count = snapshot->nrecords - first;
+  dir->first_child = first;
+  dir->nchildren = count;
+
+  const size_t path_name_len = stringbuffer_get_length(&ctx->path_name);
+
+  for (unsigned int i = first; e == NULL && i < first + count; ++i)
+  {
+    if (!can_enter(snapshot->flags, snapshot->records[i].object_type))
+      continue;
+
+    if (!stringbuffer_append_separated(&ctx->path_name, PATH_SEPARATOR,
+            get_name(snapshot, &snapshot->records[i])))
+    {
+      e = no_mem();
+      break;
+    }
+
+    const DirSnapshotRecord *old_child = NULL;
+    if (unchanged)
+    {
+      /* The block was copied in the same order, but only the catalogue of
+         this directory was skipped, so the date stamp of the sub-directory
+         must be read to find out whether it changed. */
+      old_child = &ctx->old->records[old_dir->first_child + (i - first)];
+      e = read_info(stringbuffer_get_pointer(&ctx->path_name),
+                    &snapshot->records[i]);
+    }
+    else if (old_dir != NULL)
+    {
+      old_child = find_child(ctx->old, old_dir,
+                             get_name(snapshot, &snapshot->records[i]));
+    }
+
+    if (e == NULL &&
+        can_enter(snapshot->flags, snapshot->records[i].object_type))
+    {
+      const bool child_unchanged = ctx->skip_unchanged &&
+        old_child != NULL &&
+        old_child->object_type == snapshot->records[i].object_type &&
+        same_date(&old_child->info, &snapshot->records[i].info);
+
+      DirSnapshotRecord child = snapshot->records[i];
+      e = scan_dir(ctx, &child, old_child, child_unchanged);
+      snapshot->records[i].first_child = child.first_child;
+      snapshot->records[i].nchildren = child.nchildren;
+    }
+
+    stringbuffer_truncate(&ctx->path_name, path_name_len);
+  }
+
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *scan(DirSnapshot **snapshot,
+                                   DirSnapshot *new_snapshot,
+                                   const DirSnapshot *old,
+                                   bool skip_unchanged)
+{
+  assert(snapshot != NULL);
+  assert(new_snapshot != NULL);
+
+  ScanContext ctx = {
+    .snapshot = new_snapshot,
+    .old = old,
+    .skip_unchanged = skip_unchanged,
+    .iterator = NULL
+  };
+  stringbuffer_init(&ctx.path_name);
+
+  CONST _kernel_oserror *e = NULL;
+  if (!stringbuffer_append_all(&ctx.path_name, new_snapshot->path_name))
+    e = no_mem();
+
+  /* The date stamp of the root directory is needed to find out whether it
+     changed when the snapshot is rescanned */
+  if (e == NULL)
+    e = read_info(new_snapshot->path_name, &new_snapshot->root);
+
+  if (e == NULL)
+  {
+    const bool unchanged = skip_unchanged && old != NULL &&
+      old->root.object_type == new_snapshot->root.object_type &&
+      same_date(&old->root.info, &new_snapshot->root.info);
+
+    e = scan_dir(&ctx, &new_snapshot->root,
+                 old == NULL ? NULL : &old->root, unchanged);
+  }
+
+  diriterator_destroy(ctx.iterator);
+  stringbuffer_destroy(&ctx.path_name);
+
+  if (e == NULL)
+  {
+    DEBUGF("DirSnapshot: %u objects recorded, %zu directories read\n",
+           new_snapshot->nrecords, new_snapshot->dirs_read);
+    *snapshot = new_snapshot;
+  }
+  else
+  {
+    dirsnapshot_destroy(new_snapshot);
+  }
+
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool push_name(StringBuffer *sub_path_name, const char *name)
+{
+  assert(sub_path_name != NULL);
+  assert(name != NULL);
+
+  if (stringbuffer_get_length(sub_path_name) == 0)
+    return stringbuffer_append_all(sub_path_name, name);
+
+  return stringbuffer_append_separated(sub_path_name, PATH_SEPARATOR, name);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *report_tree(DiffContext *ctx,
+                                          DirSnapshotChange change,
+                                          const DirSnapshotRecord *record)
+{
+  assert(ctx != NULL);
+  assert(record != NULL);
+  assert(change != DirSnapshotChange_Modified);
+
+  const DirSnapshot *const snapshot = change == DirSnapshotChange_Added ?
+                                      ctx->new : ctx->old;
+  const size_t sub_path_name_len = stringbuffer_get_length(&ctx->sub_path_name);
+
+  if (!push_name(&ctx->sub_path_name, get_name(snapshot, record)))
+    return no_mem();
+
+  ctx->stop = !ctx->callback(change,
+                  stringbuffer_get_pointer(&ctx->sub_path_name),
+                  record->object_type,
+                  change == DirSnapshotChange_Removed ? &record->info : NULL,
+                  change == DirSnapshotChange_Added ? &record->info : NULL,
+                  ctx->arg);
+
+  /* Report the objects in an added or removed directory */
+  CONST _kernel_oserror *e = NULL;
+  for (unsigned int i = 0; e == NULL && !ctx->stop && i < record->nchildren;
+       ++i)
+  {
+    e = report_tree(ctx, change,
+                    &snapshot->records[record->first_child + i]);
+  }
+
+  stringbuffer_truncate(&ctx->sub_path_name, sub_path_name_len);
+  return e;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *diff_dir(DiffContext *ctx,
+                                       const DirSnapshotRecord *old_dir,
+                                       const DirSnapshotRecord *new_dir)
+{
+  assert(ctx != NULL);
+  assert(old_dir != NULL);
+  assert(new_dir != NULL);
+
+  CONST _kernel_oserror *e = NULL;
+  unsigned int i = 0, j = 0;
+
+  /* Merge the two sorted blocks of records for the directory */
+  while (e == NULL && !ctx->stop &&
+         (i < old_dir->nchildren || j < new_dir->nchildren))
+  {
+    const DirSnapshotRecord *const old_record = i < old_dir->nchildren ?
+      &ctx->old->records[old_dir->first_child + i] : NULL;
+    const DirSnapshotRecord *const new_record = j < new_dir->nchildren ?
+      &ctx->new->records[new_dir->first_child + j] : NULL;
+
+    int cmp;
+    if (old_record == NULL)
+      cmp = 1;
+    else if (new_record == NULL)
+      cmp = -1;
+    else
+      cmp = stricmp(get_name(ctx->old, old_record),
+                    get_name(ctx->new, new_record));
+
+    if (cmp < 0)
+    {
+      e = report_tree(ctx, DirSnapshotChange_Removed, old_record);
+      ++i;
+    }
+    else if (cmp > 0)
+    {
+      e = report_tree(ctx, DirSnapshotChange_Added, new_record);
+      ++j;
+    }
+    else
+    {
+      const size_t sub_path_name_len =
+        stringbuffer_get_length(&ctx->sub_path_name);
+
+      if (!push_name(&ctx->sub_path_name, get_name(ctx->new, new_record)))
+      {
+        e = no_mem();
+      }
+      else
+      {
+        if (!same_info(old_record, new_record))
+        {
+          ctx->stop = !ctx->callback(DirSnapshotChange_Modified,
+                          stringbuffer_get_pointer(&ctx->sub_path_name),
+                          new_record->object_type, &old_record->info,
+                          &new_record->info, ctx->arg);
+        }
+
+        if (!ctx->stop)
+          e = diff_dir(ctx, old_record, new_record);
+
+        stringbuffer_truncate(&ctx->sub_path_name, sub_path_name_len);
+      }
+      ++i;
+      ++j;
+    }
+  }
+
+  return e;
+}
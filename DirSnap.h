@@ -0,0 +1,188 @@
+/*
+ * CBLibrary: Directory tree snapshots and change detection
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* DirSnap.h declares functions and types to record the sub-path name and
+   catalogue information of every object in a directory tree as a compact
+   snapshot, which can be saved and loaded, and to find out which objects
+   were added, removed or modified between two snapshots of the same tree.
+
+  Example usage (reports changes since an earlier snapshot):
+
+  DirSnapshot *now;
+  const _kernel_oserror *e = dirsnapshot_rescan(&now, before, 0);
+  if (e == NULL)
+  {
+    e = dirsnapshot_diff(before, now, report_change, NULL);
+    dirsnapshot_destroy(now);
+  }
+
+Dependencies: ANSI C library, Acorn library kernel, StreamLib.
+Message tokens: NoMem, ReadFail, WriteFail.
+History:
+  CJB: 16-Oct-26: Created this header file.
+  CJB: 16-Oct-26: Added prototype of function dirsnapshot_initialise.
+                  dirsnapshot_write and dirsnapshot_read now take the name
+                  of the file to report in error messages.
+*/
+
+#ifndef DirSnap_h
+#define DirSnap_h
+
+/* ISO library headers */
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "toolbox.h"
+
+/* StreamLib headers */
+#include "Reader.h"
+#include "Writer.h"
+
+/* Local headers */
+#include "Macros.h"
+#include "DirIter.h"
+
+CONST _kernel_oserror *dirsnapshot_initialise(MessagesFD * /*mfd*/);
+   /*
+    * Initialises the DirSnapshot module. Unless 'mfd' is a null pointer, the
+    * specified messages file will be given priority over the global messages
+    * file when looking up text required by this module.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+typedef struct DirSnapshot DirSnapshot;
+   /*
+    * Incomplete struct type representing a snapshot of a directory tree.
+    */
+
+typedef enum
+{
+  DirSnapshotChange_Added,
+  DirSnapshotChange_Removed,
+  DirSnapshotChange_Modified
+}
+DirSnapshotChange;
+
+/* Flags for use with the dirsnapshot_rescan function */
+#define DirSnapshot_SkipUnchangedDirectories (1u << 0)
+
+CONST _kernel_oserror *dirsnapshot_make(DirSnapshot ** /*snapshot*/,
+                                        unsigned int   /*flags*/,
+                                        const char   * /*path_name*/,
+                                        const char   * /*pattern*/);
+   /*
+    * Creates a snapshot of the directory tree 'path_name'. The objects
+    * recorded are those that an iterator created by diriterator_make with
+    * the same arguments would visit.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+CONST _kernel_oserror *dirsnapshot_rescan(DirSnapshot       ** /*snapshot*/,
+                                          const DirSnapshot  * /*old*/,
+                                          unsigned int         /*flags*/);
+   /*
+    * Creates a new snapshot of the same directory tree as an 'old' snapshot,
+    * with the same flags and pattern. If 'flags' includes
+    * DirSnapshot_SkipUnchangedDirectories then the catalogue of any
+    * directory whose date stamp is unchanged is not read; instead, the
+    * objects in it are copied from the old snapshot and only the date
+    * stamps of its sub-directories are read. That is much faster for large
+    * trees with few changes, but is only safe on filing systems that update
+    * the date stamp of a directory whenever an object in it is created,
+    * deleted, renamed or modified.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+size_t dirsnapshot_get_count(const DirSnapshot * /*snapshot*/);
+   /*
+    * Gets the number of objects recorded in a snapshot.
+    * Returns: the number of objects.
+    */
+
+size_t dirsnapshot_get_dirs_read(const DirSnapshot * /*snapshot*/);
+   /*
+    * Gets the number of directories whose catalogue was read to create a
+    * snapshot (including the root). This is zero for a snapshot that was
+    * loaded by dirsnapshot_read.
+    * Returns: the number of directories read.
+    */
+
+typedef bool DirSnapshotDiffFunction(DirSnapshotChange            /*change*/,
+                                     const char                  */*sub_path_name*/,
+                                     int                          /*object_type*/,
+                                     const DirIteratorObjectInfo */*old_info*/,
+                                     const DirIteratorObjectInfo */*new_info*/,
+                                     void                        */*arg*/);
+   /*
+    * Type of function called by dirsnapshot_diff for each object that was
+    * added, removed or modified. 'sub_path_name' is the object's path name
+    * relative to the root of the tree (as output by
+    * diriterator_get_object_sub_path_name) and 'object_type' is its current
+    * type, or its old type if it was removed. 'old_info' is a null pointer
+    * if the object was added and 'new_info' is a null pointer if it was
+    * removed. 'arg' is the value passed to dirsnapshot_diff.
+    * Returns: true to continue comparing, or false to stop.
+    */
+
+CONST _kernel_oserror *dirsnapshot_diff(
+                                     const DirSnapshot       * /*old*/,
+                                     const DirSnapshot       * /*new*/,
+                                     DirSnapshotDiffFunction * /*callback*/,
+                                     void                    * /*arg*/);
+   /*
+    * Compares two snapshots of the same directory tree and calls the given
+    * function for each object that was added, removed or modified (i.e.
+    * has a different type, date stamp, length, attributes or file type).
+    * If a directory was added or removed then the function is also called
+    * for each object in it. Object names are compared without regard to
+    * case.
+    * Returns: a pointer to an OS error block, or else NULL for success
+    *          (including if the comparison was stopped by the function).
+    */
+
+CONST _kernel_oserror *dirsnapshot_write(const DirSnapshot * /*snapshot*/,
+                                         Writer            * /*writer*/,
+                                         const char        * /*file_name*/);
+   /*
+    * Writes a snapshot to the given stream in a format that can be read by
+    * dirsnapshot_read on the same platform. 'file_name' is the full path or
+    * leaf name of the output file, which is used only in error messages.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+CONST _kernel_oserror *dirsnapshot_read(DirSnapshot ** /*snapshot*/,
+                                        Reader       * /*reader*/,
+                                        const char   * /*file_name*/);
+   /*
+    * Creates a snapshot from data previously written to a stream by
+    * dirsnapshot_write. Invalid or truncated data is reported as a read
+    * error. 'file_name' is the full path or leaf name of the input file,
+    * which is used only in error messages.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+void dirsnapshot_destroy(DirSnapshot * /*snapshot*/);
+   /*
+    * Frees memory that was previously allocated for a snapshot.
+    * Does nothing if called with a null pointer.
+    */
+
+#endif
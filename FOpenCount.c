@@ -26,22 +26,108 @@
   CJB: 18-Apr-16: Cast pointer parameters to void * to match %p.
   CJB: 01-Nov-18: Replaced DEBUG macro usage with DEBUGF.
   CJB: 28-Apr-19: Less verbose debugging output.
+  CJB: 16-Oct-26: Added a cache of streams parked by suspended file
+                  operations. fopen_inc closes the least recently parked
+                  stream if there are too many open streams.
+  CJB: 16-Oct-26: fopen_inc only closes parked streams and retries if
+                  opening a file failed for want of a file handle.
  */
 
 /* ISO library headers */
 #include <stdio.h>
+#include <stdbool.h>
 #include <errno.h>
 
+/* CBUtilLib headers */
+#include "LinkedList.h"
+
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "FOpenCount.h"
 
+/* States of a lease */
+enum
+{
+  LeaseState_Idle,    /* No stream parked */
+  LeaseState_Parked,  /* Stream parked and still open */
+  LeaseState_Evicted  /* Stream parked but since closed */
+};
+
 static unsigned int fopen_count = 0;
+static LinkedList parked_list; /* Least recently parked first */
+static bool parked_list_init = false;
+static FOpenLeaseStats lease_stats;
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static LinkedList *get_parked_list(void)
+{
+  if (!parked_list_init)
+  {
+    linkedlist_init(&parked_list);
+    parked_list_init = true;
+  }
+  return &parked_list;
+}
+
+static void unpark(FOpenLease *const lease)
+{
+  assert(lease != NULL);
+  assert(lease->state == LeaseState_Parked);
+  assert(lease_stats.parked > 0);
+
+  linkedlist_remove(get_parked_list(), &lease->list_item);
+  --lease_stats.parked;
+}
+
+static bool out_of_handles(void)
+{
+  if (fopen_count >= FOPEN_MAX)
+    return true;
+
+#if defined(EMFILE) && defined(ENFILE)
+  /* Hosted libraries report the limits of the process and system */
+  return errno == EMFILE || errno == ENFILE;
+#else
+  return false;
+#endif
+}
+
+static bool evict_lru(void)
+{
+  /* Close the stream that has been parked for longest */
+  LinkedListItem *const item = linkedlist_get_head(get_parked_list());
+  if (item == NULL)
+    return false;
+
+  FOpenLease *const lease = CONTAINER_OF(item, FOpenLease, list_item);
+  DEBUGF("FOpenCount: Evicting parked stream %p\n", (void *)lease->stream);
+
+  unpark(lease);
+  (void)fclose_dec(lease->stream);
+  lease->stream = NULL;
+  lease->state = LeaseState_Evicted;
+  ++lease_stats.evictions;
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
 
 FILE *fopen_inc(const char *filename, const char *mode)
 {
-  /* Open a file, incrementing the counter if successful */
-  FILE *const f = fopen(filename, mode);
+  /* Make room by closing parked streams if there are too many open */
+  while (fopen_count >= FOPEN_MAX && evict_lru())
+  {
+  }
+
+  /* Open a file, incrementing the counter if successful. Closing a parked
+     stream can only help if the failure was for want of a file handle. */
+  FILE *f = fopen(filename, mode);
+  while (f == NULL && out_of_handles() && evict_lru()) {
+    f = fopen(filename, mode);
+  }
   if (f != NULL) {
     fopen_count++;
   }
@@ -80,3 +166,84 @@ unsigned int fopen_num(void)
   DEBUGF("FOpenCount: Currently %u files open\n", fopen_count);
   return fopen_count;
 }
+
+/* ----------------------------------------------------------------------- */
+
+void fopen_lease_init(FOpenLease *lease)
+{
+  assert(lease != NULL);
+  lease->stream = NULL;
+  lease->state = LeaseState_Idle;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void fopen_lease_park(FOpenLease *lease, FILE *stream)
+{
+  assert(lease != NULL);
+  assert(lease->state != LeaseState_Parked);
+  assert(stream != NULL);
+  DEBUGF("FOpenCount: Parking stream %p\n", (void *)stream);
+
+  lease->stream = stream;
+  lease->state = LeaseState_Parked;
+  LinkedList *const list = get_parked_list();
+  linkedlist_insert(list, linkedlist_get_tail(list), &lease->list_item);
+  ++lease_stats.parked;
+}
+
+/* ----------------------------------------------------------------------- */
+
+FILE *fopen_lease_resume(FOpenLease *lease)
+{
+  FILE *stream = NULL;
+
+  assert(lease != NULL);
+
+  switch (lease->state)
+  {
+  case LeaseState_Parked:
+    DEBUGF("FOpenCount: Resuming parked stream %p\n", (void *)lease->stream);
+    unpark(lease);
+    stream = lease->stream;
+    ++lease_stats.hits;
+    break;
+
+  case LeaseState_Evicted:
+    DEBUGF("FOpenCount: Parked stream was evicted\n");
+    ++lease_stats.misses;
+    break;
+
+  default:
+    break;
+  }
+
+  lease->stream = NULL;
+  lease->state = LeaseState_Idle;
+  return stream;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void fopen_lease_cancel(FOpenLease *lease)
+{
+  assert(lease != NULL);
+
+  if (lease->state == LeaseState_Parked)
+  {
+    DEBUGF("FOpenCount: Closing parked stream %p\n", (void *)lease->stream);
+    unpark(lease);
+    (void)fclose_dec(lease->stream);
+  }
+
+  lease->stream = NULL;
+  lease->state = LeaseState_Idle;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void fopen_lease_get_stats(FOpenLeaseStats *stats)
+{
+  assert(stats != NULL);
+  *stats = lease_stats;
+}
@@ -19,14 +19,18 @@
 
 /* FopenCount.h declares three functions that provide a veneer to the <stdio.h>
    fopen and fclose functions in order to keep an accessible count of the
-   number of open streams.
+   number of open streams. It also declares functions to manage a shared
+   cache of streams belonging to suspended file operations, which are only
+   closed when streams run short.
 
-Dependencies: ANSI C library.
+Dependencies: ANSI C library, CBUtilLib.
 Message tokens: None.
 History:
   CJB: 05-Nov-04: Added clib-style documentation and dependency information.
   CJB: 05-Mar-05: Updated documentation on fclose_dec.
   CJB: 11-Dec-20: Deleted redundant uses of the 'extern' keyword.
+  CJB: 16-Oct-26: Added the FOpenLease and FOpenLeaseStats types and
+                  functions to park streams in a cache while not in use.
 */
 
 #ifndef FopenCount_h
@@ -35,11 +39,17 @@ History:
 /* ISO library headers */
 #include <stdio.h>
 
+/* CBUtilLib headers */
+#include "LinkedList.h"
+
 FILE *fopen_inc(const char * /*filename*/, const char * /*mode*/);
    /*
     * Opens the file whose name is the string pointed to by 'filename', and
     * associates a stream with it. This function is a direct replacement for
     * fopen.
+    * If the number of open streams has reached FOPEN_MAX, or the open
+    * operation fails, then the least recently parked stream (if any) is
+    * closed to make room first.
     * Returns: a pointer to the object controlling the stream. If the open
     *          operation fails, fopen returns a null pointer.
     */
@@ -61,4 +71,65 @@ unsigned int fopen_num(void);
     *          fclose_dec.
     */
 
+typedef struct
+{
+  LinkedListItem  list_item; /* Private: link in the list of parked streams */
+  FILE           *stream;    /* Private */
+  int             state;     /* Private */
+}
+FOpenLease;
+   /*
+    * Records whether a suspended file operation's stream is parked in the
+    * cache. Its members should not be accessed directly.
+    */
+
+void fopen_lease_init(FOpenLease * /*lease*/);
+   /*
+    * Initialises a lease with no stream parked. Must be called before any
+    * other function is called with the same lease.
+    */
+
+void fopen_lease_park(FOpenLease * /*lease*/, FILE * /*stream*/);
+   /*
+    * Parks a stream opened by fopen_inc in the cache whilst the file operation
+    * that owns it is suspended, instead of closing it. The stream may be
+    * closed by the cache at any time after this call, if a stream is
+    * needed for something else. Errors on closing are not reported, so
+    * output streams should be flushed before they are parked.
+    */
+
+FILE *fopen_lease_resume(FOpenLease * /*lease*/);
+   /*
+    * Takes back a stream that was parked in the cache by fopen_lease_park.
+    * If the cache had to close the stream then the caller must reopen the
+    * file and seek to the position where it left off. Hits are counted if
+    * the stream is still open and misses if it was closed.
+    * Returns: a pointer to the object controlling the stream, or a null
+    *          pointer if no stream is parked.
+    */
+
+void fopen_lease_cancel(FOpenLease * /*lease*/);
+   /*
+    * Closes any stream parked in the cache for a file operation that has
+    * been abandoned. Does nothing if no stream is parked.
+    */
+
+typedef struct
+{
+  unsigned long int hits;      /* Parked streams that were still open */
+  unsigned long int misses;    /* Parked streams that had been closed */
+  unsigned long int evictions; /* Parked streams closed to make room */
+  unsigned int      parked;    /* Streams currently parked */
+}
+FOpenLeaseStats;
+   /*
+    * Statistics about the use of the cache of parked streams.
+    */
+
+void fopen_lease_get_stats(FOpenLeaseStats * /*stats*/);
+   /*
+    * Gets statistics about the use of the cache of parked streams since the
+    * program started.
+    */
+
 #endif
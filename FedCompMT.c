@@ -60,14 +60,46 @@
   CJB: 06-Nov-19: Fixed failure to check the return value of fclose_dec().
   CJB: 29-Sep-20: Fixed missing/misplaced casts in assertions.
                   Made debugging output less verbose by default.
+  CJB: 16-Oct-26: Data is now copied via a buffer in the operation's state
+                  instead of a 256-byte stack buffer, in chunks whose size
+                  adapts to the time taken. Added compress_set_history to
+                  allow a wider history than the Fednet format's 512 bytes.
+  CJB: 16-Oct-26: Added a block container format, selected by calling the
+                  new compress_set_block_size function, in which data is
+                  compressed as independent blocks listed in an index.
+                  load_compressedM recognises it and the new function
+                  load_compressed_block decompresses any one block.
+  CJB: 16-Oct-26: Cached catalogue information about the file written by
+                  save_compressedM2 is discarded after each call.
+  CJB: 16-Oct-26: Data compressed with a wide history is always written as
+                  a block container, so that the history size is recorded.
+                  load_compressedM decodes a single Fednet stream with the
+                  Fednet history regardless of compress_set_history, and
+                  checks that it decompresses to the expected size.
+  CJB: 16-Oct-26: Added compress_set_threads. If built with
+                  FEDCOMP_USE_THREADS defined, the blocks of a block
+                  container are (de)compressed in parallel by a pool of
+                  POSIX threads. load_compressed_block now returns when
+                  'time_up' becomes true, like load_compressedM. Aborted
+                  operations only destroy the reader and writer if open.
 */
 
+#ifdef FEDCOMP_USE_THREADS
+/* Needed for pthreads and open_memstream in strict ISO C mode */
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 /* ISO library headers */
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <limits.h>
 
+#ifdef FEDCOMP_USE_THREADS
+/* POSIX headers */
+#include <pthread.h>
+#endif
+
 /* Acorn C/C++ library headers */
 #include "kernel.h"
 #include "flex.h"
@@ -84,12 +116,14 @@
 
 /* CBOSLib headers */
 #include "MessTrans.h"
+#include "OSReadTime.h"
 
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "FopenCount.h"
 #include "FedCompMT.h"
 #include "FileUtils.h"
+#include "CatCache.h"
 #ifdef CBLIB_OBSOLETE
 #include "MsgTrans.h"
 #endif /* CBLIB_OBSOLETE */
@@ -100,12 +134,40 @@ enum
 {
   FednetHistoryLog2 = 9, /* Base 2 logarithm of the history size used by
                          the compression algorithm */
-  BufferSize        = 256, /* I/O buffer size for compressed bitstream */
+  WideHistoryLog2   = 12, /* Base 2 logarithm of the history size used in
+                             wide mode */
+  MinChunkSize      = 256, /* Minimum number of bytes to (de)compress before
+                              checking for time up */
+  MaxChunkSize      = 32 * 1024, /* Maximum number of bytes to (de)compress
+                                    before checking for time up, and size of
+                                    the I/O buffer */
+  TargetChunkTime   = 1, /* Centiseconds to aim to spend on each chunk */
+  WordSize          = 4, /* Size of each word in a block container header */
+  IndexOffset       = 5 * WordSize, /* Offset of the table of block offsets
+                                       in a block container */
+  MaxThreads        = 16 /* Maximum number of threads used to (de)compress
+                            the blocks of a block container */
 };
 
+/* First word of a block container. It can't be mistaken for the first word
+   of a Fednet file because that is the decompressed size, which must be
+   positive. */
+#define BLOCK_MAGIC 0xFEDB10C5UL
+
 typedef struct
 {
   fileop_common   common;
+  bool            reader_open; /* False between blocks */
+  unsigned int    history_log2;
+  unsigned int    block_size; /* 0 if not a block container */
+  unsigned int    block; /* Index of the block being decompressed */
+  unsigned int    end_block; /* Index of the block after the last to
+                                decompress */
+  unsigned long   base; /* Decompressed offset of the first block */
+  unsigned long   total_len; /* Decompressed size of the whole file */
+  bool            parallel; /* Blocks are decompressed by the thread pool */
+  size_t          chunk_size;
+  char            buffer[MaxChunkSize];
 }
 decomp_state;
 
@@ -114,10 +176,63 @@ typedef struct
   fileop_common  common;
   unsigned int   start_offset;
   unsigned int   end_offset;
+  bool           writer_open; /* False between blocks */
+  unsigned int   history_log2;
+  unsigned int   block_size; /* 0 to write a single Fednet stream */
+  unsigned int   block; /* Index of the block being compressed */
+  unsigned int   nblocks;
+  bool           parallel; /* Blocks are compressed by the thread pool */
+  size_t         chunk_size;
+  char           buffer[MaxChunkSize];
 }
 comp_state;
 
 static MessagesFD *desc;
+static FedCompHistory history = FedCompHistory_Fednet;
+static unsigned int block_size;
+static unsigned int nthreads = 1;
+
+#ifdef FEDCOMP_USE_THREADS
+typedef struct BlockTask BlockTask;
+
+typedef const char *BlockTaskFunction(BlockTask *task);
+
+struct BlockTask
+{
+  BlockTaskFunction *function;
+  unsigned int       history_log2;
+  FILE              *f; /* Stream positioned at the compressed data, or NULL */
+  char              *in; /* Data to compress, or NULL */
+  char              *out; /* Compressed or decompressed data */
+  size_t             len; /* Decompressed size of the block */
+  size_t             out_size; /* Size of the compressed data */
+  const char        *e_token; /* Result of calling 'function' */
+};
+
+/* Worker threads which run a batch of tasks alongside the calling thread.
+   Tasks only use their own buffers and streams, so flex blocks (which can
+   move) and the file being loaded or saved are only accessed by the calling
+   thread. */
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t  work_ready;
+  pthread_cond_t  work_done;
+  pthread_t       threads[MaxThreads - 1];
+  unsigned int    nstarted; /* Number of worker threads created */
+  BlockTask      *tasks;
+  unsigned int    ntasks;
+  unsigned int    next_task; /* Index of the first task not yet claimed */
+  unsigned int    nfinished;
+  bool            quit;
+}
+pool =
+{
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .work_ready = PTHREAD_COND_INITIALIZER,
+  .work_done = PTHREAD_COND_INITIALIZER
+};
+#endif /* FEDCOMP_USE_THREADS */
 
 /* ----------------------------------------------------------------------- */
 /*                         Private functions                               */
@@ -154,6 +269,55 @@ static int get_perc(long int const progress, long int const total)
 
 /* ----------------------------------------------------------------------- */
 
+static unsigned int get_history_log2(void)
+{
+  return history == FedCompHistory_Wide ? WideHistoryLog2 : FednetHistoryLog2;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static unsigned int get_nblocks(unsigned long const len,
+  unsigned int const size)
+{
+  /* Even empty data has one (empty) block */
+  assert(size > 0);
+  return len == 0 ? 1 : (unsigned int)((len - 1) / size) + 1;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static unsigned long get_block_end(unsigned long const len,
+  unsigned int const size, unsigned int const block)
+{
+  /* Get the decompressed offset of the end of a block */
+  if (size == 0)
+    return len;
+
+  return LOWEST(((unsigned long)block + 1) * size, len);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void adapt_chunk_size(size_t *const chunk_size, int const elapsed)
+{
+  /* Double the chunk size while chunks are quicker than the target, so
+     that fewer calls are made through the reader and writer, and halve it
+     if they are slower, so that the caller's deadline isn't badly overrun. */
+  assert(chunk_size != NULL);
+  if (elapsed < TargetChunkTime && *chunk_size < MaxChunkSize)
+  {
+    *chunk_size *= 2;
+    DEBUG_VERBOSEF("Increased chunk size to %zu\n", *chunk_size);
+  }
+  else if (elapsed > TargetChunkTime && *chunk_size > MinChunkSize)
+  {
+    *chunk_size /= 2;
+    DEBUG_VERBOSEF("Decreased chunk size to %zu\n", *chunk_size);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
 typedef enum
 {
   DESTROY_OK,
@@ -161,12 +325,16 @@ typedef enum
   DESTROY_FCLOSE_FAIL
 } DestroyResult;
 
-static DestroyResult destroy_common(fileop_common *const common)
+static DestroyResult destroy_common(fileop_common *const common,
+  bool const reader_open, bool const writer_open)
 {
   DestroyResult result = DESTROY_OK;
   assert(common != NULL);
-  reader_destroy(&common->reader);
-  if (writer_destroy(&common->writer) < 0)
+  if (reader_open)
+  {
+    reader_destroy(&common->reader);
+  }
+  if (writer_open && writer_destroy(&common->writer) < 0)
   {
     result = DESTROY_WRITE_FAIL;
   }
@@ -183,7 +351,8 @@ static DestroyResult destroy_common(fileop_common *const common)
 static const char *destroy_decomp(decomp_state *const decomp)
 {
   assert(decomp != NULL);
-  return destroy_common(&decomp->common) == DESTROY_WRITE_FAIL ? "NoMem" : NULL;
+  return destroy_common(&decomp->common, decomp->reader_open, true) ==
+         DESTROY_WRITE_FAIL ? "NoMem" : NULL;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -191,20 +360,311 @@ static const char *destroy_decomp(decomp_state *const decomp)
 static const char *destroy_comp(comp_state *const comp)
 {
   assert(comp != NULL);
-  return destroy_common(&comp->common) != DESTROY_OK ? "WriteFail" : NULL;
+  return destroy_common(&comp->common, true, comp->writer_open) !=
+         DESTROY_OK ? "WriteFail" : NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void destroy_decomp_cb(void *const fop)
+{
+  (void)destroy_decomp(fop);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void destroy_comp_cb(void *const fop)
+{
+  (void)destroy_comp(fop);
+}
+
+/* ----------------------------------------------------------------------- */
+
+#ifdef FEDCOMP_USE_THREADS
+static void run_task(void)
+{
+  /* The pool's lock must be held on entry, and is held again on exit */
+  assert(pool.next_task < pool.ntasks);
+  BlockTask *const task = &pool.tasks[pool.next_task++];
+
+  pthread_mutex_unlock(&pool.lock);
+  task->e_token = task->function(task);
+  pthread_mutex_lock(&pool.lock);
+
+  if (++pool.nfinished == pool.ntasks)
+  {
+    pthread_cond_signal(&pool.work_done);
+  }
 }
 
 /* ----------------------------------------------------------------------- */
 
-static void destroy_cb(void *const fop)
+static void *worker(void *const arg)
 {
-  (void)destroy_common(fop);
+  NOT_USED(arg);
+  pthread_mutex_lock(&pool.lock);
+  while (!pool.quit)
+  {
+    if (pool.next_task < pool.ntasks)
+    {
+      run_task();
+    }
+    else
+    {
+      pthread_cond_wait(&pool.work_ready, &pool.lock);
+    }
+  }
+  pthread_mutex_unlock(&pool.lock);
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void run_batch(BlockTask *const tasks, unsigned int const ntasks)
+{
+  assert(tasks != NULL);
+  assert(ntasks > 0);
+
+  /* Start the worker threads when first needed. If one can't be created
+     then the calling thread runs more of the tasks itself. */
+  while (pool.nstarted + 1 < nthreads &&
+         pthread_create(&pool.threads[pool.nstarted], NULL, worker, NULL) == 0)
+  {
+    ++pool.nstarted;
+  }
+
+  pthread_mutex_lock(&pool.lock);
+  pool.tasks = tasks;
+  pool.ntasks = ntasks;
+  pool.next_task = 0;
+  pool.nfinished = 0;
+  pthread_cond_broadcast(&pool.work_ready);
+
+  while (pool.next_task < pool.ntasks)
+  {
+    run_task();
+  }
+
+  while (pool.nfinished < pool.ntasks)
+  {
+    pthread_cond_wait(&pool.work_done, &pool.lock);
+  }
+
+  pool.tasks = NULL;
+  pool.ntasks = 0;
+  pool.next_task = 0;
+  pthread_mutex_unlock(&pool.lock);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void stop_pool(void)
+{
+  pthread_mutex_lock(&pool.lock);
+  pool.quit = true;
+  pthread_cond_broadcast(&pool.work_ready);
+  pthread_mutex_unlock(&pool.lock);
+
+  for (unsigned int i = 0; i < pool.nstarted; ++i)
+  {
+    (void)pthread_join(pool.threads[i], NULL);
+  }
+  pool.nstarted = 0;
+  pool.quit = false;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const char *compress_task(BlockTask *const task)
+{
+  assert(task != NULL);
+  assert(task->in != NULL);
+
+  /* The compressed data is written to memory, to be copied into the file
+     by the calling thread in block order */
+  FILE *const f = open_memstream(&task->out, &task->out_size);
+  if (f == NULL)
+  {
+    DEBUGF("open_memstream failed\n");
+    return "NoMem";
+  }
+
+  const char *e_token = NULL;
+  Writer writer;
+  if (!writer_gkey_init(&writer, task->history_log2, (long)task->len, f))
+  {
+    DEBUGF("writer_gkey_init failed\n");
+    e_token = "NoMem";
+  }
+  else
+  {
+    if (writer_fwrite(task->in, 1, task->len, &writer) != task->len)
+    {
+      e_token = "WriteFail";
+    }
+    if (writer_destroy(&writer) < 0 && e_token == NULL)
+    {
+      e_token = "WriteFail";
+    }
+  }
+
+  if (fclose(f) && e_token == NULL)
+  {
+    e_token = "NoMem";
+  }
+  return e_token;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const char *decompress_task(BlockTask *const task)
+{
+  assert(task != NULL);
+  assert(task->f != NULL);
+  assert(task->out != NULL);
+
+  Reader reader;
+  if (!reader_gkey_init(&reader, task->history_log2, task->f))
+  {
+    DEBUGF("reader_gkey_init failed\n");
+    return "NoMem";
+  }
+
+  /* The block must decompress to exactly the expected size */
+  char extra;
+  size_t const nread = reader_fread(task->out, 1, task->len, &reader);
+  const char *const e_token = nread != task->len ||
+    reader_fread(&extra, 1, 1, &reader) != 0 || reader_ferror(&reader) ?
+    "ReadFail" : NULL;
+
+  reader_destroy(&reader);
+  return e_token;
+}
+#endif /* FEDCOMP_USE_THREADS */
+
+/* ----------------------------------------------------------------------- */
+
+static const char *start_decomp_block(decomp_state *const state)
+{
+  assert(state != NULL);
+  assert(!state->reader_open);
+
+  long int offset = 0;
+  if (state->block_size > 0)
+  {
+    /* Find the block in the container's index */
+    if (fseek(state->common.f, IndexOffset + (long)state->block * WordSize,
+              SEEK_SET) ||
+        !fread_int32le(&offset, state->common.f))
+    {
+      DEBUGF("fseek or fread_int32le failed\n");
+      return "ReadFail";
+    }
+  }
+
+  DEBUGF("Starting block %u at offset %ld\n", state->block, offset);
+  if (fseek(state->common.f, offset, SEEK_SET))
+  {
+    DEBUGF("fseek failed\n");
+    return "ReadFail";
+  }
+
+  if (!reader_gkey_init(&state->common.reader, state->history_log2,
+    state->common.f))
+  {
+    DEBUGF("reader_gkey_init failed\n");
+    return "NoMem";
+  }
+
+  state->reader_open = true;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const char *read_header(decomp_state *const state,
+  bool const whole_file, unsigned int const block, long int *const len)
+{
+  assert(state != NULL);
+  assert(len != NULL);
+
+  long int word;
+  if (!fread_int32le(&word, state->common.f))
+  {
+    DEBUGF("fread_int32le failed\n");
+    return "ReadFail";
+  }
+
+  if (((unsigned long)word & 0xffffffffUL) != BLOCK_MAGIC)
+  {
+    /* A single Fednet stream, which starts with the decompressed size.
+       Only block containers record the history size, so the Fednet history
+       is assumed whatever the current setting. */
+    if (!whole_file)
+    {
+      DEBUGF("Not a block container\n");
+      return "ReadFail";
+    }
+    state->history_log2 = FednetHistoryLog2;
+    state->block_size = 0;
+    state->block = 0;
+    state->end_block = 1;
+    state->base = 0;
+    state->total_len = word < 0 ? 0 : (unsigned long)word;
+    *len = word;
+    return NULL;
+  }
+
+  long int history_log2, total_len, size, nblocks;
+  if (!fread_int32le(&history_log2, state->common.f) ||
+      !fread_int32le(&total_len, state->common.f) ||
+      !fread_int32le(&size, state->common.f) ||
+      !fread_int32le(&nblocks, state->common.f))
+  {
+    DEBUGF("fread_int32le failed\n");
+    return "ReadFail";
+  }
+
+  DEBUGF("Block container with history %ld, size %ld, block size %ld, "
+         "%ld blocks\n", history_log2, total_len, size, nblocks);
+
+  if ((history_log2 != FednetHistoryLog2 &&
+       history_log2 != WideHistoryLog2) ||
+      total_len < 0 || total_len > INT_MAX || size <= 0 || size > INT_MAX ||
+      nblocks != (long)get_nblocks((unsigned long)total_len,
+                                   (unsigned int)size) ||
+      (!whole_file && block >= (unsigned long)nblocks))
+  {
+    DEBUGF("Bad block container header or block number\n");
+    return "ReadFail";
+  }
+
+  state->history_log2 = (unsigned int)history_log2;
+  state->block_size = (unsigned int)size;
+  state->total_len = (unsigned long)total_len;
+  if (whole_file)
+  {
+    state->block = 0;
+    state->end_block = (unsigned int)nblocks;
+    state->base = 0;
+    *len = total_len;
+  }
+  else
+  {
+    state->block = block;
+    state->end_block = block + 1;
+    state->base = (unsigned long)block * state->block_size;
+    *len = (long)(get_block_end(state->total_len, state->block_size, block) -
+                  state->base);
+  }
+  return NULL;
 }
 
 /* ----------------------------------------------------------------------- */
 
 static decomp_state *make_decomp(const char *const file_path,
-  flex_ptr buffer_anchor, const char **const e_token)
+  flex_ptr buffer_anchor, bool const whole_file, unsigned int const block,
+  const char **const e_token)
 {
   const char *token = NULL;
   decomp_state *state = malloc(sizeof(*state));
@@ -214,7 +674,9 @@ static decomp_state *make_decomp(const char *const file_path,
   }
   else
   {
-    state->common.destructor = destroy_cb;
+    state->common.destructor = destroy_decomp_cb;
+    state->chunk_size = MinChunkSize;
+    state->reader_open = false;
     state->common.f = fopen_inc(file_path, "rb"); /* open for reading */
 
     if (state->common.f == NULL)
@@ -226,31 +688,32 @@ static decomp_state *make_decomp(const char *const file_path,
     {
       /* Get size of decompressed data */
       long int len;
-      if (!fread_int32le(&len, state->common.f) ||
-          fseek(state->common.f, 0, SEEK_SET))
-      {
-        DEBUGF("fread_int32le or fseek failed\n");
-        token = "ReadFail";
-      }
-      else if (len < 0 || len > INT_MAX ||
-               !flex_alloc(buffer_anchor, (int)len))
-      {
-        DEBUGF("flex_alloc %ld failed\n", len);
-        token = "NoMem";
-      }
-      else
+      token = read_header(state, whole_file, block, &len);
+      if (token == NULL)
       {
-        state->common.len = len;
-        if (!reader_gkey_init(&state->common.reader, FednetHistoryLog2,
-          state->common.f))
+        if (len < 0 || len > INT_MAX ||
+            !flex_alloc(buffer_anchor, (int)len))
         {
-          DEBUGF("reader_gkey_init failed\n");
+          DEBUGF("flex_alloc %ld failed\n", len);
           token = "NoMem";
-          flex_free(buffer_anchor);
         }
         else
         {
-          writer_flex_init(&state->common.writer, buffer_anchor);
+          state->common.len = len;
+
+          /* Blocks are decompressed by the thread pool if there are
+             several, so no reader is needed */
+          state->parallel = nthreads > 1 &&
+                            state->end_block - state->block > 1;
+          token = state->parallel ? NULL : start_decomp_block(state);
+          if (token)
+          {
+            flex_free(buffer_anchor);
+          }
+          else
+          {
+            writer_flex_init(&state->common.writer, buffer_anchor);
+          }
         }
       }
       if (token)
@@ -270,6 +733,294 @@ static decomp_state *make_decomp(const char *const file_path,
 
 /* ----------------------------------------------------------------------- */
 
+static bool check_decomp_block(decomp_state *const state)
+{
+  assert(state != NULL);
+
+  /* Check that the block decompressed to the expected size */
+  long int const wpos = writer_ftell(&state->common.writer);
+  unsigned long const expected = get_block_end(state->total_len,
+    state->block_size, state->block) - state->base;
+
+  if (wpos < 0 || (unsigned long)wpos != expected)
+  {
+    DEBUGF("Block %u ended at %ld instead of %lu\n", state->block, wpos,
+           expected);
+    return false;
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const char *next_decomp_block(decomp_state *const state)
+{
+  assert(state != NULL);
+  assert(state->reader_open);
+
+  if (!check_decomp_block(state))
+  {
+    return "ReadFail";
+  }
+
+  reader_destroy(&state->common.reader);
+  state->reader_open = false;
+  ++state->block;
+  return start_decomp_block(state);
+}
+
+/* ----------------------------------------------------------------------- */
+
+#ifdef FEDCOMP_USE_THREADS
+static const char *decompress_batch(decomp_state *const state,
+  const char *const file_path)
+{
+  assert(state != NULL);
+  assert(state->block < state->end_block);
+  assert(state->block_size > 0);
+  assert(!state->reader_open);
+
+  BlockTask tasks[MaxThreads];
+  unsigned int const ntasks = LOWEST(nthreads,
+                                     state->end_block - state->block);
+  const char *e_token = NULL;
+  unsigned int n;
+
+  for (n = 0; n < ntasks && e_token == NULL; ++n)
+  {
+    BlockTask *const task = &tasks[n];
+    unsigned int const block = state->block + n;
+    unsigned long const start = (unsigned long)block * state->block_size;
+
+    *task = (BlockTask){
+      .function = decompress_task,
+      .history_log2 = state->history_log2,
+      .f = NULL,
+      .in = NULL,
+      .out = NULL,
+      .len = (size_t)(get_block_end(state->total_len, state->block_size,
+                                    block) - start),
+      .out_size = 0,
+      .e_token = NULL
+    };
+
+    /* Find the block in the container's index and give each task its own
+       stream, so that they can read concurrently */
+    long int offset;
+    if (fseek(state->common.f, IndexOffset + (long)block * WordSize,
+              SEEK_SET) ||
+        !fread_int32le(&offset, state->common.f))
+    {
+      DEBUGF("fseek or fread_int32le failed\n");
+      e_token = "ReadFail";
+    }
+    else if ((task->out = malloc(task->len > 0 ? task->len : 1)) == NULL)
+    {
+      DEBUGF("Failed to allocate %zu bytes\n", task->len);
+      e_token = "NoMem";
+    }
+    else if ((task->f = fopen_inc(file_path, "rb")) == NULL)
+    {
+      DEBUGF("fopen_inc failed\n");
+      e_token = "OpenInFail";
+    }
+    else if (fseek(task->f, offset, SEEK_SET))
+    {
+      DEBUGF("fseek failed\n");
+      e_token = "ReadFail";
+    }
+  }
+
+  if (e_token == NULL)
+  {
+    DEBUGF("Decompressing blocks %u to %u\n", state->block,
+           state->block + ntasks - 1);
+    run_batch(tasks, ntasks);
+  }
+
+  /* Append the decompressed blocks to the flex block in order */
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    BlockTask *const task = &tasks[i];
+    if (e_token == NULL)
+    {
+      e_token = task->e_token;
+    }
+    if (e_token == NULL &&
+        writer_fwrite(task->out, 1, task->len, &state->common.writer) !=
+        task->len)
+    {
+      DEBUGF("writer_fwrite failed\n");
+      e_token = "NoMem";
+    }
+    if (task->f != NULL)
+    {
+      fclose_dec(task->f);
+    }
+    free(task->out);
+  }
+
+  state->block += ntasks;
+  return e_token;
+}
+#endif /* FEDCOMP_USE_THREADS */
+
+/* ----------------------------------------------------------------------- */
+
+static const char *decompress(decomp_state **const state_ptr,
+  const char *const file_path, const volatile bool *const time_up)
+{
+  assert(state_ptr != NULL);
+  assert(time_up != NULL);
+  decomp_state *state = *state_ptr;
+  assert(state != NULL);
+  const char *e_token = NULL;
+  bool done = false;
+
+  DEBUGF("Time up %d at start\n", *time_up);
+#ifdef FEDCOMP_USE_THREADS
+  if (state->parallel)
+  {
+    do
+    {
+      e_token = decompress_batch(state, file_path);
+      done = state->block >= state->end_block;
+    }
+    while (e_token == NULL && !done && !*time_up);
+  }
+  else
+#else
+  NOT_USED(file_path);
+#endif /* FEDCOMP_USE_THREADS */
+  do
+  {
+    int start_time, end_time;
+    size_t const nmemb = state->chunk_size;
+
+    (void)os_read_monotonic_time(&start_time);
+    size_t const nread = reader_fread(state->buffer, 1, nmemb,
+      &state->common.reader);
+
+    DEBUG_VERBOSEF("Read %zu of %zu bytes\n", nread, nmemb);
+    assert(nread <= nmemb);
+    if (reader_ferror(&state->common.reader))
+    {
+      DEBUGF("reader_fread failed\n");
+      e_token = "ReadFail";
+      break;
+    }
+
+    size_t const nwrote = writer_fwrite(state->buffer, 1, nread,
+      &state->common.writer);
+
+    assert(nwrote <= nread);
+    if (nwrote != nread)
+    {
+      DEBUGF("Wrote %zu of %zu bytes\n", nwrote, nread);
+      e_token = "NoMem";
+      break;
+    }
+
+    if (reader_feof(&state->common.reader))
+    {
+      if (state->block + 1 < state->end_block)
+      {
+        e_token = next_decomp_block(state);
+        if (e_token != NULL)
+        {
+          break;
+        }
+      }
+      else if (!check_decomp_block(state))
+      {
+        e_token = "ReadFail";
+        break;
+      }
+      else
+      {
+        done = true;
+      }
+    }
+
+    (void)os_read_monotonic_time(&end_time);
+    adapt_chunk_size(&state->chunk_size, end_time - start_time);
+  }
+  while (!done && !*time_up);
+
+  if (e_token != NULL || done)
+  {
+    DEBUGF("Decompression complete or error\n");
+    const char *const e = destroy_decomp(state);
+    if (e_token == NULL)
+    {
+      e_token = e;
+    }
+    state = NULL;
+  }
+  else
+  {
+    DEBUGF("Pausing decompression\n");
+  }
+
+  *state_ptr = state;
+  return e_token;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static const char *start_comp_block(comp_state *const state)
+{
+  assert(state != NULL);
+  assert(!state->writer_open);
+
+  unsigned long const block_start = state->block_size == 0 ? 0 :
+    (unsigned long)state->block * state->block_size;
+
+  long int const len = (long)(get_block_end((unsigned long)state->common.len,
+    state->block_size, state->block) - block_start);
+
+  DEBUGF("Starting block %u of size %ld\n", state->block, len);
+  if (!writer_gkey_init(&state->common.writer,
+    state->history_log2, len, state->common.f))
+  {
+    DEBUGF("writer_gkey_init failed\n");
+    return "NoMem";
+  }
+
+  state->writer_open = true;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool write_header(comp_state *const state)
+{
+  assert(state != NULL);
+  assert(state->block_size > 0);
+
+  /* The offset of every block but the first is filled in later */
+  if (!fwrite_int32le((long)BLOCK_MAGIC, state->common.f) ||
+      !fwrite_int32le((long)state->history_log2, state->common.f) ||
+      !fwrite_int32le(state->common.len, state->common.f) ||
+      !fwrite_int32le((long)state->block_size, state->common.f) ||
+      !fwrite_int32le((long)state->nblocks, state->common.f))
+  {
+    return false;
+  }
+
+  long int const first = IndexOffset + (long)state->nblocks * WordSize;
+  for (unsigned int block = 0; block < state->nblocks; ++block)
+  {
+    if (!fwrite_int32le(block == 0 ? first : 0, state->common.f))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
 static comp_state *make_comp(const char *const file_path,
   flex_ptr buffer_anchor, unsigned int const start_offset,
   unsigned int const end_offset, const char **const e_token)
@@ -287,8 +1038,26 @@ static comp_state *make_comp(const char *const file_path,
     state->common.len = len;
     state->start_offset = start_offset;
     state->end_offset = end_offset;
+    state->writer_open = false;
+    state->history_log2 = get_history_log2();
+    state->block_size = block_size;
+    state->block = 0;
+
+    /* A wide history is only used in a block container, which records the
+       history size, so that the data can't be decoded with the wrong one */
+    if (state->block_size == 0 && history == FedCompHistory_Wide)
+    {
+      state->block_size = len > 0 ? len : 1;
+    }
+    state->nblocks = state->block_size == 0 ? 1 :
+                     get_nblocks(len, state->block_size);
 
-    state->common.destructor = destroy_cb;
+    /* Blocks are compressed by the thread pool if there are several, so no
+       writer is needed */
+    state->parallel = nthreads > 1 && state->nblocks > 1;
+
+    state->common.destructor = destroy_comp_cb;
+    state->chunk_size = MinChunkSize;
     state->common.f = fopen_inc(file_path, "wb"); /* open for writing */
 
     if (state->common.f == NULL)
@@ -298,15 +1067,18 @@ static comp_state *make_comp(const char *const file_path,
     }
     else
     {
-      if (!writer_gkey_init(&state->common.writer,
-        FednetHistoryLog2, len, state->common.f))
+      if (state->block_size > 0 && !write_header(state))
       {
-        DEBUGF("writer_gkey_init failed\n");
-        token = "NoMem";
+        DEBUGF("write_header failed\n");
+        token = "WriteFail";
       }
       else
       {
-        reader_flex_init(&state->common.reader, buffer_anchor);
+        token = state->parallel ? NULL : start_comp_block(state);
+        if (token == NULL)
+        {
+          reader_flex_init(&state->common.reader, buffer_anchor);
+        }
       }
       if (token)
       {
@@ -323,6 +1095,129 @@ static comp_state *make_comp(const char *const file_path,
   return state;
 }
 
+/* ----------------------------------------------------------------------- */
+
+static const char *next_comp_block(comp_state *const state)
+{
+  assert(state != NULL);
+  assert(state->writer_open);
+
+  /* Flush the compressed data of the finished block before recording
+     where the next block starts */
+  state->writer_open = false;
+  if (writer_destroy(&state->common.writer) < 0)
+  {
+    DEBUGF("writer_destroy failed\n");
+    return "WriteFail";
+  }
+
+  ++state->block;
+  long int const offset = ftell(state->common.f);
+  if (offset < 0 ||
+      fseek(state->common.f, IndexOffset + (long)state->block * WordSize,
+            SEEK_SET) ||
+      !fwrite_int32le(offset, state->common.f) ||
+      fseek(state->common.f, offset, SEEK_SET))
+  {
+    DEBUGF("Failed to record offset %ld of block %u\n", offset,
+           state->block);
+    return "WriteFail";
+  }
+
+  return start_comp_block(state);
+}
+
+/* ----------------------------------------------------------------------- */
+
+#ifdef FEDCOMP_USE_THREADS
+static const char *compress_batch(comp_state *const state)
+{
+  assert(state != NULL);
+  assert(state->block < state->nblocks);
+  assert(state->block_size > 0);
+  assert(!state->writer_open);
+
+  BlockTask tasks[MaxThreads];
+  unsigned int const ntasks = LOWEST(nthreads, state->nblocks - state->block);
+  const char *e_token = NULL;
+  unsigned int n;
+
+  /* Copy each block out of the flex block, which must only be accessed by
+     the calling thread */
+  for (n = 0; n < ntasks && e_token == NULL; ++n)
+  {
+    BlockTask *const task = &tasks[n];
+    unsigned int const block = state->block + n;
+    unsigned long const start = (unsigned long)block * state->block_size;
+
+    *task = (BlockTask){
+      .function = compress_task,
+      .history_log2 = state->history_log2,
+      .f = NULL,
+      .in = NULL,
+      .out = NULL,
+      .len = (size_t)(get_block_end((unsigned long)state->common.len,
+                                    state->block_size, block) - start),
+      .out_size = 0,
+      .e_token = NULL
+    };
+
+    if ((task->in = malloc(task->len > 0 ? task->len : 1)) == NULL)
+    {
+      DEBUGF("Failed to allocate %zu bytes\n", task->len);
+      e_token = "NoMem";
+    }
+    else
+    {
+      size_t const nread = reader_fread(task->in, 1, task->len,
+        &state->common.reader);
+      assert(nread == task->len);
+      NOT_USED(nread);
+    }
+  }
+
+  if (e_token == NULL)
+  {
+    DEBUGF("Compressing blocks %u to %u\n", state->block,
+           state->block + ntasks - 1);
+    run_batch(tasks, ntasks);
+  }
+
+  /* Write the compressed blocks to the file in order, recording where
+     each one starts */
+  for (unsigned int i = 0; i < n; ++i)
+  {
+    BlockTask *const task = &tasks[i];
+    if (e_token == NULL)
+    {
+      e_token = task->e_token;
+    }
+    if (e_token == NULL)
+    {
+      long int const offset = ftell(state->common.f);
+      if (offset < 0 ||
+          fseek(state->common.f,
+                IndexOffset + (long)(state->block + i) * WordSize,
+                SEEK_SET) ||
+          !fwrite_int32le(offset, state->common.f) ||
+          fseek(state->common.f, offset, SEEK_SET) ||
+          fwrite(task->out, 1, task->out_size, state->common.f) !=
+          task->out_size)
+      {
+        DEBUGF("Failed to write block %u at offset %ld\n",
+               state->block + i, offset);
+        e_token = "WriteFail";
+      }
+    }
+    free(task->in);
+    free(task->out);
+  }
+
+  state->block += ntasks;
+  return e_token;
+}
+#endif /* FEDCOMP_USE_THREADS */
+
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
 
@@ -335,6 +1230,40 @@ CONST _kernel_oserror *compress_initialise(MessagesFD *const mfd)
 
 /* ----------------------------------------------------------------------- */
 
+void compress_set_history(FedCompHistory const new_history)
+{
+  DEBUGF("Setting history %d\n", (int)new_history);
+  assert(new_history == FedCompHistory_Fednet ||
+         new_history == FedCompHistory_Wide);
+  history = new_history;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void compress_set_block_size(unsigned int const new_block_size)
+{
+  DEBUGF("Setting block size %u\n", new_block_size);
+  assert(new_block_size <= INT_MAX);
+  block_size = new_block_size;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void compress_set_threads(unsigned int const new_nthreads)
+{
+  DEBUGF("Setting %u threads\n", new_nthreads);
+  assert(new_nthreads > 0);
+#ifdef FEDCOMP_USE_THREADS
+  /* Any worker threads are restarted when next needed */
+  stop_pool();
+  nthreads = HIGHEST(LOWEST(new_nthreads, MaxThreads), 1);
+#else
+  NOT_USED(new_nthreads);
+#endif /* FEDCOMP_USE_THREADS */
+}
+
+/* ----------------------------------------------------------------------- */
+
 unsigned int get_decomp_perc(FILE ***const handle)
 {
   assert(handle != NULL);
@@ -380,56 +1309,43 @@ CONST _kernel_oserror *load_compressedM(const char *const file_path,
   if (state == NULL)
   {
     DEBUGF("starting decompression process\n");
-    state = make_decomp(file_path, buffer_anchor, &e_token);
+    state = make_decomp(file_path, buffer_anchor, true, 0, &e_token);
   }
 
   if (state)
   {
-    DEBUGF("Time up %d at start\n", *time_up);
-    char buffer[BufferSize];
-    do
-    {
-      size_t const nread = reader_fread(buffer, 1, sizeof(buffer),
-        &state->common.reader);
+    e_token = decompress(&state, file_path, time_up);
+  }
 
-      DEBUG_VERBOSEF("Read %zu of %zu bytes\n", nread, sizeof(buffer));
-      assert(nread <= sizeof(buffer));
-      if (reader_ferror(&state->common.reader))
-      {
-        DEBUGF("reader_fread failed\n");
-        e_token = "ReadFail";
-        break;
-      }
+  *handle = (FILE **)state; /* write back pointer to state */
+  return e_token != NULL ? lookup_error(e_token, file_path) : NULL;
+}
 
-      size_t const nwrote = writer_fwrite(buffer, 1, nread,
-        &state->common.writer);
+/* ----------------------------------------------------------------------- */
 
-      assert(nwrote <= nread);
-      if (nwrote != nread)
-      {
-        DEBUGF("Wrote %zu of %zu bytes\n", nwrote, nread);
-        e_token = "NoMem";
-        break;
-      }
-    }
-    while (!reader_feof(&state->common.reader) && !*time_up);
+CONST _kernel_oserror *load_compressed_block(const char *const file_path,
+  unsigned int const block, flex_ptr buffer_anchor,
+  const volatile bool *const time_up, FILE ***const handle)
+{
+  assert(file_path != NULL);
+  assert(buffer_anchor != NULL);
+  assert(handle != NULL);
+  const char *e_token = NULL;
+  decomp_state *state = (decomp_state *)*handle;
 
-    if (e_token != NULL || reader_feof(&state->common.reader))
-    {
-      DEBUGF("Decompression complete or error\n");
-      if (state)
-      {
-        const char *const e = destroy_decomp(state);
-        if (e_token == NULL)
-        {
-          e_token = e;
-        }
-      }
-      state = NULL;
-    }
-    else
+  if (state == NULL)
+  {
+    DEBUGF("decompressing block %u\n", block);
+    state = make_decomp(file_path, buffer_anchor, false, block, &e_token);
+  }
+
+  if (state)
+  {
+    e_token = decompress(&state, file_path, time_up);
+    if (e_token != NULL)
     {
-      DEBUGF("Pausing decompression\n");
+      assert(state == NULL);
+      flex_free(buffer_anchor);
     }
   }
 
@@ -470,18 +1386,37 @@ CONST _kernel_oserror *save_compressedM2(const char *const file_path,
   if (state)
   {
     DEBUGF("Time up %d at start\n", *time_up);
-    char buffer[BufferSize];
-    bool truncated = false;
+    bool truncated = false, done = false;
+#ifdef FEDCOMP_USE_THREADS
+    if (state->parallel)
+    {
+      do
+      {
+        e_token = compress_batch(state);
+        done = state->block >= state->nblocks;
+      }
+      while (e_token == NULL && !done && !*time_up);
+    }
+    else
+#endif /* FEDCOMP_USE_THREADS */
     do
     {
+      int start_time, end_time;
+      (void)os_read_monotonic_time(&start_time);
+
       long int const rpos = reader_ftell(&state->common.reader);
       assert(rpos >= 0);
       assert(state->start_offset <= (unsigned long)rpos);
       assert(state->end_offset >= (unsigned long)rpos);
-      unsigned long const rem = state->end_offset - (unsigned long)rpos;
-      DEBUGF("Still need to read %lu bytes\n", rem);
-
-      size_t nmemb = sizeof(buffer);
+      unsigned long const block_end = state->start_offset +
+        get_block_end((unsigned long)state->common.len, state->block_size,
+                      state->block);
+      assert(block_end >= (unsigned long)rpos);
+      unsigned long const rem = block_end - (unsigned long)rpos;
+      DEBUGF("Still need to read %lu bytes of block %u\n", rem,
+             state->block);
+
+      size_t nmemb = state->chunk_size;
       if (nmemb > rem)
       {
         DEBUGF("Truncating input\n");
@@ -489,14 +1424,14 @@ CONST _kernel_oserror *save_compressedM2(const char *const file_path,
         truncated = true;
       }
 
-      size_t const nread = reader_fread(buffer, 1, nmemb,
+      size_t const nread = reader_fread(state->buffer, 1, nmemb,
         &state->common.reader);
 
       DEBUG_VERBOSEF("Read %zu of %zu bytes\n", nread, nmemb);
       assert(nread <= nmemb);
       assert(!reader_ferror(&state->common.reader));
 
-      size_t const nwrote = writer_fwrite(buffer, 1, nread,
+      size_t const nwrote = writer_fwrite(state->buffer, 1, nread,
         &state->common.writer);
 
       assert(nwrote <= nread);
@@ -506,10 +1441,25 @@ CONST _kernel_oserror *save_compressedM2(const char *const file_path,
         e_token = "WriteFail";
         break;
       }
+
+      if (truncated && state->block + 1 < state->nblocks)
+      {
+        /* Finished a block but not the last */
+        e_token = next_comp_block(state);
+        if (e_token != NULL)
+        {
+          break;
+        }
+        truncated = false;
+      }
+
+      (void)os_read_monotonic_time(&end_time);
+      adapt_chunk_size(&state->chunk_size, end_time - start_time);
     }
     while (!truncated && !reader_feof(&state->common.reader) && !*time_up);
 
-    if (e_token != NULL || truncated || reader_feof(&state->common.reader))
+    if (e_token != NULL || done || truncated ||
+        reader_feof(&state->common.reader))
     {
       DEBUGF("Compression complete or error\n");
       const char *const e = destroy_comp(state);
@@ -526,6 +1476,10 @@ CONST _kernel_oserror *save_compressedM2(const char *const file_path,
   }
 
   *handle = (FILE **)state; /* write back pointer to state */
+
+  /* Any cached size or date stamp of the file is now out of date */
+  catcache_invalidate(file_path);
+
   return e_token != NULL ? lookup_error(e_token, file_path) : NULL;
 }
 
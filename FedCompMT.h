@@ -22,7 +22,13 @@
    background. In conjunction with the Timer component this allows multi-
    tasking file operations to be implemented.
 
-Dependencies: ANSI C library, Acorn library kernel, Acorn's flex library.
+   If the library is built for a hosted platform with FEDCOMP_USE_THREADS
+   defined then the blocks of a block container can be compressed and
+   decompressed in parallel by a pool of POSIX threads (see
+   compress_set_threads).
+
+Dependencies: ANSI C library, Acorn library kernel, Acorn's flex library,
+              StreamLib, CBOSLib.
 Message tokens: NoMem, OpenInFail, ReadFail, OpenOutFail, WriteFail.
 History:
   CJB: 05-Nov-04: Added clib-style documentation and dependency information.
@@ -35,6 +41,14 @@ History:
                   should be called to initialise this module. Added "NoMem" to
                   list of required message tokens.
   CJB: 11-Dec-20: Deleted redundant uses of the 'extern' keyword.
+  CJB: 16-Oct-26: Added the FedCompHistory type and a declaration of the
+                  compress_set_history function.
+  CJB: 16-Oct-26: Added declarations of the compress_set_block_size and
+                  load_compressed_block functions.
+  CJB: 16-Oct-26: compress_set_history no longer affects decompression.
+  CJB: 16-Oct-26: Added a declaration of the compress_set_threads function.
+                  load_compressed_block now takes 'time_up' and 'handle'
+                  arguments, like load_compressedM.
 */
 
 #ifndef FedCompMT_h
@@ -60,6 +74,52 @@ CONST _kernel_oserror *compress_initialise(MessagesFD */*mfd*/);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+typedef enum
+{
+  FedCompHistory_Fednet, /* 512-byte history, as used by the Fednet games
+                            (the default) */
+  FedCompHistory_Wide    /* 4 KB history, which usually gives better
+                            compression */
+}
+FedCompHistory;
+
+void compress_set_history(FedCompHistory /*history*/);
+   /*
+    * Selects the size of the history used by subsequent calls to
+    * save_compressedM2 that start a new file operation. Operations already
+    * in progress are not affected. Because a single Fednet stream doesn't
+    * record the history size, data compressed in wide mode is always written
+    * as a block container (of one block, if no block size was selected) and
+    * can't be read by the games themselves. load_compressedM uses the
+    * history size recorded in a block container and the Fednet history for
+    * anything else, so this setting doesn't affect decompression.
+    */
+
+void compress_set_block_size(unsigned int /*block_size*/);
+   /*
+    * Selects whether subsequent calls to save_compressedM2 that start a new
+    * file operation write a single Fednet stream (if 'block_size' is 0,
+    * the default) or a block container. A block container splits the data
+    * into blocks of 'block_size' bytes (except the last), each compressed
+    * independently, preceded by an index of where each block starts and by
+    * the history size. load_compressedM recognises block containers
+    * automatically, but other programs which read Fednet files (including
+    * the games) can't. In wide mode, a block container is written even if
+    * 'block_size' is 0.
+    */
+
+void compress_set_threads(unsigned int /*nthreads*/);
+   /*
+    * Selects how many threads (including the caller's) subsequent calls to
+    * save_compressedM2, load_compressedM and load_compressed_block use to
+    * compress or decompress the blocks of a block container. The default is
+    * 1, which means that no other threads are used. If more than one, each
+    * call processes at least one block per thread before checking whether
+    * 'time_up' is true. Any threads already started are stopped, so call
+    * this with 1 before exiting. It has no effect unless the library is
+    * built with FEDCOMP_USE_THREADS defined.
+    */
+
 unsigned int get_decomp_perc(FILE *** /*handle*/);
    /*
     * Calculates what proportion of a decompression operation has been
@@ -87,6 +147,21 @@ CONST _kernel_oserror *load_compressedM(const char * /*file_path*/, flex_ptr /*b
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+CONST _kernel_oserror *load_compressed_block(const char * /*file_path*/, unsigned int /*block*/, flex_ptr /*buffer_anchor*/, const volatile bool * /*time_up*/, FILE *** /*handle*/);
+   /*
+    * Decompresses block number 'block' (counting from 0) of the block
+    * container in the specified file 'file_path' into a new flex block
+    * anchored at 'buffer_anchor', without decompressing any other blocks.
+    * Like load_compressedM, it returns when the variable pointed to by
+    * 'time_up' is found to be true, and the FILE ** pointer pointed to by
+    * 'handle' should be NULL on the first call and is NULL again once
+    * finished. It fails if the file isn't a block container or the block
+    * number is too big. Block n holds the data at offsets from n times the
+    * block size used to compress the file. The flex block is freed if an
+    * error occurs.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
 CONST _kernel_oserror *save_compressedM2(const char * /*file_path*/, flex_ptr /*buffer_anchor*/, const volatile bool * /*time_up*/, unsigned int /*start_offset*/, unsigned int /*end_offset*/, FILE *** /*handle*/);
    /*
     * Compresses (using the Fednet algorithm) an area of the flex block
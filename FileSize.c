@@ -19,6 +19,7 @@
 
 /* History:
   CJB: 10-Nov-19: Created this file.
+  CJB: 16-Oct-26: Catalogue information is now read via the cache.
  */
 
 /* Acorn C/C++ library headers */
@@ -30,6 +31,7 @@
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "FileUtils.h"
+#include "CatCache.h"
 
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
@@ -40,7 +42,7 @@ CONST _kernel_oserror *get_file_size(const char *const f, int *const size)
   assert(size != NULL);
 
   OS_File_CatalogueInfo cat;
-  ON_ERR_RTN_E(os_file_read_cat_no_path(f, &cat));
+  ON_ERR_RTN_E(catcache_read_cat_no_path(f, &cat));
 
   switch (cat.object_type)
   {
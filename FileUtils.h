@@ -35,6 +35,7 @@ History:
   CJB: 10-Nov-19: Added a declaration of the get_file_size function.
   CJB: 11-Dec-20: Deleted redundant uses of the 'extern' keyword.
   CJB: 31-May-21: Added a declaration of the get_file_type function.
+  CJB: 16-Oct-26: Documented use of the catalogue information cache.
 */
 
 #ifndef FileUtils_h
@@ -59,20 +60,23 @@ CONST _kernel_oserror *canonicalise(char ** /*b*/, const char * /*pv*/, const ch
 CONST _kernel_oserror *set_file_type(const char */*f*/, int /*type*/);
    /*
     * Sets the type of a specified file to indicate its contents (e.g. 0xfff
-    * means text, whereas 0xfaf means HTML).
+    * means text, whereas 0xfaf means HTML). Any cached catalogue information
+    * about the file is discarded.
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
 CONST _kernel_oserror *get_file_type(const char */*f*/, int * /*type*/);
    /*
-    * Gets the type of a specified file.
+    * Gets the type of a specified file. Uses cached catalogue information
+    * if the catalogue information cache is enabled (see CatCache.h).
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
 CONST _kernel_oserror *get_file_size(const char */*f*/, int * /*size*/);
    /*
     * Gets the size of a specified file, in bytes. Returns an error if the
-    * object doesn't exist or is not a file.
+    * object doesn't exist or is not a file. Uses cached catalogue
+    * information if the catalogue information cache is enabled.
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
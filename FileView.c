@@ -0,0 +1,278 @@
+/*
+ * CBLibrary: Read-only views of files, loaded on demand
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* History:
+  CJB: 16-Oct-26: Created this source file.
+  CJB: 16-Oct-26: Added fileview_initialise so that error messages can be
+                  looked up in the client's messages file.
+ */
+
+#ifdef FILEVIEW_USE_MMAP
+/* Needed for mmap and fstat in strict ISO C mode */
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef FILEVIEW_USE_MMAP
+/* POSIX headers */
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+
+/* Local headers */
+#include "Internal/CBMisc.h"
+#include "FileView.h"
+#ifndef FILEVIEW_USE_MMAP
+#include "FopenCount.h"
+#include "FileUtils.h"
+#endif
+
+/* Constant numeric values */
+enum
+{
+  WindowSize = 64 * 1024 /* Minimum number of bytes to read at once, so that
+                            nearby requests can be satisfied without reading
+                            the file again */
+};
+
+struct FileView
+{
+  long int  size;
+  char     *file_path; /* For error messages */
+#ifdef FILEVIEW_USE_MMAP
+  char     *base; /* Address at which the file is mapped, or NULL if empty */
+#else
+  FILE     *f;
+  char     *window; /* Data read from the file */
+  size_t    window_size; /* Size of the memory allocated for 'window' */
+  long int  window_start; /* File offset of the data in 'window' */
+  size_t    window_used; /* Number of bytes of data in 'window' */
+#endif
+};
+
+static MessagesFD *desc;
+
+/* ----------------------------------------------------------------------- */
+/*                       Function prototypes                               */
+
+static CONST _kernel_oserror *lookup_error(const char *token, const char *param);
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+CONST _kernel_oserror *fileview_initialise(MessagesFD *mfd)
+{
+  /* Store pointer to messages file descriptor */
+  desc = mfd;
+  return NULL; /* success */
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *fileview_open(FileView **view, const char *file_path)
+{
+  FileView *new_view;
+
+  assert(view != NULL);
+  assert(file_path != NULL);
+  DEBUGF("FileView: Opening view of '%s'\n", file_path);
+
+  *view = NULL;
+  new_view = malloc(sizeof(*new_view));
+  if (new_view == NULL)
+    return lookup_error("NoMem", NULL);
+
+  new_view->file_path = malloc(strlen(file_path) + 1);
+  if (new_view->file_path == NULL)
+  {
+    free(new_view);
+    return lookup_error("NoMem", NULL);
+  }
+  strcpy(new_view->file_path, file_path);
+
+#ifdef FILEVIEW_USE_MMAP
+  struct stat st;
+  const int fd = open(file_path, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    DEBUGF("FileView: open or fstat failed\n");
+    if (fd >= 0)
+      close(fd);
+    free(new_view->file_path);
+    free(new_view);
+    return lookup_error("OpenInFail", file_path);
+  }
+
+  new_view->size = (long int)st.st_size;
+  new_view->base = NULL;
+  if (new_view->size > 0)
+  {
+    /* The mapping remains valid after the file descriptor is closed */
+    void *const base = mmap(NULL, (size_t)new_view->size, PROT_READ,
+                            MAP_PRIVATE, fd, 0);
+    if (base == MAP_FAILED)
+    {
+      DEBUGF("FileView: mmap failed\n");
+      close(fd);
+      free(new_view->file_path);
+      free(new_view);
+      return lookup_error("OpenInFail", file_path);
+    }
+    new_view->base = base;
+  }
+  close(fd);
+#else
+  int size;
+  CONST _kernel_oserror *const e = get_file_size(file_path, &size);
+  if (e != NULL)
+  {
+    free(new_view->file_path);
+    free(new_view);
+    return e;
+  }
+
+  _kernel_last_oserror(); /* reset SCL's error recording */
+
+  new_view->f = fopen_inc(file_path, "rb");
+  if (new_view->f == NULL)
+  {
+    DEBUGF("FileView: fopen_inc failed\n");
+    free(new_view->file_path);
+    free(new_view);
+    ON_ERR_RTN_E(_kernel_last_oserror()); /* return any OS error */
+    return lookup_error("OpenInFail", file_path);
+  }
+
+  new_view->size = size;
+  new_view->window = NULL;
+  new_view->window_size = 0;
+  new_view->window_start = 0;
+  new_view->window_used = 0;
+#endif
+
+  DEBUGF("FileView: File size is %ld\n", new_view->size);
+  *view = new_view;
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+long int fileview_get_size(const FileView *view)
+{
+  assert(view != NULL);
+  return view->size;
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *fileview_map(FileView     *view,
+                                    long int      offset,
+                                    size_t        size,
+                                    const void  **data)
+{
+  assert(view != NULL);
+  assert(offset >= 0);
+  assert(offset <= view->size);
+  assert(size <= (size_t)(view->size - offset));
+  assert(data != NULL);
+  DEBUG_VERBOSEF("FileView: Mapping %zu bytes at offset %ld\n", size, offset);
+
+#ifdef FILEVIEW_USE_MMAP
+  *data = view->base + offset;
+#else
+  if (offset < view->window_start ||
+      size > view->window_used ||
+      (size_t)(offset - view->window_start) > view->window_used - size)
+  {
+    /* The requested range isn't all in the window, so read it (and as much
+       of the rest of the file as fits in a minimum-size window) */
+    const size_t read_size = LOWEST(HIGHEST(size, (size_t)WindowSize),
+                                    (size_t)(view->size - offset));
+    if (read_size > view->window_size)
+    {
+      char *const window = realloc(view->window, read_size);
+      if (window == NULL)
+        return lookup_error("NoMem", NULL);
+
+      view->window = window;
+      view->window_size = read_size;
+    }
+
+    DEBUGF("FileView: Reading %zu bytes at offset %ld\n", read_size, offset);
+    view->window_start = offset;
+    view->window_used = 0;
+
+    _kernel_last_oserror(); /* reset SCL's error recording */
+
+    if (fseek(view->f, offset, SEEK_SET) != 0 ||
+        fread(view->window, sizeof(char), read_size, view->f) != read_size)
+    {
+      DEBUGF("FileView: fseek or fread failed\n");
+      clearerr(view->f);
+      ON_ERR_RTN_E(_kernel_last_oserror()); /* return any OS error */
+      return lookup_error("ReadFail", view->file_path);
+    }
+    view->window_used = read_size;
+  }
+
+  *data = view->window + (offset - view->window_start);
+#endif
+
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void fileview_close(FileView *view)
+{
+  DEBUGF("FileView: Closing view %p\n", (void *)view);
+  if (view != NULL)
+  {
+#ifdef FILEVIEW_USE_MMAP
+    if (view->base != NULL)
+      munmap(view->base, (size_t)view->size);
+#else
+    fclose_dec(view->f);
+    free(view->window);
+#endif
+    free(view->file_path);
+    free(view);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static CONST _kernel_oserror *lookup_error(const char *token, const char *param)
+{
+  /* Look up error message from the token, outputting to an internal buffer */
+  return messagetrans_error_lookup(desc, DUMMY_ERRNO, token, 1, param);
+}
@@ -0,0 +1,99 @@
+/*
+ * CBLibrary: Read-only views of files, loaded on demand
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* FileView.h declares functions to read parts of a file on demand, as an
+   alternative to loading the whole file into a flex block with load_fileM2
+   when only some of its data will be read. Only the bytes requested (and
+   any others in the same window) are read from the file, so opening a view
+   of a huge file takes the same time as opening a view of a small one.
+
+   If the library is built for a hosted platform with FILEVIEW_USE_MMAP
+   defined then the file is mapped into memory instead, so no data is
+   copied at all and pages are read by the host's virtual memory system
+   when first accessed.
+
+Dependencies: ANSI C library, Acorn library kernel.
+Message tokens: NoMem, OpenInFail, ReadFail.
+History:
+  CJB: 16-Oct-26: Created this header file.
+  CJB: 16-Oct-26: Added prototype of function fileview_initialise.
+*/
+
+#ifndef FileView_h
+#define FileView_h
+
+/* ISO library headers */
+#include <stddef.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "toolbox.h"
+
+/* Local headers */
+#include "Macros.h"
+
+CONST _kernel_oserror *fileview_initialise(MessagesFD * /*mfd*/);
+   /*
+    * Initialises the FileView module. Unless 'mfd' is a null pointer, the
+    * specified messages file will be given priority over the global messages
+    * file when looking up text required by this module.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+typedef struct FileView FileView;
+   /*
+    * Incomplete struct type representing a read-only view of a file.
+    */
+
+CONST _kernel_oserror *fileview_open(FileView   ** /*view*/,
+                                     const char  * /*file_path*/);
+   /*
+    * Creates a read-only view of the file 'file_path', which is kept open
+    * until the view is closed. No data is read until requested.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+long int fileview_get_size(const FileView * /*view*/);
+   /*
+    * Gets the size of the file on which a view was opened.
+    * Returns: the file size, in bytes.
+    */
+
+CONST _kernel_oserror *fileview_map(FileView     * /*view*/,
+                                    long int       /*offset*/,
+                                    size_t         /*size*/,
+                                    const void  ** /*data*/);
+   /*
+    * Gets a pointer to 'size' bytes of a file's data, starting 'offset'
+    * bytes from the start. The requested range must be within the file.
+    * Data already read for an earlier request is reused if possible. On
+    * success, a pointer to the data is stored in the object pointed to by
+    * 'data'. It remains valid until the next call to fileview_map or
+    * fileview_close with the same view and must not be used to write.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+void fileview_close(FileView * /*view*/);
+   /*
+    * Closes the file on which a view was opened and frees the memory that
+    * was allocated for the view. Does nothing if called with a null
+    * pointer.
+    */
+
+#endif
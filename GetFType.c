@@ -19,6 +19,7 @@
 
 /* History:
   CJB: 31-May-21: Created this source file.
+  CJB: 16-Oct-26: Catalogue information is now read via the cache.
  */
 
 /* ISO library headers */
@@ -33,6 +34,7 @@
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "FileUtils.h"
+#include "CatCache.h"
 
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
@@ -40,7 +42,7 @@
 CONST _kernel_oserror *get_file_type(const char *f, int *type)
 {
   OS_File_CatalogueInfo info;
-  CONST _kernel_oserror *e = os_file_read_cat_no_path(f, &info);
+  CONST _kernel_oserror *e = catcache_read_cat_no_path(f, &info);
   if (!e) {
     *type = decode_load_exec(info.load, info.exec, NULL);
   }
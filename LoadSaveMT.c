@@ -57,6 +57,17 @@
   CJB: 01-Nov-18: Replaced DEBUG macro usage with DEBUGF.
   CJB: 06-Nov-19: Fixed failure to check the return value of fclose_dec().
   CJB: 10-Nov-19: Modified load_fileM2() to use get_file_size().
+  CJB: 16-Oct-26: Added a direct transfer mode, selected by calling the new
+                  loadsave_set_mode() function, in which unbuffered streams
+                  are used to read and write the flex block directly in
+                  chunks whose size adapts to the time taken.
+  CJB: 16-Oct-26: Streams are now parked in the FOpenCount handle cache
+                  when an operation is suspended instead of being kept open
+                  only if there were spare file handles. They are reopened
+                  only if they were closed to make room for other streams.
+  CJB: 16-Oct-26: load_fileM2 no longer seeks a stream that was parked.
+  CJB: 16-Oct-26: Cached catalogue information about the file written by
+                  save_fileM2 is discarded after each call.
  */
 
 /* ISO library headers */
@@ -74,6 +85,7 @@
 /* CBOSLib headers */
 #include "MessTrans.h"
 #include "Hourglass.h"
+#include "OSReadTime.h"
 #include "SprFormats.h"
 
 /* Local headers */
@@ -82,6 +94,7 @@
 #include "LoadSaveMT.h"
 #include "FopenCount.h"
 #include "FileUtils.h"
+#include "CatCache.h"
 #ifdef CBLIB_OBSOLETE
 #include "MsgTrans.h"
 #endif /* CBLIB_OBSOLETE */
@@ -101,9 +114,15 @@ enum
   HeapPreExpandBig               = BUFSIZ, /* Amount to pre-expand the heap by
                                               before disabling flex budging
                                               for fread/fwrite */
-  HeapPreExpandSmall             = 512 /* Amount to pre-expand the heap by
+  HeapPreExpandSmall             = 512, /* Amount to pre-expand the heap by
                                           before disabling flex budging for
                                           memcpy */
+  MaxChunkSize                   = 1024 * 1024, /* Maximum number of bytes to
+                                                   read/write in direct mode
+                                                   before checking for time
+                                                   up */
+  TargetChunkTime                = 1 /* Centiseconds to aim to spend on each
+                                        chunk in direct mode */
 };
 
 typedef struct
@@ -113,6 +132,9 @@ typedef struct
   unsigned int   start;
   unsigned int   mem_pos;
   unsigned int   limit;
+  bool           direct;
+  size_t         chunk_size; /* Only used in direct mode */
+  FOpenLease     lease; /* Holds the stream whilst suspended */
 }
 fileop_state;
 
@@ -120,11 +142,17 @@ fileop_state;
 static char static_buffer[Granularity];
 #endif
 static MessagesFD *desc;
+static LoadSaveMode mode = LoadSaveMode_Buffered;
 
 /* ----------------------------------------------------------------------- */
 /*                       Function prototypes                               */
 
 static CONST _kernel_oserror *lookup_error(const char *token, const char *param);
+static FILE *open_stream(const fileop_state *state, const char *file_path, const char *open_mode);
+static void adapt_chunk_size(fileop_state *state, int elapsed);
+static size_t next_chunk_size(const fileop_state *state);
+static FILE *resume_stream(fileop_state *state, const char *file_path, const char *open_mode, bool *resumed);
+static void destroy_cb(void *fop);
 
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
@@ -138,6 +166,15 @@ CONST _kernel_oserror *loadsave_initialise(MessagesFD *mfd)
 
 /* ----------------------------------------------------------------------- */
 
+void loadsave_set_mode(LoadSaveMode new_mode)
+{
+  DEBUGF("LoadSaveMT: Setting mode %d\n", (int)new_mode);
+  assert(new_mode == LoadSaveMode_Buffered || new_mode == LoadSaveMode_Direct);
+  mode = new_mode;
+}
+
+/* ----------------------------------------------------------------------- */
+
 unsigned int get_loadsave_perc(FILE ***handle)
 {
   fileop_state *state = (fileop_state *)*handle;
@@ -201,8 +238,11 @@ CONST _kernel_oserror *load_fileM2(const char *file_path, flex_ptr buffer_anchor
     state->mem_pos = 0;
     state->start = 0;
     state->common.f = NULL;
-    state->common.destructor = NULL;
+    state->common.destructor = destroy_cb;
     state->read_pos = 0; /* start reading from beginning of file */
+    state->direct = (mode == LoadSaveMode_Direct);
+    state->chunk_size = Granularity;
+    fopen_lease_init(&state->lease);
   }
   else
   {
@@ -215,10 +255,12 @@ CONST _kernel_oserror *load_fileM2(const char *file_path, flex_ptr buffer_anchor
 
   if (state->common.f == NULL)
   {
-    /* (Re)open file and start reading data where we left off */
-    state->common.f = fopen_inc(file_path, "rb"); /* open for reading */
+    /* (Re)open file and start reading data where we left off. A stream
+       that was parked is still at that position. */
+    bool resumed;
+    state->common.f = resume_stream(state, file_path, "rb", &resumed); /* open for reading */
     if (state->common.f == NULL ||
-        fseek(state->common.f, state->read_pos, SEEK_SET) == -1)
+        (!resumed && fseek(state->common.f, state->read_pos, SEEK_SET) == -1))
     {
       DEBUGF("LoadSaveMT: fopen_inc or fseek failed\n");
       if (state->common.f != NULL)
@@ -231,15 +273,49 @@ CONST _kernel_oserror *load_fileM2(const char *file_path, flex_ptr buffer_anchor
   }
 
   hourglass_on(); /* floppy discs can be really slow! */
+
+  if (*time_up)
+    DEBUGF("LoadSaveMT: Time up before start (will do one iteration anyway)\n");
+
+  if (state->direct)
+  {
+    /* The stream is unbuffered, so reading it doesn't need any heap. Budge
+       is disabled once per call instead of once per chunk. */
+    nobudge_register(HeapPreExpandSmall); /* protect pointer into flexblock */
+    char *const ptr = *buffer_anchor;
+
+    /* Read chunks of data directly into the flex block until time up */
+    while (state->mem_pos < state->limit)
+    {
+      const size_t chunk_size = next_chunk_size(state);
+      int start_time, end_time;
+
+      (void)os_read_monotonic_time(&start_time);
+      const size_t num_read = fread(ptr + state->mem_pos, sizeof(char),
+                                    chunk_size, state->common.f);
+      (void)os_read_monotonic_time(&end_time);
+
+      if (num_read != chunk_size)
+        break; /* EOF or read error */
+
+      state->mem_pos += num_read;
+      adapt_chunk_size(state, end_time - start_time);
+
+      if (*time_up)
+        break;
+    } /* endwhile */
+
+    nobudge_deregister();
+  }
+  else
 #ifndef STATIC_BUFFER
   {
     nobudge_register(HeapPreExpandBig); /* protect pointer into flexblock */
     void *ptr = *buffer_anchor;
+#else
+  {
 #endif
 
-    if (*time_up)
-      DEBUGF("LoadSaveMT: Time up before start (will do one iteration anyway)\n");
-
     /* Read chunks of data until time up */
     while (state->mem_pos < state->limit)
     {
@@ -277,8 +353,8 @@ CONST _kernel_oserror *load_fileM2(const char *file_path, flex_ptr buffer_anchor
 
 #ifndef STATIC_BUFFER
     nobudge_deregister();
-  }
 #endif
+  }
   hourglass_off();
 
   if (ferror(state->common.f))
@@ -308,13 +384,10 @@ CONST _kernel_oserror *load_fileM2(const char *file_path, flex_ptr buffer_anchor
     DEBUGF("LoadSaveMT: Loading suspended at mem_pos %u (time up)\n",
           state->mem_pos);
 
-    if (fopen_num() >= FOPEN_MAX)
-    {
-      /* if we have no spare file handles then close file */
-      state->read_pos = ftell(state->common.f);
-      fclose_dec(state->common.f);
-      state->common.f = NULL;
-    }
+    /* Park the file in case it has to be closed and reopened later */
+    state->read_pos = ftell(state->common.f);
+    fopen_lease_park(&state->lease, state->common.f);
+    state->common.f = NULL;
     *handle = (FILE **)state; /* write back pointer to state */
   }
   return NULL; /* no error */
@@ -340,7 +413,10 @@ CONST _kernel_oserror *save_fileM2(const char *file_path, flex_ptr buffer_anchor
     state->start= start_offset;
     state->mem_pos = start_offset;
     state->common.f = NULL;
-    state->common.destructor = NULL;
+    state->common.destructor = destroy_cb;
+    state->direct = (mode == LoadSaveMode_Direct);
+    state->chunk_size = Granularity;
+    fopen_lease_init(&state->lease);
     open_mode = "wb"; /* open for writing */
   }
   else
@@ -356,7 +432,8 @@ CONST _kernel_oserror *save_fileM2(const char *file_path, flex_ptr buffer_anchor
   if (state->common.f == NULL)
   {
     /* (Re)open file */
-    state->common.f = fopen_inc(file_path, open_mode);
+    bool resumed;
+    state->common.f = resume_stream(state, file_path, open_mode, &resumed);
     if (state->common.f == NULL)
     {
       free(state);
@@ -367,15 +444,50 @@ CONST _kernel_oserror *save_fileM2(const char *file_path, flex_ptr buffer_anchor
   }
 
   hourglass_on(); /* floppy discs can be really slow! */
+
+  if (*time_up)
+    DEBUGF("LoadSaveMT: Time up before start\n");
+
+  if (state->direct)
+  {
+    /* The stream is unbuffered, so writing it doesn't need any heap. Budge
+       is disabled once per call instead of once per chunk. */
+    nobudge_register(HeapPreExpandSmall); /* protect pointer into flexblock */
+    const char *const ptr = *buffer_anchor;
+
+    /* Write chunks of data directly from the flex block until we run out
+       or time up */
+    while (state->mem_pos < state->limit)
+    {
+      const size_t chunk_size = next_chunk_size(state);
+      int start_time, end_time;
+
+      (void)os_read_monotonic_time(&start_time);
+      const size_t num_written = fwrite(ptr + state->mem_pos, sizeof(char),
+                                        chunk_size, state->common.f);
+      (void)os_read_monotonic_time(&end_time);
+
+      if (num_written != chunk_size)
+        break; /* write error */
+
+      state->mem_pos += num_written;
+      adapt_chunk_size(state, end_time - start_time);
+
+      if (*time_up)
+        break;
+    } /* endwhile */
+
+    nobudge_deregister();
+  }
+  else
 #ifndef STATIC_BUFFER
   {
     nobudge_register(HeapPreExpandBig); /* protect pointer into flexblock */
     char *ptr = (char *)*buffer_anchor;
+#else
+  {
 #endif
 
-    if (*time_up)
-      DEBUGF("LoadSaveMT: Time up before start\n");
-
     /* Write chunks of data until we run out or time up */
     while (state->mem_pos < state->limit)
     {
@@ -416,8 +528,8 @@ CONST _kernel_oserror *save_fileM2(const char *file_path, flex_ptr buffer_anchor
 
 #ifndef STATIC_BUFFER
     nobudge_deregister();
-  }
 #endif
+  }
   hourglass_off();
 
   bool write_fail = false;
@@ -447,24 +559,28 @@ CONST _kernel_oserror *save_fileM2(const char *file_path, flex_ptr buffer_anchor
     DEBUGF("LoadSaveMT: Saving suspended at mem_pos %u (time up)\n",
           state->mem_pos);
 
-    if (fopen_num() >= FOPEN_MAX)
+    /* Park the file in case it has to be closed and reopened later.
+       Flush it first so that a write error can't be lost if it is closed
+       to make room for other streams. */
+    if (fflush(state->common.f))
     {
-      /* if we have no spare file handles then close file */
-      if (fclose_dec(state->common.f))
-      {
-        write_fail = true;
-        free(state);
-        state = NULL;
-      }
-      else
-      {
-        state->common.f = NULL;
-      }
+      fclose_dec(state->common.f);
+      write_fail = true;
+      free(state);
+      state = NULL;
+    }
+    else
+    {
+      fopen_lease_park(&state->lease, state->common.f);
+      state->common.f = NULL;
     }
   }
 
   *handle = (FILE **)state; /* write back pointer to state */
 
+  /* Any cached size or date stamp of the file is now out of date */
+  catcache_invalidate(file_path);
+
   if (write_fail)
   {
     ON_ERR_RTN_E(_kernel_last_oserror()); /* return any OS error */
@@ -519,6 +635,79 @@ CONST _kernel_oserror *save_fileM(const char *file_path, int file_type, flex_ptr
 /* ----------------------------------------------------------------------- */
 /*                         Private functions                               */
 
+static FILE *open_stream(const fileop_state *state, const char *file_path, const char *open_mode)
+{
+  FILE *const f = fopen_inc(file_path, open_mode);
+
+  /* In direct mode, data is transferred between the flex block and the file
+     without copying it via a stream buffer, which would also have to be
+     allocated whilst flex budging is disabled. */
+  if (f != NULL && state->direct && setvbuf(f, NULL, _IONBF, 0) != 0)
+  {
+    DEBUGF("LoadSaveMT: setvbuf failed\n");
+    fclose_dec(f);
+    return NULL;
+  }
+  return f;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static FILE *resume_stream(fileop_state *state, const char *file_path, const char *open_mode, bool *resumed)
+{
+  /* Reuse the parked stream unless it was closed whilst suspended */
+  FILE *const f = fopen_lease_resume(&state->lease);
+  *resumed = (f != NULL);
+  if (f != NULL)
+    return f;
+
+  return open_stream(state, file_path, open_mode);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void destroy_cb(void *const fop)
+{
+  /* Called by abort_file_op */
+  fileop_state *const state = fop;
+
+  assert(state != NULL);
+  if (state->common.f != NULL)
+    fclose_dec(state->common.f);
+
+  fopen_lease_cancel(&state->lease);
+  free(state);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static size_t next_chunk_size(const fileop_state *state)
+{
+  assert(state->limit >= state->mem_pos);
+  return LOWEST(state->chunk_size, (size_t)(state->limit - state->mem_pos));
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void adapt_chunk_size(fileop_state *state, int elapsed)
+{
+  /* Double the chunk size while chunks are quicker than the target, so
+     that fewer checks are made for time up, and halve it if they are
+     slower, so that the caller's deadline isn't badly overrun. */
+  if (elapsed < TargetChunkTime && state->chunk_size < MaxChunkSize)
+  {
+    state->chunk_size *= 2;
+    DEBUG_VERBOSEF("LoadSaveMT: Increased chunk size to %zu\n",
+                   state->chunk_size);
+  }
+  else if (elapsed > TargetChunkTime && state->chunk_size > Granularity)
+  {
+    state->chunk_size /= 2;
+    DEBUG_VERBOSEF("LoadSaveMT: Decreased chunk size to %zu\n",
+                   state->chunk_size);
+  }
+}
+
 static CONST _kernel_oserror *lookup_error(const char *token, const char *param)
 {
 #ifdef CBLIB_OBSOLETE
@@ -35,6 +35,8 @@ History:
                   should be called to initialise this module.
   CJB: 15-Oct-09: Added "NoMem" to list of required message tokens.
   CJB: 11-Dec-20: Deleted redundant uses of the 'extern' keyword.
+  CJB: 16-Oct-26: Added the LoadSaveMode type and a declaration of the
+                  loadsave_set_mode function.
 */
 
 #ifndef LoadSaveMT_h
@@ -60,6 +62,28 @@ CONST _kernel_oserror *loadsave_initialise(MessagesFD */*mfd*/);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+typedef enum
+{
+  LoadSaveMode_Buffered, /* Data is copied via a static buffer in chunks of
+                            a fixed size (the default) */
+  LoadSaveMode_Direct    /* Data is transferred directly between the flex
+                            block and an unbuffered stream, in chunks of a
+                            size that adapts to the time taken */
+}
+LoadSaveMode;
+
+void loadsave_set_mode(LoadSaveMode /*mode*/);
+   /*
+    * Selects how data is transferred by subsequent calls to load_fileM2 and
+    * save_fileM2 that start a new file operation. Operations already in
+    * progress are not affected. In direct mode, flex budging is disabled
+    * for the whole of each call rather than for each chunk copied, and
+    * chunks grow from 4 KB up to 1 MB whilst each takes less than a
+    * centisecond to transfer. That is much faster for large files but
+    * relies on the C library reading and writing unbuffered streams without
+    * allocating memory.
+    */
+
 unsigned int get_loadsave_perc(FILE *** /*handle*/);
    /*
     * Calculates what proportion of a file operation has been completed and
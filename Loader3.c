@@ -30,6 +30,10 @@
   CJB: 01-Nov-20: Assign a compound literal to initialise a load operation.
   CJB: 07-Nov-20: Added the loader3_load_file function to allow DataOpen and
                   DataLoad handlers to reuse existing code.
+  CJB: 16-Oct-26: Register the time-out function with the scheduler in return
+                  for a token, so that it can be deregistered without a
+                  search.
+  CJB: 16-Oct-26: Use scheduler_call_after for the time-out function.
 */
 
 /* ISO library headers */
@@ -72,7 +76,7 @@ typedef struct
   int   last_message_type;
   int   bytes_received;
   bool  RAM_capable;
-  bool  idle_function;
+  SchedulerToken time_out_token; /* Null if no time-out */
   bool  no_flex_budge;
   void *RAM_buffer;
   Loader3ReadMethod   *read_method;
@@ -124,8 +128,6 @@ static CONST _kernel_oserror *no_mem(void)
 
 /* ----------------------------------------------------------------------- */
 
-static SchedulerIdleFunction time_out;
-
 static void destroy_op(LoadOpData *const load_op_data)
 {
   DEBUGF("Loader3: Removing record of operation %p\n", (void *)load_op_data);
@@ -134,8 +136,8 @@ static void destroy_op(LoadOpData *const load_op_data)
   if (load_op_data->no_flex_budge)
     nobudge_deregister();
 
-  if (load_op_data->idle_function)
-    scheduler_deregister(time_out, load_op_data);
+  if (load_op_data->time_out_token != NULL)
+    scheduler_deregister_token(load_op_data->time_out_token);
 
   if (load_op_data->RAM_buffer != NULL)
     flex_free(&load_op_data->RAM_buffer);
@@ -167,22 +169,20 @@ static void report_fail(LoadOpData *const load_op_data,
 
 /* ----------------------------------------------------------------------- */
 
-static SchedulerTime time_out(void *const handle,
-  SchedulerTime const time_now, const volatile bool *const time_up)
+static void time_out(void *const arg)
 {
   /* This function is called by the scheduler 30 seconds after we start
      a load operation (unless we cancel it in the interim). We use it to
      free up resources associated with stalled load operations. */
-  LoadOpData *const load_op_data = handle;
+  LoadOpData *const load_op_data = arg;
   assert(load_op_data != NULL);
-  NOT_USED(time_up);
+
+  /* The scheduler has already forgotten this function */
+  load_op_data->time_out_token = NULL;
 
   DEBUGF("Loader3: Load operation %p timed out\n", (void *)load_op_data);
   report_fail(load_op_data, NULL);
   destroy_op(load_op_data);
-
-  return time_now; /* Return time doesn't actually matter because already
-                      deregistered this function */
 }
 
 /* ----------------------------------------------------------------------- */
@@ -761,7 +761,7 @@ CONST _kernel_oserror *loader3_receive_data(const WimpMessage *const message,
     /* Initialise record for a new load operation */
     *load_op_data = (LoadOpData){
       .RAM_capable = false,
-      .idle_function = false,
+      .time_out_token = NULL,
       .no_flex_budge = false,
       .RAM_buffer = NULL, /* no flex block here */
       .bytes_received = 0,
@@ -786,12 +786,11 @@ CONST _kernel_oserror *loader3_receive_data(const WimpMessage *const message,
      DataSaveAck as recorded delivery breaks the SaveAs module, for one.)
      To prevent us leaking memory, we abandon stalled load operations after
      30 seconds. */
-  CONST _kernel_oserror *e = scheduler_register_delay(
-    time_out, load_op_data, DataLoadWaitTime, SchedulerPriority_Min);
+  CONST _kernel_oserror *e = scheduler_call_after(DataLoadWaitTime,
+    time_out, load_op_data, &load_op_data->time_out_token);
 
   if (e == NULL)
   {
-    load_op_data->idle_function = true;
 
     /* Can try RAM transfer (see if they support it) */
 
@@ -845,7 +844,7 @@ bool loader3_load_file(const char *const file_name, int const file_type,
 
   LoadOpData load_op_data = {
     .RAM_capable = false,
-    .idle_function = false,
+    .time_out_token = NULL,
     .no_flex_budge = false,
     .RAM_buffer = NULL, /* no flex block here */
     .bytes_received = 0,
@@ -66,6 +66,8 @@
   CJB: 06-Nov-19: Fixed failure to check the return value of fclose_dec()
                   and called _kernel_last_oserror() to reset the error
                   trap before writing to file in _svr_save_as_file().
+  CJB: 16-Oct-26: Cached catalogue information about the saved file is
+                  discarded.
 */
 
 /* ISO library headers */
@@ -103,6 +105,7 @@
 #include "Scheduler.h"
 #endif
 #include "FOpenCount.h"
+#include "CatCache.h"
 
 typedef struct
 {
@@ -722,6 +725,9 @@ static void _svr_save_as_file(SaveOpData *save_op_data, WimpMessage *message)
       {
         n = 0;
       }
+
+      /* Any cached size or date stamp of the file is now out of date */
+      catcache_invalidate(message->data.data_save_ack.leaf_name);
     }
 
     if (n != 1)
@@ -23,6 +23,10 @@
   CJB: 06-Nov-19: Fixed failure to check the return value of fclose_dec()
                   in save_file().
   CJB: 01-Nov-20: Assign a compound literal to initialise a save operation.
+  CJB: 16-Oct-26: Use scheduler_call_after to delay the DataLoad message
+                  in SLOW_TEST builds.
+  CJB: 16-Oct-26: Cached catalogue information about the saved file is
+                  discarded. Use set_file_type instead of os_file_set_type.
 */
 
 /* ISO library headers */
@@ -48,7 +52,6 @@
 
 /* CBOSLib headers */
 #include "MessTrans.h"
-#include "OSFile.h"
 
 /* Local headers */
 #include "Internal/CBMisc.h"
@@ -58,6 +61,8 @@
 #include "Scheduler.h"
 #endif
 #include "FOpenCount.h"
+#include "FileUtils.h"
+#include "CatCache.h"
 
 /* The following structure holds all the state for a given save operation */
 typedef struct
@@ -269,6 +274,9 @@ static bool save_file(SaveOpData *const save_op_data,
     success = false;
   }
 
+  /* Any cached size or date stamp of the file is now out of date */
+  catcache_invalidate(file_path);
+
   return success;
 }
 
@@ -307,8 +315,8 @@ static bool send_dataload(SaveOpData *const save_op_data,
   }
 
   CONST _kernel_oserror *e =
-    os_file_set_type(message->data.data_save_ack.leaf_name,
-                     message->data.data_save_ack.file_type);
+    set_file_type(message->data.data_save_ack.leaf_name,
+                  message->data.data_save_ack.file_type);
 
   if (e == NULL)
   {
@@ -325,6 +333,7 @@ static bool send_dataload(SaveOpData *const save_op_data,
   {
     failed(save_op_data, e);
     remove(message->data.data_save_ack.leaf_name);
+    catcache_invalidate(message->data.data_save_ack.leaf_name);
     return false;
   }
 
@@ -334,21 +343,15 @@ static bool send_dataload(SaveOpData *const save_op_data,
 /* ----------------------------------------------------------------------- */
 
 #ifdef SLOW_TEST
-static SchedulerTime delayed_dataload(void *const handle,
-  SchedulerTime time_now, const volatile bool *const time_up)
+static void delayed_dataload(void *const arg)
 {
-  SaveOpData *const save_op_data = handle;
-  assert(handle != NULL);
-  NOT_USED(time_up);
-
-  scheduler_deregister(delayed_dataload, handle);
+  SaveOpData *const save_op_data = arg;
+  assert(arg != NULL);
 
   if (!send_dataload(save_op_data, &save_op_data->datasaveack_msg))
   {
     destroy_op(save_op_data);
   }
-
-  return time_now;
 }
 #endif
 
@@ -541,10 +544,10 @@ static int datasaveack_handler(WimpMessage *const message,
 
 #ifdef SLOW_TEST
   save_op_data->datasaveack_msg = *message;
-  if (scheduler_register_delay(delayed_dataload,
-                               save_op_data,
-                               DataLoadDelay,
-                               SchedulerPriority_Min) != NULL)
+  if (scheduler_call_after(DataLoadDelay,
+                           delayed_dataload,
+                           save_op_data,
+                           NULL) != NULL)
 #endif /* SLOW_TEST */
   {
     if (!send_dataload(save_op_data, message))
@@ -67,10 +67,47 @@
                   _scheduler_client_has_callback(). This allows use of
                   scheduler_deregister() followed by scheduler_register()
                   (for the same client) in a SchedulerIdleFunction.
+  CJB: 16-Oct-26: Replaced the linked list of clients with a binary min-heap
+                  ordered by time of next invocation, so that the cost of
+                  handling a null event or finding the time of the next one
+                  no longer depends on the total number of clients.
+                  Clients removed whilst handling a null event are taken out
+                  of the heap immediately but not freed until afterwards.
+                  Added an optional fair-share policy, in which due clients
+                  are called in order of virtual time (their run time
+                  weighted by priority) rather than the time they became due.
+                  Added run-time statistics for each client and for the
+                  scheduler as a whole, with functions to read them.
+                  Time slices and statistics are now accounted in
+                  microseconds, and can optionally be measured with
+                  sub-centisecond precision using timer_read_monotonic.
+                  A single ticker event now runs for the whole of a null
+                  event instead of one being registered and removed for
+                  each client call. Unless fine timing is enabled, the time
+                  is read from its tick count instead of by SWI.
+                  Added an adaptive mode in which the time spent handling
+                  each null event is adjusted between given bounds,
+                  according to the time spent in other tasks and whether
+                  any clients were still due when our time ran out.
+                  Added functions to register clients in return for a
+                  token that allows them to be deregistered or rescheduled
+                  without a search, and to register or deregister many
+                  clients at once.
+                  Added scheduler_call_after, to call a function once
+                  after a delay.
+                  Due clients are called in turn even if they ask to be
+                  called at a time already past.
+                  Virtual time is now 64 bits wide, so that charging a
+                  low-priority client for a long overrun can't make it
+                  appear to be ahead of the other clients.
+                  With fine timing, each client's deadline is measured
+                  from the sub-centisecond time at which it was called
+                  instead of the last tick, so 'time_up' is never set early.
  */
 
 /* ISO library headers */
 #include <stdint.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
@@ -104,31 +141,90 @@ typedef struct
 }
 SchedulerClientCallback;
 
-typedef struct
+struct SchedulerQueue;
+
+typedef struct SchedulerClient
 {
-  LinkedListItem          list_item;
+  LinkedListItem          list_item;       /* Only used whilst removal is
+                                              pending */
+  struct SchedulerQueue  *queue;           /* Heap containing this client */
+  size_t                  queue_index;     /* Position in the heap */
+  unsigned int            seq;             /* Breaks ties between clients
+                                              with the same next_invocation */
   SchedulerTime           next_invocation; /* OS_ReadMonotonicTime of next
                                               invocation */
-  SchedulerTime           time_slice;      /* Normal runtime per invocation (in
-                                              centiseconds) */
-  SchedulerTime           next_time_slice; /* Runtime for next invocation */
-  bool                    removal_pending; /* Waiting to be removed from list?*/
+  int                     time_slice;      /* Normal runtime per invocation (in
+                                              microseconds) */
+  int                     next_time_slice; /* Runtime for next invocation */
+  int                     priority;        /* Weight for fair-share policy */
+  uint64_t                virtual_time;    /* Run time scaled by the inverse
+                                              of priority (fair-share policy
+                                              only) */
+  bool                    removal_pending; /* Waiting to be freed? */
   SchedulerClientCallback callback;
+  SchedulerClientStats    stats;
+  SchedulerCallAfterFunction *call_after; /* Function to call once, or NULL */
+  void                   *call_after_arg;
 }
 SchedulerClient;
 
+/* A point in time, as read by read_time */
 typedef struct
 {
-  SchedulerTime time_now, best_relative;
+  SchedulerTime centiseconds; /* OS_ReadMonotonicTime */
+  unsigned int  fine;         /* Microseconds (modulo 2^32) */
 }
-SchedulerFindEarliestData;
+SchedulerTimestamp;
 
-static LinkedList clients_list;
-static SchedulerClient *next_client;
-static SchedulerTime max_time_in_app;
-static volatile bool time_up;
-static bool defer_removals, removal_deferred, list_changed, initialised = false;
+typedef bool SchedulerQueueOrder(const SchedulerClient *, const SchedulerClient *);
+
+/* Binary min-heap of clients. Clients that compare equal are ordered by
+   sequence number, so that they are called in turn. */
+typedef struct SchedulerQueue
+{
+  SchedulerQueueOrder *is_before;
+  SchedulerClient    **clients;
+  size_t               count;
+  size_t               size;
+}
+SchedulerQueue;
+
+/* Constant numeric values */
+enum
+{
+  QueueMinSize      = 16, /* Initial number of elements allocated for the
+                             heap */
+  QueueGrowthFactor = 2,  /* Multiplier for heap size when full */
+  FairShareScale    = 2520, /* Lowest common multiple of all priorities, to
+                               make virtual time increments exact */
+  MaxCharge         = 1000000, /* Limit on run time charged for one call
+                                  under the fair-share policy, so that one
+                                  overrun isn't penalised for too long
+                                  (microseconds) */
+  MicrosecondsPerTick = 10000,
+  IdleGap           = 2, /* Maximum time between null events for the
+                            desktop to be considered idle (centiseconds) */
+  GrowthDivisor     = 4, /* Adaptive time slice grows by 1/4 when idle */
+  ShrinkDivisor     = 2  /* and shrinks by 1/2 when other tasks are busy */
+};
+
+/* Clients waiting until their time of next invocation. Under the fair-share
+   policy, clients are moved to another heap when they become due. */
+static SchedulerQueue clients_queue, ready_queue;
+static SchedulerPolicy policy;
+static uint64_t virtual_time; /* 64 bits because one charge scaled by
+                                 FairShareScale can exceed LONG_MAX */
+static LinkedList pending_list;
+static SchedulerClient *calling;
+static unsigned int next_seq;
+static SchedulerTime max_time_in_app, min_adaptive_time, max_adaptive_time;
+static SchedulerTimestamp last_exit_time;
+static bool adaptive, backlog;
+static TimerTicker ticker;
+static SchedulerTime ticker_base;
+static bool ticker_running, defer_removals, fine_timing, initialised = false;
 static unsigned int suspended, clients_count;
+static SchedulerStats totals;
 static MessagesFD *desc;
 #ifndef CBLIB_OBSOLETE
 static void (*report)(CONST _kernel_oserror *);
@@ -141,8 +237,29 @@ static void cancel_ticker(void);
 static WimpEventHandler _scheduler_null_handler;
 static void _scheduler_mask_nulls(bool mask);
 static CONST _kernel_oserror *lookup_error(const char *token);
-static LinkedListCallbackFn _scheduler_destroy_client, _scheduler_client_has_callback, _scheduler_find_earliest, _scheduler_destroy_pending;
+static LinkedListCallbackFn _scheduler_destroy_pending;
 static SchedulerClient *_scheduler_find_client(SchedulerClientCallback *callback);
+static void _scheduler_remove_client(SchedulerClient *client_data);
+static SchedulerClient *_scheduler_new_client(SchedulerIdleFunction *function, void *handle, SchedulerTime first_call, int priority);
+static void _scheduler_add_client(SchedulerClient *client_data);
+static void _scheduler_count_removal(void);
+static SchedulerIdleFunction _scheduler_call_once;
+static SchedulerClient *_scheduler_earliest(void);
+static void _scheduler_make_ready(SchedulerTime time_now);
+static void _scheduler_update_stats(SchedulerClientStats *stats, SchedulerTime due_time, const SchedulerTimestamp *pre_time, const SchedulerTimestamp *post_time, int time_slice, bool premature_rtn);
+static CONST _kernel_oserror *read_time(SchedulerTimestamp *time);
+static int to_microseconds(SchedulerTime centiseconds);
+static void _scheduler_adapt_time_slice(int gap);
+static SchedulerQueueOrder queue_is_before, queue_is_fairer;
+static void queue_init(SchedulerQueue *queue, SchedulerQueueOrder *is_before);
+#ifdef INCLUDE_FINALISATION_CODE
+static void queue_destroy(SchedulerQueue *queue);
+#endif
+static bool queue_reserve(SchedulerQueue *queue, size_t count);
+static void queue_insert(SchedulerQueue *queue, SchedulerClient *client_data);
+static void queue_remove(SchedulerQueue *queue, SchedulerClient *client_data);
+static void queue_update(SchedulerQueue *queue, SchedulerClient *client_data);
+static SchedulerClient *queue_peek(const SchedulerQueue *queue);
 
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
@@ -171,12 +288,19 @@ CONST _kernel_oserror *scheduler_initialise(
                                            _scheduler_null_handler,
                                            NULL));
   _scheduler_mask_nulls(true);
-  linkedlist_init(&clients_list);
-  next_client = NULL;
+  queue_init(&clients_queue, queue_is_before);
+  queue_init(&ready_queue, queue_is_fairer);
+  linkedlist_init(&pending_list);
+  policy = SchedulerPolicy_Deadline;
+  virtual_time = 0;
+  next_seq = 0;
   defer_removals = false;
+  fine_timing = false;
   suspended = clients_count = 0;
+  totals = (SchedulerStats){.null_events = 0, .time_in_app = 0};
   max_time_in_app = nice;
-  time_up = true;
+  adaptive = backlog = false;
+  ticker_running = false;
 
   /* Last-ditch effort to remove ticker event routine, if still pending
      when client program terminates */
@@ -198,8 +322,10 @@ CONST _kernel_oserror *scheduler_finalise(void)
 
   DEBUGF("Scheduler: Finalising\n");
 
-  /* Free the linked list of idle client handlers */
-  linkedlist_for_each(&clients_list, _scheduler_destroy_client, NULL);
+  /* Free the heaps of idle client handlers */
+  queue_destroy(&clients_queue);
+  queue_destroy(&ready_queue);
+  linkedlist_for_each(&pending_list, _scheduler_destroy_pending, NULL);
 
   if (!suspended && clients_count)
   {
@@ -227,6 +353,72 @@ void scheduler_set_time_slice(SchedulerTime nice)
 
   assert(initialised);
   max_time_in_app = nice;
+  adaptive = false;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_set_adaptive_time_slice(SchedulerTime min_nice,
+                                       SchedulerTime max_nice)
+{
+  DEBUGF("Scheduler: adapting time slice between %d and %d\n",
+        min_nice, max_nice);
+
+  assert(initialised);
+  assert(min_nice > 0);
+  assert(min_nice <= max_nice);
+
+  min_adaptive_time = min_nice;
+  max_adaptive_time = max_nice;
+  adaptive = true;
+
+  if (max_time_in_app < min_nice)
+    max_time_in_app = min_nice;
+  else if (max_time_in_app > max_nice)
+    max_time_in_app = max_nice;
+}
+
+/* ----------------------------------------------------------------------- */
+
+SchedulerTime scheduler_get_time_slice(void)
+{
+  assert(initialised);
+  return max_time_in_app;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_set_fine_timing(bool enable)
+{
+  DEBUGF("Scheduler: %sabling fine timing\n", enable ? "en" : "dis");
+
+  assert(initialised);
+  fine_timing = enable;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_set_policy(SchedulerPolicy new_policy)
+{
+  DEBUGF("Scheduler: changing policy from %d to %d\n", policy, new_policy);
+
+  assert(initialised);
+  assert(new_policy == SchedulerPolicy_Deadline ||
+         new_policy == SchedulerPolicy_FairShare);
+
+  if (new_policy == SchedulerPolicy_Deadline)
+  {
+    /* Return any clients that are already due to the main heap, from which
+       they will be called in order of their time of next invocation. */
+    for (SchedulerClient *client_data = queue_peek(&ready_queue);
+         client_data != NULL;
+         client_data = queue_peek(&ready_queue))
+    {
+      queue_remove(&ready_queue, client_data);
+      queue_insert(&clients_queue, client_data);
+    }
+  }
+  policy = new_policy;
 }
 
 /* ----------------------------------------------------------------------- */
@@ -244,19 +436,10 @@ CONST _kernel_oserror *scheduler_register_delay(SchedulerIdleFunction *function,
 
 CONST _kernel_oserror *scheduler_register(SchedulerIdleFunction *function, void *handle, SchedulerTime first_call, int priority)
 {
-  CONST _kernel_oserror *e = NULL;
-
   DEBUGF("Scheduler: request to register function (handle %p, time %d,"
         " priority %d)\n", handle, first_call, priority);
   assert(initialised);
 
-  /* Ensure that priority is within acceptable bounds */
-  assert(priority >= SchedulerPriority_Min && priority <= SchedulerPriority_Max);
-  if (priority < SchedulerPriority_Min)
-    priority = SchedulerPriority_Min;
-  else if (priority > SchedulerPriority_Max)
-    priority = SchedulerPriority_Max;
-
   /* Ensure that the proposed key (function pointer and handle) is unique */
   SchedulerClientCallback callback = {.funct = function, .arg = handle};
   const SchedulerClient *const client_data = _scheduler_find_client(&callback);
@@ -264,34 +447,91 @@ CONST _kernel_oserror *scheduler_register(SchedulerIdleFunction *function, void
   if (client_data != NULL)
     return NULL; /* already registered */
 
-  /* Create new record for timed function */
-  SchedulerClient *const new_record = malloc(sizeof(*new_record));
+  return scheduler_register_token(function, handle, first_call, priority,
+                                  NULL);
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *scheduler_register_token(SchedulerIdleFunction *function, void *handle, SchedulerTime first_call, int priority, SchedulerToken *token)
+{
+  assert(initialised);
+
+  /* Create new record for timed function, making sure that there is room
+     for it in the heap beforehand */
+  SchedulerClient *const new_record =
+    queue_reserve(&clients_queue, clients_count + 1) &&
+    queue_reserve(&ready_queue, clients_count + 1) ?
+      _scheduler_new_client(function, handle, first_call, priority) : NULL;
+
   if (new_record == NULL)
   {
     DEBUGF("Scheduler: Not enough memory to create record!\n");
+    return lookup_error("NoMem");
+  }
+
+  _scheduler_add_client(new_record);
+
+  if (token != NULL)
+    *token = new_record;
+
+  return NULL; /* no error */
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *scheduler_register_many(const SchedulerRegistration *registrations, size_t count, SchedulerToken *tokens)
+{
+  DEBUGF("Scheduler: request to register %zu functions\n", count);
+  assert(initialised);
+  assert(registrations != NULL || count == 0);
+
+  /* Make room in the heap for all of the new clients at once */
+  if (!queue_reserve(&clients_queue, clients_count + count) ||
+      !queue_reserve(&ready_queue, clients_count + count))
+  {
+    DEBUGF("Scheduler: Not enough memory to extend heap!\n");
+    return lookup_error("NoMem");
+  }
+
+  /* Create all of the new records before inserting any of them, so that
+     either all or none are registered */
+  SchedulerClient **const new_records = malloc(sizeof(*new_records) *
+                                               (count > 0 ? count : 1));
+  if (new_records == NULL)
+    return lookup_error("NoMem");
+
+  size_t n;
+  for (n = 0; n < count; ++n)
+  {
+    new_records[n] = _scheduler_new_client(registrations[n].function,
+                                           registrations[n].handle,
+                                           registrations[n].first_call,
+                                           registrations[n].priority);
+    if (new_records[n] == NULL)
+      break;
+  }
+
+  CONST _kernel_oserror *e = NULL;
+  if (n < count)
+  {
+    DEBUGF("Scheduler: Not enough memory to create records!\n");
+    while (n-- > 0)
+      free(new_records[n]);
+
     e = lookup_error("NoMem");
   }
   else
   {
-    *new_record = (SchedulerClient){
-      .removal_pending = false,
-      .time_slice = priority,
-      .next_time_slice = priority,
-      .callback = callback,
-      .next_invocation = first_call,
-    };
-
-    /* Enable null events if this is the first client */
-    DEBUGF("Scheduler: incrementing client count from %d\n", clients_count);
-    if (++clients_count == 1 && !suspended)
+    for (n = 0; n < count; ++n)
     {
-      _scheduler_mask_nulls(false);
+      _scheduler_add_client(new_records[n]);
+      if (tokens != NULL)
+        tokens[n] = new_records[n];
     }
-
-    /* Link new record onto head of our list */
-    linkedlist_insert(&clients_list, NULL, &new_record->list_item);
-    list_changed = true;
   }
+
+  free(new_records);
   return e;
 }
 
@@ -307,35 +547,105 @@ void scheduler_deregister(SchedulerIdleFunction *function, void *handle)
 
   if (client_data != NULL)
   {
-    /* We have found the associated record in the linked list */
-    if (defer_removals)
-    {
-      /* Not safe to delink record at this time */
-      DEBUGF("Scheduler: Deferring removal from list\n");
-      client_data->removal_pending = true;
-      removal_deferred = true;
-    }
-    else
-    {
-      _scheduler_destroy_client(&clients_list, &client_data->list_item, NULL);
-    }
+    /* We have found the associated record in the heap */
+    _scheduler_remove_client(client_data);
+    _scheduler_count_removal();
+    return;
+  }
+  assert("Not found in scheduler_deregister" == NULL);
+}
+
+/* ----------------------------------------------------------------------- */
 
-    assert(clients_count > 0);
-    if (!clients_count)
+void scheduler_deregister_token(SchedulerToken token)
+{
+  DEBUGF("Scheduler: Request to deregister token %p\n", (void *)token);
+  assert(initialised);
+  assert(token != NULL);
+
+  _scheduler_remove_client(token);
+  _scheduler_count_removal();
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_deregister_many(const SchedulerToken *tokens, size_t count)
+{
+  DEBUGF("Scheduler: Request to deregister %zu tokens\n", count);
+  assert(initialised);
+  assert(tokens != NULL || count == 0);
+
+  for (size_t n = 0; n < count; ++n)
+  {
+    scheduler_deregister_token(tokens[n]);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+CONST _kernel_oserror *scheduler_call_after(SchedulerTime delay, SchedulerCallAfterFunction *function, void *arg, SchedulerToken *token)
+{
+  DEBUGF("Scheduler: request to call function with arg %p after %d\n",
+        arg, delay);
+  assert(initialised);
+  assert(function != NULL);
+
+  SchedulerTime time_now;
+  ON_ERR_RTN_E(os_read_monotonic_time(&time_now));
+
+  SchedulerToken new_token;
+  ON_ERR_RTN_E(scheduler_register_token(_scheduler_call_once, NULL,
+                                        time_now + delay,
+                                        SchedulerPriority_Min, &new_token));
+
+  /* The client record is its own handle, so that it can find the function
+     to call */
+  new_token->callback.arg = new_token;
+  new_token->call_after = function;
+  new_token->call_after_arg = arg;
+
+  if (token != NULL)
+    *token = new_token;
+
+  return NULL; /* no error */
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_reschedule(SchedulerToken token, SchedulerTime next_call)
+{
+  DEBUGF("Scheduler: Request to reschedule token %p for time %d\n",
+        (void *)token, next_call);
+  assert(initialised);
+  assert(token != NULL);
+  assert(!token->removal_pending);
+
+  /* The return value of a function that is being called takes precedence */
+  if (token->removal_pending || token == calling)
+    return;
+
+  token->next_invocation = next_call;
+  token->seq = next_seq++;
+
+  if (token->queue == &ready_queue)
+  {
+    /* A client that is no longer due must wait in the other heap */
+    SchedulerTime time_now;
+    if (os_read_monotonic_time(&time_now) == NULL &&
+        next_call - time_now > 0)
     {
-      DEBUGF("Scheduler: Invalid client count!\n");
-      return;
+      queue_remove(&ready_queue, token);
+      queue_insert(&clients_queue, token);
     }
-
-    DEBUGF("Scheduler: Decrementing client count from %d\n", clients_count);
-    if (--clients_count == 0 && !suspended)
+    else
     {
-      _scheduler_mask_nulls(true);
+      queue_update(&ready_queue, token);
     }
-
-    return;
   }
-  assert("Not found in scheduler_deregister" == NULL);
+  else
+  {
+    queue_update(&clients_queue, token);
+  }
 }
 
 /* ----------------------------------------------------------------------- */
@@ -348,25 +658,19 @@ CONST _kernel_oserror *scheduler_poll(int *event_code, WimpPollBlock *poll_block
      be masked (in which case there is no reason to use event_poll_idle). */
   if (clients_count && !suspended)
   {
-    SchedulerFindEarliestData earliest;
-
-    /* Read the current time */
-    ON_ERR_RTN_E(os_read_monotonic_time(&earliest.time_now));
-
-    /* Find the earliest time that we want to receive a null event */
-    DEBUG_VERBOSEF("Scheduler: finding earliest time for next null event\n");
-    earliest.best_relative = INT32_MAX; /* far in the future */
-
-    linkedlist_for_each(&clients_list, _scheduler_find_earliest, &earliest);
+    /* The earliest time that we want to receive a null event is when the
+       first client is due (or now, if any clients are already due) */
+    const SchedulerClient *const earliest = _scheduler_earliest();
+    assert(earliest != NULL);
 
     /* Yield control to the window manager and tell it not to return with a
        null event before the next call to a client function is due. */
     DEBUG_VERBOSEF("Scheduler: calling event_poll_idle with time %d\n",
-           earliest.time_now + earliest.best_relative);
+           earliest->next_invocation);
 
     ON_ERR_RTN_E(event_poll_idle(event_code,
                                  poll_block,
-                                 earliest.time_now + earliest.best_relative,
+                                 earliest->next_invocation,
                                  poll_word));
   }
   else
@@ -408,6 +712,51 @@ void scheduler_suspend(void)
     _scheduler_mask_nulls(true);
 }
 
+/* ----------------------------------------------------------------------- */
+
+bool scheduler_get_stats(SchedulerIdleFunction *function, void *handle, SchedulerClientStats *stats)
+{
+  assert(initialised);
+  assert(stats != NULL);
+
+  SchedulerClientCallback callback = {.funct = function, .arg = handle};
+  const SchedulerClient *const client_data = _scheduler_find_client(&callback);
+  if (client_data == NULL)
+    return false;
+
+  *stats = client_data->stats;
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_for_each_client(SchedulerForEachFunction *callback, void *arg)
+{
+  assert(initialised);
+  assert(callback != NULL);
+
+  const SchedulerQueue *const queues[] = {&clients_queue, &ready_queue};
+  for (size_t q = 0; q < ARRAY_SIZE(queues); ++q)
+  {
+    for (size_t i = 0; i < queues[q]->count; ++i)
+    {
+      const SchedulerClient *const client_data = queues[q]->clients[i];
+      if (callback(client_data->callback.funct, client_data->callback.arg,
+                   &client_data->stats, arg))
+        return;
+    }
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+void scheduler_get_totals(SchedulerStats *stats)
+{
+  assert(initialised);
+  assert(stats != NULL);
+  *stats = totals;
+}
+
 /* ----------------------------------------------------------------------- */
 /*                         Private functions                               */
 
@@ -449,144 +798,223 @@ static int _scheduler_null_handler(int event_code, WimpPollBlock *event, IdBlock
   DEBUGF("Scheduler: handling null event (%u clients)\n", clients_count);
 
   /* Read the (approximate) time that the Wimp returned control to us */
-  SchedulerTime entry_time;
-  if (check_error(os_read_monotonic_time(&entry_time)))
+  SchedulerTimestamp entry_time;
+  if (check_error(read_time(&entry_time)))
     return 1; /* claim null event */
 
   if (suspended || !clients_count)
   {
     DEBUG_VERBOSEF("Scheduler: ignoring null event %s\n", suspended ? "(suspended)" : "");
+    backlog = false;
     return 0; /* pass on null event */
   }
 
-  /* We must not attempt to remove records from the linked list of
-     'idle' functions until it is safe to do so */
+  /* If clients were still due when we last ran out of time then null events
+     were not delayed on our behalf, so the time since then was spent in
+     other tasks */
+  if (adaptive && backlog)
+    _scheduler_adapt_time_slice((int)(entry_time.fine - last_exit_time.fine));
+
+  backlog = false;
+
+  /* Start a ticker event that runs until we return to the Wimp. Each
+     client's deadline is set by updating a word that the ticker compares
+     with its tick count, so that a client that returns early costs no OS
+     calls. */
+  if (check_error(timer_ticker_start(&ticker)))
+    return 1; /* claim null event */
+
+  ticker_base = entry_time.centiseconds;
+  ticker_running = true;
+
+  /* We must not attempt to free records for 'idle' functions until it is
+     safe to do so */
   defer_removals = true;
-  removal_deferred = false;
 
   /* Call any registered 'idle' client functions until our program's
      time slice has expired (or all functions are blocking) */
-  SchedulerClient const *last_called = NULL;
+  SchedulerClient *client = NULL;
+  SchedulerTimestamp exit_time = entry_time;
+  int const max_time = to_microseconds(max_time_in_app);
   while (clients_count)
   {
-    if (next_client == NULL)
-    {
-      /* We have lost our place in the list, or reached the end */
-      DEBUG_VERBOSEF("Scheduler: returning to head of client list\n");
-      LinkedListItem *const head = linkedlist_get_head(&clients_list);
-      if (head == NULL)
-      {
-        DEBUGF("Scheduler: client list is empty!\n");
-        break; /* paranoia */
-      }
-      next_client = CONTAINER_OF(head, SchedulerClient, list_item);
-    }
-
     /* Calculate how long before our task must cede control to the Wimp */
-    SchedulerTime pre_time;
-    if (check_error(os_read_monotonic_time(&pre_time)))
+    SchedulerTimestamp pre_time;
+    if (check_error(read_time(&pre_time)))
       break;
 
-    SchedulerTime const time_left = max_time_in_app - (pre_time - entry_time);
-    DEBUGF("Scheduler: %d centiseconds remain\n", time_left);
+    exit_time = pre_time;
+
+    int const time_left = max_time - (int)(pre_time.fine - entry_time.fine);
+    DEBUGF("Scheduler: %d microseconds remain\n", time_left);
     if (time_left <= 0)
     {
+      backlog = true;
       break; /* out of time! */
     }
 
-    DEBUGF("Scheduler: client %p with arg %p and desired run time %d is ready at %d (time now: %d)\n",
-           (void *)next_client, (void *)next_client->callback.arg, next_client->next_time_slice,
-           next_client->next_invocation, pre_time);
-
-    if (!next_client->removal_pending &&
-        next_client->next_invocation - pre_time <= 0)
+    if (client == NULL)
     {
-      DEBUGF("Scheduler: function with arg %p and desired run time %d has been ready since %d\n",
-            next_client->callback.arg, next_client->next_time_slice, next_client->next_invocation);
-
-      /* Register a background ticker event to set a boolean flag when
-         it is time for the client function to return. */
-      time_up = false;
+      if (policy == SchedulerPolicy_FairShare)
+      {
+        /* The due client with the lowest virtual time is the one that has
+           had least CPU time relative to its priority */
+        _scheduler_make_ready(pre_time.centiseconds);
+        client = queue_peek(&ready_queue);
+        if (client != NULL)
+          virtual_time = client->virtual_time;
+      }
+      else
+      {
+        /* The client at the top of the heap has been ready for longest */
+        client = queue_peek(&clients_queue);
+      }
 
-      CONST _kernel_oserror *err = timer_register(&time_up,
-                           time_left < next_client->next_time_slice ?
-                             time_left : next_client->next_time_slice);
-      if (check_error(err))
+      if (client == NULL ||
+          client->next_invocation - pre_time.centiseconds > 0)
       {
-        DEBUGF("Scheduler: could not set up timer event!\n");
-        time_up = true;
+        DEBUGF("Scheduler: no client functions ready\n");
         break;
       }
+    }
+
+    DEBUGF("Scheduler: function with arg %p and desired run time %d has been ready since %d (time now: %d)\n",
+          client->callback.arg, client->next_time_slice, client->next_invocation, pre_time.centiseconds);
+
+    /* Set the deadline at which the ticker will set a boolean flag to
+       tell the client function to return. Ticks have a resolution of
+       one centisecond, so round up. With fine timing, the deadline is
+       measured from the time just read rather than the last tick. */
+    int const time_slice = time_left < client->next_time_slice ?
+                           time_left : client->next_time_slice;
+
+    if (fine_timing)
+    {
+      timer_ticker_set_fine(&ticker, time_slice,
+        pre_time.fine - (unsigned)pre_time.centiseconds * MicrosecondsPerTick);
+    }
+    else
+    {
+      timer_ticker_set(&ticker,
+        (time_slice + MicrosecondsPerTick - 1) / MicrosecondsPerTick);
+    }
 
-      /* Call the client function */
-      next_client->next_invocation = next_client->callback.funct(
-                                       next_client->callback.arg,
-                                       pre_time,
-                                       &time_up);
-      last_called = next_client;
-      bool const premature_rtn = !time_up;
+    /* Call the client function */
+    calling = client;
+    SchedulerTime const next_invocation = client->callback.funct(
+                                            client->callback.arg,
+                                            pre_time.centiseconds,
+                                            &ticker.time_up);
+    calling = NULL;
+    bool const premature_rtn = !ticker.time_up;
 
-      SchedulerTime post_time;
-      err = os_read_monotonic_time(&post_time);
+    SchedulerTimestamp post_time;
+    CONST _kernel_oserror *const err = read_time(&post_time);
 
-      /* Remove ticker event if it is still pending
-         (i.e. if client function returned prematurely) */
-      cancel_ticker();
+    DEBUGF("Scheduler: client function returned %d%s\n",
+           next_invocation, premature_rtn ? " (premature return)" : "");
 
-      DEBUGF("Scheduler: client function returned %d%s\n",
-             next_client->next_invocation,
-             premature_rtn ? " (premature return)" : "");
+    if (err == NULL)
+    {
+      exit_time = post_time;
+      _scheduler_update_stats(&client->stats, client->next_invocation,
+                              &pre_time, &post_time, time_slice,
+                              premature_rtn);
+    }
+    else
+    {
+      post_time = pre_time; /* no time can be accounted */
+    }
 
+    if (client->removal_pending)
+    {
+      /* The client deregistered itself, so it is no longer in the heap */
+      client = NULL;
       if (check_error(err))
         break;
 
-      if (!next_client->removal_pending)
-      {
-        SchedulerTime const elapsed = post_time - pre_time;
-        DEBUGF("Scheduler: function ran for %d ticks\n", elapsed);
-
-        /* If the client function returned before its allocated time slice had
-           expired, yet it does not want to sleep, then we will call it back
-           A.S.A.P. to complete. (Typically happens to the last function called
-           before we return from this event handler.) */
-        if (elapsed < next_client->next_time_slice &&
-            post_time - next_client->next_invocation >= 0)
-        {
-          /* Reduce the time slice for the next invocation of this function by
-             the time elapsed during this invocation */
-          next_client->next_time_slice -= elapsed;
-
-          DEBUGF("Scheduler: will call it back A.S.A.P. for remaining %d ticks\n",
-                next_client->next_time_slice);
-
-          continue; /* Do not advance to next record in linked list */
-        }
-
-        /* Revert to normal run time for next invocation */
-        next_client->next_time_slice = next_client->time_slice;
-      }
+      continue;
     }
-    else
+
+    int const elapsed = (int)(post_time.fine - pre_time.fine);
+    DEBUGF("Scheduler: function ran for %d microseconds\n", elapsed);
+
+    /* Move the client to its new position in the heap. A client that asks
+       to be called at a time already past is treated as due now, so that
+       it goes behind other due clients instead of being called again
+       before them. */
+    client->next_invocation = next_invocation - post_time.centiseconds < 0 ?
+                              post_time.centiseconds : next_invocation;
+    client->seq = next_seq++;
+    if (client->queue == &ready_queue)
     {
-      /* If we have traversed the entire client list without calling any
-         functions then we are wasting time that other tasks could use */
-      if (next_client == last_called)
+      /* Charge the client for at least one unit of time, otherwise a
+         function that always returns quickly would never yield to other
+         due clients */
+      int const min_charge = fine_timing ? 1 : MicrosecondsPerTick;
+      int const charge = elapsed < min_charge ? min_charge :
+                         elapsed > MaxCharge ? MaxCharge : elapsed;
+
+      client->virtual_time += (uint64_t)charge *
+                              (FairShareScale / (unsigned)client->priority);
+
+      if (client->next_invocation - post_time.centiseconds > 0)
       {
-        DEBUGF("Scheduler: no client functions ready\n");
-        break;
+        /* The client wants to sleep */
+        queue_remove(&ready_queue, client);
+        queue_insert(&clients_queue, client);
+      }
+      else
+      {
+        queue_update(&ready_queue, client);
       }
+
+      client->next_time_slice = client->time_slice;
+      client = NULL;
+      if (check_error(err))
+        break;
+
+      continue; /* Virtual time decides which client to call next */
     }
+    queue_update(&clients_queue, client);
 
-    LinkedListItem *const next = linkedlist_get_next(&next_client->list_item);
-    next_client = next ? CONTAINER_OF(next, SchedulerClient, list_item) : NULL;
+    if (check_error(err))
+      break;
+
+    /* If the client function returned before its allocated time slice had
+       expired, yet it does not want to sleep, then we will call it back
+       A.S.A.P. to complete. (Typically happens to the last function called
+       before we return from this event handler.) */
+    if (elapsed < client->next_time_slice &&
+        post_time.centiseconds - client->next_invocation >= 0)
+    {
+      /* Reduce the time slice for the next invocation of this function by
+         the time elapsed during this invocation */
+      client->next_time_slice -= elapsed;
+
+      DEBUGF("Scheduler: will call it back A.S.A.P. for remaining %d microseconds\n",
+            client->next_time_slice);
+
+      continue; /* Do not pick the next client from the heap */
+    }
+
+    /* Revert to normal run time for next invocation */
+    client->next_time_slice = client->time_slice;
+    client = NULL;
   }
 
+  cancel_ticker();
+
+  last_exit_time = exit_time;
+  totals.null_events++;
+  totals.time_in_app += exit_time.fine - entry_time.fine;
+
   /* Do any deferred removals of 'idle' functions */
   defer_removals = false;
-  if (removal_deferred)
+  if (linkedlist_get_head(&pending_list) != NULL)
   {
     DEBUGF("Scheduler: Doing deferred removals\n");
-    linkedlist_for_each(&clients_list, _scheduler_destroy_pending, NULL);
+    linkedlist_for_each(&pending_list, _scheduler_destroy_pending, NULL);
   }
 
   DEBUG_VERBOSEF("Scheduler: exiting null event handler\n");
@@ -595,15 +1023,41 @@ static int _scheduler_null_handler(int event_code, WimpPollBlock *event, IdBlock
 
 /* ----------------------------------------------------------------------- */
 
+static void _scheduler_adapt_time_slice(int gap)
+{
+  /* If other tasks are idle then we can take more time without hurting
+     the desktop's responsiveness. If other tasks took longer than we did
+     then take less, to reduce their latency. */
+  DEBUGF("Scheduler: %d microseconds since last null event\n", gap);
+
+  if (gap <= to_microseconds(IdleGap))
+  {
+    SchedulerTime const step = max_time_in_app / GrowthDivisor;
+    max_time_in_app += step > 0 ? step : 1;
+    if (max_time_in_app > max_adaptive_time)
+      max_time_in_app = max_adaptive_time;
+  }
+  else if (gap > to_microseconds(max_time_in_app))
+  {
+    SchedulerTime const step = max_time_in_app / ShrinkDivisor;
+    max_time_in_app -= step > 0 ? step : 1;
+    if (max_time_in_app < min_adaptive_time)
+      max_time_in_app = min_adaptive_time;
+  }
+
+  DEBUGF("Scheduler: time slice is now %d\n", max_time_in_app);
+}
+
+/* ----------------------------------------------------------------------- */
+
 static void cancel_ticker(void)
 {
-  if (!time_up)
+  if (ticker_running)
   {
-    DEBUGF("Scheduler: cancelling pending ticker event\n");
-    timer_deregister(&time_up);
-    time_up = true;
+    DEBUGF("Scheduler: cancelling ticker event after %d ticks\n", ticker.ticks);
+    ticker_running = false;
+    (void)timer_ticker_stop(&ticker);
   }
-  /* (suppress errors, as event may occur between check and removal) */
 }
 
 /* ----------------------------------------------------------------------- */
@@ -631,98 +1085,465 @@ static SchedulerClient *_scheduler_find_client(SchedulerClientCallback *callback
   assert(callback != NULL);
   DEBUGF("Scheduler: Searching for client with function arg %p\n", callback->arg);
 
-  LinkedListItem *const item = linkedlist_for_each(
-                    &clients_list, _scheduler_client_has_callback, callback);
+  /* Clients for which removal is pending are not in either heap */
+  SchedulerQueue *const queues[] = {&clients_queue, &ready_queue};
+  for (size_t q = 0; q < ARRAY_SIZE(queues); ++q)
+  {
+    for (size_t i = 0; i < queues[q]->count; ++i)
+    {
+      SchedulerClient *const client_data = queues[q]->clients[i];
+      if (callback->funct == client_data->callback.funct &&
+          callback->arg == client_data->callback.arg)
+      {
+        DEBUGF("Scheduler: Record %p has matching callback\n", (void *)client_data);
+        return client_data;
+      }
+    }
+  }
+
+  DEBUGF("Scheduler: End of heap (no match)\n");
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
 
-  if (item == NULL)
+static void _scheduler_remove_client(SchedulerClient *client_data)
+{
+  assert(client_data != NULL);
+  assert(!client_data->removal_pending);
+
+  queue_remove(client_data->queue, client_data);
+
+  if (defer_removals)
   {
-    DEBUGF("Scheduler: End of linked list (no match)\n");
-    return NULL;
+    /* Not safe to free record at this time */
+    DEBUGF("Scheduler: Deferring removal\n");
+    client_data->removal_pending = true;
+    linkedlist_insert(&pending_list, NULL, &client_data->list_item);
   }
+  else
+  {
+    DEBUGF("Scheduler: Freeing record for function\n");
+    free(client_data);
+  }
+}
 
-  SchedulerClient *const client_data = CONTAINER_OF(item, SchedulerClient, list_item);
-  DEBUGF("Scheduler: Record %p has matching callback\n", (void *)client_data);
-  return client_data;
+/* ----------------------------------------------------------------------- */
+
+static SchedulerClient *_scheduler_new_client(SchedulerIdleFunction *function, void *handle, SchedulerTime first_call, int priority)
+{
+  /* Ensure that priority is within acceptable bounds */
+  assert(priority >= SchedulerPriority_Min && priority <= SchedulerPriority_Max);
+  if (priority < SchedulerPriority_Min)
+    priority = SchedulerPriority_Min;
+  else if (priority > SchedulerPriority_Max)
+    priority = SchedulerPriority_Max;
+
+  SchedulerClient *const new_record = malloc(sizeof(*new_record));
+  if (new_record != NULL)
+  {
+    *new_record = (SchedulerClient){
+      .removal_pending = false,
+      .time_slice = to_microseconds(priority),
+      .next_time_slice = to_microseconds(priority),
+      .priority = priority,
+      .virtual_time = virtual_time,
+      .callback = {.funct = function, .arg = handle},
+      .stats = {
+        .invocations = 0,
+        .premature_returns = 0,
+        .overruns = 0,
+        .total_time = 0,
+        .max_time = 0,
+        .total_lateness = 0,
+        .max_lateness = 0,
+      },
+      .next_invocation = first_call,
+      .seq = next_seq++,
+      .call_after = NULL,
+      .call_after_arg = NULL,
+    };
+  }
+  return new_record;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static bool _scheduler_destroy_client(LinkedList *list, LinkedListItem *item, void *arg)
+static void _scheduler_add_client(SchedulerClient *client_data)
+{
+  assert(client_data != NULL);
+
+  /* Enable null events if this is the first client */
+  DEBUGF("Scheduler: incrementing client count from %d\n", clients_count);
+  if (++clients_count == 1 && !suspended)
+  {
+    _scheduler_mask_nulls(false);
+  }
+
+  /* Insert new record into our heap (for which room must already have been
+     reserved) */
+  queue_insert(&clients_queue, client_data);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void _scheduler_count_removal(void)
+{
+  assert(clients_count > 0);
+  if (!clients_count)
+  {
+    DEBUGF("Scheduler: Invalid client count!\n");
+    return;
+  }
+
+  DEBUGF("Scheduler: Decrementing client count from %d\n", clients_count);
+  if (--clients_count == 0 && !suspended)
+  {
+    _scheduler_mask_nulls(true);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SchedulerTime _scheduler_call_once(void *handle, SchedulerTime time_now, const volatile bool *time_up)
+{
+  SchedulerClient *const client_data = handle;
+  assert(client_data != NULL);
+  assert(client_data->call_after != NULL);
+  NOT_USED(time_up);
+
+  /* Deregister first, so that the function may register itself again */
+  SchedulerCallAfterFunction *const function = client_data->call_after;
+  void *const arg = client_data->call_after_arg;
+  scheduler_deregister_token(client_data);
+
+  function(arg);
+
+  return time_now; /* ignored because already deregistered */
+}
+
+/* ----------------------------------------------------------------------- */
+
+static bool _scheduler_destroy_pending(LinkedList *list, LinkedListItem *item, void *arg)
 {
   SchedulerClient * const client_data = CONTAINER_OF(item, SchedulerClient, list_item);
   NOT_USED(arg);
 
   DEBUGF("Scheduler: Freeing record for function\n");
+  assert(client_data->removal_pending);
+  linkedlist_remove(list, &client_data->list_item);
+  free(client_data);
+
+  return false; /* next item */
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SchedulerClient *_scheduler_earliest(void)
+{
+  /* Any client in the fair-share heap is already due */
+  SchedulerClient *const client_data = queue_peek(&ready_queue);
+  return client_data != NULL ? client_data : queue_peek(&clients_queue);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void _scheduler_make_ready(SchedulerTime time_now)
+{
+  /* Move clients that have become due to the fair-share heap. Only the
+     clients that are due need to be visited. */
+  for (SchedulerClient *client_data = queue_peek(&clients_queue);
+       client_data != NULL && client_data->next_invocation - time_now <= 0;
+       client_data = queue_peek(&clients_queue))
+  {
+    /* Don't let clients that were asleep accumulate credit for when they
+       become due, otherwise they could monopolise the CPU */
+    if (client_data->virtual_time < virtual_time)
+      client_data->virtual_time = virtual_time;
+
+    DEBUGF("Scheduler: function with arg %p is ready (virtual time %lu)\n",
+           client_data->callback.arg,
+           (unsigned long)client_data->virtual_time);
+
+    queue_remove(&clients_queue, client_data);
+    queue_insert(&ready_queue, client_data);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
 
-  /* If we are about to remove the client to be called on the next null
-     event then bring forward the next client instead */
-  if (next_client == client_data)
+static void _scheduler_update_stats(SchedulerClientStats *stats, SchedulerTime due_time, const SchedulerTimestamp *pre_time, const SchedulerTimestamp *post_time, int time_slice, bool premature_rtn)
+{
+  assert(stats != NULL);
+  assert(pre_time != NULL);
+  assert(post_time != NULL);
+
+  stats->invocations++;
+  if (premature_rtn)
+    stats->premature_returns++;
+
+  int const elapsed = (int)(post_time->fine - pre_time->fine);
+  stats->total_time += (unsigned)elapsed;
+  if (elapsed > stats->max_time)
+    stats->max_time = elapsed;
+
+  /* The client overran if it was still running a whole tick after the
+     'time_up' flag was set */
+  if (elapsed > time_slice + MicrosecondsPerTick)
+    stats->overruns++;
+
+  int const lateness = (int)(pre_time->fine -
+                             (unsigned)due_time * MicrosecondsPerTick);
+  if (lateness > 0)
   {
-    LinkedListItem *const next = linkedlist_get_next(&client_data->list_item);
-    if (next != NULL)
+    stats->total_lateness += (unsigned)lateness;
+    if (lateness > stats->max_lateness)
+      stats->max_lateness = lateness;
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static CONST _kernel_oserror *read_time(SchedulerTimestamp *time)
+{
+  assert(time != NULL);
+
+  if (fine_timing)
+  {
+    unsigned int microseconds;
+    ON_ERR_RTN_E(timer_read_monotonic(&time->centiseconds, &microseconds));
+    time->fine = (unsigned)time->centiseconds * MicrosecondsPerTick +
+                 microseconds;
+  }
+  else
+  {
+    if (ticker_running)
     {
-      next_client = CONTAINER_OF(next, SchedulerClient, list_item);
-      DEBUGF("Scheduler: Promoting client with function arg %p\n", next_client->callback.arg);
+      /* The ticker is called on the same interrupt that increments the
+         monotonic time, so its tick count tracks that time */
+      time->centiseconds = ticker_base + ticker.ticks;
     }
     else
     {
-      next_client = NULL;
+      ON_ERR_RTN_E(os_read_monotonic_time(&time->centiseconds));
     }
+    time->fine = (unsigned)time->centiseconds * MicrosecondsPerTick;
   }
-  linkedlist_remove(list, &client_data->list_item);
-  free(client_data);
+  return NULL; /* no error */
+}
 
-  return false; /* next item */
+/* ----------------------------------------------------------------------- */
+
+static int to_microseconds(SchedulerTime centiseconds)
+{
+  /* Prevent overflow on multiply */
+  if (centiseconds > INT_MAX / MicrosecondsPerTick)
+    return INT_MAX / MicrosecondsPerTick * MicrosecondsPerTick;
+
+  return centiseconds < 0 ? 0 : centiseconds * MicrosecondsPerTick;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static bool _scheduler_destroy_pending(LinkedList *list, LinkedListItem *item, void *arg)
+static bool queue_is_before(const SchedulerClient *a, const SchedulerClient *b)
 {
-  SchedulerClient * const client_data = CONTAINER_OF(item, SchedulerClient, list_item);
+  /* Compare times using subtraction to allow for wrap-around */
+  SchedulerTime const diff = a->next_invocation - b->next_invocation;
+  if (diff != 0)
+    return diff < 0;
+
+  return (int)(a->seq - b->seq) < 0;
+}
 
-  if (client_data->removal_pending)
-    return _scheduler_destroy_client(list, item, arg);
+/* ----------------------------------------------------------------------- */
 
-  return false; /* next item */
+static bool queue_is_fairer(const SchedulerClient *a, const SchedulerClient *b)
+{
+  /* Virtual time is too wide to wrap around in practice, so it can be
+     compared directly */
+  if (a->virtual_time != b->virtual_time)
+    return a->virtual_time < b->virtual_time;
+
+  return (int)(a->seq - b->seq) < 0;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static bool _scheduler_client_has_callback(LinkedList *list, LinkedListItem *item, void *arg)
+static void queue_init(SchedulerQueue *queue, SchedulerQueueOrder *is_before)
 {
-  const SchedulerClient * const client_data = CONTAINER_OF(item, SchedulerClient, list_item);
-  const SchedulerClientCallback * const callback = arg;
-  assert(callback != NULL);
-  NOT_USED(list);
+  assert(queue != NULL);
+  assert(is_before != NULL);
+  *queue = (SchedulerQueue){
+    .is_before = is_before,
+    .clients = NULL,
+    .count = 0,
+    .size = 0,
+  };
+}
+
+/* ----------------------------------------------------------------------- */
+
+#ifdef INCLUDE_FINALISATION_CODE
+static void queue_destroy(SchedulerQueue *queue)
+{
+  assert(queue != NULL);
+  for (size_t i = 0; i < queue->count; ++i)
+  {
+    free(queue->clients[i]);
+  }
+  free(queue->clients);
+  queue_init(queue, queue->is_before);
+}
+#endif
+
+/* ----------------------------------------------------------------------- */
+
+static void queue_set(SchedulerQueue *queue, size_t index, SchedulerClient *client_data)
+{
+  assert(queue != NULL);
+  assert(index < queue->count);
+  assert(client_data != NULL);
 
-  /* Check whether this client is for callbacks to the specified
-     function with the specified handle */
-  return (callback->funct == client_data->callback.funct &&
-          callback->arg == client_data->callback.arg &&
-          !client_data->removal_pending);
+  queue->clients[index] = client_data;
+  client_data->queue = queue;
+  client_data->queue_index = index;
 }
 
 /* ----------------------------------------------------------------------- */
 
-static bool _scheduler_find_earliest(LinkedList *list, LinkedListItem *item, void *arg)
+static void queue_sift_up(SchedulerQueue *queue, size_t index)
 {
-  const SchedulerClient * const client_data = CONTAINER_OF(item, SchedulerClient, list_item);
-  SchedulerFindEarliestData * const earliest = arg;
-  assert(earliest != NULL);
-  NOT_USED(list);
+  assert(queue != NULL);
+  assert(index < queue->count);
+  SchedulerClient *const client_data = queue->clients[index];
 
-  if (!client_data->removal_pending)
+  while (index > 0)
   {
-    const SchedulerTime this_relative = client_data->next_invocation -
-                                        earliest->time_now;
+    size_t const parent = (index - 1) / 2;
+    if (!queue->is_before(client_data, queue->clients[parent]))
+      break;
+
+    queue_set(queue, index, queue->clients[parent]);
+    index = parent;
+  }
+  queue_set(queue, index, client_data);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void queue_sift_down(SchedulerQueue *queue, size_t index)
+{
+  assert(queue != NULL);
+  assert(index < queue->count);
+  SchedulerClient *const client_data = queue->clients[index];
+
+  for (;;)
+  {
+    size_t child = (index * 2) + 1;
+    if (child >= queue->count)
+      break;
 
-    DEBUG_VERBOSEF("Scheduler: function is due at %d (diff %d)\n",
-           client_data->next_invocation, this_relative);
+    /* Choose the earlier of the two children */
+    if (child + 1 < queue->count &&
+        queue->is_before(queue->clients[child + 1], queue->clients[child]))
+      ++child;
 
-    if (this_relative < earliest->best_relative)
-      earliest->best_relative = this_relative;
+    if (!queue->is_before(queue->clients[child], client_data))
+      break;
+
+    queue_set(queue, index, queue->clients[child]);
+    index = child;
   }
+  queue_set(queue, index, client_data);
+}
 
-  return false; /* next item */
+/* ----------------------------------------------------------------------- */
+
+static bool queue_reserve(SchedulerQueue *queue, size_t count)
+{
+  assert(queue != NULL);
+  assert(queue->count <= queue->size);
+
+  if (count > queue->size)
+  {
+    size_t new_size = queue->size ? queue->size : QueueMinSize;
+    while (new_size < count)
+      new_size *= QueueGrowthFactor;
+
+    DEBUGF("Scheduler: extending heap from %zu to %zu clients\n",
+           queue->size, new_size);
+
+    SchedulerClient **const new_clients = realloc(queue->clients,
+                                            sizeof(*new_clients) * new_size);
+    if (new_clients == NULL)
+    {
+      DEBUGF("Scheduler: Not enough memory to extend heap!\n");
+      return false;
+    }
+    queue->clients = new_clients;
+    queue->size = new_size;
+  }
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void queue_insert(SchedulerQueue *queue, SchedulerClient *client_data)
+{
+  assert(queue != NULL);
+  assert(client_data != NULL);
+  assert(queue->count < queue->size);
+
+  queue_set(queue, queue->count++, client_data);
+  queue_sift_up(queue, client_data->queue_index);
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void queue_remove(SchedulerQueue *queue, SchedulerClient *client_data)
+{
+  assert(queue != NULL);
+  assert(client_data != NULL);
+  size_t const index = client_data->queue_index;
+  assert(index < queue->count);
+  assert(queue->clients[index] == client_data);
+
+  /* Fill the hole with the last element, then restore the heap property */
+  SchedulerClient *const last = queue->clients[--queue->count];
+  if (last != client_data)
+  {
+    queue_set(queue, index, last);
+    queue_update(queue, last);
+  }
+  client_data->queue = NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+
+static void queue_update(SchedulerQueue *queue, SchedulerClient *client_data)
+{
+  assert(queue != NULL);
+  assert(client_data != NULL);
+  size_t const index = client_data->queue_index;
+  assert(index < queue->count);
+  assert(queue->clients[index] == client_data);
+
+  /* The client may have to move towards the root or the leaves */
+  if (index > 0 &&
+      queue->is_before(client_data, queue->clients[(index - 1) / 2]))
+  {
+    queue_sift_up(queue, index);
+  }
+  else
+  {
+    queue_sift_down(queue, index);
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+
+static SchedulerClient *queue_peek(const SchedulerQueue *queue)
+{
+  assert(queue != NULL);
+  return queue->count > 0 ? queue->clients[0] : NULL;
 }
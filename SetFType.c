@@ -24,6 +24,7 @@
   CJB: 05-May-12: Added support for stress-testing failure of _kernel_osfile.
   CJB: 18-Apr-15: Assertions are now provided by debug.h.
   CJB: 29-May-16: Functionality is now delegated to FileSType.c.
+  CJB: 16-Oct-26: Cached catalogue information about the file is discarded.
  */
 
 /* ISO library headers */
@@ -38,11 +39,13 @@
 /* Local headers */
 #include "Internal/CBMisc.h"
 #include "FileUtils.h"
+#include "CatCache.h"
 
 /* ----------------------------------------------------------------------- */
 /*                         Public functions                                */
 
 CONST _kernel_oserror *set_file_type(const char *f, int type)
 {
+  catcache_invalidate(f);
   return os_file_set_type(f, type);
 }
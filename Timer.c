@@ -22,10 +22,17 @@
   CJB: 07-Jun-16: Prevented interception of _kernel_swi for error simulation
                   in timer_deregister because it's dangerous to interfere
                   with ticker event deregistration.
+  CJB: 16-Oct-26: Added timer_read_monotonic, which uses the HAL counter to
+                  read the monotonic time with sub-centisecond precision.
+  CJB: 16-Oct-26: Added functions to manage a persistent ticker with a
+                  deadline that can be reset without making OS calls.
+  CJB: 16-Oct-26: Added timer_ticker_set_fine, which sets a deadline in
+                  microseconds relative to the phase of the ticker.
  */
 
 /* ISO library headers */
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Acorn C/C++ library headers */
 #include "kernel.h"
@@ -35,7 +42,86 @@
 #include "Internal/CBMisc.h"
 #include "Timer.h"
 
+/* Constant numeric values */
+enum
+{
+  OS_Hardware_CallHAL  = 0,  /* OS_Hardware reason code */
+  HAL_CounterPeriod    = 20, /* HAL entry numbers */
+  HAL_CounterRead      = 21,
+  MicrosecondsPerTick  = 10000,
+  CounterPeriodUnknown = 0,
+  CounterUnavailable   = -1
+};
+
 extern void timer_set_flag(void);
+extern void timer_advance(void);
+
+/* Period of the HAL counter (in counter ticks per centisecond), or one of
+   the special values above */
+static int counter_period = CounterPeriodUnknown;
+
+static CONST _kernel_oserror *call_hal(int entry, int *result)
+{
+  _kernel_swi_regs regs;
+  regs.r[8] = OS_Hardware_CallHAL;
+  regs.r[9] = entry;
+  CONST _kernel_oserror *const e = _kernel_swi(OS_Hardware, &regs, &regs);
+  if (e == NULL)
+    *result = regs.r[0];
+
+  return e;
+}
+
+static CONST _kernel_oserror *read_monotonic_time(int *centiseconds)
+{
+  _kernel_swi_regs regs;
+  CONST _kernel_oserror *const e = _kernel_swi(OS_ReadMonotonicTime,
+                                               &regs, &regs);
+  if (e == NULL)
+    *centiseconds = regs.r[0];
+
+  return e;
+}
+
+CONST _kernel_oserror *timer_read_monotonic(int *centiseconds,
+                                            unsigned int *microseconds)
+{
+  if (counter_period == CounterPeriodUnknown)
+  {
+    /* Older versions of RISC OS have no HAL, in which case we can only
+       read the centisecond timer. */
+    int period;
+    if (call_hal(HAL_CounterPeriod, &period) != NULL || period <= 0)
+      counter_period = CounterUnavailable;
+    else
+      counter_period = period;
+  }
+
+  if (counter_period == CounterUnavailable)
+  {
+    *microseconds = 0;
+    return read_monotonic_time(centiseconds);
+  }
+
+  /* The counter counts down from (period - 1) to 0 once per centisecond.
+     If it was reloaded whilst reading the centisecond timer then we can't
+     tell whether the centisecond value was read before or after the tick,
+     so try again. */
+  int cs, before, after;
+  do
+  {
+    ON_ERR_RTN_E(call_hal(HAL_CounterRead, &before));
+    ON_ERR_RTN_E(read_monotonic_time(&cs));
+    ON_ERR_RTN_E(call_hal(HAL_CounterRead, &after));
+  }
+  while (after > before);
+
+  uint32_t const elapsed = (uint32_t)(counter_period - 1 - after);
+  *centiseconds = cs;
+  *microseconds = (unsigned int)(((uint64_t)elapsed * MicrosecondsPerTick) /
+                                 (uint32_t)counter_period);
+  return NULL;
+}
 
 CONST _kernel_oserror *timer_register(volatile bool *timeup_flag, int wait_time)
 {
@@ -47,6 +133,55 @@ CONST _kernel_oserror *timer_register(volatile bool *timeup_flag, int wait_time)
   return _kernel_swi(OS_CallAfter, &regs, &regs);
 }
 
+CONST _kernel_oserror *timer_ticker_start(TimerTicker *ticker)
+{
+  _kernel_swi_regs regs;
+  assert(ticker != NULL);
+  ticker->ticks = 0;
+  ticker->deadline = 0;
+  ticker->time_up = true;
+  regs.r[0] = 0; /* period minus one, in centiseconds */
+  regs.r[1] = (int)&timer_advance;
+  regs.r[2] = (int)ticker;
+  return _kernel_swi(OS_CallEvery, &regs, &regs);
+}
+
+void timer_ticker_set(TimerTicker *ticker, int wait_time)
+{
+  assert(ticker != NULL);
+  if (wait_time <= 0)
+  {
+    ticker->time_up = true;
+  }
+  else
+  {
+    /* Move the deadline before clearing the flag, otherwise a tick in
+       between could set the flag again for an earlier deadline */
+    ticker->deadline = ticker->ticks + wait_time;
+    ticker->time_up = false;
+  }
+}
+
+void timer_ticker_set_fine(TimerTicker *ticker, int wait_time,
+                           unsigned int phase)
+{
+  assert(phase < MicrosecondsPerTick);
+
+  /* The next tick is due (MicrosecondsPerTick - phase) microseconds from
+     now, so count ticks from the start of the current centisecond and
+     round up to avoid setting the flag before the deadline */
+  if (wait_time <= 0)
+  {
+    timer_ticker_set(ticker, 0);
+  }
+  else
+  {
+    unsigned int const end = phase + (unsigned)wait_time;
+    timer_ticker_set(ticker,
+      (int)((end + MicrosecondsPerTick - 1) / MicrosecondsPerTick));
+  }
+}
+
 /* It's dangerous to prevent ticker event deregistration */
 #undef _kernel_swi
 
@@ -57,3 +192,15 @@ CONST _kernel_oserror *timer_deregister(volatile bool *timeup_flag)
   regs.r[1] = (int)timeup_flag;
   return _kernel_swi(OS_RemoveTickerEvent, &regs, &regs);
 }
+
+CONST _kernel_oserror *timer_ticker_stop(TimerTicker *ticker)
+{
+  _kernel_swi_regs regs;
+  assert(ticker != NULL);
+  regs.r[0] = (int)&timer_advance;
+  regs.r[1] = (int)ticker;
+  CONST _kernel_oserror *const e = _kernel_swi(OS_RemoveTickerEvent, &regs,
+                                               &regs);
+  ticker->time_up = true;
+  return e;
+}
@@ -19,7 +19,8 @@
 
 /* Timer.h defines two functions that use RISC OS ticker timer events to change
    a boolean value after a set delay period, without any intervention by the
-   foreground process.
+   foreground process, and one to read the monotonic time more precisely than
+   OS_ReadMonotonicTime.
 
 Dependencies: None.
 Message tokens: None.
@@ -31,6 +32,10 @@ History:
                   Norcroft compiler when assigning 'long' values to it.
   CJB: 15-Oct-09: Changed wait time to 'int' to match wimp_pollidle. :-(
   CJB: 11-Dec-20: Deleted redundant uses of the 'extern' keyword.
+  CJB: 16-Oct-26: Added prototype of function timer_read_monotonic.
+  CJB: 16-Oct-26: Added the TimerTicker type and functions to start, stop and
+                  set the deadline of a persistent ticker.
+  CJB: 16-Oct-26: Added prototype of function timer_ticker_set_fine.
 */
 
 #ifndef Timer_h
@@ -45,6 +50,20 @@ History:
 /* Local headers */
 #include "Macros.h"
 
+/* The layout of this structure is known to the ticker event routine */
+typedef struct
+{
+  volatile int  ticks;    /* Number of centiseconds since the ticker
+                             was started */
+  volatile int  deadline; /* Value of 'ticks' at which to set 'time_up' */
+  volatile bool time_up;
+}
+TimerTicker;
+   /*
+    * State of a persistent ticker. Its members may be read but should only
+    * be written by the functions declared below.
+    */
+
 CONST _kernel_oserror *timer_register(volatile bool * /*timeup_flag*/, int /*wait_time*/);
    /*
     * Sets the variable pointed to by 'timeup_flag' to false and sets up a
@@ -67,4 +86,58 @@ CONST _kernel_oserror *timer_deregister(volatile bool * /*timeup_flag*/);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+CONST _kernel_oserror *timer_read_monotonic(int          * /*centiseconds*/,
+                                            unsigned int * /*microseconds*/);
+   /*
+    * Reads the number of centiseconds since the last hard reset (as would
+    * be returned by SWI OS_ReadMonotonicTime) and the number of microseconds
+    * (0-9999) that have elapsed since that centisecond counter last
+    * incremented. The latter is derived from the HAL counter, if there is
+    * one; otherwise it is always 0.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+CONST _kernel_oserror *timer_ticker_start(TimerTicker * /*ticker*/);
+   /*
+    * Sets the tick count of a persistent ticker to zero and its 'time_up'
+    * flag to true, then sets up a ticker event to increment the tick count
+    * every centisecond until timer_ticker_stop is called. Unlike
+    * timer_register, the same ticker can be reused for any number of
+    * deadlines (see timer_ticker_set) without further OS calls.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+void timer_ticker_set(TimerTicker * /*ticker*/, int /*wait_time*/);
+   /*
+    * Sets the 'time_up' flag of a running ticker to false and arranges for
+    * it to be changed to true after 'wait_time' centiseconds have elapsed.
+    * This doesn't make any OS calls. If 'wait_time' is not greater than zero
+    * then the flag is set to true immediately.
+    */
+
+void timer_ticker_set_fine(TimerTicker  * /*ticker*/,
+                           int            /*wait_time*/,
+                           unsigned int   /*phase*/);
+   /*
+    * Sets the 'time_up' flag of a running ticker to false and arranges for
+    * it to be changed to true after 'wait_time' microseconds have elapsed.
+    * 'phase' is the number of microseconds that had elapsed since the
+    * centisecond counter last incremented, as returned by
+    * timer_read_monotonic, when 'wait_time' was measured. Ticker events only
+    * occur once per centisecond, so the flag is set on the first tick at or
+    * after the deadline: never early, and late by less than one centisecond.
+    * (timer_ticker_set can be up to a centisecond early because it doesn't
+    * know how much of the current centisecond has already elapsed.)
+    * This doesn't make any OS calls. If 'wait_time' is not greater than zero
+    * then the flag is set to true immediately.
+    */
+
+CONST _kernel_oserror *timer_ticker_stop(TimerTicker * /*ticker*/);
+   /*
+    * Removes the ticker event set up by timer_ticker_start. Call this
+    * function before your program exits or polls the window manager. The
+    * 'time_up' flag is left set to true.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
 #endif
@@ -20,8 +20,11 @@
 ; History:
 ; 11.09.03 CJB Added BOOL_8_BIT variable to control width of type 'bool'.
 ; 28.05.16 CJB Renamed from Timer.s and deleted the SWI veneer functions.
+; 16.10.26 CJB Added timer_advance, which counts ticks and sets a flag when
+;              a deadline is reached.
 
   EXPORT timer_set_flag
+  EXPORT timer_advance
 
   AREA |C$$code|, CODE, READONLY
 
@@ -38,4 +41,22 @@ timer_set_flag
 
   LDR PC,[R13],#4 ; pull return address
 
+timer_advance
+  ; Called in SVC mode with interrupts disabled
+  ; Must preserve all registers and return using MOV PC,R14
+  ; R12 = pointer to TimerTicker (see Timer.h)
+
+  STMFD R13!,{R0,R1,R14}
+
+  LDR R0,[R12,#0] ; increment tick count
+  ADD R0,R0,#1
+  STR R0,[R12,#0]
+
+  LDR R1,[R12,#4] ; load deadline
+  SUBS R1,R0,R1 ; set flag byte if the deadline has been reached
+  MOVPL R14,#1
+  STRPLB R14,[R12,#8]
+
+  LDMFD R13!,{R0,R1,PC}
+
   END
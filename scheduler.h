@@ -47,6 +47,21 @@ History:
                   upon CBLIB_OBSOLETE.
   CJB: 11-Dec-14: Deleted redundant brackets from function type definitions.
   CJB: 11-Dec-20: Deleted redundant uses of the 'extern' keyword.
+  CJB: 16-Oct-26: Added the SchedulerPolicy type and a function,
+                  scheduler_set_policy, to select fair-share scheduling.
+                  Added the SchedulerClientStats and SchedulerStats types and
+                  functions to read run-time statistics.
+  CJB: 16-Oct-26: Run-time statistics are now recorded in microseconds.
+                  Added prototype of function scheduler_set_fine_timing.
+  CJB: 16-Oct-26: Added prototypes of functions
+                  scheduler_set_adaptive_time_slice and
+                  scheduler_get_time_slice.
+  CJB: 16-Oct-26: Added the SchedulerToken and SchedulerRegistration types
+                  and functions to register, deregister and reschedule
+                  clients by token, singly or in bulk.
+  CJB: 16-Oct-26: Added the SchedulerCallAfterFunction type and a function,
+                  scheduler_call_after, to call a function once after a
+                  delay.
 */
 
 #ifndef Scheduler_h
@@ -54,6 +69,9 @@ History:
 
 /* ISO library headers */
 #include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /* Acorn C/C++ library headers */
 #include "kernel.h"
@@ -72,6 +90,16 @@ enum
 /* A type for the 32-bit centisecond counter as read by OS_ReadMonotonicTime. */
 typedef int SchedulerTime;
 
+typedef enum
+{
+  SchedulerPolicy_Deadline,  /* Due clients are called in the order that they
+                                became due (default) */
+  SchedulerPolicy_FairShare  /* Due clients are called in order of the time
+                                they have already spent running, weighted
+                                by priority */
+}
+SchedulerPolicy;
+
 typedef SchedulerTime SchedulerIdleFunction (void                */*handle*/,
                                              SchedulerTime        /*time_now*/,
                                              const volatile bool */*time_up*/);
@@ -86,6 +114,71 @@ typedef SchedulerTime SchedulerIdleFunction (void                */*handle*/,
     * by some delay period.
     */
 
+typedef void SchedulerCallAfterFunction (void */*arg*/);
+   /*
+    * When your function is called it will be passed the value of 'arg' given
+    * to scheduler_call_after. It will not be called again unless registered
+    * again.
+    */
+
+typedef struct SchedulerClient *SchedulerToken;
+   /*
+    * An opaque reference to a registered function, which allows it to be
+    * deregistered or rescheduled without a search.
+    */
+
+typedef struct
+{
+  SchedulerIdleFunction *function;
+  void                  *handle;
+  SchedulerTime          first_call;
+  int                    priority;
+}
+SchedulerRegistration;
+   /*
+    * Arguments for one registration by scheduler_register_many.
+    */
+
+typedef struct
+{
+  unsigned long int invocations;       /* Number of calls */
+  unsigned long int premature_returns; /* Calls that returned before the
+                                          'time_up' flag went true */
+  unsigned long int overruns;          /* Calls that returned more than a
+                                          tick after 'time_up' went true */
+  uint64_t          total_time;        /* Total run time (microseconds) */
+  int               max_time;          /* Longest run time of any call
+                                          (microseconds) */
+  uint64_t          total_lateness;    /* Total time between becoming due
+                                          and being called (microseconds) */
+  int               max_lateness;      /* Longest time between becoming due
+                                          and being called (microseconds) */
+}
+SchedulerClientStats;
+   /*
+    * Run-time statistics for one registered function.
+    */
+
+typedef struct
+{
+  unsigned long int null_events; /* Number of null events handled */
+  uint64_t          time_in_app; /* Total time spent handling null events
+                                    (microseconds) */
+}
+SchedulerStats;
+   /*
+    * Run-time statistics for the scheduler as a whole.
+    */
+
+typedef bool SchedulerForEachFunction (SchedulerIdleFunction      */*function*/,
+                                       void                       */*handle*/,
+                                       const SchedulerClientStats */*stats*/,
+                                       void                       */*arg*/);
+   /*
+    * Type of function called by scheduler_for_each_client for each
+    * registered function. Should return true to stop the iteration early.
+    */
+
 CONST _kernel_oserror *scheduler_initialise(
                     SchedulerTime   /*nice*/
 #ifndef CBLIB_OBSOLETE
@@ -123,7 +216,57 @@ void scheduler_set_time_slice(SchedulerTime /*nice*/);
     * least one such function is due. Different values of 'nice' control the
     * granularity of task-switching and hence what proportion of CPU time your
     * task uses compared to other background tasks (e.g. programs running under
-    * TaskWindow cede control after 10cs).
+    * TaskWindow cede control after 10cs). Disables the adaptive mode
+    * selected by scheduler_set_adaptive_time_slice.
+    */
+
+void scheduler_set_adaptive_time_slice(SchedulerTime /*min_nice*/,
+                                       SchedulerTime /*max_nice*/);
+   /*
+    * Selects an adaptive mode in which the time spent calling client-
+    * registered functions upon receipt of each null event is adjusted
+    * automatically, within the bounds 'min_nice' to 'max_nice' centiseconds
+    * (inclusive). Whenever functions were still due when our time ran out,
+    * the time until the next null event is measured: if other tasks returned
+    * control almost immediately then our time slice is increased (for
+    * higher throughput), whereas if they took longer than our time slice
+    * then it is reduced (for lower latency). 'min_nice' must be at least 1.
+    */
+
+SchedulerTime scheduler_get_time_slice(void);
+   /*
+    * Gets the number of centiseconds currently spent calling client-
+    * registered functions upon receipt of a Wimp null event. This may change
+    * over time if adaptive mode was selected.
+    * Returns: the current time slice, in centiseconds.
+    */
+
+void scheduler_set_policy(SchedulerPolicy /*policy*/);
+   /*
+    * Selects the order in which functions that are due will be called.
+    * Under the default SchedulerPolicy_Deadline, a due function is called
+    * before those that became due after it, and it is allocated a time slice
+    * related to its priority. Under SchedulerPolicy_FairShare, the scheduler
+    * also keeps track of how long each function has run, and calls the due
+    * function that has had least CPU time in proportion to its priority.
+    * This gives long-running background jobs a predictable share of CPU time
+    * alongside short, frequent functions without starving either. Time spent
+    * asleep does not earn credit towards future invocations.
+    */
+
+void scheduler_set_fine_timing(bool /*enable*/);
+   /*
+    * Enables or disables sub-centisecond measurement of the time spent in
+    * each function. By default, the scheduler uses the centisecond monotonic
+    * clock, so a function that returns within a tick appears to have taken
+    * no time. When fine timing is enabled, a hardware counter is read (where
+    * available) to charge the time spent against the remaining time slice,
+    * fair-share run time and statistics to the microsecond, at the cost of
+    * extra SWI calls. The deadline at which the 'time_up' flag is set for
+    * each function is also measured from the time at which it was called,
+    * so that a function is never stopped before its time slice has expired.
+    * The flag is still set by a ticker event, so it may be set up to one
+    * centisecond late (see timer_ticker_set_fine).
     */
 
 CONST _kernel_oserror *scheduler_register(SchedulerIdleFunction */*function*/, void */*handle*/, SchedulerTime /*first_call*/, int /*priority*/);
@@ -157,6 +300,60 @@ void scheduler_deregister(SchedulerIdleFunction */*function*/, void *handle);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+CONST _kernel_oserror *scheduler_register_token(SchedulerIdleFunction */*function*/, void */*handle*/, SchedulerTime /*first_call*/, int /*priority*/, SchedulerToken */*token*/);
+   /*
+    * As scheduler_register except that the function and handle combination
+    * is not checked for uniqueness (which requires a search) and a token is
+    * written to the object pointed to by 'token' (unless null). The token
+    * may be passed to scheduler_deregister_token or scheduler_reschedule and
+    * becomes invalid when the function is deregistered. If the combination
+    * is not unique then it must not be passed to any of the functions that
+    * identify a client by function and handle.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+CONST _kernel_oserror *scheduler_register_many(const SchedulerRegistration */*registrations*/, size_t /*count*/, SchedulerToken */*tokens*/);
+   /*
+    * Registers 'count' functions at once, as if by scheduler_register_token
+    * for each element of the 'registrations' array. Unless 'tokens' is null,
+    * it must point to an array of 'count' elements to receive the tokens.
+    * Either all of the functions are registered or none of them are.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
+void scheduler_deregister_token(SchedulerToken /*token*/);
+   /*
+    * Tells the scheduler to stop calling the function identified by 'token',
+    * without a search. It is safe to deregister a function from within
+    * itself. The token becomes invalid. May cause abnormal program
+    * termination if the token is invalid.
+    */
+
+void scheduler_deregister_many(const SchedulerToken */*tokens*/, size_t /*count*/);
+   /*
+    * Deregisters 'count' functions at once, as if by
+    * scheduler_deregister_token for each element of the 'tokens' array.
+    */
+
+void scheduler_reschedule(SchedulerToken /*token*/, SchedulerTime /*next_call*/);
+   /*
+    * Changes the earliest OS monotonic time at which to call the function
+    * identified by 'token' to 'next_call', without a search. Has no effect
+    * if called whilst the specified function is being called, because its
+    * return value takes precedence.
+    */
+
+CONST _kernel_oserror *scheduler_call_after(SchedulerTime /*delay*/, SchedulerCallAfterFunction */*function*/, void */*arg*/, SchedulerToken */*token*/);
+   /*
+    * Arranges for a function to be called once, as soon as possible after
+    * 'delay' centiseconds have elapsed. It will not be called before then,
+    * and null events are not requested until then. Unless 'token' is null,
+    * a token is written to the object that it points to, which may be passed
+    * to scheduler_deregister_token to cancel the call. The token becomes
+    * invalid as soon as the function is called.
+    * Returns: a pointer to an OS error block, or else NULL for success.
+    */
+
 CONST _kernel_oserror *scheduler_poll(int */*event_code*/, WimpPollBlock */*poll_block*/, void */*poll_word*/);
    /*
     * This function is intended as a direct replacement for event_poll. It polls
@@ -183,6 +380,31 @@ void scheduler_resume(void);
     * Returns: a pointer to an OS error block, or else NULL for success.
     */
 
+bool scheduler_get_stats(SchedulerIdleFunction */*function*/, void */*handle*/, SchedulerClientStats */*stats*/);
+   /*
+    * Gets run-time statistics for a registered function, identified by the
+    * same function and handle that were used to register it. Statistics
+    * are kept whether or not this is a debug build, and are reset whenever
+    * the function is registered.
+    * Returns: true if the function was found and its statistics were
+    *          written to the object pointed to by 'stats', otherwise false.
+    */
+
+void scheduler_for_each_client(SchedulerForEachFunction */*callback*/, void */*arg*/);
+   /*
+    * Calls a function for each registered function (in no particular order),
+    * passing its run-time statistics and the value of 'arg'. Stops early if
+    * the callback returns true. The callback must not register or deregister
+    * any functions.
+    */
+
+void scheduler_get_totals(SchedulerStats */*stats*/);
+   /*
+    * Gets run-time statistics for the scheduler as a whole, i.e. the number
+    * of null events handled and the total time spent calling registered
+    * functions, since initialisation.
+    */
+
 #ifdef CBLIB_OBSOLETE
 /* Deprecated type and enumeration constant names */
 #define sch_clock_t      SchedulerTime
@@ -0,0 +1,321 @@
+/*
+ * CBLibrary test: Cache of catalogue information
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "swis.h"
+
+/* CBOSLib headers */
+#include "OSFile.h"
+
+/* CBLibrary headers */
+#include "CatCache.h"
+#include "DirIter.h"
+#include "DateStamp.h"
+#include "FileUtils.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+
+#define TEST_DIR "<Wimp$ScrapDir>.CatCacheTest"
+#define TEST_FILE TEST_DIR ".File"
+
+enum
+{
+  OS_FSControl_Wipe = 27,
+  OS_FSControl_Flag_Recurse = 1,
+  OS_File_CreateStampedFile = 11,
+  OS_File_CreateDirectory = 8,
+  OS_File_CreateDirectory_DefaultNoOfEntries = 0,
+  OS_File_SetType = 18,
+  Capacity = 64,
+  Lifetime = 6000, /* Long enough not to expire during a test */
+  NumFiles = 10,
+  FileSize = 12
+};
+
+static void wipe(const char *path_name)
+{
+  _kernel_swi_regs regs;
+
+  assert(path_name != NULL);
+
+  regs.r[0] = OS_FSControl_Wipe;
+  regs.r[1] = (int)path_name;
+  regs.r[3] = OS_FSControl_Flag_Recurse;
+  _kernel_swi(OS_FSControl, &regs, &regs);
+}
+
+static void osfile(int op, const char *name, _kernel_osfile_block *inout)
+{
+  assert(name != NULL);
+  assert(inout != NULL);
+
+  if (_kernel_osfile(op, name, inout) == _kernel_ERROR)
+  {
+    const _kernel_oserror * const e = _kernel_last_oserror();
+    assert(e != NULL);
+    printf("Error 0x%x %s\n", e->errnum, e->errmess);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void create_file(const char *path_name, int type, int size)
+{
+  _kernel_osfile_block inout;
+
+  assert(path_name != NULL);
+  inout.load = type;
+  inout.start = 0;
+  inout.end = size;
+  osfile(OS_File_CreateStampedFile, path_name, &inout);
+}
+
+static void set_type_behind_cache(const char *path_name, int type)
+{
+  _kernel_osfile_block inout;
+
+  assert(path_name != NULL);
+  inout.load = type;
+  osfile(OS_File_SetType, path_name, &inout);
+}
+
+static void make_test_dir(void)
+{
+  _kernel_osfile_block inout;
+
+  wipe(TEST_DIR);
+  inout.start = OS_File_CreateDirectory_DefaultNoOfEntries;
+  osfile(OS_File_CreateDirectory, TEST_DIR, &inout);
+  create_file(TEST_FILE, FileType_Text, FileSize);
+}
+
+static void check_stats(unsigned long int hits, unsigned long int misses,
+                        size_t count)
+{
+  CatCacheStats stats;
+
+  catcache_get_stats(&stats);
+  assert(stats.hits == hits);
+  assert(stats.misses == misses);
+  assert(stats.count == count);
+}
+
+static void test1(void)
+{
+  /* Disabled cache */
+  int type;
+
+  make_test_dir();
+  assert(!catcache_is_enabled());
+
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(type == FileType_Text);
+
+  /* The change should be seen immediately */
+  set_type_behind_cache(TEST_FILE, FileType_Data);
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(type == FileType_Data);
+
+  check_stats(0, 0, 0);
+  wipe(TEST_DIR);
+}
+
+static void test2(void)
+{
+  /* Hit and explicit invalidation */
+  int type, size;
+  OS_DateAndTime date_stamp;
+
+  make_test_dir();
+  assert(catcache_enable(Capacity, Lifetime) == NULL);
+  assert(catcache_is_enabled());
+
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(type == FileType_Text);
+  check_stats(0, 1, 1);
+
+  /* Path names are compared without regard to case */
+  assert(get_file_size(TEST_DIR ".FILE", &size) == NULL);
+  assert(size == FileSize);
+  assert(get_date_stamp(TEST_FILE, &date_stamp) == NULL);
+  check_stats(2, 1, 1);
+
+  /* The cached file type should be used until invalidated */
+  set_type_behind_cache(TEST_FILE, FileType_Data);
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(type == FileType_Text);
+
+  catcache_invalidate(TEST_FILE);
+  check_stats(3, 1, 0);
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(type == FileType_Data);
+  check_stats(3, 2, 1);
+
+  catcache_disable();
+  assert(!catcache_is_enabled());
+  wipe(TEST_DIR);
+}
+
+static void test3(void)
+{
+  /* Invalidation by set_file_type */
+  int type;
+
+  make_test_dir();
+  assert(catcache_enable(Capacity, Lifetime) == NULL);
+
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(set_file_type(TEST_FILE, FileType_Obey) == NULL);
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(type == FileType_Obey);
+  check_stats(0, 2, 1);
+
+  catcache_disable();
+  wipe(TEST_DIR);
+}
+
+static void test4(void)
+{
+  /* Populated by iterator */
+  DirIterator *it;
+  char path_name[256];
+  unsigned long int nobjects = 0;
+
+  make_test_dir();
+  for (int i = 0; i < NumFiles; ++i)
+  {
+    sprintf(path_name, TEST_DIR ".File%d", i);
+    create_file(path_name, FileType_Data, i);
+  }
+
+  assert(catcache_enable(Capacity, Lifetime) == NULL);
+
+  assert(diriterator_make(&it, DirIterator_CacheCatalogue, TEST_DIR, NULL) ==
+         NULL);
+
+  for (; !diriterator_is_empty(it); assert(diriterator_advance(it) == NULL))
+  {
+    DirIteratorObjectInfo info;
+    int size;
+
+    (void)diriterator_get_object_info(it, &info);
+    (void)diriterator_get_object_path_name(it, path_name, sizeof(path_name));
+
+    assert(get_file_size(path_name, &size) == NULL);
+    assert(size == info.length);
+    ++nobjects;
+  }
+  diriterator_destroy(it);
+
+  assert(nobjects == NumFiles + 1);
+  check_stats(nobjects, 0, nobjects);
+
+  /* Invalidating a directory should discard the objects in it */
+  catcache_invalidate(TEST_DIR);
+  check_stats(nobjects, 0, 0);
+
+  catcache_disable();
+  wipe(TEST_DIR);
+}
+
+static void test5(void)
+{
+  /* Zero lifetime */
+  int type;
+
+  make_test_dir();
+  assert(catcache_enable(Capacity, 0) == NULL);
+
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  assert(get_file_type(TEST_FILE, &type) == NULL);
+  check_stats(0, 2, 1);
+
+  catcache_disable();
+  wipe(TEST_DIR);
+}
+
+static void test6(void)
+{
+  /* Capacity and nested invalidation */
+  static const OS_File_CatalogueInfo info = {0, 0, 0, 0, ObjectType_File};
+
+  assert(catcache_enable(3, Lifetime) == NULL);
+
+  catcache_store("A", "B", &info);
+  catcache_store(NULL, "A.B.C", &info);
+  catcache_store("A", "BC", &info);
+  check_stats(0, 0, 3);
+
+  /* Storing the same object again shouldn't use another entry */
+  catcache_store(NULL, "a.b", &info);
+  check_stats(0, 0, 3);
+
+  catcache_invalidate("A.B");
+  check_stats(0, 0, 1);
+
+  /* The oldest entry should be evicted when full */
+  catcache_store("X", "1", &info);
+  catcache_store("X", "2", &info);
+  catcache_store("X", "3", &info);
+  check_stats(0, 0, 3);
+
+  catcache_invalidate(NULL);
+  check_stats(0, 0, 0);
+
+  catcache_disable();
+}
+
+void CatCache_tests(void)
+{
+  static const struct
+  {
+    const char *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Disabled cache", test1 },
+    { "Hit and explicit invalidation", test2 },
+    { "Invalidation by set_file_type", test3 },
+    { "Populated by iterator", test4 },
+    { "Zero lifetime", test5 },
+    { "Capacity and nested invalidation", test6 }
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); count ++)
+  {
+    printf("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+
+    unit_tests[count].test_func();
+
+    Fortify_LeaveScope();
+  }
+}
@@ -0,0 +1,255 @@
+/*
+ * CBLibrary test: Coroutine
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stdio.h>
+
+/* CBLibrary headers */
+#include "Scheduler.h"
+#include "Coroutine.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "SchedSim.h"
+
+enum
+{
+  TimeSlice = 10, /* centiseconds */
+  WorkTime = 100, /* microseconds */
+  NumberOfSteps = 5,
+  StopStep = 2,
+  NumberOfNullEvents = 20
+};
+
+typedef struct Job Job;
+
+struct Job
+{
+  int calls;
+  int step; /* Kept here because local variables aren't preserved */
+  bool ended;
+  bool stop_self; /* Stop this job when it reaches StopStep */
+  Job *victim; /* Job to stop when this job reaches StopStep, or NULL */
+};
+
+static SchedulerTime job_function(void *handle, Coroutine *coroutine,
+                                  SchedulerTime time_now,
+                                  const volatile bool *time_up)
+{
+  Job *const job = handle;
+  assert(job != NULL);
+  assert(!job->ended);
+  NOT_USED(time_up);
+
+  job->calls++;
+  schedsim_advance(WorkTime);
+
+  COROUTINE_BEGIN(coroutine);
+
+  for (job->step = 0; job->step < NumberOfSteps; job->step++)
+  {
+    if (job->step == StopStep)
+    {
+      if (job->stop_self)
+        coroutine_stop(job_function, job);
+
+      if (job->victim != NULL)
+        coroutine_stop(job_function, job->victim);
+    }
+
+    /* Resume at the next step as soon as possible */
+    COROUTINE_YIELD(coroutine, time_now);
+  }
+
+  job->ended = true;
+
+  COROUTINE_END(coroutine, time_now);
+}
+
+static void init_job(Job *job)
+{
+  *job = (Job){
+    .calls = 0,
+    .step = -1,
+    .ended = false,
+    .stop_self = false,
+    .victim = NULL
+  };
+}
+
+static void start_job(Job *job)
+{
+  CONST _kernel_oserror *const e = coroutine_start(job_function, job,
+    schedsim_now(), SchedulerPriority_Min);
+  assert(e == NULL);
+  NOT_USED(e);
+  assert(coroutine_is_running(job_function, job));
+}
+
+static void setup(void)
+{
+  schedsim_reset();
+  CONST _kernel_oserror *const e = scheduler_initialise(TimeSlice, NULL, NULL);
+  assert(e == NULL);
+  NOT_USED(e);
+}
+
+static void teardown(void)
+{
+  /* All coroutines should have been deregistered so null events should be
+     masked */
+  assert(!schedsim_null_event());
+
+  CONST _kernel_oserror *const e = scheduler_finalise();
+  assert(e == NULL);
+  NOT_USED(e);
+}
+
+static void run(int null_events)
+{
+  for (int n = 0; n < null_events; ++n)
+  {
+    schedsim_poll(0);
+  }
+}
+
+static void test1(void)
+{
+  /* Start, yield and end */
+  Job job;
+  setup();
+  init_job(&job);
+  start_job(&job);
+
+  run(NumberOfNullEvents);
+
+  /* Called once per step and once more to reach the end */
+  assert(job.ended);
+  assert(job.step == NumberOfSteps);
+  assert(job.calls == NumberOfSteps + 1);
+  assert(!coroutine_is_running(job_function, &job));
+
+  /* Stopping a finished coroutine does nothing */
+  coroutine_stop(job_function, &job);
+  teardown();
+}
+
+static void test2(void)
+{
+  /* Stop from within the coroutine */
+  Job job;
+  setup();
+  init_job(&job);
+  job.stop_self = true;
+  start_job(&job);
+
+  run(NumberOfNullEvents);
+
+  /* The yield after stopping should be the last call */
+  assert(!job.ended);
+  assert(job.step == StopStep);
+  assert(job.calls == StopStep + 1);
+  assert(!coroutine_is_running(job_function, &job));
+  teardown();
+}
+
+static void test3(void)
+{
+  /* Stop from within another coroutine */
+  Job job, victim;
+  setup();
+  init_job(&job);
+  init_job(&victim);
+  job.victim = &victim;
+  start_job(&job);
+  start_job(&victim);
+
+  run(NumberOfNullEvents);
+
+  assert(job.ended);
+  assert(job.calls == NumberOfSteps + 1);
+  assert(!victim.ended);
+  assert(victim.calls <= StopStep + 1);
+  assert(!coroutine_is_running(job_function, &victim));
+  teardown();
+}
+
+static void test4(void)
+{
+  /* Stop before first call */
+  Job job;
+  setup();
+  init_job(&job);
+  start_job(&job);
+  coroutine_stop(job_function, &job);
+  assert(!coroutine_is_running(job_function, &job));
+
+  run(NumberOfNullEvents);
+
+  assert(job.calls == 0);
+  teardown();
+}
+
+static void test5(void)
+{
+  /* Restart after stopping itself */
+  Job job;
+  setup();
+  init_job(&job);
+  job.stop_self = true;
+  start_job(&job);
+  run(NumberOfNullEvents);
+  assert(!coroutine_is_running(job_function, &job));
+
+  init_job(&job);
+  start_job(&job);
+  run(NumberOfNullEvents);
+  assert(job.ended);
+  assert(job.calls == NumberOfSteps + 1);
+  teardown();
+}
+
+void Coroutine_tests(void)
+{
+  static const struct
+  {
+    const char *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Start, yield and end", test1 },
+    { "Stop self", test2 },
+    { "Stop another", test3 },
+    { "Stop before first call", test4 },
+    { "Restart after stopping self", test5 }
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); count ++)
+  {
+    printf("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    unit_tests[count].test_func();
+  }
+}
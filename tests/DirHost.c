@@ -0,0 +1,684 @@
+/*
+ * CBLibrary test: Host filing system backend for DirIterator
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Needed for fstatat, dirfd and strdup in strict ISO C mode */
+#define _POSIX_C_SOURCE 200809L
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+
+/* POSIX headers */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSGBPB.h"
+#include "OSFile.h"
+#include "FileTypes.h"
+#include "OSReadTime.h"
+#include "OSWord.h"
+
+/* CBLibrary headers */
+#include "Macros.h"
+#include "Scheduler.h"
+#include "CatCache.h"
+
+/* CBUtilLib headers */
+#include "StrExtra.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "DirHost.h"
+
+enum
+{
+  MaxOpenDirs = 8, /* Enough for a deep tree plus read-ahead */
+  ErrorNum_NoMem = 1,
+  ErrorNum_BufferOverflow = 484,
+  ErrorNum_NotFound = 214,
+  ErrorNum_HostError = 0x10000, /* Added to errno */
+  FileTypeSuffixLen = 4, /* e.g. ",fff" */
+  MinNamesSize = 16,
+  Attr_OwnerRead = 1 << 0,
+  Attr_OwnerWrite = 1 << 1,
+  Attr_PublicRead = 1 << 4,
+  Attr_PublicWrite = 1 << 5,
+  CentisecondsPerSecond = 100,
+  NanosecondsPerCentisecond = 10000000
+};
+
+/* Seconds between 1900 (the RISC OS epoch) and 1970 (the Unix epoch) */
+#define EPOCH_OFFSET 2208988800u
+
+/* An open host directory and how far it has been read. */
+typedef struct
+{
+  char          *path_name; /* RISC OS path name, or NULL if free */
+  DIR           *dir;
+  int            position;  /* Number of entries consumed */
+  bool           has_pending; /* Whether 'pending' holds the next entry */
+  char           pending[NAME_MAX + 1];
+  char         **names;     /* Sorted host names, or NULL if unsorted */
+  size_t         nnames;
+  unsigned long  last_used;
+}
+OpenDir;
+
+static char *host_root;
+static bool sorted;
+/* Each thread of a parallel walk reads its own directories, so it keeps its
+   own open directories and error block. The counters are shared. */
+static __thread OpenDir open_dirs[MaxOpenDirs];
+static __thread unsigned long int use_count;
+static unsigned long int read_calls, entries_read, dirs_opened;
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static CONST _kernel_oserror *host_error(int errnum, const char *message)
+{
+  static __thread _kernel_oserror error;
+  error.errnum = errnum;
+  strncpy(error.errmess, message, sizeof(error.errmess) - 1);
+  error.errmess[sizeof(error.errmess) - 1] = '\0';
+  return &error;
+}
+
+static CONST _kernel_oserror *errno_error(int error_number)
+{
+  return host_error(ErrorNum_HostError + error_number,
+                    strerror(error_number));
+}
+
+static void swap_separators(char *s)
+{
+  for (; *s != '\0'; ++s)
+  {
+    if (*s == '.')
+      *s = '/';
+    else if (*s == '/')
+      *s = '.';
+  }
+}
+
+static int translate_name(const char *host_name, char *leaf_name)
+{
+  /* A file type may be given by a suffix such as ",fff" on the host name,
+     as RISC OS ports of Unix programs do. It isn't part of the leaf name. */
+  int file_type = FileType_Data;
+
+  assert(host_name != NULL);
+  assert(leaf_name != NULL);
+
+  strcpy(leaf_name, host_name);
+  swap_separators(leaf_name);
+
+  size_t const len = strlen(leaf_name);
+  if (len > FileTypeSuffixLen && leaf_name[len - FileTypeSuffixLen] == ',')
+  {
+    char *end;
+    long const type = strtol(leaf_name + len - FileTypeSuffixLen + 1, &end,
+                             16);
+    if (*end == '\0' && isxdigit((unsigned char)leaf_name[len - 3]))
+    {
+      file_type = (int)type;
+      leaf_name[len - FileTypeSuffixLen] = '\0';
+    }
+  }
+
+  return file_type;
+}
+
+static int compare_names(const void *a, const void *b)
+{
+  /* Sort names without regard to case, as FileCore does */
+  char leaf_a[NAME_MAX + 1], leaf_b[NAME_MAX + 1];
+  char *const *const name_a = a;
+  char *const *const name_b = b;
+
+  (void)translate_name(*name_a, leaf_a);
+  (void)translate_name(*name_b, leaf_b);
+
+  return stricmp(leaf_a, leaf_b);
+}
+
+static bool match_wildcard(const char *pattern, const char *name)
+{
+  /* '*' matches any number of characters and '#' matches any one
+     character. Names are compared without regard to case, as on
+     RISC OS. */
+  for (; *pattern != '\0'; ++pattern, ++name)
+  {
+    if (*pattern == '*')
+    {
+      do
+      {
+        if (match_wildcard(pattern + 1, name))
+          return true;
+      }
+      while (*name++ != '\0');
+      return false;
+    }
+
+    if (*name == '\0')
+      return false;
+
+    if (*pattern != '#' &&
+        tolower((unsigned char)*pattern) != tolower((unsigned char)*name))
+      return false;
+  }
+  return *name == '\0';
+}
+
+static void close_dir(OpenDir *const od)
+{
+  assert(od != NULL);
+  if (od->path_name != NULL)
+  {
+    (void)closedir(od->dir);
+    free(od->path_name);
+    od->path_name = NULL;
+
+    for (size_t i = 0; i < od->nnames; ++i)
+      free(od->names[i]);
+    free(od->names);
+    od->names = NULL;
+    od->nnames = 0;
+  }
+}
+
+static bool read_names(OpenDir *const od)
+{
+  /* Read the whole directory and sort it by name */
+  size_t size = 0;
+
+  assert(od != NULL);
+  assert(od->names == NULL);
+
+  for (const struct dirent *d = readdir(od->dir);
+       d != NULL;
+       d = readdir(od->dir))
+  {
+    if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+      continue;
+
+    if (od->nnames >= size)
+    {
+      size_t const new_size = HIGHEST(size * 2, MinNamesSize);
+      char **const names = realloc(od->names, new_size * sizeof(*names));
+      if (names == NULL)
+        return false;
+
+      od->names = names;
+      size = new_size;
+    }
+
+    od->names[od->nnames] = strdup(d->d_name);
+    if (od->names[od->nnames] == NULL)
+      return false;
+
+    ++od->nnames;
+  }
+
+  if (od->nnames > 0)
+    qsort(od->names, od->nnames, sizeof(*od->names), compare_names);
+
+  return true;
+}
+
+static bool read_next(OpenDir *const od)
+{
+  /* Skip the '.' and '..' entries, which RISC OS doesn't have */
+  assert(od != NULL);
+  if (!od->has_pending && od->names != NULL)
+  {
+    if ((size_t)od->position >= od->nnames)
+      return false;
+
+    strcpy(od->pending, od->names[od->position]);
+    od->has_pending = true;
+  }
+  else if (!od->has_pending)
+  {
+    const struct dirent *d;
+    do
+    {
+      d = readdir(od->dir);
+      if (d == NULL)
+        return false;
+    }
+    while (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0);
+
+    strncpy(od->pending, d->d_name, sizeof(od->pending) - 1);
+    od->pending[sizeof(od->pending) - 1] = '\0';
+    od->has_pending = true;
+  }
+  return true;
+}
+
+static void consume(OpenDir *const od)
+{
+  assert(od != NULL);
+  assert(od->has_pending);
+  od->has_pending = false;
+  ++od->position;
+}
+
+static CONST _kernel_oserror *find_dir(const char *dir_name, int position,
+                                       OpenDir **od_out)
+{
+  OpenDir *od = NULL;
+
+  assert(dir_name != NULL);
+  assert(position >= 0);
+  assert(od_out != NULL);
+
+  /* Continue reading a directory that is already open at the right
+     position, if possible. Otherwise reuse the least recently used slot. */
+  for (size_t i = 0; i < ARRAY_SIZE(open_dirs); ++i)
+  {
+    OpenDir *const candidate = &open_dirs[i];
+    if (candidate->path_name != NULL &&
+        candidate->position == position &&
+        strcmp(candidate->path_name, dir_name) == 0)
+    {
+      od = candidate;
+      break;
+    }
+
+    if (od == NULL || candidate->path_name == NULL ||
+        (od->path_name != NULL && candidate->last_used < od->last_used))
+    {
+      od = candidate;
+    }
+  }
+
+  assert(od != NULL);
+  if (od->path_name == NULL || od->position != position ||
+      strcmp(od->path_name, dir_name) != 0)
+  {
+    char host_path[PATH_MAX];
+    if (dirhost_get_host_path(dir_name, host_path, sizeof(host_path)) == 0)
+      return host_error(ErrorNum_NotFound, "Not found");
+
+    close_dir(od);
+
+    DIR *const dir = opendir(host_path);
+    if (dir == NULL)
+    {
+      return errno == ENOENT || errno == ENOTDIR ?
+             host_error(ErrorNum_NotFound, "Not found") : errno_error(errno);
+    }
+
+    od->path_name = malloc(strlen(dir_name) + 1);
+    if (od->path_name == NULL)
+    {
+      (void)closedir(dir);
+      return host_error(ErrorNum_NoMem, "NoMem");
+    }
+    strcpy(od->path_name, dir_name);
+    od->dir = dir;
+    od->position = 0;
+    od->has_pending = false;
+    (void)__atomic_fetch_add(&dirs_opened, 1, __ATOMIC_RELAXED);
+
+    if (sorted && !read_names(od))
+    {
+      close_dir(od);
+      return host_error(ErrorNum_NoMem, "NoMem");
+    }
+
+    /* Skip the entries that were already consumed */
+    while (od->position < position && read_next(od))
+      consume(od);
+  }
+
+  od->last_used = ++use_count;
+  *od_out = od;
+  return NULL;
+}
+
+static void encode_date_stamp(const struct stat *st, int file_type,
+                              OS_File_CatalogueInfo *info)
+{
+  /* Centiseconds since 1900, as a 40-bit number split between the load
+     and execution addresses */
+  unsigned long long cs = ((unsigned long long)st->st_mtime + EPOCH_OFFSET) *
+                          CentisecondsPerSecond +
+                          (unsigned long long)st->st_mtim.tv_nsec /
+                          NanosecondsPerCentisecond;
+
+  info->load = 0xfff00000u | ((unsigned int)file_type << 8) |
+               (unsigned int)((cs >> 32) & 0xff);
+  info->exec = (unsigned int)(cs & 0xffffffffu);
+}
+
+static bool translate_entry(int dir_fd, const char *host_name, int file_type,
+                            OS_File_CatalogueInfo *info, int *error_number)
+{
+  struct stat st;
+
+  assert(host_name != NULL);
+  assert(info != NULL);
+  assert(error_number != NULL);
+
+  /* Don't follow symbolic links, to avoid cycles */
+  if (fstatat(dir_fd, host_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+  {
+    *error_number = errno;
+    return false;
+  }
+
+  encode_date_stamp(&st, file_type, info);
+
+  if (S_ISDIR(st.st_mode))
+  {
+    info->object_type = ObjectType_Directory;
+    info->length = 0;
+  }
+  else
+  {
+    info->object_type = ObjectType_File;
+    info->length = st.st_size > INT_MAX ? INT_MAX : (int)st.st_size;
+  }
+
+  info->attributes = 0;
+  if (TEST_BITS(st.st_mode, S_IRUSR))
+    info->attributes |= Attr_OwnerRead;
+  if (TEST_BITS(st.st_mode, S_IWUSR))
+    info->attributes |= Attr_OwnerWrite;
+  if (TEST_BITS(st.st_mode, S_IROTH))
+    info->attributes |= Attr_PublicRead;
+  if (TEST_BITS(st.st_mode, S_IWOTH))
+    info->attributes |= Attr_PublicWrite;
+
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Backend control                                 */
+
+void dirhost_set_root(const char *host_path)
+{
+  assert(host_path != NULL);
+
+  for (size_t i = 0; i < ARRAY_SIZE(open_dirs); ++i)
+    close_dir(&open_dirs[i]);
+
+  free(host_root);
+  host_root = malloc(strlen(host_path) + 1);
+  if (host_root != NULL)
+    strcpy(host_root, host_path);
+
+  read_calls = 0;
+  entries_read = 0;
+  dirs_opened = 0;
+}
+
+void dirhost_set_sorted(bool sort)
+{
+  for (size_t i = 0; i < ARRAY_SIZE(open_dirs); ++i)
+    close_dir(&open_dirs[i]);
+
+  sorted = sort;
+}
+
+size_t dirhost_get_host_path(const char *path_name, char *buffer,
+                             size_t buff_size)
+{
+  const size_t root_len = strlen(DIRHOST_ROOT);
+
+  assert(path_name != NULL);
+  assert(buffer != NULL || buff_size == 0);
+
+  if (host_root == NULL || strncmp(path_name, DIRHOST_ROOT, root_len) != 0 ||
+      (path_name[root_len] != '\0' && path_name[root_len] != '.'))
+    return 0;
+
+  const char *const sub_path = path_name + root_len;
+  size_t const len = strlen(host_root) + strlen(sub_path);
+
+  if (buff_size > 0)
+  {
+    size_t n = strlen(host_root);
+    if (n >= buff_size)
+      n = buff_size - 1;
+    memcpy(buffer, host_root, n);
+
+    /* The leading '.' of the sub-path becomes '/' */
+    size_t const rest = LOWEST(strlen(sub_path), buff_size - 1 - n);
+    memcpy(buffer + n, sub_path, rest);
+    buffer[n + rest] = '\0';
+    swap_separators(buffer + n);
+  }
+
+  return len;
+}
+
+unsigned long int dirhost_read_calls(void)
+{
+  return read_calls;
+}
+
+unsigned long int dirhost_entries_read(void)
+{
+  return entries_read;
+}
+
+unsigned long int dirhost_dirs_opened(void)
+{
+  return dirs_opened;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                 Stand-ins for the functions of other modules            */
+
+CONST _kernel_oserror *os_gbpb_read_cat_no_path(const char *dir_name,
+  void *buffer, size_t buff_size, unsigned int *n, int *position,
+  const char *pattern)
+{
+  CONST _kernel_oserror *e;
+  OpenDir *od;
+
+  assert(dir_name != NULL);
+  assert(buffer != NULL);
+  assert(n != NULL);
+  assert(*n > 0);
+  assert(position != NULL);
+  assert(*position >= 0);
+
+  (void)__atomic_fetch_add(&read_calls, 1, __ATOMIC_RELAXED);
+
+  e = find_dir(dir_name, *position, &od);
+  if (e != NULL)
+    return e;
+
+  /* Copy as many entries as were requested and will fit. readdir reads
+     many entries from the host per system call, so this is a batch. */
+  char *write = buffer;
+  unsigned int count = 0;
+  bool at_end = false;
+  while (count < *n)
+  {
+    if (!read_next(od))
+    {
+      at_end = true;
+      break;
+    }
+
+    char leaf_name[sizeof(od->pending)];
+    int const file_type = translate_name(od->pending, leaf_name);
+
+    if (pattern != NULL && !match_wildcard(pattern, leaf_name))
+    {
+      consume(od);
+      continue;
+    }
+
+    size_t const name_size = strlen(leaf_name) + 1;
+    size_t const entry_size = offsetof(OS_GBPB_CatalogueInfo, name) +
+                              WORD_ALIGN(name_size);
+
+    if (entry_size > buff_size - (size_t)(write - (char *)buffer))
+      break;
+
+    OS_GBPB_CatalogueInfo *const entry = (OS_GBPB_CatalogueInfo *)write;
+    int error_number;
+    if (!translate_entry(dirfd(od->dir), od->pending, file_type,
+                         &entry->info, &error_number))
+    {
+      if (error_number == ENOENT)
+      {
+        /* Deleted since the directory was read */
+        consume(od);
+        continue;
+      }
+      return errno_error(error_number);
+    }
+    memcpy(entry->name, leaf_name, name_size);
+
+    consume(od);
+    write += entry_size;
+    ++count;
+  }
+
+  if (count == 0 && !at_end)
+    return host_error(ErrorNum_BufferOverflow, "Buffer overflow");
+
+  (void)__atomic_fetch_add(&entries_read, count, __ATOMIC_RELAXED);
+  *n = count;
+
+  if (at_end)
+  {
+    *position = OS_GBPB_ReadCat_PositionEnd;
+    close_dir(od);
+  }
+  else
+  {
+    *position = od->position;
+  }
+
+  return NULL;
+}
+
+CONST _kernel_oserror *scheduler_register_delay(
+  SchedulerIdleFunction *function, void *handle, SchedulerTime delay,
+  int priority)
+{
+  /* There is no null event on the host, so read-ahead never happens */
+  NOT_USED(function);
+  NOT_USED(handle);
+  NOT_USED(delay);
+  NOT_USED(priority);
+  return NULL;
+}
+
+void scheduler_deregister(SchedulerIdleFunction *function, void *handle)
+{
+  NOT_USED(function);
+  NOT_USED(handle);
+}
+
+CONST _kernel_oserror *scheduler_register_token(
+  SchedulerIdleFunction *function, void *handle, SchedulerTime first_call,
+  int priority, SchedulerToken *token)
+{
+  /* There is no null event on the host, so read-ahead never happens */
+  NOT_USED(function);
+  NOT_USED(handle);
+  NOT_USED(first_call);
+  NOT_USED(priority);
+  if (token != NULL)
+    *token = NULL;
+  return NULL;
+}
+
+void scheduler_deregister_token(SchedulerToken token)
+{
+  NOT_USED(token);
+}
+
+void scheduler_reschedule(SchedulerToken token, SchedulerTime next_call)
+{
+  NOT_USED(token);
+  NOT_USED(next_call);
+}
+
+void catcache_store(const char *dir_name, const char *leaf_name,
+                    const OS_File_CatalogueInfo *info)
+{
+  /* The catalogue cache is never enabled */
+  NOT_USED(dir_name);
+  NOT_USED(leaf_name);
+  NOT_USED(info);
+}
+
+CONST _kernel_oserror *os_read_monotonic_time(int *time_now)
+{
+  struct timespec ts;
+
+  assert(time_now != NULL);
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  *time_now = (int)((unsigned long)ts.tv_sec * CentisecondsPerSecond +
+                    (unsigned long)ts.tv_nsec / NanosecondsPerCentisecond);
+  return NULL;
+}
+
+int decode_load_exec(unsigned int load, unsigned int exec,
+                     OS_DateAndTime *utc)
+{
+  if ((load & 0xfff00000) != 0xfff00000)
+  {
+    if (utc != NULL)
+      memset(utc->bytes, 0, sizeof(utc->bytes));
+    return FileType_None;
+  }
+
+  if (utc != NULL)
+  {
+    utc->bytes[0] = exec & 0xff;
+    utc->bytes[1] = (exec >> 8) & 0xff;
+    utc->bytes[2] = (exec >> 16) & 0xff;
+    utc->bytes[3] = (exec >> 24) & 0xff;
+    utc->bytes[4] = load & 0xff;
+  }
+  return (load >> 8) & 0xfff;
+}
+
+CONST _kernel_oserror *messagetrans_error_lookup(MessagesFD *mfd,
+  int errnum, const char *token, size_t n, ...)
+{
+  NOT_USED(mfd);
+  NOT_USED(errnum);
+  NOT_USED(n);
+  return host_error(ErrorNum_NoMem, token);
+}
@@ -0,0 +1,91 @@
+/*
+ * CBLibrary test: Host filing system backend for DirIterator
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* DirHost.h declares functions to control a backend that lets a directory
+   tree iterator read a real directory tree on a POSIX host machine (e.g.
+   Linux). DirHost.c provides stand-ins for the functions of CBOSLib, the
+   scheduler and the catalogue cache that the iterator uses, which read
+   catalogue entries with readdir and fstatat and translate them into RISC
+   OS catalogue information. It must not be linked with the real
+   implementations of those functions, nor with DirSim.c.
+
+   Path names beginning with DIRHOST_ROOT are mapped onto the host
+   directory set by dirhost_set_root, swapping '.' and '/' as RISC OS
+   ports of Unix programs do. A suffix such as ",fff" on the name of a host
+   file gives its file type, and is not part of its leaf name; other files
+   are typed as data. Catalogue entries are returned in the order that
+   readdir returns them, unless dirhost_set_sorted was called to sort them
+   by name as FileCore does. They can be read by several threads at once,
+   each of which keeps its own directories open. */
+
+#ifndef DirHost_h
+#define DirHost_h
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stddef.h>
+
+/* The path name of the root of the host directory tree. */
+#define DIRHOST_ROOT "Host::Root.$"
+
+void dirhost_set_root(const char * /*host_path*/);
+   /*
+    * Sets the host directory onto which DIRHOST_ROOT is mapped and resets
+    * all counters. Any directories left open by earlier calls to read
+    * catalogue entries in the calling thread are closed.
+    */
+
+void dirhost_set_sorted(bool /*sort*/);
+   /*
+    * Sets whether catalogue entries are returned sorted by name without
+    * regard to case, like those of a FileCore directory, rather than in
+    * readdir order. Each directory is then read in full when opened. Any
+    * directories left open in the calling thread are closed.
+    */
+
+size_t dirhost_get_host_path(const char * /*path_name*/,
+                             char       * /*buffer*/,
+                             size_t       /*buff_size*/);
+   /*
+    * Translates a RISC OS path name beginning with DIRHOST_ROOT into the
+    * equivalent host path name. Up to 'buff_size' characters are written
+    * to 'buffer', including the terminating null character.
+    * Returns: the length of the host path name (excluding the terminator),
+    *          or 0 if 'path_name' does not begin with DIRHOST_ROOT.
+    */
+
+unsigned long int dirhost_read_calls(void);
+   /*
+    * Returns: the number of calls to read catalogue entries since the root
+    *          was set.
+    */
+
+unsigned long int dirhost_entries_read(void);
+   /*
+    * Returns: the number of catalogue entries read since the root was set.
+    */
+
+unsigned long int dirhost_dirs_opened(void);
+   /*
+    * Returns: the number of host directories opened since the root was
+    *          set. This is more than the number of directories read only
+    *          if a directory had to be reopened to continue reading it.
+    */
+
+#endif
@@ -0,0 +1,395 @@
+/*
+ * CBLibrary test: Directory iterator benchmarks on a host filing system
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Usage: DirHostBench [<ndirs> <nfiles>]
+          DirHostBench -p <host directory>
+
+   Generates a tree of 'ndirs' sub-directories of 'nfiles' files each in a
+   temporary directory (or uses an existing host directory), iterates over
+   it with and without a pattern, and walks it with one thread and with
+   several, checks the objects visited against an independent walk with
+   nftw and reports the time taken by each. */
+
+/* Needed for nftw, mkdtemp and clock_gettime in strict ISO C mode */
+#define _XOPEN_SOURCE 700
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+/* POSIX headers */
+#include <sys/stat.h>
+#include <ftw.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBOSLib headers */
+#include "OSFile.h"
+
+/* CBLibrary headers */
+#include "DirIter.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "DirHost.h"
+
+enum
+{
+  MaxOpenFDs = 64, /* For nftw */
+  PathBufferSize = 4096,
+  WalkThreads = 4 /* For diriterator_walk, if built to use threads */
+};
+
+typedef struct
+{
+  unsigned long int nobjects;
+  unsigned long int ndirs;
+  unsigned long long int total_length;
+}
+TreeCounts;
+
+static TreeCounts host_counts;
+static const char *host_root;
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static double elapsed_ms(const struct timespec *start)
+{
+  struct timespec end;
+  (void)clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) * 1000.0 +
+         (double)(end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+static int count_host_object(const char *path, const struct stat *st,
+                             int type, struct FTW *ftw)
+{
+  NOT_USED(path);
+  NOT_USED(type);
+  if (ftw->level > 0)
+  {
+    ++host_counts.nobjects;
+    if (S_ISDIR(st->st_mode))
+      ++host_counts.ndirs;
+    else
+      host_counts.total_length += (unsigned long long)st->st_size;
+  }
+  return 0;
+}
+
+static int remove_host_object(const char *path, const struct stat *st,
+                              int type, struct FTW *ftw)
+{
+  NOT_USED(st);
+  NOT_USED(type);
+  NOT_USED(ftw);
+  return remove(path);
+}
+
+static bool make_tree(char *root, unsigned int ndirs, unsigned int nfiles)
+{
+  char path[PathBufferSize];
+
+  if (mkdtemp(root) == NULL)
+  {
+    perror(root);
+    return false;
+  }
+
+  printf("Creating %u directories of %u files in %s...\n", ndirs, nfiles,
+         root);
+
+  for (unsigned int d = 0; d < ndirs; ++d)
+  {
+    sprintf(path, "%s/Dir%u", root, d);
+    if (mkdir(path, 0755) != 0)
+    {
+      perror(path);
+      return false;
+    }
+
+    size_t const dir_len = strlen(path);
+    for (unsigned int f = 0; f < nfiles; ++f)
+    {
+      /* Some names contain '.', which becomes '/' on RISC OS */
+      sprintf(path + dir_len, "/%.*s%u%s", (int)(f % 17),
+              "LongerFileNames__", f, f % 5 ? "" : ".txt");
+      int const fd = open(path, O_CREAT | O_WRONLY, 0644);
+      if (fd < 0)
+      {
+        perror(path);
+        return false;
+      }
+      (void)close(fd);
+    }
+  }
+  return true;
+}
+
+static bool match(const char *pattern, const char *name)
+{
+  for (; *pattern != '\0'; ++pattern, ++name)
+  {
+    if (*pattern == '*')
+    {
+      do
+      {
+        if (match(pattern + 1, name))
+          return true;
+      }
+      while (*name++ != '\0');
+      return false;
+    }
+
+    if (*name == '\0' || (*pattern != '#' &&
+        tolower((unsigned char)*pattern) != tolower((unsigned char)*name)))
+      return false;
+  }
+  return *name == '\0';
+}
+
+static bool bench_iterate(unsigned int flags, const char *pattern)
+{
+  /* Visit every object in the tree, checking that objects are visited
+     depth-first: each object must be in the root or in a directory that
+     is an ancestor of (or is) the object last visited. */
+  static char last[PathBufferSize];
+  TreeCounts counts = {0, 0, 0};
+  DirIterator *it;
+  struct timespec start;
+  bool ok = true;
+
+  dirhost_set_root(host_root);
+  strcpy(last, DIRHOST_ROOT);
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+
+  CONST _kernel_oserror *e = diriterator_make(&it, flags, DIRHOST_ROOT,
+                                              pattern);
+  while (e == NULL && !diriterator_is_empty(it))
+  {
+    DirIteratorPathView view;
+    DirIteratorObjectInfo info;
+
+    if (!diriterator_get_object_path_view(it, &view) ||
+        view.path_name == NULL)
+    {
+      puts("No contiguous path name");
+      ok = false;
+      break;
+    }
+
+    if (strncmp(last, view.dir_path_name, view.dir_path_name_len) != 0 ||
+        (last[view.dir_path_name_len] != '\0' &&
+         last[view.dir_path_name_len] != '.'))
+    {
+      printf("%s visited out of order after %s\n", view.path_name, last);
+      ok = false;
+    }
+
+    if (pattern != NULL && !match(pattern, view.leaf_name))
+    {
+      printf("%s doesn't match %s\n", view.leaf_name, pattern);
+      ok = false;
+    }
+
+    if (view.path_name_len >= sizeof(last))
+    {
+      puts("Path name too long");
+      ok = false;
+      break;
+    }
+    memcpy(last, view.path_name, view.path_name_len + 1);
+
+    ++counts.nobjects;
+    if (diriterator_get_object_info(it, &info) == ObjectType_Directory)
+      ++counts.ndirs;
+    else
+      counts.total_length += (unsigned long)info.length;
+
+    e = diriterator_advance(it);
+  }
+
+  double const ms = elapsed_ms(&start);
+  diriterator_destroy(it);
+
+  if (e != NULL)
+  {
+    printf("Error 0x%x: %s\n", e->errnum, e->errmess);
+    return false;
+  }
+
+  printf("  %-12s: %8lu objects, %7lu calls, %6lu opens, %9.1f ms\n",
+         pattern ? pattern : "(all)", counts.nobjects, dirhost_read_calls(),
+         dirhost_dirs_opened(), ms);
+
+  if (pattern == NULL &&
+      (counts.nobjects != host_counts.nobjects ||
+       counts.ndirs != host_counts.ndirs ||
+       counts.total_length != host_counts.total_length))
+  {
+    printf("Expected %lu objects (%lu directories, %llu bytes), "
+           "got %lu (%lu, %llu)\n", host_counts.nobjects, host_counts.ndirs,
+           host_counts.total_length, counts.nobjects, counts.ndirs,
+           counts.total_length);
+    ok = false;
+  }
+
+  return ok;
+}
+
+static bool count_walked_object(const char *path_name, int object_type,
+                                const DirIteratorObjectInfo *info,
+                                CONST _kernel_oserror *e, void *arg)
+{
+  /* This may be called by several threads at once */
+  TreeCounts *const counts = arg;
+  NOT_USED(path_name);
+
+  if (e != NULL)
+  {
+    printf("Error 0x%x reading %s: %s\n", e->errnum, path_name, e->errmess);
+    return false;
+  }
+
+  (void)__atomic_fetch_add(&counts->nobjects, 1, __ATOMIC_RELAXED);
+  if (object_type == ObjectType_Directory)
+    (void)__atomic_fetch_add(&counts->ndirs, 1, __ATOMIC_RELAXED);
+  else
+    (void)__atomic_fetch_add(&counts->total_length,
+                             (unsigned long long)info->length,
+                             __ATOMIC_RELAXED);
+  return true;
+}
+
+static bool bench_walk(unsigned int nthreads)
+{
+  TreeCounts counts = {0, 0, 0};
+  struct timespec start;
+  char name[16];
+
+  dirhost_set_root(host_root);
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+
+  CONST _kernel_oserror *const e = diriterator_walk(DIRHOST_ROOT, NULL,
+    DirIterator_RecurseIntoDirectories, nthreads, count_walked_object,
+    &counts);
+
+  double const ms = elapsed_ms(&start);
+  if (e != NULL)
+  {
+    printf("Error 0x%x: %s\n", e->errnum, e->errmess);
+    return false;
+  }
+
+  sprintf(name, "walk x%u", nthreads);
+  printf("  %-12s: %8lu objects, %7lu calls, %6lu opens, %9.1f ms\n",
+         name, counts.nobjects, dirhost_read_calls(), dirhost_dirs_opened(),
+         ms);
+
+  if (counts.nobjects != host_counts.nobjects ||
+      counts.ndirs != host_counts.ndirs ||
+      counts.total_length != host_counts.total_length)
+  {
+    printf("Expected %lu objects (%lu directories, %llu bytes), "
+           "got %lu (%lu, %llu)\n", host_counts.nobjects, host_counts.ndirs,
+           host_counts.total_length, counts.nobjects, counts.ndirs,
+           counts.total_length);
+    return false;
+  }
+
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+int main(int argc, char *argv[])
+{
+  static char temp_root[] = "/tmp/DirHostBenchXXXXXX";
+  unsigned int ndirs = 1000, nfiles = 1000;
+  bool ok = true, made = false;
+
+  if (argc == 3 && strcmp(argv[1], "-p") == 0)
+  {
+    host_root = argv[2];
+  }
+  else
+  {
+    if (argc == 3)
+    {
+      ndirs = (unsigned)strtoul(argv[1], NULL, 10);
+      nfiles = (unsigned)strtoul(argv[2], NULL, 10);
+    }
+    else if (argc != 1)
+    {
+      fprintf(stderr, "Usage: %s [<ndirs> <nfiles>] | [-p <dir>]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    ok = made = make_tree(temp_root, ndirs, nfiles);
+    host_root = temp_root;
+  }
+
+  if (ok)
+  {
+    puts("DirIterator host benchmarks");
+    puts("---------------------------");
+
+    struct timespec start;
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    if (nftw(host_root, count_host_object, MaxOpenFDs, FTW_PHYS) != 0)
+    {
+      perror(host_root);
+      ok = false;
+    }
+    else
+    {
+      printf("  %-12s: %8lu objects, %9.1f ms\n", "nftw",
+             host_counts.nobjects, elapsed_ms(&start));
+    }
+  }
+
+  if (ok)
+  {
+    unsigned int const flags = DirIterator_RecurseIntoDirectories |
+                               DirIterator_ContiguousPath;
+
+    ok = bench_iterate(flags, NULL) &&
+         bench_iterate(flags, "*1") &&
+         bench_iterate(flags | DirIterator_SortByName, NULL) &&
+         bench_walk(1) &&
+         bench_walk(WalkThreads);
+  }
+
+  if (made)
+    (void)nftw(temp_root, remove_host_object, MaxOpenFDs,
+               FTW_DEPTH | FTW_PHYS);
+
+  puts(ok ? "Passed" : "Failed");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+/*
+ * CBLibrary test: Directory iterator benchmarks on a simulated filing system
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBLibrary headers */
+#include "DirIter.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "DirSim.h"
+
+enum
+{
+  LocalCallTime = 20,     /* Microseconds of overhead per call to a local
+                             filing system */
+  NetworkCallTime = 5000, /* Microseconds of round-trip time per call to a
+                             network share */
+  EntryTime = 2,          /* Microseconds per catalogue entry read */
+  OldBatchLimit = 16,     /* Equivalent to the old fixed batch size */
+  WorkTime = 200,         /* Microseconds of work done by the client for
+                             each object */
+  IdleTime = 1000000      /* Microseconds for which the client is idle after
+                             visiting every object */
+};
+
+static void bench_scan(unsigned int ndirs, unsigned int nfiles,
+                       unsigned int call_time, unsigned int batch_limit)
+{
+  /* Count the calls needed to read catalogue entries for every object in a
+     tree and the (simulated) time spent in those calls */
+  dirsim_reset(ndirs, nfiles, call_time, EntryTime);
+
+  DirIterator *it;
+  unsigned long int nobjects = 0;
+  CONST _kernel_oserror *e = diriterator_make(&it,
+    DirIterator_RecurseIntoDirectories, DIRSIM_ROOT, NULL);
+
+  if (e == NULL)
+  {
+    diriterator_set_batch_limit(it, batch_limit);
+    for (; e == NULL && !diriterator_is_empty(it);
+         e = diriterator_advance(it))
+    {
+      ++nobjects;
+    }
+    diriterator_destroy(it);
+  }
+  assert(e == NULL);
+  assert(nobjects == ndirs + (unsigned long)ndirs * nfiles);
+  assert(dirsim_entries_read() == nobjects);
+
+  unsigned long int const calls = dirsim_read_calls();
+  printf("  limit %4u: %7lu calls, %.4f calls per entry, %8.1f ms\n",
+         batch_limit, calls, (double)calls / (double)nobjects,
+         (double)dirsim_elapsed() / 1000);
+}
+
+static void bench_read_ahead(unsigned int ndirs, unsigned int nfiles,
+                             unsigned int call_time, unsigned int flags)
+{
+  /* Measure the (simulated) time for which a client that does some work on
+     each object and then yields is blocked waiting for catalogue entries */
+  dirsim_reset(ndirs, nfiles, call_time, EntryTime);
+
+  DirIterator *it;
+  unsigned long int nobjects = 0, blocked = 0, idle_calls = 0;
+  CONST _kernel_oserror *e = diriterator_make(&it,
+    DirIterator_RecurseIntoDirectories | flags, DIRSIM_ROOT, NULL);
+
+  if (e == NULL)
+  {
+    while (e == NULL && !diriterator_is_empty(it))
+    {
+      ++nobjects;
+      dirsim_work(WorkTime);
+      if (dirsim_idle(0))
+        ++idle_calls;
+
+      unsigned long int const start = dirsim_elapsed();
+      e = diriterator_advance(it);
+      blocked += dirsim_elapsed() - start;
+    }
+
+    /* Once there is nothing left to read, the read-ahead function should
+       stop asking to be called, however long the task is idle */
+    (void)dirsim_idle(0);
+    dirsim_work(IdleTime);
+    assert(!dirsim_idle(0));
+
+    diriterator_destroy(it);
+  }
+  assert(e == NULL);
+  assert(nobjects == ndirs + (unsigned long)ndirs * nfiles);
+  assert(dirsim_entries_read() >= nobjects);
+
+  printf("  %-10s: %7lu calls, %8.1f ms blocked of %8.1f ms, "
+         "%7lu idle calls\n",
+         flags & DirIterator_ReadAhead ? "read-ahead" : "on demand",
+         dirsim_read_calls(), (double)blocked / 1000,
+         (double)dirsim_elapsed() / 1000, idle_calls);
+}
+
+int main(void)
+{
+  /* The directory iterator and stand-ins for its dependencies are linked
+     into a separate program because the stand-ins would clash with the
+     real CBOSLib functions used by the main test program. */
+  static const struct
+  {
+    unsigned int ndirs, nfiles;
+  }
+  trees[] =
+  {
+    { 100, 8 },
+    { 20, 300 },
+    { 2, 30000 },
+  };
+  static const unsigned int limits[] = {OldBatchLimit, 256, 4096};
+
+  puts("DirIterator benchmarks");
+  puts("----------------------");
+
+  for (size_t t = 0; t < ARRAY_SIZE(trees); ++t)
+  {
+    for (int network = 0; network < 2; ++network)
+    {
+      printf("%u directories of %u files (%s):\n", trees[t].ndirs,
+             trees[t].nfiles, network ? "network share" : "local disc");
+
+      for (size_t l = 0; l < ARRAY_SIZE(limits); ++l)
+      {
+        bench_scan(trees[t].ndirs, trees[t].nfiles,
+                   network ? NetworkCallTime : LocalCallTime, limits[l]);
+      }
+    }
+  }
+
+  puts("DirIterator read-ahead benchmarks");
+  puts("---------------------------------");
+
+  for (size_t t = 0; t < ARRAY_SIZE(trees); ++t)
+  {
+    printf("%u directories of %u files (network share):\n", trees[t].ndirs,
+           trees[t].nfiles);
+
+    bench_read_ahead(trees[t].ndirs, trees[t].nfiles, NetworkCallTime, 0);
+    bench_read_ahead(trees[t].ndirs, trees[t].nfiles, NetworkCallTime,
+                     DirIterator_ReadAhead);
+  }
+
+  return EXIT_SUCCESS;
+}
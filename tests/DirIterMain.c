@@ -0,0 +1,46 @@
+/*
+ * CBLibrary test: main program for DirIterator tests on the host
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Local headers */
+#include "Tests.h"
+
+int main(void)
+{
+  /* The DirIterator tests are linked with the host filing system backend,
+     whose stand-ins would clash with the real CBOSLib functions used by
+     the main test program. */
+  static const char title[] = "DirIterator";
+  const size_t len = strlen(title);
+
+  puts(title);
+  for (size_t i = 0; i < len; i++)
+      putchar('-');
+  putchar('\n');
+
+  DirIter_tests();
+
+  putchar('\n');
+
+  return EXIT_SUCCESS;
+}
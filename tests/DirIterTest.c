@@ -17,11 +17,27 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  */
 
+#ifdef USE_DIRHOST
+/* Needed for mkdtemp and nftw in strict ISO C mode */
+#define _XOPEN_SOURCE 700
+#endif
+
 /* ISO library headers */
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
+
+#ifdef USE_DIRHOST
+/* POSIX headers */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ftw.h>
+#endif
 
 /* Acorn C/C++ library headers */
 #include "kernel.h"
@@ -33,8 +49,32 @@
 
 /* Local headers */
 #include "Tests.h"
-
-#define EMPTY_PATH "<Wimp$ScrapDir>.DirIterTest.empty"
+#ifdef USE_DIRHOST
+#include "DirHost.h"
+#endif
+
+#ifdef USE_DIRHOST
+/* The test directory is created on the host machine and read through the
+   host filing system backend, which sorts names as FileCore does. */
+#define TEST_PATH DIRHOST_ROOT ".DirIterTest"
+#define HOST_TEMPLATE "/tmp/DirIterTestXXXXXX"
+
+/* Seconds between 1900 (the RISC OS epoch) and 1970 (the Unix epoch) */
+#define EPOCH_OFFSET 2208988800u
+#else
+#define TEST_PATH "<Wimp$ScrapDir>.DirIterTest"
+#endif
+
+#define EMPTY_PATH TEST_PATH ".empty"
+#define MISSING_PATH TEST_PATH ".missing"
+
+#if defined(USE_DIRHOST) && !defined(FORTIFY)
+/* Allocation failures can't be simulated without Fortify, so the fail
+   recovery tests only check that each operation eventually succeeds. */
+#define Fortify_SetNumAllocationsLimit(limit) ((void)(limit))
+#define Fortify_EnterScope() ((void)0)
+#define Fortify_LeaveScope() ((void)0)
+#endif
 
 enum
 {
@@ -48,6 +88,20 @@ enum
   OS_File_Attribute_ReadForYou = 1,
   OS_File_Attribute_WriteForYou = 2,
   ErrorNum_DirectoryDoesNotExist = 214,
+#ifdef USE_DIRHOST
+  /* The host filing system backend reports a directory's length as 0 and
+     its attributes from its host permissions */
+  DirectorySize = 0,
+  DirectoryAttributes = OS_File_Attribute_ReadForYou |
+                        OS_File_Attribute_WriteForYou,
+  HostFileMode = S_IRUSR | S_IWUSR,
+  HostDirMode = S_IRWXU,
+  HostWalkFDs = 16,
+  CentisecondsPerSecond = 100,
+#else
+  DirectorySize = 2048,
+  DirectoryAttributes = 0,
+#endif
   FortifyAllocationLimit = 2048,
   StringBufferSize = 256,
   NumberOfIterators = 5,
@@ -63,47 +117,47 @@ static struct
 test_objects[] =
 {
   {
-    "<Wimp$ScrapDir>.DirIterTest",
+    TEST_PATH,
     FileType_Directory,
     0
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.!foo",
+    TEST_PATH ".!foo",
     FileType_Application,
-    2048
+    DirectorySize
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.!foo.bar",
+    TEST_PATH ".!foo.bar",
     FileType_Squash,
     0
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.!foo.noob",
+    TEST_PATH ".!foo.noob",
     FileType_Data,
     13
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.fee",
+    TEST_PATH ".fee",
     FileType_Text,
     27
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.fi",
+    TEST_PATH ".fi",
     FileType_Obey,
     31
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.foo",
+    TEST_PATH ".foo",
     FileType_Directory,
-    2048
+    DirectorySize
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.foo.fum",
+    TEST_PATH ".foo.fum",
     FileType_Directory,
-    2048
+    DirectorySize
   },
   {
-    "<Wimp$ScrapDir>.DirIterTest.IfMyFella'sInAHurryHe'llNeverHaveToWorryHeKnowsThatI'maNaturalGirlINeverWorryIfI'mShowingWithAllThatI'veGotGoingIJustWashMyFaceForgetAboutCurls!",
+    TEST_PATH ".IfMyFella'sInAHurryHe'llNeverHaveToWorryHeKnowsThatI'maNaturalGirlINeverWorryIfI'mShowingWithAllThatI'veGotGoingIJustWashMyFaceForgetAboutCurls!",
     FileType_Sprite,
     2048
   }
@@ -167,6 +221,72 @@ static bool pattern_match(const char *string, const char *pattern)
   return match;
 }
 
+#ifdef USE_DIRHOST
+
+static char host_dir[] = HOST_TEMPLATE;
+
+static void get_host_path(const char *path_name, char *buffer,
+                          size_t buff_size)
+{
+  assert(path_name != NULL);
+  const size_t n = dirhost_get_host_path(path_name, buffer, buff_size);
+  assert(n > 0);
+  assert(n < buff_size);
+}
+
+static int remove_object(const char *host_path, const struct stat *st,
+                         int flag, struct FTW *ftw)
+{
+  NOT_USED(st);
+  NOT_USED(ftw);
+  return flag == FTW_DP ? rmdir(host_path) : unlink(host_path);
+}
+
+static void wipe(const char *path_name)
+{
+  char host_path[PATH_MAX];
+
+  /* Like *Wipe without the force flag, this doesn't complain if the object
+     doesn't exist */
+  get_host_path(path_name, host_path, sizeof(host_path));
+  (void)nftw(host_path, remove_object, HostWalkFDs, FTW_DEPTH | FTW_PHYS);
+}
+
+static void create_dir(const char *path_name)
+{
+  char host_path[PATH_MAX];
+
+  get_host_path(path_name, host_path, sizeof(host_path));
+  if (mkdir(host_path, HostDirMode) != 0)
+  {
+    perror(host_path);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void create_file(const char *path_name, int type, int size)
+{
+  char host_path[PATH_MAX];
+
+  /* The file type is given by a suffix on the host file name */
+  get_host_path(path_name, host_path, sizeof(host_path));
+  const size_t len = strlen(host_path);
+  const int n = snprintf(host_path + len, sizeof(host_path) - len, ",%03x",
+                         (unsigned int)type);
+  assert(n >= 0);
+  assert((size_t)n < sizeof(host_path) - len);
+
+  const int fd = open(host_path, O_WRONLY | O_CREAT | O_TRUNC, HostFileMode);
+  if (fd < 0 || ftruncate(fd, size) != 0)
+  {
+    perror(host_path);
+    exit(EXIT_FAILURE);
+  }
+  (void)close(fd);
+}
+
+#else /* USE_DIRHOST */
+
 static void wipe(const char *path_name)
 {
   _kernel_swi_regs regs;
@@ -211,10 +331,22 @@ static void create_file(const char *path_name, int type, int size)
   osfile(OS_File_CreateStampedFile, path_name, &inout);
 }
 
+#endif /* USE_DIRHOST */
+
 static void init(void)
 {
   unsigned int i;
 
+#ifdef USE_DIRHOST
+  if (mkdtemp(host_dir) == NULL)
+  {
+    perror(host_dir);
+    exit(EXIT_FAILURE);
+  }
+  dirhost_set_root(host_dir);
+  dirhost_set_sorted(true);
+#endif
+
   wipe(test_objects[0].name);
 
   for (i = 0; i < ARRAY_SIZE(test_objects); ++i)
@@ -238,8 +370,35 @@ static void init(void)
 static void final(void)
 {
   wipe(test_objects[0].name);
+
+#ifdef USE_DIRHOST
+  (void)rmdir(host_dir);
+#endif
+}
+
+#ifdef USE_DIRHOST
+
+static int date_and_time_to_string(OSDateAndTime *utc,
+                                   char *buffer,
+                                   size_t buff_size)
+{
+  /* Centiseconds since 1900, as a 40-bit number */
+  unsigned long long cs = 0;
+  for (size_t i = ARRAY_SIZE(utc->bytes); i-- > 0; )
+    cs = (cs << 8) | utc->bytes[i];
+
+  const time_t seconds = (time_t)(cs / CentisecondsPerSecond - EPOCH_OFFSET);
+  const struct tm *const tm = gmtime(&seconds);
+  if (tm == NULL)
+    return -1;
+
+  const size_t nchars = strftime(buffer, buff_size, "%H:%M:%S %d %b %Y", tm);
+
+  return nchars > 0 ? (int)nchars : -1;
 }
 
+#else /* USE_DIRHOST */
+
 static int date_and_time_to_string(OSDateAndTime *utc,
                                    char *buffer,
                                    size_t buff_size)
@@ -264,6 +423,8 @@ static int date_and_time_to_string(OSDateAndTime *utc,
   return nchars;
 }
 
+#endif /* USE_DIRHOST */
+
 static void validate_object_info(DirIteratorObjectInfo *info, int object_type, size_t i)
 {
   unsigned int expected_attributes;
@@ -271,10 +432,6 @@ static void validate_object_info(DirIteratorObjectInfo *info, int object_type, s
 
   assert(i < ARRAY_SIZE(test_objects));
 
-  int n = date_and_time_to_string(
-                   &info->date_stamp, buffer, sizeof(buffer));
-  assert(n >= 0);
-  assert(n < (int)sizeof(buffer));
   printf("object type: %d\n", object_type);
 
   switch (test_objects[i].type)
@@ -282,7 +439,7 @@ static void validate_object_info(DirIteratorObjectInfo *info, int object_type, s
     case FileType_Directory:
     case FileType_Application:
       assert(object_type == ObjectType_Directory);
-      expected_attributes = 0;
+      expected_attributes = DirectoryAttributes;
       break;
 
     default:
@@ -294,7 +451,8 @@ static void validate_object_info(DirIteratorObjectInfo *info, int object_type, s
 
   if (info != NULL)
   {
-    n = date_and_time_to_string(&info->date_stamp, buffer, sizeof(buffer));
+    const int n = date_and_time_to_string(&info->date_stamp, buffer,
+                                          sizeof(buffer));
     assert(n >= 0);
     assert(n < (int)sizeof(buffer));
     printf("date stamp:%s\nlength: %ld\nattributes: 0x%x\nfile type: 0x%x\n",
@@ -541,7 +699,7 @@ static void test8(void)
   /* Make from missing directory without recursion */
   DirIterator *it;
   const _kernel_oserror * const e = diriterator_make(
-    &it, 0, "<Wimp$ScrapDir>.DirIterTest.missing", NULL);
+    &it, 0, MISSING_PATH, NULL);
   assert(e != NULL);
   assert(e->errnum == ErrorNum_DirectoryDoesNotExist);
   assert(it == NULL);
@@ -552,7 +710,7 @@ static void test9(void)
   /* Make from missing directory with recursion */
   DirIterator *it;
   const _kernel_oserror * const e = diriterator_make(
-    &it, DirIterator_RecurseIntoDirectories, "<Wimp$ScrapDir>.DirIterTest.missing", NULL);
+    &it, DirIterator_RecurseIntoDirectories, MISSING_PATH, NULL);
   assert(e != NULL);
   assert(e->errnum == ErrorNum_DirectoryDoesNotExist);
   assert(it == NULL);
@@ -917,6 +1075,470 @@ static void test22(void)
   diriterator_destroy(NULL);
 }
 
+typedef struct
+{
+  unsigned int visited; /* One bit per element of test_objects */
+  unsigned int count;
+  unsigned int limit; /* Number of objects after which to stop, or 0 */
+  unsigned int nerrors; /* Number of directories that couldn't be read */
+  int errnum; /* Number of the last error */
+}
+WalkState;
+
+static bool walk_callback(const char *path_name, int object_type,
+                          const DirIteratorObjectInfo *info,
+                          const _kernel_oserror *e, void *arg)
+{
+  WalkState *const state = arg;
+  size_t i;
+
+  assert(path_name != NULL);
+  assert(state != NULL);
+  puts(path_name);
+
+  if (e != NULL)
+  {
+    /* Carry on with the rest of the tree */
+    assert(object_type == ObjectType_NotFound);
+    assert(info == NULL);
+    ++state->nerrors;
+    state->errnum = e->errnum;
+    return true;
+  }
+
+  assert(info != NULL);
+
+  /* Each object should be visited exactly once, and never the root */
+  for (i = 1; i < ARRAY_SIZE(test_objects); ++i)
+  {
+    if (strcmp(path_name, test_objects[i].name) == 0)
+      break;
+  }
+  assert(i < ARRAY_SIZE(test_objects));
+  assert(!(state->visited & (1u << i)));
+  state->visited |= 1u << i;
+  ++state->count;
+
+  DirIteratorObjectInfo copy = *info;
+  validate_object_info(&copy, object_type, i);
+
+  return state->count != state->limit;
+}
+
+static void test23(void)
+{
+  /* Walk */
+  WalkState state = {0, 0, 0, 0, 0};
+
+  const _kernel_oserror *const e = diriterator_walk(test_objects[0].name,
+    NULL, DirIterator_RecurseIntoDirectories, 1, walk_callback, &state);
+  assert(e == NULL);
+  assert(state.count == ARRAY_SIZE(test_objects) - 1);
+  assert(state.nerrors == 0);
+}
+
+static void test24(void)
+{
+  /* Walk stopped by callback */
+  WalkState state = {0, 0, 2, 0, 0};
+
+  const _kernel_oserror *const e = diriterator_walk(test_objects[0].name,
+    NULL, DirIterator_RecurseIntoDirectories, 1, walk_callback, &state);
+  assert(e == NULL);
+  assert(state.count == 2);
+  assert(state.nerrors == 0);
+}
+
+static void test25(void)
+{
+  /* Walk missing directory */
+  WalkState state = {0, 0, 0, 0, 0};
+
+  /* The error is passed to the callback instead of being returned */
+  const _kernel_oserror *const e = diriterator_walk(
+    MISSING_PATH, NULL,
+    DirIterator_RecurseIntoDirectories, 1, walk_callback, &state);
+  assert(e == NULL);
+  assert(state.nerrors == 1);
+  assert(state.errnum == ErrorNum_DirectoryDoesNotExist);
+  assert(state.count == 0);
+}
+
+static void test26(void)
+{
+  /* Rebind */
+  DirIterator *it;
+  size_t i;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories, test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  for (i = 1; !diriterator_is_empty(it); ++i)
+  {
+    validate_object(it, i);
+    e = diriterator_advance(it);
+    assert(e == NULL);
+  }
+
+  /* Rebind to a sub-directory containing one object */
+  e = diriterator_rebind(it, test_objects[6].name);
+  assert(e == NULL);
+  assert(!diriterator_is_empty(it));
+
+  char buffer[StringBufferSize];
+  const size_t n = diriterator_get_object_path_name(it, buffer, sizeof(buffer));
+  assert(n == strlen(test_objects[7].name));
+  assert(strcmp(buffer, test_objects[7].name) == 0);
+
+  e = diriterator_advance(it);
+  assert(e == NULL);
+  assert(diriterator_is_empty(it));
+
+  /* Rescanning the original tree should not allocate any memory */
+  Fortify_SetNumAllocationsLimit(0);
+  e = diriterator_rebind(it, test_objects[0].name);
+  assert(e == NULL);
+
+  for (i = 1; !diriterator_is_empty(it); ++i)
+  {
+    validate_object(it, i);
+    e = diriterator_advance(it);
+    assert(e == NULL);
+  }
+  Fortify_SetNumAllocationsLimit(ULONG_MAX);
+
+  /* Check that the iterator didn't become empty too early */
+  assert(i >= ARRAY_SIZE(test_objects));
+
+  diriterator_destroy(it);
+}
+
+static void test27(void)
+{
+  /* Rebind to missing directory */
+  DirIterator *it;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories, test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  e = diriterator_rebind(it, MISSING_PATH);
+  assert(e != NULL);
+  assert(e->errnum == ErrorNum_DirectoryDoesNotExist);
+  check_empty(it);
+
+  e = diriterator_rebind(it, test_objects[0].name);
+  assert(e == NULL);
+  validate_object(it, 1);
+
+  diriterator_destroy(it);
+}
+
+static void validate_view(const DirIterator *it, size_t root, size_t i,
+                          bool contiguous)
+{
+  DirIteratorPathView view;
+
+  assert(it != NULL);
+  assert(root < i);
+  assert(i < ARRAY_SIZE(test_objects));
+
+  assert(diriterator_get_object_path_view(it, &view));
+
+  /* The directory and leaf name must make up the expected path name */
+  const char *const expected = test_objects[i].name;
+  const size_t root_len = strlen(test_objects[root].name);
+  assert(view.root_path_name_len == root_len);
+  assert(view.dir_path_name_len >= root_len);
+  assert(view.dir_path_name_len + 1 + view.leaf_name_len == strlen(expected));
+  assert(strncmp(view.dir_path_name, expected, view.dir_path_name_len) == 0);
+  assert(expected[view.dir_path_name_len] == '.');
+  assert(strcmp(view.leaf_name, expected + view.dir_path_name_len + 1) == 0);
+
+  if (contiguous)
+  {
+    assert(view.path_name != NULL);
+    assert(view.path_name_len == strlen(expected));
+    assert(strcmp(view.path_name, expected) == 0);
+
+    assert(view.sub_path_name != NULL);
+    assert(view.sub_path_name_len == strlen(expected) - root_len - 1);
+    assert(strcmp(view.sub_path_name, expected + root_len + 1) == 0);
+  }
+  else
+  {
+    assert(view.path_name == NULL);
+    assert(view.sub_path_name == NULL);
+  }
+}
+
+static void test28(void)
+{
+  /* Get path view */
+  DirIterator *it;
+  size_t i;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories, test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  for (i = 1; !diriterator_is_empty(it); ++i)
+  {
+    validate_view(it, 0, i, false);
+    validate_object(it, i);
+    e = diriterator_advance(it);
+    assert(e == NULL);
+  }
+
+  assert(i >= ARRAY_SIZE(test_objects));
+
+  /* The view should not be modified if the iterator is empty */
+  DirIteratorPathView view = { NULL, 0, 0, NULL, 0, NULL, 0, NULL, 0 };
+  assert(!diriterator_get_object_path_view(it, &view));
+  assert(view.dir_path_name == NULL);
+
+  diriterator_destroy(it);
+}
+
+static void test29(void)
+{
+  /* Get path view with contiguous path */
+  DirIterator *it;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories | DirIterator_ContiguousPath,
+    test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  /* Gradually increase the number of advances between resets */
+  for (size_t j = 1; !diriterator_is_empty(it); ++j)
+  {
+    size_t i;
+
+    for (e = diriterator_reset(it), i = 1;
+         !diriterator_is_empty(it) && i <= j;
+         e = diriterator_advance(it), ++i)
+    {
+      assert(e == NULL);
+
+      /* The other getters must not be confused by the leaf name at the
+         end of the iterator's path name buffer */
+      validate_view(it, 0, i, true);
+      validate_object(it, i);
+    }
+    assert(e == NULL);
+  }
+
+  /* Rebinding must not leave a stale leaf name in the buffer */
+  e = diriterator_rebind(it, test_objects[6].name);
+  assert(e == NULL);
+  validate_view(it, 6, 7, true);
+
+  diriterator_destroy(it);
+}
+
+static void test30(void)
+{
+  /* Advance with contiguous path fail recovery */
+  DirIterator *it;
+  size_t i;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories | DirIterator_ContiguousPath,
+    test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  for (i = 1; !diriterator_is_empty(it); ++i)
+  {
+    unsigned long limit;
+
+    for (limit = 0; limit < FortifyAllocationLimit; ++limit)
+    {
+      Fortify_SetNumAllocationsLimit(limit);
+      e = diriterator_advance(it);
+      Fortify_SetNumAllocationsLimit(ULONG_MAX);
+
+      if (e == NULL)
+        break; /* success - validate the next object */
+
+      /* The current object should be unchanged */
+      validate_object(it, i);
+    }
+    assert(limit != FortifyAllocationLimit);
+
+    if (!diriterator_is_empty(it))
+    {
+      /* The full path name may be unavailable if memory ran out */
+      DirIteratorPathView view;
+      assert(diriterator_get_object_path_view(it, &view));
+      validate_view(it, 0, i + 1, view.path_name != NULL);
+      validate_object(it, i + 1);
+    }
+  }
+
+  assert(i >= ARRAY_SIZE(test_objects));
+  check_empty(it);
+
+  diriterator_destroy(it);
+}
+
+static void check_order(unsigned int flags, const DirIteratorFilter *filter,
+                        const size_t *expected, size_t nexpected)
+{
+  DirIterator *it;
+  size_t i;
+  const _kernel_oserror *e = diriterator_make(
+    &it, flags, test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  if (filter != NULL)
+  {
+    e = diriterator_set_filter(it, filter);
+    assert(e == NULL);
+  }
+
+  for (i = 0; !diriterator_is_empty(it); ++i)
+  {
+    assert(i < nexpected);
+    validate_object(it, expected[i]);
+    e = diriterator_advance(it);
+    assert(e == NULL);
+  }
+  assert(i == nexpected);
+
+  diriterator_destroy(it);
+}
+
+static void test31(void)
+{
+  /* Sort by name */
+  static const size_t ascending[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  static const size_t descending[] = { 8, 6, 7, 5, 4, 1, 3, 2 };
+
+  check_order(DirIterator_RecurseIntoDirectories | DirIterator_SortByName,
+              NULL, ascending, ARRAY_SIZE(ascending));
+
+  check_order(DirIterator_RecurseIntoDirectories | DirIterator_SortByName |
+              DirIterator_SortDescending,
+              NULL, descending, ARRAY_SIZE(descending));
+}
+
+static void test32(void)
+{
+  /* Sort by length */
+#ifdef USE_DIRHOST
+  static const size_t expected[] = { 1, 6, 4, 5, 8 };
+#else
+  static const size_t expected[] = { 4, 5, 1, 6, 8 };
+#endif
+
+  check_order(DirIterator_SortByLength, NULL, expected, ARRAY_SIZE(expected));
+}
+
+static void test33(void)
+{
+  /* Filter by file type and length */
+  static const size_t text[] = { 4 };
+  static const size_t text_recurse[] = { 1, 4, 6, 7 };
+  static const size_t small[] = { 4, 5 };
+  DirIteratorFilter filter;
+
+  filter.flags = DirIteratorFilter_FileType;
+  filter.file_type = FileType_Text;
+  check_order(0, &filter, text, ARRAY_SIZE(text));
+
+  /* Directories are never skipped if recursing into them */
+  check_order(DirIterator_RecurseIntoDirectories, &filter, text_recurse,
+              ARRAY_SIZE(text_recurse));
+
+  filter.flags = DirIteratorFilter_Length;
+  filter.min_length = 20;
+  filter.max_length = 40;
+  check_order(DirIterator_SortByName, &filter, small, ARRAY_SIZE(small));
+}
+
+typedef struct
+{
+  size_t count;
+  size_t stop_after;
+}
+VisitState;
+
+static bool visit_cb(const DirIterator *it, void *arg)
+{
+  VisitState *const state = arg;
+
+  assert(state != NULL);
+  assert(state->count + 1 < ARRAY_SIZE(test_objects));
+  validate_object(it, ++state->count);
+  return state->count != state->stop_after;
+}
+
+static void test34(void)
+{
+  /* Advance until time up */
+  DirIterator *it;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories, test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  /* One object should be visited per call if time is already up */
+  volatile bool time_up = true;
+  VisitState state = { 0, 0 };
+  unsigned int progress = diriterator_get_progress(it);
+  assert(progress < 100);
+
+  while (!diriterator_is_empty(it))
+  {
+    const size_t old_count = state.count;
+    e = diriterator_advance_until(it, &time_up, visit_cb, &state);
+    assert(e == NULL);
+    assert(state.count == old_count + 1);
+
+    progress = diriterator_get_progress(it);
+    assert(progress <= 100);
+  }
+  assert(state.count == ARRAY_SIZE(test_objects) - 1);
+  assert(progress == 100);
+
+  /* All objects should be visited in one call if time is never up */
+  e = diriterator_reset(it);
+  assert(e == NULL);
+  time_up = false;
+  state.count = 0;
+  e = diriterator_advance_until(it, &time_up, visit_cb, &state);
+  assert(e == NULL);
+  assert(state.count == ARRAY_SIZE(test_objects) - 1);
+  assert(diriterator_is_empty(it));
+
+  diriterator_destroy(it);
+}
+
+static void test35(void)
+{
+  /* Advance until stopped by callback */
+  DirIterator *it;
+  const _kernel_oserror *e = diriterator_make(
+    &it, DirIterator_RecurseIntoDirectories, test_objects[0].name, NULL);
+  assert(e == NULL);
+  assert(it != NULL);
+
+  volatile bool time_up = false;
+  VisitState state = { 0, 3 };
+  e = diriterator_advance_until(it, &time_up, visit_cb, &state);
+  assert(e == NULL);
+  assert(state.count == 3);
+
+  /* The iterator should not have advanced past the object at which the
+     callback stopped */
+  validate_object(it, 3);
+
+  diriterator_destroy(it);
+}
+
 void DirIter_tests(void)
 {
   static const struct
@@ -947,7 +1569,20 @@ void DirIter_tests(void)
     { "Advance fail recovery", test19 },
     { "Reset", test20 },
     { "Reset fail recovery", test21 },
-    { "Destroy null", test22 }
+    { "Destroy null", test22 },
+    { "Walk", test23 },
+    { "Walk stopped by callback", test24 },
+    { "Walk missing directory", test25 },
+    { "Rebind", test26 },
+    { "Rebind to missing directory", test27 },
+    { "Get path view", test28 },
+    { "Get path view with contiguous path", test29 },
+    { "Advance with contiguous path fail recovery", test30 },
+    { "Sort by name", test31 },
+    { "Sort by length", test32 },
+    { "Filter by file type and length", test33 },
+    { "Advance until time up", test34 },
+    { "Advance until stopped by callback", test35 }
   };
 
   init();
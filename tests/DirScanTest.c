@@ -0,0 +1,236 @@
+/*
+ * CBLibrary test: Background directory scan on a simulated filing system
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBLibrary headers */
+#include "DirIter.h"
+#include "DirScan.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "DirSim.h"
+
+enum
+{
+  NumberOfDirs = 20,
+  FilesPerDir = 50,
+  NumberOfObjects = NumberOfDirs + NumberOfDirs * FilesPerDir,
+  CallTime = 500,  /* Microseconds per simulated call to read catalogue
+                      entries */
+  EntryTime = 2,   /* Microseconds per catalogue entry read */
+  WorkTime = 100,  /* Microseconds of work done by the visitor for each
+                      object */
+  TimeSlice = 2000, /* Microseconds before 'time_up' becomes true */
+  StopAfter = 123,  /* Number of objects to visit before stopping */
+  MaxIdleCalls = NumberOfObjects + 1 /* In case the scan never finishes */
+};
+
+typedef struct
+{
+  unsigned long int nvisited;
+  unsigned long int stop_after; /* 0 to visit every object */
+  int nfinished;
+  CONST _kernel_oserror *e;
+}
+ScanState;
+
+static bool count_object(const DirIterator *iterator, void *arg)
+{
+  ScanState *const state = arg;
+  assert(state != NULL);
+  assert(state->nfinished == 0);
+  assert(!diriterator_is_empty(iterator));
+  NOT_USED(iterator);
+
+  dirsim_work(WorkTime);
+  ++state->nvisited;
+
+  return state->stop_after == 0 || state->nvisited < state->stop_after;
+}
+
+static void scan_finished(CONST _kernel_oserror *e, void *arg)
+{
+  ScanState *const state = arg;
+  assert(state != NULL);
+  ++state->nfinished;
+  state->e = e;
+}
+
+static DirScan *start(ScanState *state, unsigned long int stop_after)
+{
+  *state = (ScanState){
+    .nvisited = 0,
+    .stop_after = stop_after,
+    .nfinished = 0,
+    .e = NULL
+  };
+
+  dirsim_reset(NumberOfDirs, FilesPerDir, CallTime, EntryTime);
+
+  DirScan *scan;
+  CONST _kernel_oserror *const e = dirscan_start(&scan,
+    DirIterator_RecurseIntoDirectories, DIRSIM_ROOT, NULL, count_object,
+    scan_finished, state);
+  assert(e == NULL);
+  NOT_USED(e);
+  assert(scan != NULL);
+
+  /* Nothing is visited until the task is idle */
+  assert(state->nvisited == 0);
+  assert(dirscan_get_progress(scan) == 0);
+  return scan;
+}
+
+static int run(DirScan *scan, ScanState *state)
+{
+  /* Keep the task idle until the scan finishes, checking the progress
+     between time slices */
+  unsigned int last_progress = dirscan_get_progress(scan);
+  int ncalls = 0;
+
+  while (state->nfinished == 0)
+  {
+    assert(ncalls < MaxIdleCalls);
+    unsigned long int const before = state->nvisited;
+    bool const called = dirsim_idle(TimeSlice);
+    assert(called);
+    NOT_USED(called);
+    ++ncalls;
+
+    /* Each time slice should make progress */
+    assert(state->nvisited > before);
+    NOT_USED(before);
+
+    if (state->nfinished == 0)
+    {
+      unsigned int const progress = dirscan_get_progress(scan);
+      assert(progress >= last_progress);
+      assert(progress <= 100);
+      last_progress = progress;
+    }
+  }
+
+  /* The scan was destroyed before the finished function was called */
+  assert(state->nfinished == 1);
+  assert(!dirsim_idle(TimeSlice));
+  return ncalls;
+}
+
+static void test1(void)
+{
+  /* Finish after visiting every object */
+  ScanState state;
+  DirScan *const scan = start(&state, 0);
+  int const ncalls = run(scan, &state);
+
+  printf("%lu objects visited in %d time slices\n", state.nvisited, ncalls);
+  assert(state.e == NULL);
+  assert(state.nvisited == NumberOfObjects);
+  assert(ncalls > 1);
+}
+
+static void test2(void)
+{
+  /* Stopped by the visitor */
+  ScanState state;
+  DirScan *const scan = start(&state, StopAfter);
+  (void)run(scan, &state);
+
+  assert(state.e == NULL);
+  assert(state.nvisited == StopAfter);
+}
+
+static void test3(void)
+{
+  /* Stop mid-scan */
+  ScanState state;
+  DirScan *const scan = start(&state, 0);
+
+  unsigned int last_progress = 0;
+  for (int n = 0; n < 3; ++n)
+  {
+    bool const called = dirsim_idle(TimeSlice);
+    assert(called);
+    NOT_USED(called);
+
+    unsigned int const progress = dirscan_get_progress(scan);
+    assert(progress >= last_progress);
+    last_progress = progress;
+  }
+
+  unsigned long int const nvisited = state.nvisited;
+  assert(nvisited > 0);
+  assert(nvisited < NumberOfObjects);
+  NOT_USED(nvisited);
+
+  dirscan_stop(scan);
+
+  /* Nothing more is visited and the finished function isn't called */
+  assert(!dirsim_idle(TimeSlice));
+  assert(state.nvisited == nvisited);
+  assert(state.nfinished == 0);
+}
+
+static void test4(void)
+{
+  /* Stop null */
+  dirscan_stop(NULL);
+}
+
+int main(void)
+{
+  /* DirScan, the directory iterator and stand-ins for their dependencies
+     are linked into a separate program because the stand-ins would clash
+     with the real CBOSLib functions used by the main test program. */
+  static const struct
+  {
+    const char *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Scan to completion", test1 },
+    { "Stopped by visitor", test2 },
+    { "Stop mid-scan", test3 },
+    { "Stop null", test4 }
+  };
+
+  puts("DirScan");
+  puts("-------");
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); count ++)
+  {
+    printf("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    unit_tests[count].test_func();
+  }
+
+  return EXIT_SUCCESS;
+}
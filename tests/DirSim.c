@@ -0,0 +1,317 @@
+/*
+ * CBLibrary test: Simulated filing system for DirIterator
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSGBPB.h"
+#include "OSReadTime.h"
+#include "OSWord.h"
+
+/* CBLibrary headers */
+#include "Macros.h"
+#include "Scheduler.h"
+#include "CatCache.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "DirSim.h"
+
+enum
+{
+  MicrosecondsPerTick = 10000,
+  ErrorNum_NoMem = 1,
+  ErrorNum_BufferOverflow = 484,
+  ErrorNum_NotFound = 214,
+  MaxNameLen = 31,
+  FileAttributes = 0x33, /* WR/wr */
+  FileLength = 1024
+};
+
+static unsigned int sub_dirs, files_per_dir, call_cost, entry_cost;
+static unsigned long int read_calls, entries_read, now_us;
+/* The only client of the stand-in scheduler */
+struct SchedulerClient
+{
+  SchedulerIdleFunction *function;
+  void *handle;
+  SchedulerTime due;
+};
+static struct SchedulerClient idle_client;
+static volatile bool time_up;
+static unsigned long int time_up_at;
+
+/* ----------------------------------------------------------------------- */
+/*                         Simulation control                              */
+
+void dirsim_reset(unsigned int ndirs, unsigned int nfiles,
+                  unsigned int call_time, unsigned int entry_time)
+{
+  sub_dirs = ndirs;
+  files_per_dir = nfiles;
+  call_cost = call_time;
+  entry_cost = entry_time;
+  read_calls = 0;
+  entries_read = 0;
+  now_us = 0;
+}
+
+unsigned long int dirsim_read_calls(void)
+{
+  return read_calls;
+}
+
+unsigned long int dirsim_entries_read(void)
+{
+  return entries_read;
+}
+
+unsigned long int dirsim_elapsed(void)
+{
+  return now_us;
+}
+
+static void advance_clock(unsigned long int microseconds)
+{
+  now_us += microseconds;
+  if (now_us >= time_up_at)
+    time_up = true;
+}
+
+void dirsim_work(unsigned int microseconds)
+{
+  advance_clock(microseconds);
+}
+
+bool dirsim_idle(unsigned int time_slice)
+{
+  SchedulerTime const time_now = (SchedulerTime)(now_us / MicrosecondsPerTick);
+
+  if (idle_client.function == NULL || time_now - idle_client.due < 0)
+    return false;
+
+  time_up_at = now_us + time_slice;
+  time_up = (time_slice == 0);
+  idle_client.due = idle_client.function(idle_client.handle, time_now,
+                                         &time_up);
+  return true;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static unsigned int get_entry(bool is_root, unsigned int index,
+                              char (*name)[MaxNameLen + 1])
+{
+  /* Sub-directories are all named alike but file names vary in length
+     from a few characters to about twice the typical RISC OS length. */
+  if (is_root)
+  {
+    sprintf(*name, "Dir%u", index);
+    return ObjectType_Directory;
+  }
+
+  sprintf(*name, "%.*s%u", (int)(index % 17), "LongerFileNames__", index);
+  return ObjectType_File;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                 Stand-ins for the functions of other modules            */
+
+CONST _kernel_oserror *os_gbpb_read_cat_no_path(const char *dir_name,
+  void *buffer, size_t buff_size, unsigned int *n, int *position,
+  const char *pattern)
+{
+  static _kernel_oserror error;
+  const size_t root_len = strlen(DIRSIM_ROOT);
+
+  assert(dir_name != NULL);
+  assert(buffer != NULL);
+  assert(n != NULL);
+  assert(*n > 0);
+  assert(position != NULL);
+  assert(*position >= 0);
+  assert(pattern == NULL);
+  NOT_USED(pattern);
+
+  ++read_calls;
+  advance_clock(call_cost);
+
+  /* Find the number of entries in the named directory */
+  bool const is_root = (strcmp(dir_name, DIRSIM_ROOT) == 0);
+  unsigned int nentries = 0;
+  if (is_root)
+  {
+    nentries = sub_dirs;
+  }
+  else if (strncmp(dir_name, DIRSIM_ROOT, root_len) == 0 &&
+           dir_name[root_len] == '.' &&
+           strncmp(dir_name + root_len + 1, "Dir", 3) == 0)
+  {
+    nentries = files_per_dir;
+  }
+  else
+  {
+    error.errnum = ErrorNum_NotFound;
+    strcpy(error.errmess, "Not found");
+    return &error;
+  }
+
+  /* Copy as many entries as were requested and will fit */
+  char *write = buffer;
+  unsigned int index = (unsigned)*position, count = 0;
+  while (count < *n && index < nentries)
+  {
+    char name[MaxNameLen + 1];
+    unsigned int const object_type = get_entry(is_root, index, &name);
+    size_t const name_size = strlen(name) + 1;
+    size_t const entry_size = offsetof(OS_GBPB_CatalogueInfo, name) +
+                              WORD_ALIGN(name_size);
+
+    if (entry_size > buff_size - (size_t)(write - (char *)buffer))
+      break;
+
+    OS_GBPB_CatalogueInfo *const entry = (OS_GBPB_CatalogueInfo *)write;
+    entry->info.load = 0xfffffd00;
+    entry->info.exec = index;
+    entry->info.length = object_type == ObjectType_File ? FileLength : 0;
+    entry->info.attributes = FileAttributes;
+    entry->info.object_type = object_type;
+    memcpy(entry->name, name, name_size);
+
+    write += entry_size;
+    ++index;
+    ++count;
+  }
+
+  advance_clock((unsigned long)entry_cost * count);
+
+  if (count == 0 && index < nentries)
+  {
+    error.errnum = ErrorNum_BufferOverflow;
+    strcpy(error.errmess, "Buffer overflow");
+    return &error;
+  }
+
+  entries_read += count;
+  *n = count;
+  *position = index < nentries ? (int)index : OS_GBPB_ReadCat_PositionEnd;
+  return NULL;
+}
+
+CONST _kernel_oserror *scheduler_register_delay(
+  SchedulerIdleFunction *function, void *handle, SchedulerTime delay,
+  int priority)
+{
+  return scheduler_register_token(function, handle,
+    (SchedulerTime)(now_us / MicrosecondsPerTick) + delay, priority, NULL);
+}
+
+void scheduler_deregister(SchedulerIdleFunction *function, void *handle)
+{
+  assert(function == idle_client.function);
+  assert(handle == idle_client.handle);
+  NOT_USED(function);
+  NOT_USED(handle);
+  scheduler_deregister_token(&idle_client);
+}
+
+CONST _kernel_oserror *scheduler_register_token(
+  SchedulerIdleFunction *function, void *handle, SchedulerTime first_call,
+  int priority, SchedulerToken *token)
+{
+  assert(function != NULL);
+  assert(idle_client.function == NULL);
+  NOT_USED(priority);
+  idle_client.function = function;
+  idle_client.handle = handle;
+  idle_client.due = first_call;
+  if (token != NULL)
+    *token = &idle_client;
+  return NULL;
+}
+
+void scheduler_deregister_token(SchedulerToken token)
+{
+  assert(token == &idle_client);
+  NOT_USED(token);
+  idle_client.function = NULL;
+  idle_client.handle = NULL;
+}
+
+void scheduler_reschedule(SchedulerToken token, SchedulerTime next_call)
+{
+  assert(token == &idle_client);
+  assert(idle_client.function != NULL);
+  NOT_USED(token);
+  idle_client.due = next_call;
+}
+
+void catcache_store(const char *dir_name, const char *leaf_name,
+                    const OS_File_CatalogueInfo *info)
+{
+  /* The catalogue cache is never enabled */
+  NOT_USED(dir_name);
+  NOT_USED(leaf_name);
+  NOT_USED(info);
+}
+
+CONST _kernel_oserror *os_read_monotonic_time(int *time_now)
+{
+  assert(time_now != NULL);
+  *time_now = (int)(now_us / MicrosecondsPerTick);
+  return NULL;
+}
+
+int decode_load_exec(unsigned int load, unsigned int exec,
+                     OS_DateAndTime *utc)
+{
+  /* All simulated objects are date-stamped */
+  assert((load & 0xfff00000) == 0xfff00000);
+  if (utc != NULL)
+  {
+    utc->bytes[0] = exec & 0xff;
+    utc->bytes[1] = (exec >> 8) & 0xff;
+    utc->bytes[2] = (exec >> 16) & 0xff;
+    utc->bytes[3] = (exec >> 24) & 0xff;
+    utc->bytes[4] = load & 0xff;
+  }
+  return (load >> 8) & 0xfff;
+}
+
+CONST _kernel_oserror *messagetrans_error_lookup(MessagesFD *mfd,
+  int errnum, const char *token, size_t n, ...)
+{
+  static _kernel_oserror error;
+  NOT_USED(mfd);
+  NOT_USED(errnum);
+  NOT_USED(n);
+  error.errnum = ErrorNum_NoMem;
+  strncpy(error.errmess, token, sizeof(error.errmess) - 1);
+  return &error;
+}
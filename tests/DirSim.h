@@ -0,0 +1,81 @@
+/*
+ * CBLibrary test: Simulated filing system for DirIterator
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* DirSim.h declares functions to control a simulated filing system on
+   which a directory tree iterator can be benchmarked. DirSim.c provides
+   stand-ins for the functions of CBOSLib, the scheduler and the catalogue
+   cache that the iterator uses, which read catalogue entries from the
+   simulated filing system and a virtual monotonic clock instead of the
+   real ones. It must not be linked with the real implementations of those
+   functions. */
+
+#ifndef DirSim_h
+#define DirSim_h
+
+/* ISO library headers */
+#include <stdbool.h>
+
+/* The path name of the root of the simulated directory tree. */
+#define DIRSIM_ROOT "Sim::Root.$"
+
+void dirsim_reset(unsigned int ndirs, unsigned int nfiles,
+                  unsigned int call_time, unsigned int entry_time);
+   /*
+    * Creates a simulated directory tree in which the root directory contains
+    * 'ndirs' sub-directories, each of which contains 'nfiles' files with
+    * names of varying length. Each simulated call to read catalogue entries
+    * advances the virtual clock by 'call_time' microseconds plus
+    * 'entry_time' microseconds per entry read. Resets all counters.
+    */
+
+unsigned long int dirsim_read_calls(void);
+   /*
+    * Returns: the number of simulated calls to read catalogue entries
+    *          since the filing system was reset.
+    */
+
+unsigned long int dirsim_entries_read(void);
+   /*
+    * Returns: the number of catalogue entries read since the filing system
+    *          was reset.
+    */
+
+unsigned long int dirsim_elapsed(void);
+   /*
+    * Returns: the virtual time elapsed since the filing system was reset,
+    *          in microseconds. Only simulated calls to read catalogue
+    *          entries and dirsim_work advance the virtual clock.
+    */
+
+void dirsim_work(unsigned int microseconds);
+   /*
+    * Advances the virtual clock to simulate work done by the client.
+    */
+
+bool dirsim_idle(unsigned int time_slice);
+   /*
+    * Simulates the task being idle by calling the function registered with
+    * the stand-in for scheduler_register_delay or scheduler_register_token,
+    * if any, unless it isn't due to be called yet. The function's 'time_up'
+    * flag becomes true when the virtual clock has advanced by 'time_slice'
+    * microseconds.
+    * Returns: true if the function was called.
+    */
+
+#endif
@@ -0,0 +1,488 @@
+/*
+ * CBLibrary test: Directory tree snapshots
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "swis.h"
+
+/* StreamLib headers */
+#include "ReaderRaw.h"
+#include "WriterRaw.h"
+
+/* CBLibrary headers */
+#include "DirSnap.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+
+#define ROOT_PATH "<Wimp$ScrapDir>.DirSnapTest"
+#define SNAPSHOT_PATH "<Wimp$ScrapDir>.DirSnapTestData"
+#define TRUNCATED_PATH "<Wimp$ScrapDir>.DirSnapTestTrunc"
+
+enum
+{
+  OS_FSControl_Wipe = 27,
+  OS_FSControl_Flag_Recurse = 1,
+  OS_File_CreateStampedFile = 11,
+  OS_File_CreateDirectory = 8,
+  OS_File_CreateDirectory_DefaultNoOfEntries = 0,
+  FortifyAllocationLimit = 2048,
+  MaxChanges = 8,
+  TruncateStep = 7,
+  PathNameLenOffset = 20 /* Offset of path name length in the header */
+};
+
+static const struct
+{
+  const char *name;
+  int type;
+  int size;
+}
+test_objects[] =
+{
+  { ROOT_PATH, FileType_Directory, 0 },
+  { ROOT_PATH ".a", FileType_Text, 10 },
+  { ROOT_PATH ".b", FileType_Directory, 0 },
+  { ROOT_PATH ".b.c", FileType_Data, 20 },
+  { ROOT_PATH ".b.d", FileType_Obey, 30 }
+};
+
+typedef struct
+{
+  unsigned int count;
+  unsigned int limit; /* Number of changes after which to stop, or 0 */
+  struct
+  {
+    DirSnapshotChange change;
+    char sub_path_name[16];
+  }
+  changes[MaxChanges];
+}
+DiffState;
+
+static void wipe(const char *path_name)
+{
+  _kernel_swi_regs regs;
+
+  assert(path_name != NULL);
+
+  regs.r[0] = OS_FSControl_Wipe;
+  regs.r[1] = (int)path_name;
+  regs.r[3] = OS_FSControl_Flag_Recurse;
+  _kernel_swi(OS_FSControl, &regs, &regs);
+}
+
+static void osfile(int op, const char *name, _kernel_osfile_block *inout)
+{
+  const int err = _kernel_osfile(op, name, inout);
+  if (err == _kernel_ERROR)
+  {
+    const _kernel_oserror * const e = _kernel_last_oserror();
+    assert(e != NULL);
+    printf("Error 0x%x %s\n", e->errnum, e->errmess);
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void create_object(const char *path_name, int type, int size)
+{
+  _kernel_osfile_block inout;
+
+  assert(path_name != NULL);
+  if (type == FileType_Directory)
+  {
+    inout.start = OS_File_CreateDirectory_DefaultNoOfEntries;
+    osfile(OS_File_CreateDirectory, path_name, &inout);
+  }
+  else
+  {
+    inout.load = type;
+    inout.start = 0;
+    inout.end = size;
+    osfile(OS_File_CreateStampedFile, path_name, &inout);
+  }
+}
+
+static void init(void)
+{
+  wipe(test_objects[0].name);
+
+  for (size_t i = 0; i < ARRAY_SIZE(test_objects); ++i)
+  {
+    create_object(test_objects[i].name, test_objects[i].type,
+                  test_objects[i].size);
+  }
+}
+
+static void final(void)
+{
+  wipe(test_objects[0].name);
+  remove(SNAPSHOT_PATH);
+  remove(TRUNCATED_PATH);
+}
+
+static bool diff_callback(DirSnapshotChange change, const char *sub_path_name,
+                          int object_type, const DirIteratorObjectInfo *old_info,
+                          const DirIteratorObjectInfo *new_info, void *arg)
+{
+  DiffState *const state = arg;
+
+  assert(sub_path_name != NULL);
+  assert(state != NULL);
+  assert(state->count < ARRAY_SIZE(state->changes));
+  printf("Change %d to '%s' (type %d)\n", change, sub_path_name, object_type);
+
+  switch (change)
+  {
+    case DirSnapshotChange_Added:
+      assert(old_info == NULL);
+      assert(new_info != NULL);
+      break;
+    case DirSnapshotChange_Removed:
+      assert(old_info != NULL);
+      assert(new_info == NULL);
+      break;
+    default:
+      assert(change == DirSnapshotChange_Modified);
+      assert(old_info != NULL);
+      assert(new_info != NULL);
+      break;
+  }
+
+  state->changes[state->count].change = change;
+  assert(strlen(sub_path_name) <
+         sizeof(state->changes[state->count].sub_path_name));
+  strcpy(state->changes[state->count].sub_path_name, sub_path_name);
+  ++state->count;
+
+  return state->count != state->limit;
+}
+
+static void check_no_changes(const DirSnapshot *old, const DirSnapshot *new)
+{
+  DiffState state = {.count = 0, .limit = 0};
+  const _kernel_oserror *const e = dirsnapshot_diff(old, new, diff_callback,
+                                                    &state);
+  assert(e == NULL);
+  assert(state.count == 0);
+}
+
+static void test1(void)
+{
+  /* Make/destroy */
+  DirSnapshot *snapshot;
+  const _kernel_oserror *const e = dirsnapshot_make(&snapshot,
+    DirIterator_RecurseIntoDirectories, ROOT_PATH, NULL);
+  assert(e == NULL);
+  assert(snapshot != NULL);
+  assert(dirsnapshot_get_count(snapshot) == ARRAY_SIZE(test_objects) - 1);
+  assert(dirsnapshot_get_dirs_read(snapshot) == 2);
+  dirsnapshot_destroy(snapshot);
+}
+
+static void test2(void)
+{
+  /* Make without recursion */
+  DirSnapshot *snapshot;
+  const _kernel_oserror *const e = dirsnapshot_make(&snapshot, 0, ROOT_PATH,
+                                                    NULL);
+  assert(e == NULL);
+  assert(snapshot != NULL);
+  assert(dirsnapshot_get_count(snapshot) == 2);
+  assert(dirsnapshot_get_dirs_read(snapshot) == 1);
+  dirsnapshot_destroy(snapshot);
+}
+
+static void test3(void)
+{
+  /* Make from missing directory */
+  DirSnapshot *snapshot;
+  const _kernel_oserror *const e = dirsnapshot_make(&snapshot,
+    DirIterator_RecurseIntoDirectories, ROOT_PATH ".missing", NULL);
+  assert(e != NULL);
+  assert(snapshot == NULL);
+}
+
+static void test4(void)
+{
+  /* Rescan unchanged tree */
+  static const unsigned int flags[] = {
+    0, DirSnapshot_SkipUnchangedDirectories
+  };
+  DirSnapshot *old;
+  const _kernel_oserror *e = dirsnapshot_make(&old,
+    DirIterator_RecurseIntoDirectories, ROOT_PATH, NULL);
+  assert(e == NULL);
+
+  for (size_t i = 0; i < ARRAY_SIZE(flags); ++i)
+  {
+    DirSnapshot *new;
+    e = dirsnapshot_rescan(&new, old, flags[i]);
+    assert(e == NULL);
+    assert(dirsnapshot_get_count(new) == dirsnapshot_get_count(old));
+    check_no_changes(old, new);
+    dirsnapshot_destroy(new);
+  }
+
+  dirsnapshot_destroy(old);
+}
+
+static void test5(void)
+{
+  /* Rescan changed tree */
+  DirSnapshot *old, *new;
+  const _kernel_oserror *e = dirsnapshot_make(&old,
+    DirIterator_RecurseIntoDirectories, ROOT_PATH, NULL);
+  assert(e == NULL);
+
+  create_object(ROOT_PATH ".a", FileType_Text, 11);
+  wipe(ROOT_PATH ".b.d");
+  create_object(ROOT_PATH ".b.e", FileType_Data, 40);
+
+  e = dirsnapshot_rescan(&new, old, 0);
+  assert(e == NULL);
+  assert(dirsnapshot_get_count(new) == dirsnapshot_get_count(old));
+
+  DiffState state = {.count = 0, .limit = 0};
+  e = dirsnapshot_diff(old, new, diff_callback, &state);
+  assert(e == NULL);
+
+  /* Changes are reported in order of case-insensitive name */
+  assert(state.count == 3);
+  assert(state.changes[0].change == DirSnapshotChange_Modified);
+  assert(strcmp(state.changes[0].sub_path_name, "a") == 0);
+  assert(state.changes[1].change == DirSnapshotChange_Removed);
+  assert(strcmp(state.changes[1].sub_path_name, "b.d") == 0);
+  assert(state.changes[2].change == DirSnapshotChange_Added);
+  assert(strcmp(state.changes[2].sub_path_name, "b.e") == 0);
+
+  dirsnapshot_destroy(new);
+  dirsnapshot_destroy(old);
+  init();
+}
+
+static void test6(void)
+{
+  /* Diff of removed directory */
+  DirSnapshot *old, *new;
+  const _kernel_oserror *e = dirsnapshot_make(&old,
+    DirIterator_RecurseIntoDirectories, ROOT_PATH, NULL);
+  assert(e == NULL);
+
+  wipe(ROOT_PATH ".b");
+
+  e = dirsnapshot_rescan(&new, old, DirSnapshot_SkipUnchangedDirectories);
+  assert(e == NULL);
+  assert(dirsnapshot_get_count(new) == 1);
+
+  /* The directory and each object in it are reported */
+  DiffState state = {.count = 0, .limit = 0};
+  e = dirsnapshot_diff(old, new, diff_callback, &state);
+  assert(e == NULL);
+  assert(state.count == 3);
+  assert(state.changes[0].change == DirSnapshotChange_Removed);
+  assert(strcmp(state.changes[0].sub_path_name, "b") == 0);
+  assert(state.changes[1].change == DirSnapshotChange_Removed);
+  assert(strcmp(state.changes[1].sub_path_name, "b.c") == 0);
+  assert(state.changes[2].change == DirSnapshotChange_Removed);
+  assert(strcmp(state.changes[2].sub_path_name, "b.d") == 0);
+
+  /* The reverse comparison reports additions */
+  state.count = 0;
+  e = dirsnapshot_diff(new, old, diff_callback, &state);
+  assert(e == NULL);
+  assert(state.count == 3);
+  for (size_t i = 0; i < state.count; ++i)
+    assert(state.changes[i].change == DirSnapshotChange_Added);
+
+  /* Stop after the first change */
+  state.count = 0;
+  state.limit = 1;
+  e = dirsnapshot_diff(new, old, diff_callback, &state);
+  assert(e == NULL);
+  assert(state.count == 1);
+
+  dirsnapshot_destroy(new);
+  dirsnapshot_destroy(old);
+  init();
+}
+
+static void test7(void)
+{
+  /* Write and read */
+  DirSnapshot *snapshot, *copy;
+  const _kernel_oserror *e = dirsnapshot_make(&snapshot,
+    DirIterator_RecurseIntoDirectories, ROOT_PATH, "#*");
+  assert(e == NULL);
+
+  FILE *f = fopen(SNAPSHOT_PATH, "wb");
+  assert(f != NULL);
+  Writer writer;
+  writer_raw_init(&writer, f);
+  e = dirsnapshot_write(snapshot, &writer, SNAPSHOT_PATH);
+  assert(e == NULL);
+  const long int len = writer_destroy(&writer);
+  assert(len > 0);
+  fclose(f);
+
+  f = fopen(SNAPSHOT_PATH, "rb");
+  assert(f != NULL);
+  Reader reader;
+  reader_raw_init(&reader, f);
+  e = dirsnapshot_read(&copy, &reader, SNAPSHOT_PATH);
+  assert(e == NULL);
+  reader_destroy(&reader);
+  fclose(f);
+
+  assert(dirsnapshot_get_count(copy) == dirsnapshot_get_count(snapshot));
+  assert(dirsnapshot_get_dirs_read(copy) == 0);
+  check_no_changes(snapshot, copy);
+  dirsnapshot_destroy(snapshot);
+
+  /* A loaded snapshot can be rescanned */
+  e = dirsnapshot_rescan(&snapshot, copy, 0);
+  assert(e == NULL);
+  check_no_changes(copy, snapshot);
+  dirsnapshot_destroy(copy);
+  dirsnapshot_destroy(snapshot);
+
+  /* Truncated data is rejected */
+  for (long int trunc = 0; trunc < len; trunc += TruncateStep)
+  {
+    f = fopen(SNAPSHOT_PATH, "rb");
+    assert(f != NULL);
+    static char buffer[4096];
+    assert(len <= (long)sizeof(buffer));
+    const size_t n = fread(buffer, 1, (size_t)trunc, f);
+    assert(n == (size_t)trunc);
+    fclose(f);
+
+    f = fopen(TRUNCATED_PATH, "wb");
+    assert(f != NULL);
+    assert(fwrite(buffer, 1, n, f) == n);
+    fclose(f);
+
+    f = fopen(TRUNCATED_PATH, "rb");
+    assert(f != NULL);
+    reader_raw_init(&reader, f);
+    e = dirsnapshot_read(&copy, &reader, TRUNCATED_PATH);
+    assert(e != NULL);
+    assert(copy == NULL);
+    reader_destroy(&reader);
+    fclose(f);
+  }
+
+  /* Huge lengths in the header are rejected without allocating memory */
+  static const unsigned int bad_lens[] = {UINT_MAX, INT_MAX, 65536, 4096};
+  for (size_t i = 0; i < ARRAY_SIZE(bad_lens); ++i)
+  {
+    f = fopen(SNAPSHOT_PATH, "r+b");
+    assert(f != NULL);
+    assert(!fseek(f, PathNameLenOffset, SEEK_SET));
+    assert(fwrite(&bad_lens[i], sizeof(bad_lens[i]), 1, f) == 1);
+    fclose(f);
+
+    f = fopen(SNAPSHOT_PATH, "rb");
+    assert(f != NULL);
+    reader_raw_init(&reader, f);
+    Fortify_SetNumAllocationsLimit(0);
+    e = dirsnapshot_read(&copy, &reader, SNAPSHOT_PATH);
+    Fortify_SetNumAllocationsLimit(ULONG_MAX);
+    assert(e != NULL);
+    assert(copy == NULL);
+    reader_destroy(&reader);
+    fclose(f);
+  }
+}
+
+static void test8(void)
+{
+  /* Make fail recovery */
+  DirSnapshot *snapshot;
+  unsigned long limit;
+
+  for (limit = 0; limit < FortifyAllocationLimit; ++limit)
+  {
+    Fortify_SetNumAllocationsLimit(limit);
+    const _kernel_oserror *const e = dirsnapshot_make(&snapshot,
+      DirIterator_RecurseIntoDirectories, ROOT_PATH, "#*");
+    Fortify_SetNumAllocationsLimit(ULONG_MAX);
+
+    if (e == NULL)
+      break;
+
+    assert(snapshot == NULL);
+  }
+  assert(limit != FortifyAllocationLimit);
+  assert(dirsnapshot_get_count(snapshot) == ARRAY_SIZE(test_objects) - 1);
+  dirsnapshot_destroy(snapshot);
+}
+
+static void test9(void)
+{
+  /* Destroy null */
+  dirsnapshot_destroy(NULL);
+}
+
+void DirSnap_tests(void)
+{
+  static const struct
+  {
+    const char *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Make/destroy", test1 },
+    { "Make without recursion", test2 },
+    { "Make from missing directory", test3 },
+    { "Rescan unchanged tree", test4 },
+    { "Rescan changed tree", test5 },
+    { "Diff of removed directory", test6 },
+    { "Write and read", test7 },
+    { "Make fail recovery", test8 },
+    { "Destroy null", test9 }
+  };
+
+  init();
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); count ++)
+  {
+    printf("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    Fortify_EnterScope();
+
+    unit_tests[count].test_func();
+
+    Fortify_LeaveScope();
+  }
+
+  final();
+}
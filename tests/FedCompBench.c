@@ -0,0 +1,358 @@
+/*
+ * CBLibrary test: Throughput benchmarks for interruptible Fednet compression
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Usage: FedCompBench [<megabytes> [<threads>]]
+
+   Compresses a large block of data to a file with save_compressedM2 and
+   decompresses it again with load_compressedM, with each size of history,
+   using an interval timer to set the 'time_up' flag at the end of each
+   time slice as the Timer module would on RISC OS. Checks that the data
+   survives the round trip and reports the throughput, the number of calls
+   needed and the compressed size. Then it does the same with a block
+   container, first with one thread and then with the given number of
+   threads, and times decompressing one block from the middle of it. The
+   data is made from words chosen at random, so that it compresses about as
+   well as typical game data. This file provides stand-ins for the flex,
+   catalogue cache and CBOSLib functions used by FedCompMT.c and StreamLib,
+   so it must not be linked with the real ones. */
+
+/* Needed for setitimer, sigaction and stat in strict ISO C mode */
+#define _XOPEN_SOURCE 700
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+
+/* POSIX headers */
+#include <sys/stat.h>
+#include <sys/time.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "flex.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSReadTime.h"
+
+/* CBLibrary headers */
+#include "FedCompMT.h"
+#include "CatCache.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+
+enum
+{
+  DefaultMegabytes = 16,
+  BytesPerMegabyte = 1024 * 1024,
+  TimeSlice = 10000, /* Microseconds between setting 'time_up' */
+  BlockSize = 256 * 1024,
+  DefaultThreads = 4,
+  ErrorNum_NoMem = 1
+};
+
+#define TEST_FILE "/tmp/FedCompBench"
+
+static volatile bool time_up;
+
+/* ----------------------------------------------------------------------- */
+/*                 Stand-ins for the functions of other modules            */
+
+int flex_alloc(flex_ptr anchor, int size)
+{
+  /* The size is stored before the block */
+  int *const block = malloc(sizeof(int) + (size_t)size);
+  if (block == NULL)
+    return 0;
+  *block = size;
+  *anchor = block + 1;
+  return 1;
+}
+
+void flex_free(flex_ptr anchor)
+{
+  free((int *)*anchor - 1);
+  *anchor = NULL;
+}
+
+int flex_size(flex_ptr anchor)
+{
+  return ((int *)*anchor)[-1];
+}
+
+int flex_extend(flex_ptr anchor, int newsize)
+{
+  int *const block = realloc((int *)*anchor - 1, sizeof(int) + (size_t)newsize);
+  if (block == NULL)
+    return 0;
+  *block = newsize;
+  *anchor = block + 1;
+  return 1;
+}
+
+int flex_midextend(flex_ptr anchor, int at, int by)
+{
+  int const old_size = flex_size(anchor);
+  if (by > 0 && !flex_extend(anchor, old_size + by))
+    return 0;
+
+  char *const data = *anchor;
+  memmove(data + at + by, data + at, (size_t)(old_size - at));
+  return by >= 0 || flex_extend(anchor, old_size + by);
+}
+
+void catcache_invalidate(const char *path_name)
+{
+  /* The catalogue cache is never enabled */
+  NOT_USED(path_name);
+}
+
+CONST _kernel_oserror *os_read_monotonic_time(int *time_now)
+{
+  struct timespec ts;
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  *time_now = (int)(ts.tv_sec * 100 + ts.tv_nsec / 10000000);
+  return NULL;
+}
+
+CONST _kernel_oserror *messagetrans_error_lookup(MessagesFD *mfd,
+  int errnum, const char *token, size_t n, ...)
+{
+  static _kernel_oserror error;
+  NOT_USED(mfd);
+  NOT_USED(errnum);
+  NOT_USED(n);
+  error.errnum = ErrorNum_NoMem;
+  strncpy(error.errmess, token, sizeof(error.errmess) - 1);
+  return &error;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static void set_time_up(int sig)
+{
+  NOT_USED(sig);
+  time_up = true;
+}
+
+static double elapsed_s(const struct timespec *start)
+{
+  struct timespec end;
+  (void)clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) +
+         (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static const char *history_name(FedCompHistory history)
+{
+  return history == FedCompHistory_Wide ? "wide" : "fednet";
+}
+
+static void make_data(char *data, size_t nbytes)
+{
+  static const char *const words[] =
+  {
+    "ship ", "fighter ", "mission ", "base ", "pilot ", "wing ", "attack ",
+    "defend ", "convoy ", "mine ", "satellite ", "the ", "and ", "of ",
+    "\0\0\0\0", "\1\2\3\4", "\xff\xfe"
+  };
+
+  srand(1);
+  for (size_t i = 0; i < nbytes; )
+  {
+    const char *const word = words[(size_t)rand() % ARRAY_SIZE(words)];
+    size_t const len = LOWEST(strlen(word) + 1, nbytes - i);
+    memcpy(data + i, word, len);
+    i += len;
+  }
+}
+
+static bool bench_history(FedCompHistory history, unsigned int block_size,
+                          unsigned int nthreads, void **data, size_t nbytes)
+{
+  struct timespec start;
+  unsigned long int ncalls;
+  FILE **handle = NULL;
+  void *loaded = NULL;
+  CONST _kernel_oserror *e;
+  struct stat st;
+
+  compress_set_history(history);
+  compress_set_block_size(block_size);
+  compress_set_threads(nthreads);
+
+  /* Compress the data, yielding at the end of each time slice */
+  ncalls = 0;
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    time_up = false;
+    e = save_compressedM2(TEST_FILE, data, &time_up, 0, (unsigned)nbytes,
+                          &handle);
+    ++ncalls;
+  }
+  while (e == NULL && handle != NULL);
+
+  if (e != NULL)
+  {
+    printf("Compression failed: %s\n", e->errmess);
+    return false;
+  }
+
+  double const comp_s = elapsed_s(&start);
+  if (stat(TEST_FILE, &st) != 0)
+    return false;
+
+  printf("  %-6s %-6s %2u compress  : %8.2f MB/s, %6lu calls, %5.1f%% of "
+         "original size\n", history_name(history),
+         block_size > 0 ? "blocks" : "stream", nthreads,
+         (double)nbytes / BytesPerMegabyte / comp_s, ncalls,
+         (double)st.st_size * 100.0 / (double)nbytes);
+
+  /* Decompress it again. The history size must be detected, so select
+     the other one first. */
+  compress_set_history(history == FedCompHistory_Wide ?
+                       FedCompHistory_Fednet : FedCompHistory_Wide);
+  ncalls = 0;
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    time_up = false;
+    e = load_compressedM(TEST_FILE, &loaded, &time_up, &handle);
+    ++ncalls;
+  }
+  while (e == NULL && handle != NULL);
+
+  if (e != NULL)
+  {
+    printf("Decompression failed: %s\n", e->errmess);
+    return false;
+  }
+
+  printf("  %-6s %-6s %2u decompress: %8.2f MB/s, %6lu calls\n",
+         history_name(history), block_size > 0 ? "blocks" : "stream",
+         nthreads, (double)nbytes / BytesPerMegabyte / elapsed_s(&start), ncalls);
+
+  bool ok = (size_t)flex_size(&loaded) == nbytes &&
+            memcmp(loaded, *data, nbytes) == 0;
+  flex_free(&loaded);
+
+  if (ok && block_size > 0)
+  {
+    /* Decompress only the middle block */
+    unsigned int const block = (unsigned int)(nbytes / 2 / block_size);
+    size_t const offset = (size_t)block * block_size;
+    size_t const size = LOWEST((size_t)block_size, nbytes - offset);
+
+    ncalls = 0;
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    do
+    {
+      time_up = false;
+      e = load_compressed_block(TEST_FILE, block, &loaded, &time_up,
+                                &handle);
+      ++ncalls;
+    }
+    while (e == NULL && handle != NULL);
+
+    if (e != NULL)
+    {
+      printf("Block decompression failed: %s\n", e->errmess);
+      return false;
+    }
+
+    printf("  %-6s block %-4u          : %8.3f ms, %6lu calls\n",
+           history_name(history), block, elapsed_s(&start) * 1000.0, ncalls);
+
+    ok = (size_t)flex_size(&loaded) == size &&
+         memcmp(loaded, (char *)*data + offset, size) == 0;
+    flex_free(&loaded);
+  }
+
+  if (!ok)
+    puts("Decompressed data doesn't match original data");
+
+  return ok;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+int main(int argc, char *argv[])
+{
+  size_t megabytes = DefaultMegabytes;
+  unsigned int nthreads = DefaultThreads;
+  void *data = NULL;
+  bool ok = true;
+
+  if (argc > 1)
+    megabytes = strtoul(argv[1], NULL, 10);
+
+  if (argc > 2)
+    nthreads = (unsigned int)strtoul(argv[2], NULL, 10);
+
+  size_t const nbytes = megabytes * BytesPerMegabyte;
+  if (!flex_alloc(&data, (int)nbytes))
+  {
+    puts("Not enough memory");
+    return EXIT_FAILURE;
+  }
+
+  make_data(data, nbytes);
+
+  /* Set 'time_up' periodically, like a Timer module ticker event */
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = set_time_up;
+  (void)sigaction(SIGALRM, &sa, NULL);
+
+  struct itimerval slice = {{0, TimeSlice}, {0, TimeSlice}};
+  (void)setitimer(ITIMER_REAL, &slice, NULL);
+
+  printf("FedCompMT benchmarks (%zu MB, %d ms time slices)\n", megabytes,
+         TimeSlice / 1000);
+  puts("--------------------------------------------------");
+
+  ok = bench_history(FedCompHistory_Fednet, 0, 1, &data, nbytes) &&
+       bench_history(FedCompHistory_Wide, 0, 1, &data, nbytes) &&
+       bench_history(FedCompHistory_Fednet, BlockSize, 1, &data, nbytes) &&
+       bench_history(FedCompHistory_Wide, BlockSize, 1, &data, nbytes) &&
+       bench_history(FedCompHistory_Fednet, BlockSize, nthreads, &data,
+                     nbytes) &&
+       bench_history(FedCompHistory_Wide, BlockSize, nthreads, &data, nbytes);
+
+  /* Stop any worker threads */
+  compress_set_threads(1);
+
+  memset(&slice, 0, sizeof(slice));
+  (void)setitimer(ITIMER_REAL, &slice, NULL);
+
+  (void)remove(TEST_FILE);
+  flex_free(&data);
+
+  puts(ok ? "Passed" : "Failed");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,478 @@
+/*
+ * CBLibrary test: Throughput benchmarks for interruptible loading/saving
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Usage: LoadSaveBench [<megabytes>]
+
+   Saves and loads a large file with load_fileM2 and save_fileM2 in each
+   mode, using an interval timer to set the 'time_up' flag at the end of
+   each time slice as the Timer module would on RISC OS. Checks that the
+   data survives the round trip and reports the throughput, the number of
+   calls needed and how often flex budging was disabled. Then it opens a
+   read-only view of the file and reports how long it takes to read just
+   the header or to read every byte (one megabyte at a time), for
+   comparison with loading the whole file. Finally, it interleaves fewer
+   and then more loads than there are file handles, and reports how often
+   each suspended load's stream was still open when it resumed. It also
+   checks that failing to open a missing file doesn't close a parked
+   stream. This file provides stand-ins for the flex, NoBudge, Hourglass,
+   catalogue cache and CBOSLib functions used by LoadSaveMT.c and
+   FileView.c, so it must not be linked with the real ones. */
+
+/* Needed for setitimer, sigaction and stat in strict ISO C mode */
+#define _XOPEN_SOURCE 700
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+
+/* POSIX headers */
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "flex.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSReadTime.h"
+
+/* CBLibrary headers */
+#include "LoadSaveMT.h"
+#include "FileView.h"
+#include "FOpenCount.h"
+#include "AbortFOp.h"
+#include "NoBudge.h"
+#include "CatCache.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+
+enum
+{
+  DefaultMegabytes = 64,
+  HeaderSize = 64,
+  BytesPerMegabyte = 1024 * 1024,
+  TimeSlice = 10000, /* Microseconds between setting 'time_up' */
+  MaxConcurrentLoads = FOPEN_MAX + 4,
+  ConcurrentMegabytes = 1,
+  ErrorNum_NoMem = 1,
+  ErrorNum_NotFound = 214
+};
+
+#define TEST_FILE "/tmp/LoadSaveBench"
+#define MISSING_FILE "/tmp/LoadSaveBench/Missing"
+
+static volatile bool time_up;
+static unsigned long int nobudge_count;
+
+/* ----------------------------------------------------------------------- */
+/*                 Stand-ins for the functions of other modules            */
+
+int flex_alloc(flex_ptr anchor, int size)
+{
+  /* The size is stored before the block */
+  int *const block = malloc(sizeof(int) + (size_t)size);
+  if (block == NULL)
+    return 0;
+  *block = size;
+  *anchor = block + 1;
+  return 1;
+}
+
+void flex_free(flex_ptr anchor)
+{
+  free((int *)*anchor - 1);
+  *anchor = NULL;
+}
+
+int flex_size(flex_ptr anchor)
+{
+  return ((int *)*anchor)[-1];
+}
+
+void nobudge_register(size_t heap_ensure)
+{
+  NOT_USED(heap_ensure);
+  ++nobudge_count;
+}
+
+void nobudge_deregister(void)
+{
+}
+
+void hourglass_on(void)
+{
+}
+
+void hourglass_off(void)
+{
+}
+
+CONST _kernel_oserror *get_file_size(const char *f, int *size)
+{
+  static _kernel_oserror error = {ErrorNum_NotFound, "Not found"};
+  struct stat st;
+
+  if (stat(f, &st) != 0)
+    return &error;
+  *size = (int)st.st_size;
+  return NULL;
+}
+
+void catcache_invalidate(const char *path_name)
+{
+  /* The catalogue cache is never enabled */
+  NOT_USED(path_name);
+}
+
+CONST _kernel_oserror *os_read_monotonic_time(int *time_now)
+{
+  struct timespec ts;
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  *time_now = (int)(ts.tv_sec * 100 + ts.tv_nsec / 10000000);
+  return NULL;
+}
+
+CONST _kernel_oserror *messagetrans_error_lookup(MessagesFD *mfd,
+  int errnum, const char *token, size_t n, ...)
+{
+  static _kernel_oserror error;
+  NOT_USED(mfd);
+  NOT_USED(errnum);
+  NOT_USED(n);
+  error.errnum = ErrorNum_NoMem;
+  strncpy(error.errmess, token, sizeof(error.errmess) - 1);
+  return &error;
+}
+
+_kernel_oserror *_kernel_last_oserror(void)
+{
+  return NULL;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Private functions                               */
+
+static void set_time_up(int sig)
+{
+  NOT_USED(sig);
+  time_up = true;
+}
+
+static double elapsed_s(const struct timespec *start)
+{
+  struct timespec end;
+  (void)clock_gettime(CLOCK_MONOTONIC, &end);
+  return (double)(end.tv_sec - start->tv_sec) +
+         (double)(end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void report(const char *what, LoadSaveMode mode, size_t nbytes,
+                   double seconds, unsigned long int ncalls)
+{
+  printf("  %-4s %-8s: %8.1f MB/s, %6lu calls, %8lu budge disables\n",
+         what, mode == LoadSaveMode_Direct ? "direct" : "buffered",
+         (double)nbytes / BytesPerMegabyte / seconds, ncalls, nobudge_count);
+}
+
+static bool bench_mode(LoadSaveMode mode, void **data, size_t nbytes)
+{
+  struct timespec start;
+  unsigned long int ncalls;
+  FILE **handle = NULL;
+  void *loaded = NULL;
+  CONST _kernel_oserror *e;
+
+  loadsave_set_mode(mode);
+
+  /* Save the data, yielding at the end of each time slice */
+  nobudge_count = 0;
+  ncalls = 0;
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    time_up = false;
+    e = save_fileM2(TEST_FILE, data, &time_up, 0, (unsigned)nbytes, &handle);
+    ++ncalls;
+  }
+  while (e == NULL && handle != NULL);
+
+  if (e != NULL)
+  {
+    printf("Save failed: %s\n", e->errmess);
+    return false;
+  }
+  report("save", mode, nbytes, elapsed_s(&start), ncalls);
+
+  /* Load it again */
+  nobudge_count = 0;
+  ncalls = 0;
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    time_up = false;
+    e = load_fileM2(TEST_FILE, &loaded, &time_up, &handle);
+    ++ncalls;
+  }
+  while (e == NULL && handle != NULL);
+
+  if (e != NULL)
+  {
+    printf("Load failed: %s\n", e->errmess);
+    return false;
+  }
+  report("load", mode, nbytes, elapsed_s(&start), ncalls);
+
+  bool const ok = (size_t)flex_size(&loaded) == nbytes &&
+                  memcmp(loaded, *data, nbytes) == 0;
+  if (!ok)
+    puts("Loaded data doesn't match saved data");
+
+  flex_free(&loaded);
+  return ok;
+}
+
+static bool bench_view(const void *data, size_t nbytes)
+{
+  struct timespec start;
+  FileView *view;
+  const void *mapped;
+  CONST _kernel_oserror *e;
+  bool ok = true;
+
+  /* Read only the header, as a client looking for a signature would */
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+  e = fileview_open(&view, TEST_FILE);
+  if (e == NULL)
+  {
+    e = fileview_map(view, 0, HeaderSize, &mapped);
+    if (e == NULL)
+      ok = memcmp(mapped, data, HeaderSize) == 0;
+
+    fileview_close(view);
+  }
+  if (e == NULL)
+  {
+    printf("  view header   : %8.3f ms\n", elapsed_s(&start) * 1000.0);
+
+    /* Read every byte */
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    e = fileview_open(&view, TEST_FILE);
+  }
+  if (e == NULL)
+  {
+    if ((size_t)fileview_get_size(view) != nbytes)
+      ok = false;
+
+    for (size_t offset = 0; ok && e == NULL && offset < nbytes;
+         offset += BytesPerMegabyte)
+    {
+      size_t const size = LOWEST((size_t)BytesPerMegabyte, nbytes - offset);
+      e = fileview_map(view, (long)offset, size, &mapped);
+      if (e == NULL)
+        ok = memcmp(mapped, (const char *)data + offset, size) == 0;
+    }
+    fileview_close(view);
+  }
+
+  if (e != NULL)
+  {
+    printf("View failed: %s\n", e->errmess);
+    return false;
+  }
+
+  printf("  view all      : %8.1f MB/s\n",
+         (double)nbytes / BytesPerMegabyte / elapsed_s(&start));
+
+  if (!ok)
+    puts("Viewed data doesn't match saved data");
+
+  return ok;
+}
+
+static bool bench_concurrent(const void *data, size_t data_size,
+                             size_t nloads)
+{
+  struct timespec start;
+  void *loaded[MaxConcurrentLoads] = {NULL};
+  FILE **handle[MaxConcurrentLoads] = {NULL};
+  CONST _kernel_oserror *e = NULL;
+  bool ok = true, busy;
+  size_t const nbytes = LOWEST((size_t)ConcurrentMegabytes * BytesPerMegabyte,
+                              data_size);
+  FOpenLeaseStats before, after;
+
+  assert(nloads <= MaxConcurrentLoads);
+
+  /* Write a smaller file so that each load needs only a few calls */
+  FILE *const f = fopen(TEST_FILE, "wb");
+  if (f == NULL)
+    return false;
+
+  ok = fwrite(data, 1, nbytes, f) == nbytes;
+  if (fclose(f) != 0 || !ok)
+    return false;
+
+  /* Start all of the loads, then resume each in turn until all are done */
+  loadsave_set_mode(LoadSaveMode_Buffered);
+  fopen_lease_get_stats(&before);
+  (void)clock_gettime(CLOCK_MONOTONIC, &start);
+  do
+  {
+    busy = false;
+    for (size_t i = 0; e == NULL && i < nloads; ++i)
+    {
+      if (handle[i] == NULL && loaded[i] != NULL)
+        continue; /* finished */
+
+      /* Yield after each chunk, so that every load is suspended often */
+      time_up = true;
+      e = load_fileM2(TEST_FILE, &loaded[i], &time_up, &handle[i]);
+      if (handle[i] != NULL)
+        busy = true;
+    }
+  }
+  while (e == NULL && busy);
+  double const seconds = elapsed_s(&start);
+
+  if (e != NULL)
+  {
+    printf("Load failed: %s\n", e->errmess);
+    ok = false;
+  }
+
+  for (size_t i = 0; i < nloads; ++i)
+  {
+    abort_file_op(&handle[i]);
+    if (loaded[i] != NULL)
+    {
+      if ((size_t)flex_size(&loaded[i]) != nbytes ||
+          memcmp(loaded[i], data, nbytes) != 0)
+        ok = false;
+
+      flex_free(&loaded[i]);
+    }
+  }
+
+  fopen_lease_get_stats(&after);
+  printf("  %2zu loads     : %8.1f MB/s, %6lu hits, %6lu misses, "
+         "%6lu evictions\n", nloads,
+         (double)nbytes * nloads / BytesPerMegabyte / seconds,
+         after.hits - before.hits, after.misses - before.misses,
+         after.evictions - before.evictions);
+
+  if (after.parked != 0 || fopen_num() != 0)
+  {
+    puts("Streams left open");
+    ok = false;
+  }
+
+  if (!ok)
+    puts("Loaded data doesn't match saved data");
+
+  return ok;
+}
+
+static bool check_missing(void)
+{
+  /* Failing to open a missing file must not close a parked stream */
+  FOpenLease lease;
+  FOpenLeaseStats before, after;
+
+  fopen_lease_init(&lease);
+  FILE *f = fopen_inc(TEST_FILE, "rb");
+  if (f == NULL)
+    return false;
+
+  fopen_lease_park(&lease, f);
+  fopen_lease_get_stats(&before);
+  bool const missing = fopen_inc(MISSING_FILE, "rb") == NULL;
+  fopen_lease_get_stats(&after);
+
+  f = fopen_lease_resume(&lease);
+  bool const ok = missing && f != NULL &&
+                  after.evictions == before.evictions;
+  if (f != NULL)
+    fclose_dec(f);
+
+  if (!ok)
+    puts("Parked stream closed when opening a missing file");
+
+  return ok;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                         Public functions                                */
+
+int main(int argc, char *argv[])
+{
+  size_t megabytes = DefaultMegabytes;
+  void *data = NULL;
+  bool ok = true;
+
+  if (argc > 1)
+    megabytes = strtoul(argv[1], NULL, 10);
+
+  size_t const nbytes = megabytes * BytesPerMegabyte;
+  if (!flex_alloc(&data, (int)nbytes))
+  {
+    puts("Not enough memory");
+    return EXIT_FAILURE;
+  }
+
+  srand(1);
+  for (size_t i = 0; i < nbytes; ++i)
+    ((unsigned char *)data)[i] = (unsigned char)rand();
+
+  /* Set 'time_up' periodically, like a Timer module ticker event */
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = set_time_up;
+  (void)sigaction(SIGALRM, &sa, NULL);
+
+  struct itimerval slice = {{0, TimeSlice}, {0, TimeSlice}};
+  (void)setitimer(ITIMER_REAL, &slice, NULL);
+
+  printf("LoadSaveMT benchmarks (%zu MB, %d ms time slices)\n", megabytes,
+         TimeSlice / 1000);
+  puts("--------------------------------------------------");
+
+  ok = bench_mode(LoadSaveMode_Buffered, &data, nbytes) &&
+       bench_mode(LoadSaveMode_Direct, &data, nbytes) &&
+       bench_view(data, nbytes) &&
+       check_missing() &&
+       bench_concurrent(data, nbytes, FOPEN_MAX / 2) &&
+       bench_concurrent(data, nbytes, MaxConcurrentLoads);
+
+  memset(&slice, 0, sizeof(slice));
+  (void)setitimer(ITIMER_REAL, &slice, NULL);
+
+  (void)remove(TEST_FILE);
+  flex_free(&data);
+
+  puts(ok ? "Passed" : "Failed");
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -43,7 +43,9 @@ int main(int argc, char *argv[])
     { "Macros",  Macros_tests },
     { "DecodeLExe", DecodeLExe_tests },
     { "DirIter", DirIter_tests },
+    { "DirSnap", DirSnap_tests },
     { "Timer", Timer_tests },
+    { "CatCache", CatCache_tests },
   };
 
   NOT_USED(argc);
@@ -0,0 +1,70 @@
+/*
+ * CBLibrary test: main program for simulated Scheduler tests
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* CBLibrary headers */
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+
+int main(int argc, char *argv[])
+{
+  /* The Scheduler and Coroutine modules and stand-ins for their
+     dependencies are linked into a separate program because the stand-ins
+     would clash with the real Timer module used by the main test program. */
+  static const struct
+  {
+    const char *test_name;
+    void (*test_func)(void);
+  }
+  test_groups[] =
+  {
+    { "Scheduler", Scheduler_tests },
+    { "Coroutine", Coroutine_tests },
+    { "Scheduler benchmarks", Scheduler_benchmarks },
+  };
+
+  /* Benchmarks (the last group) are only run if requested
+     (e.g. "SchedTests bench") */
+  size_t const ngroups = (argc > 1 && strcmp(argv[1], "bench") == 0) ?
+                         ARRAY_SIZE(test_groups) :
+                         ARRAY_SIZE(test_groups) - 1;
+
+  for (size_t count = 0; count < ngroups; count ++)
+  {
+    /* Print title of this group of tests, then underline it */
+    const size_t len = strlen(test_groups[count].test_name);
+    puts(test_groups[count].test_name);
+    for (size_t i = 0; i < len; i++)
+        putchar('-');
+    putchar('\n');
+
+    /* Call a function to perform the group of tests */
+    test_groups[count].test_func();
+
+    putchar('\n');
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+/*
+ * CBLibrary test: Simulated clock and Wimp for Scheduler
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <stddef.h>
+#include <limits.h>
+#include <string.h>
+
+/* Acorn C/C++ library headers */
+#include "kernel.h"
+#include "wimp.h"
+#include "toolbox.h"
+#include "event.h"
+
+/* CBOSLib headers */
+#include "MessTrans.h"
+#include "OSReadTime.h"
+
+/* CBLibrary headers */
+#include "Timer.h"
+#include "Scheduler.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "SchedSim.h"
+
+enum
+{
+  MicrosecondsPerTick = 10000,
+  ClockWrapDelay = 100, /* Centiseconds after reset that the clock wraps */
+  ErrorNum_NoMem = 1
+};
+
+static unsigned int now_us;
+static int now_cs;
+static unsigned int fraction_us;
+static TimerTicker *ticker;
+static bool fine_pending;
+static unsigned int fine_deadline;
+static WimpEventHandler *null_handler;
+static void *null_handle;
+static unsigned int event_mask;
+static int idle_time;
+static bool idle_time_valid;
+static unsigned long int os_calls;
+
+/* ----------------------------------------------------------------------- */
+/*                         Simulation control                              */
+
+void schedsim_reset(void)
+{
+  now_cs = INT_MAX - ClockWrapDelay;
+  now_us = (unsigned)now_cs * MicrosecondsPerTick;
+  fraction_us = 0;
+  ticker = NULL;
+  fine_pending = false;
+  null_handler = NULL;
+  null_handle = NULL;
+  event_mask = 0;
+  idle_time_valid = false;
+  os_calls = 0;
+}
+
+int schedsim_now(void)
+{
+  return now_cs;
+}
+
+unsigned int schedsim_now_us(void)
+{
+  return now_us;
+}
+
+void schedsim_advance(unsigned int microseconds)
+{
+  now_us += microseconds;
+  fraction_us += microseconds;
+
+  /* A sub-centisecond deadline is met exactly, as it could be by a
+     hosted timer, rather than on the next tick */
+  if (ticker != NULL && fine_pending &&
+      (int)(now_us - fine_deadline) >= 0)
+  {
+    fine_pending = false;
+    ticker->time_up = true;
+  }
+
+  while (fraction_us >= MicrosecondsPerTick)
+  {
+    fraction_us -= MicrosecondsPerTick;
+    now_cs = (int)((unsigned)now_cs + 1); /* may wrap around */
+
+    if (ticker != NULL)
+    {
+      ticker->ticks++;
+      if (ticker->ticks - ticker->deadline >= 0)
+        ticker->time_up = true;
+    }
+  }
+}
+
+bool schedsim_null_event(void)
+{
+  if (null_handler == NULL || TEST_BITS(event_mask, Wimp_Poll_NullMask))
+    return false;
+
+  WimpPollBlock poll_block;
+  memset(&poll_block, 0, sizeof(poll_block));
+  IdBlock id_block;
+  memset(&id_block, 0, sizeof(id_block));
+  null_handler(Wimp_ENull, &poll_block, &id_block, null_handle);
+  return true;
+}
+
+void schedsim_poll(unsigned int other_tasks)
+{
+  int event_code;
+  WimpPollBlock poll_block;
+  idle_time_valid = false;
+  CONST _kernel_oserror *const e = scheduler_poll(&event_code, &poll_block,
+                                                  NULL);
+  assert(e == NULL);
+  NOT_USED(e);
+
+  schedsim_advance(other_tasks);
+
+  if (idle_time_valid && idle_time - now_cs > 0)
+  {
+    schedsim_advance((unsigned)(idle_time - now_cs) * MicrosecondsPerTick -
+                     fraction_us);
+  }
+
+  (void)schedsim_null_event();
+}
+
+unsigned long int schedsim_os_calls(void)
+{
+  return os_calls;
+}
+
+/* ----------------------------------------------------------------------- */
+/*                 Stand-ins for the functions of other modules            */
+
+CONST _kernel_oserror *os_read_monotonic_time(int *time_now)
+{
+  assert(time_now != NULL);
+  ++os_calls;
+  *time_now = now_cs;
+  return NULL;
+}
+
+CONST _kernel_oserror *timer_read_monotonic(int *centiseconds,
+                                            unsigned int *microseconds)
+{
+  assert(centiseconds != NULL);
+  assert(microseconds != NULL);
+  os_calls += 3;
+  *centiseconds = now_cs;
+  *microseconds = fraction_us;
+  return NULL;
+}
+
+CONST _kernel_oserror *timer_register(volatile bool *timeup_flag, int wait_time)
+{
+  /* The scheduler uses a persistent ticker instead */
+  NOT_USED(timeup_flag);
+  NOT_USED(wait_time);
+  assert("Unexpected call to timer_register" == NULL);
+  return NULL;
+}
+
+CONST _kernel_oserror *timer_deregister(volatile bool *timeup_flag)
+{
+  NOT_USED(timeup_flag);
+  assert("Unexpected call to timer_deregister" == NULL);
+  return NULL;
+}
+
+CONST _kernel_oserror *timer_ticker_start(TimerTicker *t)
+{
+  assert(t != NULL);
+  assert(ticker == NULL);
+  ++os_calls;
+  t->ticks = 0;
+  t->deadline = 0;
+  t->time_up = true;
+  ticker = t;
+  return NULL;
+}
+
+void timer_ticker_set(TimerTicker *t, int wait_time)
+{
+  assert(t != NULL);
+  if (wait_time <= 0)
+  {
+    t->time_up = true;
+  }
+  else
+  {
+    t->deadline = t->ticks + wait_time;
+    t->time_up = false;
+  }
+  fine_pending = false;
+}
+
+void timer_ticker_set_fine(TimerTicker *t, int wait_time, unsigned int phase)
+{
+  assert(t != NULL);
+  assert(phase == fraction_us);
+  if (wait_time <= 0)
+  {
+    timer_ticker_set(t, 0);
+  }
+  else
+  {
+    /* Keep a tick deadline as a backstop, as the real ticker would */
+    timer_ticker_set(t, (int)((phase + (unsigned)wait_time +
+                              MicrosecondsPerTick - 1) / MicrosecondsPerTick));
+    fine_deadline = now_us + (unsigned)wait_time;
+    fine_pending = true;
+  }
+}
+
+CONST _kernel_oserror *timer_ticker_stop(TimerTicker *t)
+{
+  assert(t != NULL);
+  assert(ticker == t);
+  ++os_calls;
+  t->time_up = true;
+  ticker = NULL;
+  fine_pending = false;
+  return NULL;
+}
+
+_kernel_oserror *event_register_wimp_handler(ObjectId object_id,
+  int event_code, WimpEventHandler *handler, void *handle)
+{
+  assert(event_code == Wimp_ENull);
+  NOT_USED(object_id);
+  NOT_USED(event_code);
+  null_handler = handler;
+  null_handle = handle;
+  return NULL;
+}
+
+_kernel_oserror *event_deregister_wimp_handler(ObjectId object_id,
+  int event_code, WimpEventHandler *handler, void *handle)
+{
+  assert(event_code == Wimp_ENull);
+  assert(handler == null_handler);
+  NOT_USED(object_id);
+  NOT_USED(event_code);
+  NOT_USED(handler);
+  NOT_USED(handle);
+  null_handler = NULL;
+  return NULL;
+}
+
+_kernel_oserror *event_get_mask(unsigned int *mask)
+{
+  assert(mask != NULL);
+  *mask = event_mask;
+  return NULL;
+}
+
+_kernel_oserror *event_set_mask(unsigned int mask)
+{
+  event_mask = mask;
+  return NULL;
+}
+
+_kernel_oserror *event_poll(int *event_code, WimpPollBlock *poll_block,
+  void *poll_word)
+{
+  NOT_USED(poll_block);
+  NOT_USED(poll_word);
+  *event_code = Wimp_ENull;
+  return NULL;
+}
+
+_kernel_oserror *event_poll_idle(int *event_code, WimpPollBlock *poll_block,
+  unsigned int earliest, void *poll_word)
+{
+  NOT_USED(poll_block);
+  NOT_USED(poll_word);
+  *event_code = Wimp_ENull;
+  idle_time = (int)earliest;
+  idle_time_valid = true;
+  return NULL;
+}
+
+CONST _kernel_oserror *messagetrans_error_lookup(MessagesFD *mfd,
+  int errnum, const char *token, size_t n, ...)
+{
+  static _kernel_oserror error;
+  NOT_USED(mfd);
+  NOT_USED(errnum);
+  NOT_USED(n);
+  error.errnum = ErrorNum_NoMem;
+  strncpy(error.errmess, token, sizeof(error.errmess) - 1);
+  return &error;
+}
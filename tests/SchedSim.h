@@ -0,0 +1,76 @@
+/*
+ * CBLibrary test: Simulated clock and Wimp for Scheduler
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* SchedSim.h declares functions to drive the scheduler deterministically.
+   SchedSim.c provides stand-ins for the functions of the Timer module, the
+   event library and CBOSLib that the scheduler uses, all of which are driven
+   by a virtual monotonic clock instead of the real one. It must not be
+   linked with the real implementations of those functions. */
+
+#ifndef SchedSim_h
+#define SchedSim_h
+
+/* ISO library headers */
+#include <stdbool.h>
+
+void schedsim_reset(void);
+   /*
+    * Resets the virtual clock to an arbitrary starting time (chosen so that
+    * the centisecond counter wraps around soon afterwards) and forgets any
+    * pending ticker events or null event handler.
+    */
+
+int schedsim_now(void);
+   /*
+    * Returns: the virtual monotonic time, in centiseconds.
+    */
+
+unsigned int schedsim_now_us(void);
+   /*
+    * Returns: the virtual monotonic time, in microseconds (modulo 2^32).
+    */
+
+void schedsim_advance(unsigned int microseconds);
+   /*
+    * Advances the virtual clock, calling any ticker events that become due.
+    * Typically called by a client function to simulate doing some work.
+    */
+
+bool schedsim_null_event(void);
+   /*
+    * Delivers a null event to the registered handler, unless null events
+    * are masked or there is no handler.
+    * Returns: true if a null event was delivered.
+    */
+
+void schedsim_poll(unsigned int other_tasks);
+   /*
+    * Calls scheduler_poll then advances the virtual clock by 'other_tasks'
+    * microseconds (to simulate time spent in other tasks). If null events are
+    * unmasked then the virtual clock is also advanced to the time requested
+    * by the scheduler (if later) and a null event is delivered.
+    */
+
+unsigned long int schedsim_os_calls(void);
+   /*
+    * Returns: the number of simulated OS calls made by the scheduler since
+    * the clock was reset.
+    */
+
+#endif
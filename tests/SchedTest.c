@@ -0,0 +1,758 @@
+/*
+ * CBLibrary test: Scheduler
+ * Copyright (C) 2026 Christopher Bazley
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* ISO library headers */
+#include <stdbool.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* CBLibrary headers */
+#include "Scheduler.h"
+#include "Macros.h"
+
+/* Local headers */
+#include "Tests.h"
+#include "SchedSim.h"
+
+enum
+{
+  TimeSlice = 10, /* centiseconds */
+  MicrosecondsPerTick = 10000,
+  WorkTime = 100, /* microseconds */
+  FirstCall = 50, /* centiseconds */
+  NumberOfClients = 10,
+  NumberOfNullEvents = 1000,
+  NumberOfTokens = 1000,
+  AcceptableShareError = 5, /* percent */
+  IdleGapTime = 1000, /* microseconds */
+  BusyGapTime = 500000, /* microseconds */
+  MinTimeSlice = 2, /* centiseconds */
+  MaxTimeSlice = 40, /* centiseconds */
+  BenchmarkCalls = 200000,
+  BenchmarkPeriods = 50, /* centiseconds */
+  LatencyClients = 200,
+  LatencyNullEvents = 20000,
+  MaxLatencySamples = 1000000,
+  RandomSeed = 12345,
+  OverrunTime = 2000000, /* microseconds (more than the maximum charge) */
+  OverrunNullEvents = 5,
+  PhaseTime = 8000 /* microseconds (into a centisecond) */
+};
+
+typedef struct
+{
+  int calls;
+  SchedulerTime due; /* Time at which next call was requested */
+  SchedulerTime first_time_now; /* 'time_now' on first call */
+  int period; /* centiseconds */
+  unsigned int work; /* microseconds per call, or 0 to run until time up */
+  bool deregister_self;
+  SchedulerToken token;
+}
+Client;
+
+static Client clients[NumberOfTokens];
+static unsigned long int total_calls;
+static unsigned int *latencies;
+static size_t nlatencies;
+static unsigned long int random_state;
+
+static unsigned int next_random(void)
+{
+  /* Deterministic linear congruential generator (from the C standard) */
+  random_state = random_state * 1103515245 + 12345;
+  return (unsigned int)(random_state / 65536) % 32768;
+}
+
+static void record_latency(const Client *client)
+{
+  if (latencies != NULL && nlatencies < MaxLatencySamples)
+  {
+    /* Microseconds since the client became due */
+    latencies[nlatencies++] = schedsim_now_us() -
+                              (unsigned)client->due * MicrosecondsPerTick;
+  }
+}
+
+static SchedulerTime client_function(void *handle, SchedulerTime time_now,
+                                     const volatile bool *time_up)
+{
+  Client *const client = handle;
+  assert(client != NULL);
+
+  total_calls++;
+  if (client->calls++ == 0)
+    client->first_time_now = time_now;
+
+  assert(time_now == schedsim_now());
+  assert(time_now - client->due >= 0);
+  record_latency(client);
+
+  if (client->work > 0)
+  {
+    schedsim_advance(client->work);
+  }
+  else
+  {
+    while (!*time_up)
+      schedsim_advance(WorkTime);
+  }
+
+  if (client->deregister_self)
+  {
+    if (client->token != NULL)
+      scheduler_deregister_token(client->token);
+    else
+      scheduler_deregister(client_function, client);
+  }
+
+  client->due = time_now + client->period;
+  return client->due;
+}
+
+static void init_clients(size_t count)
+{
+  assert(count <= ARRAY_SIZE(clients));
+  for (size_t n = 0; n < count; ++n)
+  {
+    clients[n] = (Client){
+      .calls = 0,
+      .due = schedsim_now(),
+      .first_time_now = 0,
+      .period = 0,
+      .work = WorkTime,
+      .deregister_self = false,
+      .token = NULL
+    };
+  }
+}
+
+static void setup(SchedulerPolicy policy)
+{
+  schedsim_reset();
+  CONST _kernel_oserror *const e = scheduler_initialise(TimeSlice, NULL, NULL);
+  assert(e == NULL);
+  NOT_USED(e);
+  scheduler_set_policy(policy);
+  scheduler_set_fine_timing(true);
+}
+
+static void teardown(void)
+{
+  CONST _kernel_oserror *const e = scheduler_finalise();
+  assert(e == NULL);
+  NOT_USED(e);
+}
+
+static void run(int null_events, unsigned int other_tasks)
+{
+  for (int n = 0; n < null_events; ++n)
+  {
+    schedsim_poll(other_tasks);
+  }
+}
+
+static int compare_unsigned(const void *a, const void *b)
+{
+  unsigned int const x = *(const unsigned int *)a;
+  unsigned int const y = *(const unsigned int *)b;
+  return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static unsigned int percentile(const unsigned int *sorted, size_t count,
+                               unsigned int percent)
+{
+  assert(count > 0);
+  return sorted[(count - 1) * percent / 100];
+}
+
+static void test1(void)
+{
+  /* Register and call when due */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(1);
+  SchedulerTime const first_call = schedsim_now() + FirstCall;
+  clients[0].due = first_call;
+  clients[0].period = 1;
+
+  CONST _kernel_oserror *const e = scheduler_register(client_function,
+    &clients[0], clients[0].due, SchedulerPriority_Max);
+  assert(e == NULL);
+  NOT_USED(e);
+
+  /* Null events should now be unmasked but the client is not yet due */
+  assert(schedsim_null_event());
+  assert(clients[0].calls == 0);
+
+  /* The scheduler should ask not to be woken until the client is due */
+  run(1, 0);
+  assert(clients[0].calls > 0);
+  assert(clients[0].first_time_now == first_call);
+
+  scheduler_deregister(client_function, &clients[0]);
+
+  /* Null events should now be masked */
+  assert(!schedsim_null_event());
+  teardown();
+}
+
+static void test2(void)
+{
+  /* Deregister from within the called function */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(NumberOfClients);
+
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    clients[n].deregister_self = (n % 2) == 0;
+    CONST _kernel_oserror *const e = scheduler_register(client_function,
+      &clients[n], schedsim_now(), SchedulerPriority_Min);
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  run(NumberOfClients, 0);
+
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    if (clients[n].deregister_self)
+    {
+      assert(clients[n].calls == 1);
+    }
+    else
+    {
+      assert(clients[n].calls > 1);
+      scheduler_deregister(client_function, &clients[n]);
+    }
+  }
+  teardown();
+}
+
+static void test3(void)
+{
+  /* Time shared in proportion to priority under fair-share policy */
+  setup(SchedulerPolicy_FairShare);
+  init_clients(NumberOfClients);
+
+  int total_priority = 0;
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    int const priority = SchedulerPriority_Min + (int)n;
+    total_priority += priority;
+    clients[n].work = 0; /* run until time up */
+    CONST _kernel_oserror *const e = scheduler_register(client_function,
+      &clients[n], schedsim_now(), priority);
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  run(NumberOfNullEvents, 0);
+
+  uint64_t total_time = 0;
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    SchedulerClientStats stats;
+    bool const found = scheduler_get_stats(client_function, &clients[n],
+                                           &stats);
+    assert(found);
+    NOT_USED(found);
+    total_time += stats.total_time;
+  }
+
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    SchedulerClientStats stats;
+    (void)scheduler_get_stats(client_function, &clients[n], &stats);
+    int const priority = SchedulerPriority_Min + (int)n;
+    int const share = (int)(stats.total_time * 100 / total_time);
+    int const expected = priority * 100 / total_priority;
+    printf("Priority %d: %d%% of time (expected %d%%)\n", priority, share,
+           expected);
+    assert(abs(share - expected) <= AcceptableShareError);
+    scheduler_deregister(client_function, &clients[n]);
+  }
+  teardown();
+}
+
+static void test4(void)
+{
+  /* Bulk registration, rescheduling and deregistration by token */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(NumberOfTokens);
+
+  static SchedulerRegistration registrations[NumberOfTokens];
+  static SchedulerToken tokens[NumberOfTokens];
+  for (size_t n = 0; n < NumberOfTokens; ++n)
+  {
+    clients[n].due = schedsim_now() + FirstCall;
+    clients[n].period = FirstCall;
+    registrations[n] = (SchedulerRegistration){
+      .function = client_function,
+      .handle = &clients[n],
+      .first_call = clients[n].due,
+      .priority = SchedulerPriority_Min
+    };
+  }
+
+  CONST _kernel_oserror *const e = scheduler_register_many(registrations,
+    NumberOfTokens, tokens);
+  assert(e == NULL);
+  NOT_USED(e);
+
+  /* Bring one client forward */
+  clients[0].due = schedsim_now();
+  scheduler_reschedule(tokens[0], clients[0].due);
+  assert(schedsim_null_event());
+  assert(clients[0].calls == 1);
+  assert(clients[1].calls == 0);
+
+  /* Deregister half without calling them */
+  scheduler_deregister_many(tokens + NumberOfTokens / 2, NumberOfTokens / 2);
+  run(1, 0);
+
+  for (size_t n = 0; n < NumberOfTokens; ++n)
+  {
+    assert((n < NumberOfTokens / 2) == (clients[n].calls > 0));
+  }
+
+  scheduler_deregister_many(tokens, NumberOfTokens / 2);
+  assert(!schedsim_null_event());
+  teardown();
+}
+
+static void test5(void)
+{
+  /* Adaptive time slice */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(1);
+  clients[0].work = 0; /* run until time up */
+  scheduler_set_adaptive_time_slice(MinTimeSlice, MaxTimeSlice);
+
+  CONST _kernel_oserror *const e = scheduler_register(client_function,
+    &clients[0], schedsim_now(), SchedulerPriority_Max);
+  assert(e == NULL);
+  NOT_USED(e);
+
+  run(NumberOfClients, IdleGapTime);
+  assert(scheduler_get_time_slice() == MaxTimeSlice);
+
+  run(NumberOfClients, BusyGapTime);
+  assert(scheduler_get_time_slice() == MinTimeSlice);
+
+  scheduler_set_time_slice(TimeSlice);
+  run(NumberOfClients, IdleGapTime);
+  assert(scheduler_get_time_slice() == TimeSlice);
+
+  scheduler_deregister(client_function, &clients[0]);
+  teardown();
+}
+
+static void test6(void)
+{
+  /* OS calls per null event do not depend on the number of clients */
+  unsigned long int os_calls[2];
+  size_t const nclients[ARRAY_SIZE(os_calls)] = {1, NumberOfTokens};
+
+  for (size_t t = 0; t < ARRAY_SIZE(os_calls); ++t)
+  {
+    setup(SchedulerPolicy_Deadline);
+    scheduler_set_fine_timing(false);
+    init_clients(nclients[t]);
+
+    for (size_t n = 0; n < nclients[t]; ++n)
+    {
+      clients[n].work = 1;
+      clients[n].period = 1;
+      CONST _kernel_oserror *const e = scheduler_register_token(
+        client_function, &clients[n], schedsim_now(), SchedulerPriority_Min,
+        &clients[n].token);
+      assert(e == NULL);
+      NOT_USED(e);
+    }
+
+    unsigned long int const before = schedsim_os_calls();
+    assert(schedsim_null_event());
+    os_calls[t] = schedsim_os_calls() - before;
+
+    for (size_t n = 0; n < nclients[t]; ++n)
+    {
+      assert(clients[n].calls == 1);
+      scheduler_deregister_token(clients[n].token);
+    }
+    teardown();
+  }
+
+  printf("OS calls per null event: %lu (1 client), %lu (%d clients)\n",
+         os_calls[0], os_calls[1], NumberOfTokens);
+  assert(os_calls[0] == os_calls[1]);
+}
+
+static void call_after_function(void *arg)
+{
+  Client *const client = arg;
+  assert(client != NULL);
+  assert(schedsim_now() - client->due >= 0);
+  client->calls++;
+}
+
+static void test7(void)
+{
+  /* Call once after a delay, or cancel */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(2);
+
+  for (size_t n = 0; n < 2; ++n)
+  {
+    clients[n].due = schedsim_now() + FirstCall;
+    CONST _kernel_oserror *const e = scheduler_call_after(FirstCall,
+      call_after_function, &clients[n], &clients[n].token);
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  /* Not due yet */
+  assert(schedsim_null_event());
+  assert(clients[0].calls == 0);
+
+  scheduler_deregister_token(clients[1].token);
+  run(NumberOfClients, 0);
+  assert(clients[0].calls == 1);
+  assert(clients[1].calls == 0);
+
+  /* No clients remain, so null events should be masked */
+  assert(!schedsim_null_event());
+  teardown();
+}
+
+static void test8(void)
+{
+  /* Due clients called in turn */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(NumberOfClients);
+
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    /* Ask to be called again at a time already past */
+    clients[n].period = -FirstCall;
+    CONST _kernel_oserror *const e = scheduler_register(client_function,
+      &clients[n], schedsim_now(), SchedulerPriority_Min);
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  run(NumberOfClients, 0);
+
+  int min_calls = INT_MAX, max_calls = 0;
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    min_calls = LOWEST(min_calls, clients[n].calls);
+    max_calls = HIGHEST(max_calls, clients[n].calls);
+    scheduler_deregister(client_function, &clients[n]);
+  }
+
+  printf("Calls per client: %d to %d\n", min_calls, max_calls);
+  assert(min_calls > 0);
+  assert(max_calls <= min_calls * 2);
+  teardown();
+}
+
+static void test9(void)
+{
+  /* Maximum charge under fair-share policy */
+  setup(SchedulerPolicy_FairShare);
+  init_clients(2);
+
+  /* The first client overruns its time slice by far more than can be
+     charged, at the lowest priority, so that its virtual time increases by
+     more than fits in a 32-bit signed integer */
+  clients[0].work = OverrunTime;
+  for (size_t n = 0; n < 2; ++n)
+  {
+    CONST _kernel_oserror *const e = scheduler_register(client_function,
+      &clients[n], schedsim_now(), SchedulerPriority_Min);
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  run(1, 0);
+  assert(clients[0].calls == 1);
+
+  /* The client that overran should now be last in the queue */
+  int const calls = clients[1].calls;
+  run(OverrunNullEvents, 0);
+  printf("Calls after overrun: %d and %d\n", clients[0].calls,
+         clients[1].calls);
+  assert(clients[0].calls == 1);
+  assert(clients[1].calls > calls);
+  NOT_USED(calls);
+
+  for (size_t n = 0; n < 2; ++n)
+    scheduler_deregister(client_function, &clients[n]);
+
+  teardown();
+}
+
+static void test10(void)
+{
+  /* Time up measured from sub-centisecond start time */
+  setup(SchedulerPolicy_Deadline);
+  init_clients(1);
+  clients[0].work = 0; /* run until time up */
+  clients[0].period = FirstCall; /* not due again during the null event */
+
+  CONST _kernel_oserror *const e = scheduler_register(client_function,
+    &clients[0], schedsim_now(), SchedulerPriority_Min);
+  assert(e == NULL);
+  NOT_USED(e);
+
+  /* Start the client most of the way through a centisecond, so that the
+     next tick comes long before its time slice has expired */
+  schedsim_advance(PhaseTime);
+  unsigned int const start = schedsim_now_us();
+  run(1, 0);
+  unsigned int const elapsed = schedsim_now_us() - start;
+  printf("Time slice %d, ran for %u microseconds\n",
+         SchedulerPriority_Min * MicrosecondsPerTick, elapsed);
+  assert(clients[0].calls == 1);
+  assert(elapsed >= SchedulerPriority_Min * MicrosecondsPerTick);
+  assert(elapsed <= SchedulerPriority_Min * MicrosecondsPerTick + WorkTime);
+  NOT_USED(elapsed);
+
+  scheduler_deregister(client_function, &clients[0]);
+  teardown();
+}
+
+void Scheduler_tests(void)
+{
+  static const struct
+  {
+    const char *test_name;
+    void (*test_func)(void);
+  }
+  unit_tests[] =
+  {
+    { "Register and call when due", test1 },
+    { "Deregister from within function", test2 },
+    { "Fair share", test3 },
+    { "Register and deregister many", test4 },
+    { "Adaptive time slice", test5 },
+    { "OS calls per null event", test6 },
+    { "Call after delay", test7 },
+    { "Due clients called in turn", test8 },
+    { "Maximum charge under fair share", test9 },
+    { "Fine time slice", test10 }
+  };
+
+  for (size_t count = 0; count < ARRAY_SIZE(unit_tests); count ++)
+  {
+    printf("Test %zu/%zu : %s\n",
+           1 + count,
+           ARRAY_SIZE(unit_tests),
+           unit_tests[count].test_name);
+
+    unit_tests[count].test_func();
+  }
+}
+
+/* ----------------------------------------------------------------------- */
+/*                              Benchmarks                                 */
+
+static void bench_dispatch(size_t nclients)
+{
+  /* Measure the host CPU time taken to dispatch calls to many clients,
+     each of which is due periodically and does little work */
+  setup(SchedulerPolicy_Deadline);
+  random_state = RandomSeed;
+
+  Client *const bclients = malloc(sizeof(*bclients) * nclients);
+  SchedulerRegistration *const registrations =
+    malloc(sizeof(*registrations) * nclients);
+  SchedulerToken *const tokens = malloc(sizeof(*tokens) * nclients);
+  assert(bclients != NULL && registrations != NULL && tokens != NULL);
+
+  for (size_t n = 0; n < nclients; ++n)
+  {
+    bclients[n] = (Client){
+      .calls = 0,
+      .due = schedsim_now(),
+      .period = 1 + (int)(next_random() % BenchmarkPeriods),
+      .work = 1 + next_random() % WorkTime,
+      .deregister_self = false,
+      .token = NULL
+    };
+    registrations[n] = (SchedulerRegistration){
+      .function = client_function,
+      .handle = &bclients[n],
+      .first_call = bclients[n].due,
+      .priority = SchedulerPriority_Min + (int)(n % SchedulerPriority_Max)
+    };
+  }
+
+  CONST _kernel_oserror *const e = scheduler_register_many(registrations,
+    nclients, tokens);
+  assert(e == NULL);
+  NOT_USED(e);
+
+  SchedulerStats before;
+  scheduler_get_totals(&before);
+
+  total_calls = 0;
+  clock_t const start = clock();
+  while (total_calls < BenchmarkCalls)
+  {
+    schedsim_poll(0);
+  }
+  clock_t const elapsed = clock() - start;
+  unsigned long int const calls = total_calls;
+
+  SchedulerStats after;
+  scheduler_get_totals(&after);
+
+  printf("%zu clients: %lu calls in %lu null events, %.3f us per call "
+         "(host CPU time)\n",
+         nclients, calls, after.null_events - before.null_events,
+         (double)elapsed * 1e6 / CLOCKS_PER_SEC / (double)calls);
+
+  scheduler_deregister_many(tokens, nclients);
+  free(tokens);
+  free(registrations);
+  free(bclients);
+  teardown();
+}
+
+static void bench_fairness(SchedulerPolicy policy)
+{
+  /* Measure the share of time given to clients of mixed priorities that
+     always want to run */
+  setup(policy);
+  init_clients(NumberOfClients);
+
+  int total_priority = 0;
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    int const priority = SchedulerPriority_Min + (int)n;
+    total_priority += priority;
+    clients[n].work = 0;
+    CONST _kernel_oserror *const e = scheduler_register(client_function,
+      &clients[n], schedsim_now(), priority);
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  run(NumberOfNullEvents, 0);
+
+  double weighted[NumberOfClients], sum = 0, sum_squares = 0;
+  uint64_t total_time = 0;
+  SchedulerClientStats stats[NumberOfClients];
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    (void)scheduler_get_stats(client_function, &clients[n], &stats[n]);
+    total_time += stats[n].total_time;
+  }
+
+  printf("%s policy:\n", policy == SchedulerPolicy_FairShare ?
+                         "Fair-share" : "Deadline");
+
+  for (size_t n = 0; n < NumberOfClients; ++n)
+  {
+    int const priority = SchedulerPriority_Min + (int)n;
+    double const share = (double)stats[n].total_time / (double)total_time;
+    double const expected = (double)priority / total_priority;
+    printf("  priority %2d: %5.1f%% of time (%5.1f%% by priority), "
+           "%lu calls\n", priority, share * 100, expected * 100,
+           stats[n].invocations);
+    weighted[n] = share / expected;
+    sum += weighted[n];
+    sum_squares += weighted[n] * weighted[n];
+    scheduler_deregister(client_function, &clients[n]);
+  }
+
+  /* Jain's index is 1.0 if time is shared exactly in proportion to
+     priority */
+  printf("  fairness index: %.3f\n",
+         sum * sum / (NumberOfClients * sum_squares));
+  teardown();
+}
+
+static void bench_latency(SchedulerPolicy policy)
+{
+  /* Measure the time between periodic clients becoming due and being called
+     when they need most of the time available */
+  setup(policy);
+  init_clients(LatencyClients);
+  random_state = RandomSeed;
+
+  latencies = malloc(sizeof(*latencies) * MaxLatencySamples);
+  assert(latencies != NULL);
+  nlatencies = 0;
+
+  for (size_t n = 0; n < LatencyClients; ++n)
+  {
+    clients[n].due = schedsim_now();
+    clients[n].period = 5 + (int)(next_random() % 96);
+    clients[n].work = 100 + next_random() % 2900;
+    CONST _kernel_oserror *const e = scheduler_register(client_function,
+      &clients[n], clients[n].due,
+      SchedulerPriority_Min + (int)(n % SchedulerPriority_Max));
+    assert(e == NULL);
+    NOT_USED(e);
+  }
+
+  run(LatencyNullEvents, 2 * MicrosecondsPerTick);
+
+  qsort(latencies, nlatencies, sizeof(*latencies), compare_unsigned);
+  printf("%s policy: %zu calls, latency p50 %u us, p90 %u us, p99 %u us, "
+         "max %u us\n", policy == SchedulerPolicy_FairShare ?
+                        "Fair-share" : "Deadline",
+         nlatencies, percentile(latencies, nlatencies, 50),
+         percentile(latencies, nlatencies, 90),
+         percentile(latencies, nlatencies, 99),
+         latencies[nlatencies - 1]);
+
+  free(latencies);
+  latencies = NULL;
+
+  for (size_t n = 0; n < LatencyClients; ++n)
+  {
+    scheduler_deregister(client_function, &clients[n]);
+  }
+  teardown();
+}
+
+void Scheduler_benchmarks(void)
+{
+  static const size_t nclients[] = {10, 1000, 100000};
+
+  puts("Null event dispatch");
+  for (size_t n = 0; n < ARRAY_SIZE(nclients); ++n)
+  {
+    bench_dispatch(nclients[n]);
+  }
+
+  puts("\nFairness under mixed priorities");
+  bench_fairness(SchedulerPolicy_Deadline);
+  bench_fairness(SchedulerPolicy_FairShare);
+
+  puts("\nLatency under mixed priorities");
+  bench_latency(SchedulerPolicy_Deadline);
+  bench_latency(SchedulerPolicy_FairShare);
+}
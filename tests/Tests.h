@@ -42,12 +42,17 @@
 
 #endif /* USE_CBDEBUG */
 
+void CatCache_tests(void);
+void Coroutine_tests(void);
 void DecodeLExe_tests(void);
 void DirIter_tests(void);
+void DirSnap_tests(void);
 void IntVector_tests(void);
 void Macros_tests(void);
 void MakePath_tests(void);
 void PathTail_tests(void);
+void Scheduler_benchmarks(void);
+void Scheduler_tests(void);
 void Timer_tests(void);
 void UserData_tests(void);
 